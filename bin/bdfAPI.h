@@ -22,6 +22,8 @@
 namespace filereader {
 	/// <summary>
 	///  Public Abstract BDF API Interface
+	///  An API object is not thread safe: the calls on one object must be serialized. To read from several
+	///  threads, open the file with one API object per thread (see bdfParallel.h).
 	/// </summary>
 	class bdfAPI {
 	public:
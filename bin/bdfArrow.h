@@ -0,0 +1,588 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfConvert.h"
+#include "bdfParallel.h"
+
+namespace filereader {
+	/// <summary>
+	/// Minimal FlatBuffers encoder for the Arrow IPC metadata. The buffer is laid out front to back:
+	/// every table is written before the objects it references, and the offset slots of the table are
+	/// patched once the referenced string, vector or table has been appended.
+	/// </summary>
+	class bdfFlatBuilder {
+	public:
+		/// One scalar or offset field of a table
+		struct sField {
+			unsigned Id;
+			unsigned Size;
+			uint64_t Value;
+			bool Offset;
+		};
+
+		static sField scalar(unsigned Id, unsigned Size, uint64_t Value) { return sField{ Id, Size, Value, false }; }
+		static sField offset(unsigned Id) { return sField{ Id, 4, 0, true }; }
+
+		bdfFlatBuilder() : m_Data(4, 0) {}
+
+		const std::string& data() const { return m_Data; }
+
+		/// Set the root table
+		void root(size_t Table) { patch(0, Table); }
+
+		/// Point an offset slot to an object written after it
+		void patch(size_t Slot, size_t Target) {
+			const uint32_t value = (uint32_t)(Target - Slot);
+			memcpy(&m_Data[Slot], &value, sizeof(value));
+		}
+
+		/// <summary>
+		/// Write a vtable and its table
+		/// </summary>
+		/// <param name="Slots">Receives the positions of the offset fields, in the order of Fields</param>
+		/// <returns>Position of the table</returns>
+		size_t table(const std::vector<sField>& Fields, std::vector<size_t>& Slots) {
+			unsigned nrOfIds = 0;
+			for (const sField& f : Fields) nrOfIds = std::max(nrOfIds, f.Id + 1);
+			std::vector<uint16_t> vtable(nrOfIds, 0);
+			std::vector<size_t> at(Fields.size());
+			size_t size = 4;
+			for (size_t k = 0; k < Fields.size(); k++) {
+				size = (size + Fields[k].Size - 1) / Fields[k].Size * Fields[k].Size;
+				at[k] = size;
+				vtable[Fields[k].Id] = (uint16_t)size;
+				size += Fields[k].Size;
+			}
+
+			align(2);
+			const size_t vtablePosition = m_Data.size();
+			put<uint16_t>((uint16_t)(4 + 2 * nrOfIds));
+			put<uint16_t>((uint16_t)size);
+			for (uint16_t v : vtable) put<uint16_t>(v);
+
+			align(8);
+			const size_t tablePosition = m_Data.size();
+			m_Data.append(size, 0);
+			const int32_t vtableOffset = (int32_t)(tablePosition - vtablePosition);
+			memcpy(&m_Data[tablePosition], &vtableOffset, sizeof(vtableOffset));
+			Slots.clear();
+			for (size_t k = 0; k < Fields.size(); k++) {
+				if (Fields[k].Offset) Slots.push_back(tablePosition + at[k]);
+				else memcpy(&m_Data[tablePosition + at[k]], &Fields[k].Value, Fields[k].Size);
+			}
+			return tablePosition;
+		}
+
+		/// Write a string, returns its position
+		size_t string(const std::string& Value) {
+			align(4);
+			const size_t position = m_Data.size();
+			put<uint32_t>((uint32_t)Value.size());
+			m_Data.append(Value);
+			m_Data.push_back(0);
+			return position;
+		}
+
+		/// <summary>
+		/// Write a vector of offsets to tables
+		/// </summary>
+		/// <param name="Slots">Receives the position of each element</param>
+		/// <returns>Position of the vector</returns>
+		size_t offsets(size_t Count, std::vector<size_t>& Slots) {
+			align(4);
+			const size_t position = m_Data.size();
+			put<uint32_t>((uint32_t)Count);
+			Slots.resize(Count);
+			for (size_t n = 0; n < Count; n++) {
+				Slots[n] = m_Data.size();
+				put<uint32_t>(0);
+			}
+			return position;
+		}
+
+		/// Write a vector of structs with 8 byte alignment, returns its position
+		size_t structs(const void* Data, size_t Count, size_t ElementSize) {
+			align(4);
+			if ((m_Data.size() + 4) % 8) m_Data.append(4, 0);
+			const size_t position = m_Data.size();
+			put<uint32_t>((uint32_t)Count);
+			m_Data.append(static_cast<const char*>(Data), Count * ElementSize);
+			return position;
+		}
+
+	private:
+		void align(size_t Alignment) {
+			while (m_Data.size() % Alignment) m_Data.push_back(0);
+		}
+
+		template <typename T> void put(T Value) {
+			m_Data.append(reinterpret_cast<const char*>(&Value), sizeof(Value));
+		}
+
+		std::string m_Data;
+	};
+
+	/// <summary>
+	/// Writes a self contained Arrow IPC file (format version 5) with floating point columns and
+	/// without nulls. The body of a record batch is written exactly as the caller filled it: the
+	/// columns are placed at the offsets of bodyLayout, so data converted straight into that buffer is
+	/// never copied again before it reaches the file.
+	/// </summary>
+	class bdfArrowWriter {
+	public:
+		typedef std::vector<std::pair<std::string, std::string>> tMetadata;
+
+		enum eColumnType {
+			columnFloat,	/// 32 bit IEEE floating point
+			columnDouble	/// 64 bit IEEE floating point
+		};
+
+		struct sColumn {
+			std::string Name;
+			eColumnType Type;
+			tMetadata Metadata;
+		};
+
+		/// Alignment of the column buffers in a record batch body
+		static const size_t BufferAlignment = 64;
+
+		~bdfArrowWriter() {
+			if (m_File.is_open()) close();
+		}
+
+		static size_t bytesPerValue(eColumnType Type) { return Type == columnFloat ? 4 : 8; }
+
+		/// <summary>
+		/// Offsets of the column buffers in the body of a record batch
+		/// </summary>
+		/// <param name="Rows">Number of rows of the batch</param>
+		/// <param name="BodyLength">Receives the length of the body</param>
+		static std::vector<size_t> bodyLayout(const std::vector<sColumn>& Columns, uint64_t Rows, size_t& BodyLength) {
+			std::vector<size_t> offsets(Columns.size());
+			BodyLength = 0;
+			for (size_t c = 0; c < Columns.size(); c++) {
+				offsets[c] = BodyLength;
+				BodyLength += padded((size_t)Rows * bytesPerValue(Columns[c].Type), BufferAlignment);
+			}
+			return offsets;
+		}
+
+		/// <summary>
+		/// Create the file and write the schema
+		/// </summary>
+		/// <param name="Metadata">Key/value pairs stored with the schema</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode open(const std::string& FileName, const std::vector<sColumn>& Columns, const tMetadata& Metadata) {
+			if (m_File.is_open()) close();
+			if (Columns.empty()) return bdfAPI::errArgument;
+			m_Columns = Columns;
+			m_Metadata = Metadata;
+			m_Batches.clear();
+			m_File.open(FileName, std::ios::binary | std::ios::trunc);
+			if (!m_File) return bdfAPI::errResource;
+			m_File.write("ARROW1\0\0", 8);
+			m_Position = 8;
+
+			bdfFlatBuilder builder;
+			std::vector<size_t> slots;
+			builder.root(builder.table({ bdfFlatBuilder::scalar(0, 2, MetadataVersion), bdfFlatBuilder::scalar(1, 1, headerSchema),
+				bdfFlatBuilder::offset(2), bdfFlatBuilder::scalar(3, 8, 0) }, slots));
+			builder.patch(slots[0], schema(builder));
+			return message(builder, nullptr, 0);
+		}
+
+		/// <summary>
+		/// Append a record batch
+		/// </summary>
+		/// <param name="Rows">Number of rows</param>
+		/// <param name="Body">Column buffers at the offsets of bodyLayout, BodyLength bytes</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode writeBatch(uint64_t Rows, const char* Body, size_t BodyLength) {
+			if (!m_File.is_open()) return bdfAPI::errInvalidHandle;
+			size_t length;
+			const std::vector<size_t> offsets = bodyLayout(m_Columns, Rows, length);
+			if (BodyLength != length) return bdfAPI::errArgument;
+
+			std::vector<int64_t> nodes, buffers;
+			for (size_t c = 0; c < m_Columns.size(); c++) {
+				nodes.insert(nodes.end(), { (int64_t)Rows, 0 });
+				// no validity bitmap, then the values
+				buffers.insert(buffers.end(), { (int64_t)offsets[c], 0, (int64_t)offsets[c], (int64_t)(Rows * bytesPerValue(m_Columns[c].Type)) });
+			}
+
+			bdfFlatBuilder builder;
+			std::vector<size_t> slots, batchSlots;
+			builder.root(builder.table({ bdfFlatBuilder::scalar(0, 2, MetadataVersion), bdfFlatBuilder::scalar(1, 1, headerRecordBatch),
+				bdfFlatBuilder::offset(2), bdfFlatBuilder::scalar(3, 8, (uint64_t)BodyLength) }, slots));
+			builder.patch(slots[0], builder.table({ bdfFlatBuilder::scalar(0, 8, Rows), bdfFlatBuilder::offset(1), bdfFlatBuilder::offset(2) }, batchSlots));
+			builder.patch(batchSlots[0], builder.structs(nodes.data(), m_Columns.size(), 16));
+			builder.patch(batchSlots[1], builder.structs(buffers.data(), 2 * m_Columns.size(), 16));
+			return message(builder, Body, BodyLength, true);
+		}
+
+		/// <summary>
+		/// Write the end of stream marker and the footer and close the file
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode close() {
+			if (!m_File.is_open()) return bdfAPI::errInvalidHandle;
+			const uint32_t endOfStream[2] = { Continuation, 0 };
+			m_File.write(reinterpret_cast<const char*>(endOfStream), sizeof(endOfStream));
+
+			bdfFlatBuilder builder;
+			std::vector<size_t> slots;
+			builder.root(builder.table({ bdfFlatBuilder::scalar(0, 2, MetadataVersion), bdfFlatBuilder::offset(1), bdfFlatBuilder::offset(3) }, slots));
+			builder.patch(slots[0], schema(builder));
+			builder.patch(slots[1], builder.structs(m_Batches.data(), m_Batches.size(), sizeof(sBlock)));
+			const std::string& footer = builder.data();
+			const uint32_t footerLength = (uint32_t)footer.size();
+			m_File.write(footer.data(), footer.size());
+			m_File.write(reinterpret_cast<const char*>(&footerLength), sizeof(footerLength));
+			m_File.write("ARROW1", 6);
+			m_Position += sizeof(endOfStream) + footer.size() + sizeof(footerLength) + 6;
+			const bool ok = (bool)m_File;
+			m_File.close();
+			return ok && m_File ? bdfAPI::errNoError : bdfAPI::errResource;
+		}
+
+		/// Number of record batches written
+		size_t numberOfBatches() const { return m_Batches.size(); }
+
+		/// Number of bytes written
+		uint64_t bytesWritten() const { return m_Position; }
+
+	private:
+		static const uint16_t MetadataVersion = 4;	/// V5
+		static const uint32_t Continuation = 0xFFFFFFFF;
+		enum { headerSchema = 1, headerRecordBatch = 3 };
+		enum { typeFloatingPoint = 3 };
+		enum { precisionSingle = 1, precisionDouble = 2 };
+
+		/// File block of a record batch, as stored in the footer
+		struct sBlock {
+			int64_t Offset;
+			int32_t MetaDataLength;
+			int32_t Padding;
+			int64_t BodyLength;
+		};
+
+		static size_t padded(size_t Size, size_t Alignment) { return (Size + Alignment - 1) / Alignment * Alignment; }
+
+		size_t schema(bdfFlatBuilder& Builder) {
+			std::vector<size_t> slots, fieldSlots, metadataSlots, columnSlots;
+			const size_t position = Builder.table({ bdfFlatBuilder::offset(1), bdfFlatBuilder::offset(2) }, slots);
+			Builder.patch(slots[0], Builder.offsets(m_Columns.size(), fieldSlots));
+			Builder.patch(slots[1], metadata(Builder, m_Metadata));
+			for (size_t c = 0; c < m_Columns.size(); c++) {
+				const sColumn& column = m_Columns[c];
+				Builder.patch(fieldSlots[c], Builder.table({ bdfFlatBuilder::offset(0), bdfFlatBuilder::scalar(1, 1, 0), bdfFlatBuilder::scalar(2, 1, typeFloatingPoint),
+					bdfFlatBuilder::offset(3), bdfFlatBuilder::offset(5), bdfFlatBuilder::offset(6) }, columnSlots));
+				Builder.patch(columnSlots[0], Builder.string(column.Name));
+				std::vector<size_t> typeSlots;
+				Builder.patch(columnSlots[1], Builder.table({ bdfFlatBuilder::scalar(0, 2, column.Type == columnFloat ? precisionSingle : precisionDouble) }, typeSlots));
+				Builder.patch(columnSlots[2], Builder.offsets(0, typeSlots));
+				Builder.patch(columnSlots[3], metadata(Builder, column.Metadata));
+			}
+			return position;
+		}
+
+		static size_t metadata(bdfFlatBuilder& Builder, const tMetadata& Metadata) {
+			std::vector<size_t> slots, pairSlots;
+			const size_t position = Builder.offsets(Metadata.size(), slots);
+			for (size_t n = 0; n < Metadata.size(); n++) {
+				Builder.patch(slots[n], Builder.table({ bdfFlatBuilder::offset(0), bdfFlatBuilder::offset(1) }, pairSlots));
+				Builder.patch(pairSlots[0], Builder.string(Metadata[n].first));
+				Builder.patch(pairSlots[1], Builder.string(Metadata[n].second));
+			}
+			return position;
+		}
+
+		/// Write an encapsulated message: continuation marker, metadata length, metadata and body
+		bdfAPI::eErrorCode message(const bdfFlatBuilder& Builder, const char* Body, size_t BodyLength, bool RecordBatch = false) {
+			const std::string& data = Builder.data();
+			const uint32_t prefix[2] = { Continuation, (uint32_t)padded(data.size(), 8) };
+			const size_t padding = prefix[1] - data.size();
+			if (RecordBatch) m_Batches.push_back(sBlock{ (int64_t)m_Position, (int32_t)(sizeof(prefix) + prefix[1]), 0, (int64_t)BodyLength });
+			m_File.write(reinterpret_cast<const char*>(prefix), sizeof(prefix));
+			m_File.write(data.data(), data.size());
+			m_File.write("\0\0\0\0\0\0\0", padding);
+			if (BodyLength) m_File.write(Body, BodyLength);
+			m_Position += sizeof(prefix) + prefix[1] + BodyLength;
+			return m_File ? bdfAPI::errNoError : bdfAPI::errResource;
+		}
+
+		std::ofstream m_File;
+		std::vector<sColumn> m_Columns;
+		tMetadata m_Metadata;
+		std::vector<sBlock> m_Batches;
+		uint64_t m_Position = 0;
+	};
+
+	/// Settings of bdfArrowExport
+	struct sArrowExportConfig {
+		/// Scaling of the input columns
+		bdfConvert::eUnit Unit = bdfConvert::unitVolt;
+		/// float instead of double columns
+		bool SinglePrecision = false;
+		/// Add a "time" column in seconds relative to the trigger sample
+		bool TimeColumn = true;
+		/// Rows per record batch
+		unsigned BatchRows = 1 << 18;
+		/// Batch bodies in memory, 0 for two per worker thread
+		unsigned BatchesInFlight = 0;
+	};
+
+	/// Counters of bdfArrowExport
+	struct sArrowExportStatistics {
+		uint64_t Files;
+		uint64_t Batches;
+		uint64_t Rows;
+		uint64_t Bytes;
+		double Seconds;
+	};
+
+	/// <summary>
+	/// Export of recordings to Arrow IPC files, one file per group and block. Each input becomes a
+	/// column named after its ChName attribute, scaled to volt or physical unit, with the channel
+	/// attributes and scaling factors as field metadata; an optional time column holds the time
+	/// relative to the trigger. The block is cut into record batches that the workers of a
+	/// bdfParallelReader convert directly into the batch bodies, while the finished batches are
+	/// written in order. At most BatchesInFlight bodies exist at any time, so memory stays bounded
+	/// independent of the block length.
+	/// </summary>
+	class bdfArrowExport {
+	public:
+		/// File name of one group and block: BaseName_g<Group>_b<Block>.arrow
+		static std::string fileName(const std::string& BaseName, unsigned Group, unsigned Block) {
+			return BaseName + "_g" + std::to_string(Group) + "_b" + std::to_string(Block) + ".arrow";
+		}
+
+		/// <summary>
+		/// Export one block of a group
+		/// </summary>
+		/// <param name="Reader">Workers with the file loaded</param>
+		/// <param name="Statistics">Optional, the counters are accumulated</param>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode exportBlock(bdfParallelReader& Reader, unsigned Group, unsigned Block, const std::string& FileName, const sArrowExportConfig& Config = sArrowExportConfig(), sArrowExportStatistics* Statistics = nullptr) {
+			bdfAPI* api = Reader.api();
+			if (api == nullptr) return bdfAPI::errInvalidHandle;
+			if (Config.BatchRows == 0) return bdfAPI::errArgument;
+			const auto startTime = std::chrono::steady_clock::now();
+
+			// metadata, read before the workers start
+			const unsigned nrOfInputs = api->getNumberOfInputs(Group);
+			if (nrOfInputs == 0) return bdfAPI::errArgument;
+			std::vector<bdfAPI::sInputInfo> inputInfos(nrOfInputs);
+			std::vector<bdfAPI::sBlockInfo> blockInfos(nrOfInputs);
+			bdfAPI::eOperationMode mode;
+			bdfAPI::eErrorCode err = api->getOperationMode(Group, mode);
+			if (err != bdfAPI::errNoError) return err;
+			uint64_t rows = 0;
+			for (unsigned i = 0; i < nrOfInputs; i++) {
+				err = api->getInputInfo(Group, i, &inputInfos[i]);
+				if (err != bdfAPI::errNoError) return err;
+				err = api->getBlockInfo(Group, i, Block, &blockInfos[i]);
+				if (err != bdfAPI::errNoError) return err;
+				rows = std::max(rows, blockInfos[i].BlockLength);
+			}
+			const bdfAPI::sBlockInfo& blockInfo = blockInfos[0];
+			const double divisor = blockInfo.TimebaseDivisor > 0 ? blockInfo.TimebaseDivisor : 1;
+			const double sampleRate = blockInfo.SampleRateHertz > 0 ? blockInfo.SampleRateHertz / divisor : 1;
+
+			const bdfArrowWriter::eColumnType type = Config.SinglePrecision ? bdfArrowWriter::columnFloat : bdfArrowWriter::columnDouble;
+			std::vector<bdfArrowWriter::sColumn> columns;
+			if (Config.TimeColumn) columns.push_back(bdfArrowWriter::sColumn{ "time", bdfArrowWriter::columnDouble, { { "unit", "s" } } });
+			for (unsigned i = 0; i < nrOfInputs; i++) columns.push_back(column(api, Group, i, inputInfos[i], type, Config.Unit, columns));
+
+			char startTimeText[32];
+			const bdfAPI::sDateTime& s = blockInfo.StartTime;
+			snprintf(startTimeText, sizeof(startTimeText), "%04u-%02u-%02uT%02u:%02u:%02u.%03u", s.Year, s.Month, s.Day, s.Hour, s.Minute, s.Second, s.MilliSecond);
+			const bdfArrowWriter::tMetadata metadata = {
+				{ "Group", std::to_string(Group) },
+				{ "Block", std::to_string(Block) },
+				{ "OperationMode", std::to_string((int)mode) },
+				{ "StartTime", startTimeText },
+				{ "SampleRateHertz", number(blockInfo.SampleRateHertz) },
+				{ "TimebaseDivisor", std::to_string(blockInfo.TimebaseDivisor) },
+				{ "TriggerSample", std::to_string(blockInfo.TriggerSample) },
+				{ "TriggerTimeSeconds", number(blockInfo.TriggerTimeSeconds) },
+				{ "StopTriggerSample", std::to_string(blockInfo.StopTriggerSample) },
+			};
+
+			bdfArrowWriter writer;
+			err = writer.open(FileName, columns, metadata);
+			if (err != bdfAPI::errNoError) return err;
+
+			// pipeline: batch n is converted into slot n % window and written once all batches before it are
+			const size_t nrOfBatches = (size_t)((rows + Config.BatchRows - 1) / Config.BatchRows);
+			const size_t window = Config.BatchesInFlight ? Config.BatchesInFlight : 2 * (size_t)std::max(1u, Reader.numberOfThreads());
+			std::vector<std::vector<char>> bodies(std::min(window, std::max<size_t>(nrOfBatches, 1)));
+			std::vector<bool> ready(bodies.size(), false);
+			std::mutex mutex;
+			std::condition_variable slotFree;
+			size_t nextToWrite = 0;
+			bool failed = false;
+
+			err = Reader.run(nrOfBatches, [&](bdfAPI* Api, size_t n) {
+				const size_t slot = n % bodies.size();
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					slotFree.wait(lock, [&] { return failed || n < nextToWrite + bodies.size(); });
+					if (failed) return bdfAPI::errInternal;
+				}
+
+				const uint64_t address = (uint64_t)n * Config.BatchRows;
+				const unsigned count = (unsigned)std::min<uint64_t>(Config.BatchRows, rows - address);
+				size_t bodyLength;
+				const std::vector<size_t> offsets = bdfArrowWriter::bodyLayout(columns, count, bodyLength);
+				std::vector<char>& body = bodies[slot];
+				if (body.size() < bodyLength) body.resize(bodyLength);
+				bdfAPI::eErrorCode result = fill(Api, Group, Block, inputInfos, blockInfos, sampleRate, Config, address, count, body.data(), offsets);
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (result == bdfAPI::errNoError && !failed) {
+					ready[slot] = true;
+					while (nextToWrite < nrOfBatches && ready[nextToWrite % bodies.size()] && result == bdfAPI::errNoError) {
+						const uint64_t writeAddress = (uint64_t)nextToWrite * Config.BatchRows;
+						const uint64_t writeCount = std::min<uint64_t>(Config.BatchRows, rows - writeAddress);
+						size_t writeLength;
+						bdfArrowWriter::bodyLayout(columns, writeCount, writeLength);
+						result = writer.writeBatch(writeCount, bodies[nextToWrite % bodies.size()].data(), writeLength);
+						ready[nextToWrite % bodies.size()] = false;
+						nextToWrite++;
+					}
+				}
+				if (result != bdfAPI::errNoError) failed = true;
+				slotFree.notify_all();
+				return result;
+			});
+			const uint64_t batches = writer.numberOfBatches();
+			const bdfAPI::eErrorCode closeErr = writer.close();
+			if (err == bdfAPI::errNoError) err = closeErr;
+			if (err != bdfAPI::errNoError) {
+				std::remove(FileName.c_str());
+				return err;
+			}
+
+			if (Statistics) {
+				Statistics->Files++;
+				Statistics->Batches += batches;
+				Statistics->Rows += rows;
+				Statistics->Bytes += writer.bytesWritten();
+				Statistics->Seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+			}
+			return bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Export every block of every group to fileName(BaseName, Group, Block)
+		/// </summary>
+		/// <param name="FileNames">Optional, receives the names of the written files</param>
+		/// <param name="Statistics">Optional, receives the totals</param>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode exportFile(bdfParallelReader& Reader, const std::string& BaseName, const sArrowExportConfig& Config = sArrowExportConfig(), std::vector<std::string>* FileNames = nullptr, sArrowExportStatistics* Statistics = nullptr) {
+			bdfAPI* api = Reader.api();
+			if (api == nullptr) return bdfAPI::errInvalidHandle;
+			sArrowExportStatistics statistics{};
+			if (FileNames) FileNames->clear();
+			const unsigned nrOfGroups = api->getNumberOfGroups();
+			for (unsigned g = 0; g < nrOfGroups; g++) {
+				if (api->getNumberOfInputs(g) == 0) continue;
+				const unsigned nrOfBlocks = api->getNumberOfBlocks(g, 0);
+				for (unsigned b = 0; b < nrOfBlocks; b++) {
+					const std::string name = fileName(BaseName, g, b);
+					bdfAPI::eErrorCode err = exportBlock(Reader, g, b, name, Config, &statistics);
+					if (err != bdfAPI::errNoError) return err;
+					if (FileNames) FileNames->push_back(name);
+				}
+			}
+			if (Statistics) *Statistics = statistics;
+			return bdfAPI::errNoError;
+		}
+
+	private:
+		static std::string number(double Value) {
+			char text[32];
+			snprintf(text, sizeof(text), "%.17g", Value);
+			return text;
+		}
+
+		static std::string attribute(bdfAPI* Api, unsigned Group, unsigned Input, const char* Key) {
+			char key[32];
+			char value[256] = { 0 };
+			snprintf(key, sizeof(key), "%s", Key);
+			if (Api->getAttribute(Group, Input, key, value, sizeof(value)) != bdfAPI::errNoError) return std::string();
+			value[sizeof(value) - 1] = 0;
+			return value;
+		}
+
+		static bdfArrowWriter::sColumn column(bdfAPI* Api, unsigned Group, unsigned Input, const bdfAPI::sInputInfo& Info, bdfArrowWriter::eColumnType Type, bdfConvert::eUnit Unit, const std::vector<bdfArrowWriter::sColumn>& Columns) {
+			const std::string name = attribute(Api, Group, Input, "ChName");
+			const std::string physicalUnit = attribute(Api, Group, Input, "ChPhysUnit");
+			bdfArrowWriter::sColumn column;
+			column.Type = Type;
+			column.Name = name.empty() ? "Input" + std::to_string(Input) : name;
+			// column names must be unique
+			for (const auto& c : Columns) {
+				if (c.Name == column.Name) {
+					column.Name += "_" + std::to_string(Input);
+					break;
+				}
+			}
+			column.Metadata = {
+				{ "unit", Unit == bdfConvert::unitPhysical ? physicalUnit : "V" },
+				{ "ChName", name },
+				{ "ChPhysUnit", physicalUnit },
+				{ "ChPhysUnitExt", attribute(Api, Group, Input, "ChPhysUnitExt") },
+				{ "Input", std::to_string(Input) },
+				{ "BoardNumber", std::to_string(Info.BoardNumber) },
+				{ "InputNumber", std::to_string(Info.InputNumber) },
+				{ "ResolutionInBits", std::to_string(Info.ResolutionInBits) },
+				{ "BinToVoltFactor", number(Info.BinToVoltFactor) },
+				{ "BinToVoltConstant", number(Info.BinToVoltConstant) },
+				{ "BinToPhysicalFactor", number(Info.BinToPhysicalFactor) },
+				{ "BinToPhysicalConstant", number(Info.BinToPhysicalConstant) },
+			};
+			return column;
+		}
+
+		/// Convert one batch into its body. Samples past the end of a shorter input are NaN.
+		static bdfAPI::eErrorCode fill(bdfAPI* Api, unsigned Group, unsigned Block, const std::vector<bdfAPI::sInputInfo>& InputInfos, const std::vector<bdfAPI::sBlockInfo>& BlockInfos, double SampleRate, const sArrowExportConfig& Config, uint64_t Address, unsigned Count, char* Body, const std::vector<size_t>& Offsets) {
+			size_t column = 0;
+			if (Config.TimeColumn) {
+				double* time = reinterpret_cast<double*>(Body + Offsets[column++]);
+				const double first = (double)Address - (double)BlockInfos[0].TriggerSample;
+				for (unsigned k = 0; k < Count; k++) time[k] = (first + k) / SampleRate;
+			}
+			for (unsigned i = 0; i < InputInfos.size(); i++) {
+				char* data = Body + Offsets[column++];
+				const uint64_t length = BlockInfos[i].BlockLength;
+				const unsigned valid = Address >= length ? 0 : (unsigned)std::min<uint64_t>(Count, length - Address);
+				bdfAPI::eErrorCode err = bdfAPI::errNoError;
+				if (Config.SinglePrecision) {
+					float* values = reinterpret_cast<float*>(data);
+					if (valid) err = bdfConvert::getData(Api, InputInfos[i], Group, i, Block, Address, values, valid, Config.Unit);
+					std::fill(values + valid, values + Count, std::numeric_limits<float>::quiet_NaN());
+				}
+				else {
+					double* values = reinterpret_cast<double*>(data);
+					if (valid) err = bdfConvert::getData(Api, InputInfos[i], Group, i, Block, Address, values, valid, Config.Unit);
+					std::fill(values + valid, values + Count, std::numeric_limits<double>::quiet_NaN());
+				}
+				if (err != bdfAPI::errNoError) return err;
+			}
+			return bdfAPI::errNoError;
+		}
+	};
+}
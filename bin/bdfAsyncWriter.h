@@ -0,0 +1,711 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfDecorator.h"
+
+namespace filereader {
+	/// <summary>
+	/// Asynchronous writer mode. writeData copies the data into a bounded pool of pre-allocated,
+	/// aligned buffers per streamer and returns. A dedicated I/O thread passes the filled buffers
+	/// to the wrapped API object in order. If all buffers of a streamer are in flight the producer
+	/// waits (backpressure) or gets errResource, depending on the configuration.
+	///
+	/// writeData may be called concurrently for different streamers of any group, e.g. one acquisition
+	/// thread per input. Each streamer passes its filled buffers to the I/O thread through a lock-free
+	/// single producer / single consumer ring and gets them back through a second ring, so producers
+	/// share no lock. The I/O thread is the only caller of the wrapped writeData and takes one buffer
+	/// per streamer in turn.
+	///
+	/// writeEORInfo commits a block atomically across its inputs: the End of Record Information of the
+	/// inputs of a group and block are collected until every streamer of the group has passed the block,
+	/// then the I/O thread writes the remaining data of these streamers followed by all records at once.
+	/// The blocks of a group are committed in block order, so a producer may run several blocks ahead of
+	/// the others; its data of the later blocks is held back until their predecessors are committed.
+	/// writeEORInfo of an input must be called by the thread writing its streamer, which then continues with
+	/// the next block. flush and closeFile commit incomplete blocks as they are.
+	///
+	/// A streamer which reported its end while a newer streamer of the same input exists is finished and must
+	/// not be written anymore. Its buffers are released once its data is written, so a new streamer per block
+	/// keeps the memory bounded by the number of inputs.
+	///
+	/// All calls into the wrapped API object are serialized, so it does not need to be thread safe.
+	/// closeFile and flush must not be called while writeData is running.
+	/// </summary>
+	class bdfAsyncWriter : public bdfAPIDecorator {
+	public:
+		/// Configuration of the asynchronous writer
+		struct sAsyncWriterConfig {
+			/// Size of one buffer in bytes
+			unsigned BufferSize = 4 * 1024 * 1024;
+			/// Number of buffers per streamer, at least 2 for double buffering
+			unsigned BuffersPerStreamer = 4;
+			/// Alignment of the buffers in bytes
+			unsigned Alignment = 4096;
+			/// Wait for a free buffer if true, otherwise writeData returns errResource
+			bool BlockWhenFull = true;
+		};
+
+		/// Statistics of the asynchronous writer
+		struct sAsyncWriterStatistics {
+			/// Bytes passed to writeData
+			uint64_t BytesQueued;
+			/// Bytes written by the I/O thread
+			uint64_t BytesWritten;
+			/// Buffers written by the I/O thread
+			uint64_t BuffersWritten;
+			/// Highest number of buffers waiting for or in the I/O thread
+			unsigned QueueHighWaterMark;
+			/// Highest number of bytes waiting for or in the I/O thread
+			uint64_t BytesHighWaterMark;
+			/// Number of writeData calls which had to wait for a free buffer
+			uint64_t Stalls;
+			/// Total time writeData waited for free buffers in seconds
+			double StallSeconds;
+			/// Longest wait of a writeData call in seconds
+			double MaxStallSeconds;
+			/// Longest single write of the I/O thread in seconds
+			double MaxWriteSeconds;
+			/// Blocks committed with writeEORInfo
+			uint64_t BlocksCommitted;
+			/// Streamers holding buffers, finished streamers are released once their data is written
+			unsigned Streamers;
+		};
+
+		/// <summary>
+		/// Wrap a writer API object and start the I/O thread with the default configuration
+		/// </summary>
+		/// <param name="Api">API object used for writing</param>
+		explicit bdfAsyncWriter(bdfAPI* Api) : bdfAsyncWriter(Api, sAsyncWriterConfig()) {}
+
+		/// <summary>
+		/// Wrap a writer API object and start the I/O thread
+		/// </summary>
+		/// <param name="Api">API object used for writing</param>
+		/// <param name="Config"></param>
+		bdfAsyncWriter(bdfAPI* Api, const sAsyncWriterConfig& Config)
+			: bdfAPIDecorator(Api), m_Config(Config) {
+			if (m_Config.BuffersPerStreamer < 2) m_Config.BuffersPerStreamer = 2;
+			if (m_Config.BufferSize == 0) m_Config.BufferSize = sAsyncWriterConfig().BufferSize;
+			if (m_Config.Alignment < alignof(std::max_align_t)) m_Config.Alignment = alignof(std::max_align_t);
+			resetStatistics();
+			m_Thread = std::thread(&bdfAsyncWriter::ioThread, this);
+		}
+
+		/// Writes out all pending buffers and stops the I/O thread
+		virtual ~bdfAsyncWriter() {
+			flush();
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Stop = true;
+			}
+			m_WorkCondition.notify_all();
+			m_Thread.join();
+		}
+
+		bdfAsyncWriter(const bdfAsyncWriter&) = delete;
+		bdfAsyncWriter& operator=(const bdfAsyncWriter&) = delete;
+
+		virtual int initFileWriter(unsigned Group, sDateTime& StartTime, eOperationMode OperationMode, double SampleRate, uint32_t TimebaseDivisor, uint32_t TriggerSample) override {
+			std::lock_guard<std::mutex> api(m_ApiMutex);
+			return m_Api->initFileWriter(Group, StartTime, OperationMode, SampleRate, TimebaseDivisor, TriggerSample);
+		}
+
+		virtual int writeInputHeader(uint32_t BoardNumber, uint32_t InputNumber, uint32_t AnalogMask, uint32_t MarkerMask, double Range, double Offset, double VoltToPhysicalFactor, double VoltToPhysicalConstant, int Handle = 0) override {
+			std::lock_guard<std::mutex> api(m_ApiMutex);
+			return m_Api->writeInputHeader(BoardNumber, InputNumber, AnalogMask, MarkerMask, Range, Offset, VoltToPhysicalFactor, VoltToPhysicalConstant, Handle);
+		}
+
+		virtual int initInputStreamer(uint32_t BoardNumber, uint32_t InputNumber, uint32_t BlockNr, int Handle = 0) override {
+			int streamer;
+			{
+				std::lock_guard<std::mutex> api(m_ApiMutex);
+				streamer = m_Api->initInputStreamer(BoardNumber, InputNumber, BlockNr, Handle);
+			}
+			if (streamer >= 0) {
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				sStreamer* s = getStreamer(Handle, streamer);
+				if (s == nullptr) return errResource;
+				s->Board = BoardNumber;
+				s->Input = InputNumber;
+				s->Block = BlockNr;
+				s->Ended = false;
+				try {
+					m_Newest[std::make_tuple(Handle, BoardNumber, InputNumber)] = s;
+				}
+				catch (const std::bad_alloc&) {
+					return errResource;
+				}
+				retire();
+			}
+			return streamer;
+		}
+
+		/// <summary>
+		/// Copy the data into the buffers of the streamer, the data is written by the I/O thread.
+		/// Different streamers may be written concurrently, one streamer by one thread at a time.
+		/// Without BlockWhenFull the data is accepted completely or not at all: errResource means nothing
+		/// was copied and the call can be repeated, errArgument that count exceeds the buffers of a streamer.
+		/// </summary>
+		/// <returns>eErrorCode, also reports errors of previous asynchronous writes</returns>
+		virtual int writeData(int StreamerHandle, char* Data, unsigned int count, int Handle = 0) override {
+			const int error = m_Error.load(std::memory_order_relaxed);
+			if (error != errNoError) return error;
+			sStreamer* s = findStreamer(Handle, StreamerHandle);
+			if (s == nullptr) {
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				s = getStreamer(Handle, StreamerHandle);
+				if (s == nullptr) return errResource;
+			}
+			if (!m_Config.BlockWhenFull) {
+				// free buffers only become more while the producer checks, so enough now means enough for the copy
+				const uint64_t room = s->Current != nullptr ? m_Config.BufferSize - s->Fill : 0;
+				const uint64_t needed = count > room ? (count - room + m_Config.BufferSize - 1) / m_Config.BufferSize : 0;
+				if (needed > m_Config.BuffersPerStreamer - (s->Current != nullptr ? 1u : 0u)) return errArgument;
+				if (needed > s->Free.size()) return errResource;
+			}
+			s->BytesQueued.fetch_add(count, std::memory_order_relaxed);
+
+			// the current buffer of a streamer is only touched by its producer
+			while (count > 0) {
+				if (s->Current == nullptr) {
+					int err = acquire(*s);
+					if (err != errNoError) return err;
+				}
+				unsigned n = m_Config.BufferSize - s->Fill;
+				if (n > count) n = count;
+				memcpy(s->Current + s->Fill, Data, n);
+				s->Fill += n;
+				Data += n;
+				count -= n;
+				if (s->Fill == m_Config.BufferSize) enqueue(*s);
+			}
+			return errNoError;
+		}
+
+		virtual int setAttribute(unsigned Input, const std::string& Key, const std::string& Value, int GroupHandle = 0) override {
+			std::lock_guard<std::mutex> api(m_ApiMutex);
+			return m_Api->setAttribute(Input, Key, Value, GroupHandle);
+		}
+
+		virtual int writeAttributes(int GroupHandle = 0) override {
+			std::lock_guard<std::mutex> api(m_ApiMutex);
+			return m_Api->writeAttributes(GroupHandle);
+		}
+
+		/// <summary>
+		/// Stage the End of Record Information of an input. When no streamer of the group is left at BlockNr
+		/// or an earlier block, and the earlier blocks of the group are committed, the I/O thread writes the
+		/// remaining data of the block and then the records of all its inputs.
+		/// The streamer continues with block BlockNr + 1; data written to it afterwards is held back until
+		/// the block is committed.
+		/// </summary>
+		virtual void writeEORInfo(uint32_t BlockNr, uint64_t TriggerTime, uint64_t DataCntr, uint32_t Input, uint32_t Board, int GroupHandle = 0) override {
+			sStreamer* s = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				// a finished streamer continued to BlockNr loses against the streamer initialized for it
+				for (auto& it : m_Streamers) {
+					sStreamer& candidate = *it.second;
+					if (candidate.Handle != GroupHandle || candidate.Block != BlockNr || candidate.Input != Input || candidate.Board != Board) continue;
+					if (s == nullptr || !finished(candidate)) s = &candidate;
+				}
+			}
+			// the partial buffer belongs to the producer, which is the calling thread
+			if (s != nullptr && s->Current != nullptr && s->Fill > 0) enqueue(*s);
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			sCommit& commit = m_Staged[std::make_pair(GroupHandle, BlockNr)];
+			commit.Records.push_back(sRecord{ BlockNr, TriggerTime, DataCntr, Input, Board, GroupHandle });
+			if (s != nullptr) {
+				// the barriers of blocks ahead queue up behind the one the I/O thread is held at
+				s->Barriers.push_back(s->Pushed);
+				if (s->Barriers.size() == 1) s->Barrier.store(s->Pushed, std::memory_order_release);
+				commit.Targets.push_back(std::make_pair(s, s->Pushed));
+				s->Block = BlockNr + 1;
+				s->Ended = true;
+			}
+			stageCommits();
+		}
+
+		/// <summary>
+		/// Write out all pending data, then close the file.
+		/// </summary>
+		virtual void closeFile(int handle = -1) override {
+			flush();
+			std::lock_guard<std::mutex> api(m_ApiMutex);
+			m_Api->closeFile(handle);
+		}
+
+		/// <summary>
+		/// Queue the partially filled buffers of all streamers, commit the staged blocks and wait until the
+		/// I/O thread wrote everything.
+		/// </summary>
+		/// <returns>eErrorCode of the asynchronous writes</returns>
+		int flush() {
+			std::vector<sStreamer*> streamers;
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				for (auto& it : m_Streamers) streamers.push_back(it.second.get());
+			}
+			for (sStreamer* s : streamers) {
+				if (s->Current != nullptr && s->Fill > 0) enqueue(*s);
+			}
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			// in the order of the group handle and block number
+			for (auto& it : m_Staged) {
+				m_Commits.push_back(std::move(it.second));
+				m_CommitsPending.fetch_add(1);
+			}
+			m_Staged.clear();
+			m_WorkCounter.fetch_add(1);
+			m_WorkCondition.notify_one();
+			m_IdleCondition.wait(lock, [this] { return m_InFlight.load() == 0 && m_Commits.empty(); });
+			retire();
+			return m_Error;
+		}
+
+		/// <summary>
+		/// Get the statistics since construction or the last reset
+		/// </summary>
+		sAsyncWriterStatistics getStatistics() const {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			sAsyncWriterStatistics statistics = m_Statistics;
+			statistics.BytesQueued = m_RetiredBytesQueued;
+			for (auto& it : m_Streamers) statistics.BytesQueued += it.second->BytesQueued.load(std::memory_order_relaxed);
+			statistics.BytesWritten = m_BytesWritten.load();
+			statistics.BuffersWritten = m_BuffersWritten.load();
+			statistics.QueueHighWaterMark = m_QueueHighWaterMark.load();
+			statistics.BytesHighWaterMark = m_BytesHighWaterMark.load();
+			statistics.MaxWriteSeconds = m_MaxWriteSeconds.load();
+			statistics.BlocksCommitted = m_BlocksCommitted.load();
+			statistics.Streamers = (unsigned)m_Streamers.size();
+			return statistics;
+		}
+
+		/// <summary>
+		/// Reset the statistics
+		/// </summary>
+		void resetStatistics() {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Statistics = sAsyncWriterStatistics();
+			for (auto& it : m_Streamers) it.second->BytesQueued = 0;
+			m_RetiredBytesQueued = 0;
+			m_BytesWritten = 0;
+			m_BuffersWritten = 0;
+			m_QueueHighWaterMark = 0;
+			m_BytesHighWaterMark = 0;
+			m_MaxWriteSeconds = 0;
+			m_BlocksCommitted = 0;
+		}
+
+	private:
+		struct sAlignedDelete {
+			size_t Alignment;
+			void operator()(char* p) const { ::operator delete[](p, std::align_val_t(Alignment)); }
+		};
+		typedef std::unique_ptr<char[], sAlignedDelete> tBuffer;
+
+		struct sQueued {
+			char* Data;
+			unsigned Size;
+		};
+
+		/// Lock-free ring with one producer and one consumer thread
+		template <typename T>
+		struct sRing {
+			std::vector<T> Items;
+			uint64_t Mask = 0;
+			alignas(64) std::atomic<uint64_t> Head{ 0 }; /// Next item to pop, written by the consumer
+			alignas(64) std::atomic<uint64_t> Tail{ 0 }; /// Next item to push, written by the producer
+
+			void resize(size_t Capacity) {
+				size_t size = 1;
+				while (size < Capacity) size *= 2;
+				Items.resize(size);
+				Mask = size - 1;
+			}
+
+			bool push(const T& Item) {
+				const uint64_t tail = Tail.load(std::memory_order_relaxed);
+				if (tail - Head.load(std::memory_order_acquire) > Mask) return false;
+				Items[(size_t)(tail & Mask)] = Item;
+				Tail.store(tail + 1, std::memory_order_release);
+				return true;
+			}
+
+			/// Number of items, exact for the consumer thread or a lower bound while the producer pushes
+			size_t size() const {
+				return (size_t)(Tail.load(std::memory_order_acquire) - Head.load(std::memory_order_relaxed));
+			}
+
+			bool pop(T& Item) {
+				const uint64_t head = Head.load(std::memory_order_relaxed);
+				if (head == Tail.load(std::memory_order_acquire)) return false;
+				Item = Items[(size_t)(head & Mask)];
+				Head.store(head + 1, std::memory_order_release);
+				return true;
+			}
+		};
+
+		static constexpr uint64_t NoBarrier = UINT64_MAX;
+		static constexpr uint32_t NoBlock = UINT32_MAX;
+
+		struct sStreamer {
+			int Handle = 0;
+			int Streamer = 0;
+			/// Board, input and block of initInputStreamer, m_Mutex must be locked
+			uint32_t Board = NoBlock;
+			uint32_t Input = NoBlock;
+			uint32_t Block = NoBlock;
+			/// Reported an end since initInputStreamer, m_Mutex must be locked
+			bool Ended = false;
+			std::vector<tBuffer> Storage;
+			sRing<sQueued> Filled; /// Producer to I/O thread
+			sRing<char*> Free; /// I/O thread to producer
+			/// Owned by the producer
+			char* Current = nullptr;
+			unsigned Fill = 0;
+			uint64_t Pushed = 0;
+			/// Owned by the I/O thread
+			uint64_t Consumed = 0;
+			/// Buffer counts of the staged blocks of the streamer in block order, m_Mutex must be locked
+			std::deque<uint64_t> Barriers;
+			/// The I/O thread takes no buffer beyond this count until the staged block is committed, the first of Barriers
+			std::atomic<uint64_t> Barrier{ NoBarrier };
+			std::atomic<bool> Waiting{ false };
+			std::atomic<uint64_t> BytesQueued{ 0 };
+		};
+
+		struct sRecord {
+			uint32_t BlockNr;
+			uint64_t TriggerTime;
+			uint64_t DataCntr;
+			uint32_t Input;
+			uint32_t Board;
+			int GroupHandle;
+		};
+
+		/// End of Record Information of the inputs of one block, with the buffer count each streamer must reach first
+		struct sCommit {
+			std::vector<sRecord> Records;
+			std::vector<std::pair<sStreamer*, uint64_t>> Targets;
+		};
+
+		typedef std::map<std::pair<int, int>, sStreamer*> tTable;
+
+		/// Find a streamer in the published table without locking
+		sStreamer* findStreamer(int Handle, int StreamerHandle) {
+			m_TableReaders.fetch_add(1);
+			const tTable* table = m_Table.load();
+			sStreamer* s = nullptr;
+			if (table != nullptr) {
+				auto it = table->find(std::make_pair(Handle, StreamerHandle));
+				if (it != table->end()) s = it->second;
+			}
+			m_TableReaders.fetch_sub(1);
+			return s;
+		}
+
+		/// True if a newer streamer of the input was initialized, m_Mutex must be locked
+		bool superseded(const sStreamer& S) const {
+			auto it = m_Newest.find(std::make_tuple(S.Handle, S.Board, S.Input));
+			return it != m_Newest.end() && it->second != &S;
+		}
+
+		/// True if the streamer will not be written anymore, m_Mutex must be locked
+		bool finished(const sStreamer& S) const { return S.Ended && superseded(S); }
+
+		/// True if every streamer of the group has passed the block, m_Mutex must be locked
+		bool passed(int Handle, uint32_t Block) const {
+			for (auto& it : m_Streamers) {
+				const sStreamer& s = *it.second;
+				if (s.Handle == Handle && s.Block <= Block && !finished(s)) return false;
+			}
+			return true;
+		}
+
+		/// Pass the staged blocks every streamer of their group has passed to the I/O thread, per group in
+		/// block order. m_Mutex must be locked.
+		void stageCommits() {
+			bool staged = false;
+			for (auto it = m_Staged.begin(); it != m_Staged.end();) {
+				const int handle = it->first.first;
+				if (!passed(handle, it->first.second)) {
+					// the later blocks of the group wait for this one
+					while (it != m_Staged.end() && it->first.first == handle) ++it;
+					continue;
+				}
+				m_Commits.push_back(std::move(it->second));
+				it = m_Staged.erase(it);
+				m_CommitsPending.fetch_add(1);
+				staged = true;
+			}
+			if (staged) {
+				m_WorkCounter.fetch_add(1);
+				m_WorkCondition.notify_one();
+			}
+		}
+
+		/// <summary>
+		/// Publish a new lookup table. The previous table and the retired streamers stay valid for threads
+		/// reading the previous table and are released once no thread reads a table. m_Mutex must be locked.
+		/// </summary>
+		void publish(std::unique_ptr<tTable> Table) {
+			m_OldTables.reserve(m_OldTables.size() + 1);
+			m_Table.store(Table.get());
+			if (m_PublishedTable) m_OldTables.push_back(std::move(m_PublishedTable));
+			m_PublishedTable = std::move(Table);
+			reclaim();
+		}
+
+		/// Release the unpublished tables and retired streamers if no thread reads a table, m_Mutex must be locked
+		void reclaim() {
+			// a reader counted after this check loads the current table
+			if (m_TableReaders.load() != 0) return;
+			m_OldTables.clear();
+			m_OldStreamers.clear();
+		}
+
+		/// Release the buffers of the finished streamers whose data is written and remove them from the table, m_Mutex must be locked
+		void retire() {
+			try {
+				std::vector<std::pair<int, int>> done;
+				for (auto& it : m_Streamers) {
+					const sStreamer& s = *it.second;
+					// the producer of a finished streamer is gone, all its buffers back in the free ring means all is written
+					if (finished(s) && s.Current == nullptr && s.Barriers.empty() && s.Free.size() == s.Storage.size()) done.push_back(it.first);
+				}
+				if (done.empty()) {
+					reclaim();
+					return;
+				}
+				std::unique_ptr<tTable> table(new tTable(*m_Table.load()));
+				m_OldStreamers.reserve(m_OldStreamers.size() + done.size());
+				for (const std::pair<int, int>& key : done) {
+					table->erase(key);
+					auto it = m_Streamers.find(key);
+					m_RetiredBytesQueued += it->second->BytesQueued.load(std::memory_order_relaxed);
+					it->second->Storage.clear();
+					m_OldStreamers.push_back(std::move(it->second));
+					m_Streamers.erase(it);
+				}
+				publish(std::move(table));
+			}
+			catch (const std::bad_alloc&) {
+				// retried with the next initInputStreamer or flush
+			}
+		}
+
+		/// Find or create the buffer pool of a streamer, m_Mutex must be locked
+		sStreamer* getStreamer(int Handle, int StreamerHandle) {
+			std::unique_ptr<sStreamer>& s = m_Streamers[std::make_pair(Handle, StreamerHandle)];
+			if (s) return s.get();
+			try {
+				std::unique_ptr<sStreamer> streamer(new sStreamer());
+				streamer->Handle = Handle;
+				streamer->Streamer = StreamerHandle;
+				streamer->Filled.resize(m_Config.BuffersPerStreamer);
+				streamer->Free.resize(m_Config.BuffersPerStreamer);
+				for (unsigned n = 0; n < m_Config.BuffersPerStreamer; n++) {
+					char* p = static_cast<char*>(::operator new[](m_Config.BufferSize, std::align_val_t(m_Config.Alignment)));
+					streamer->Storage.emplace_back(p, sAlignedDelete{ m_Config.Alignment });
+					streamer->Free.push(p);
+				}
+				std::unique_ptr<tTable> table(new tTable(m_Table.load() != nullptr ? *m_Table.load() : tTable()));
+				(*table)[std::make_pair(Handle, StreamerHandle)] = streamer.get();
+				publish(std::move(table));
+				s = std::move(streamer);
+			}
+			catch (const std::bad_alloc&) {
+				m_Streamers.erase(std::make_pair(Handle, StreamerHandle));
+				return nullptr;
+			}
+			return s.get();
+		}
+
+		/// Take a free buffer of the streamer, waits if all buffers are in flight
+		int acquire(sStreamer& S) {
+			S.Fill = 0;
+			if (S.Free.pop(S.Current)) return errNoError;
+			if (!m_Config.BlockWhenFull) return errResource;
+
+			auto start = std::chrono::steady_clock::now();
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			S.Waiting.store(true);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			m_FreeCondition.wait(lock, [this, &S] { return S.Free.pop(S.Current) || m_Error.load() != errNoError; });
+			S.Waiting.store(false);
+			double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			m_Statistics.Stalls++;
+			m_Statistics.StallSeconds += waited;
+			if (waited > m_Statistics.MaxStallSeconds) m_Statistics.MaxStallSeconds = waited;
+			return S.Current != nullptr ? errNoError : m_Error.load();
+		}
+
+		/// Pass the current buffer of a streamer to the I/O thread, called by the producer
+		void enqueue(sStreamer& S) {
+			// the ring has room for all buffers of the streamer
+			S.Filled.push(sQueued{ S.Current, S.Fill });
+			S.Pushed++;
+			const unsigned inFlight = m_InFlight.fetch_add(1) + 1;
+			const uint64_t bytes = m_QueuedBytes.fetch_add(S.Fill) + S.Fill;
+			S.Current = nullptr;
+			S.Fill = 0;
+			raise(m_QueueHighWaterMark, inFlight);
+			raise(m_BytesHighWaterMark, bytes);
+			signal();
+		}
+
+		/// Wake the I/O thread if it waits for work
+		void signal() {
+			m_WorkCounter.fetch_add(1);
+			if (m_IoWaiting.load()) {
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_WorkCondition.notify_one();
+			}
+		}
+
+		template <typename T>
+		static void raise(std::atomic<T>& Maximum, T Value) {
+			T current = Maximum.load(std::memory_order_relaxed);
+			while (Value > current && !Maximum.compare_exchange_weak(current, Value, std::memory_order_relaxed)) {}
+		}
+
+		/// Write one buffer of the streamer if it has one before its barrier
+		bool writeNext(sStreamer& S) {
+			if (S.Consumed >= S.Barrier.load(std::memory_order_acquire)) return false;
+			sQueued item;
+			if (!S.Filled.pop(item)) return false;
+
+			auto start = std::chrono::steady_clock::now();
+			int result;
+			{
+				std::lock_guard<std::mutex> api(m_ApiMutex);
+				result = m_Api->writeData(S.Streamer, item.Data, item.Size, S.Handle);
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			S.Consumed++;
+			S.Free.push(item.Data);
+			m_BytesWritten.fetch_add(item.Size, std::memory_order_relaxed);
+			m_BuffersWritten.fetch_add(1, std::memory_order_relaxed);
+			if (seconds > m_MaxWriteSeconds.load(std::memory_order_relaxed)) m_MaxWriteSeconds.store(seconds, std::memory_order_relaxed);
+			if (result != errNoError) {
+				int expected = errNoError;
+				m_Error.compare_exchange_strong(expected, result);
+			}
+			m_QueuedBytes.fetch_sub(item.Size);
+			m_InFlight.fetch_sub(1);
+
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (S.Waiting.load() || result != errNoError) {
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_FreeCondition.notify_all();
+			}
+			return true;
+		}
+
+		/// Write the records of the oldest staged block once all its data is written
+		bool commitNext() {
+			sCommit commit;
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				if (m_Commits.empty()) return false;
+				for (auto& target : m_Commits.front().Targets) {
+					if (target.first->Consumed < target.second) return false;
+				}
+				commit = m_Commits.front();
+			}
+			{
+				std::lock_guard<std::mutex> api(m_ApiMutex);
+				for (const sRecord& r : commit.Records) m_Api->writeEORInfo(r.BlockNr, r.TriggerTime, r.DataCntr, r.Input, r.Board, r.GroupHandle);
+			}
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			// the streamer continues up to the barrier of its next staged block
+			for (auto& target : commit.Targets) {
+				std::deque<uint64_t>& barriers = target.first->Barriers;
+				if (!barriers.empty()) barriers.pop_front();
+				target.first->Barrier.store(barriers.empty() ? NoBarrier : barriers.front(), std::memory_order_release);
+			}
+			m_Commits.pop_front();
+			m_CommitsPending.fetch_sub(1);
+			m_BlocksCommitted.fetch_add(1);
+			return true;
+		}
+
+		void ioThread() {
+			for (;;) {
+				const uint64_t work = m_WorkCounter.load();
+				bool worked = false;
+				// one buffer per streamer and round, so no streamer starves the others
+				m_TableReaders.fetch_add(1);
+				const tTable* table = m_Table.load();
+				if (table != nullptr) {
+					for (auto& it : *table) worked |= writeNext(*it.second);
+				}
+				while (m_CommitsPending.load() > 0 && commitNext()) worked = true;
+				m_TableReaders.fetch_sub(1);
+				if (worked) continue;
+
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				reclaim();
+				m_IdleCondition.notify_all();
+				if (m_Stop) return;
+				m_IoWaiting.store(true);
+				m_WorkCondition.wait(lock, [this, work] { return m_WorkCounter.load() != work || m_Stop; });
+				m_IoWaiting.store(false);
+			}
+		}
+
+		sAsyncWriterConfig m_Config;
+		mutable std::mutex m_Mutex;
+		/// Serializes the calls into the wrapped API object
+		std::mutex m_ApiMutex;
+		std::condition_variable m_WorkCondition;
+		std::condition_variable m_FreeCondition;
+		std::condition_variable m_IdleCondition;
+		std::map<std::pair<int, int>, std::unique_ptr<sStreamer>> m_Streamers;
+		/// Last initialized streamer per group handle, board and input
+		std::map<std::tuple<int, uint32_t, uint32_t>, sStreamer*> m_Newest;
+		/// Lookup table of writeData and the I/O thread, replaced when a streamer is added or removed
+		std::atomic<const tTable*> m_Table{ nullptr };
+		std::unique_ptr<tTable> m_PublishedTable;
+		/// Threads reading a table
+		std::atomic<unsigned> m_TableReaders{ 0 };
+		std::vector<std::unique_ptr<tTable>> m_OldTables;
+		std::vector<std::unique_ptr<sStreamer>> m_OldStreamers;
+		/// BytesQueued of the removed streamers
+		uint64_t m_RetiredBytesQueued = 0;
+		std::map<std::pair<int, uint32_t>, sCommit> m_Staged;
+		std::deque<sCommit> m_Commits;
+		std::atomic<unsigned> m_CommitsPending{ 0 };
+		std::atomic<uint64_t> m_WorkCounter{ 0 };
+		std::atomic<bool> m_IoWaiting{ false };
+		std::atomic<unsigned> m_InFlight{ 0 };
+		std::atomic<uint64_t> m_QueuedBytes{ 0 };
+		bool m_Stop = false;
+		std::atomic<int> m_Error{ errNoError };
+		sAsyncWriterStatistics m_Statistics;
+		std::atomic<uint64_t> m_BytesWritten{ 0 };
+		std::atomic<uint64_t> m_BuffersWritten{ 0 };
+		std::atomic<unsigned> m_QueueHighWaterMark{ 0 };
+		std::atomic<uint64_t> m_BytesHighWaterMark{ 0 };
+		std::atomic<double> m_MaxWriteSeconds{ 0 };
+		std::atomic<uint64_t> m_BlocksCommitted{ 0 };
+		std::thread m_Thread;
+	};
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfConvert.h"
+
+namespace filereader {
+	/// <summary>
+	/// Reads the same sample range of several inputs of one group in a single call.
+	/// The input infos are looked up once per input and kept, the samples are converted with the
+	/// vectorized kernels of bdfConvert and written either planar (channel-major) or interleaved.
+	/// </summary>
+	class bdfBatchRead {
+	public:
+		/// Memory layout of the result
+		enum eLayout {
+			layoutPlanar,	/// Data[input * Count + sample]
+			layoutInterleaved /// Data[sample * NrOfInputs + input]
+		};
+
+		/// <summary>
+		/// Create a batch reader for an API object with a loaded file.
+		/// </summary>
+		/// <param name="Api">API object on which loadFile and initFileReader were called</param>
+		explicit bdfBatchRead(bdfAPI* Api) : m_Api(Api) {}
+
+		/// <summary>
+		/// Read raw 16-bit words of several inputs
+		/// </summary>
+		/// <param name="Group"></param>
+		/// <param name="Block"></param>
+		/// <param name="Address">The starting sample address offset inside the block</param>
+		/// <param name="Count">Number of samples per input</param>
+		/// <param name="Inputs">Inputs to read, all inputs of the group if empty</param>
+		/// <param name="Data">Receives Count * number of inputs words</param>
+		/// <param name="Layout"></param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getRawDataS(unsigned Group, unsigned Block, uint64_t Address, unsigned Count, const std::vector<unsigned>& Inputs, uint16_t* Data, eLayout Layout = layoutPlanar) {
+			return read(Group, Block, Address, Count, Inputs, Data, Layout, bdfConvert::unitVolt);
+		}
+
+		/// <summary>
+		/// Read samples of several inputs scaled to volt or physical unit as float
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getDataF(unsigned Group, unsigned Block, uint64_t Address, unsigned Count, const std::vector<unsigned>& Inputs, float* Data, eLayout Layout = layoutPlanar, bdfConvert::eUnit Unit = bdfConvert::unitVolt) {
+			return read(Group, Block, Address, Count, Inputs, Data, Layout, Unit);
+		}
+
+		/// <summary>
+		/// Read samples of several inputs scaled to volt or physical unit as double
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getDataD(unsigned Group, unsigned Block, uint64_t Address, unsigned Count, const std::vector<unsigned>& Inputs, double* Data, eLayout Layout = layoutPlanar, bdfConvert::eUnit Unit = bdfConvert::unitVolt) {
+			return read(Group, Block, Address, Count, Inputs, Data, Layout, Unit);
+		}
+
+	private:
+		bdfAPI::eErrorCode inputInfo(unsigned Group, unsigned Input, const bdfAPI::sInputInfo** Info) {
+			auto key = std::make_pair(Group, Input);
+			auto it = m_InputInfos.find(key);
+			if (it == m_InputInfos.end()) {
+				bdfAPI::sInputInfo info;
+				bdfAPI::eErrorCode err = m_Api->getInputInfo(Group, Input, &info);
+				if (err != bdfAPI::errNoError) return err;
+				it = m_InputInfos.emplace(key, info).first;
+			}
+			*Info = &it->second;
+			return bdfAPI::errNoError;
+		}
+
+		bdfAPI::eErrorCode readInput(const bdfAPI::sInputInfo&, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint16_t* Data, unsigned Count, bdfConvert::eUnit) {
+			return m_Api->getRawDataS(Group, Input, Block, Address, Data, Count);
+		}
+
+		template <typename T>
+		bdfAPI::eErrorCode readInput(const bdfAPI::sInputInfo& Info, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, T* Data, unsigned Count, bdfConvert::eUnit Unit) {
+			return bdfConvert::getData(m_Api, Info, Group, Input, Block, Address, Data, Count, Unit);
+		}
+
+		template <typename T>
+		bdfAPI::eErrorCode read(unsigned Group, unsigned Block, uint64_t Address, unsigned Count, const std::vector<unsigned>& Inputs, T* Data, eLayout Layout, bdfConvert::eUnit Unit) {
+			if (m_Api == nullptr) return bdfAPI::errInvalidHandle;
+			if (Data == nullptr) return bdfAPI::errArgument;
+
+			std::vector<unsigned> inputs = Inputs;
+			if (inputs.empty()) {
+				unsigned nrOfInputs = m_Api->getNumberOfInputs(Group);
+				for (unsigned i = 0; i < nrOfInputs; i++) inputs.push_back(i);
+			}
+			if (inputs.empty()) return bdfAPI::errArgument;
+
+			std::vector<const bdfAPI::sInputInfo*> infos(inputs.size());
+			for (size_t n = 0; n < inputs.size(); n++) {
+				bdfAPI::eErrorCode err = inputInfo(Group, inputs[n], &infos[n]);
+				if (err != bdfAPI::errNoError) return err;
+			}
+
+			if (Layout == layoutPlanar || inputs.size() == 1) {
+				for (size_t n = 0; n < inputs.size(); n++) {
+					bdfAPI::eErrorCode err = readInput(*infos[n], Group, inputs[n], Block, Address, Data + n * (size_t)Count, Count, Unit);
+					if (err != bdfAPI::errNoError) return err;
+				}
+				return bdfAPI::errNoError;
+			}
+
+			// interleaved: one read of the whole range per input into a staging buffer, then scatter it into the result
+			const size_t nrOfInputs = inputs.size();
+			m_Staging.resize(((size_t)Count * sizeof(T) + sizeof(double) - 1) / sizeof(double));
+			T* staging = reinterpret_cast<T*>(m_Staging.data());
+			for (size_t i = 0; i < nrOfInputs; i++) {
+				bdfAPI::eErrorCode err = readInput(*infos[i], Group, inputs[i], Block, Address, staging, Count, Unit);
+				if (err != bdfAPI::errNoError) return err;
+				T* dst = Data + i;
+				for (unsigned k = 0; k < Count; k++) dst[(size_t)k * nrOfInputs] = staging[k];
+			}
+			return bdfAPI::errNoError;
+		}
+
+		bdfAPI* m_Api;
+		std::map<std::pair<unsigned, unsigned>, bdfAPI::sInputInfo> m_InputInfos;
+		/// Staging buffer of the interleaved layout, Count samples of any sample type
+		std::vector<double> m_Staging;
+	};
+}
@@ -0,0 +1,628 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfConvert.h"
+#include "bdfDecorator.h"
+#include "bdfIndex.h"
+
+namespace filereader {
+	/// <summary>
+	/// Memory budgeted LRU cache of raw data chunks and envelope windows, shared by any number of API objects
+	/// and threads. Entries are spread over shards by the hash of their key, each shard has its own lock and
+	/// its own LRU list with an equal part of the byte budget, so concurrent readers rarely wait for each other.
+	/// Entries are immutable and shared, a reader copies from an entry without holding a lock.
+	/// </summary>
+	class bdfBlockCache {
+	public:
+		/// Kind of a cache entry
+		enum eKind {
+			kindRaw, /// Raw words of a chunk, uint16_t or int32_t by BytesPerSample
+			kindEnvWindows, /// Masked raw (min, max) as uint32_t pairs of consecutive windows of one size
+			kindEnvEdge /// Raw words of one window of the finest envelope level, read for the edges of envelope segments
+		};
+
+		/// Key of an entry. Raw chunks and edges have Address = first sample and Size = number of samples,
+		/// envelope windows have Address = first sample of the first window, Size = samples per window and Count = windows
+		/// per entry. Count is 0 for the other kinds.
+		struct sKey {
+			uint64_t File; /// File id, see fileId
+			uint32_t Group;
+			uint32_t Input;
+			uint32_t Block;
+			uint32_t Kind;
+			uint64_t Address;
+			uint64_t Size;
+			uint32_t Count;
+
+			bool operator==(const sKey& Other) const {
+				return File == Other.File && Group == Other.Group && Input == Other.Input && Block == Other.Block && Kind == Other.Kind && Address == Other.Address && Size == Other.Size && Count == Other.Count;
+			}
+		};
+
+		/// Entry data
+		typedef std::shared_ptr<const std::vector<uint8_t>> tEntry;
+
+		/// Counters since creation or resetStatistics
+		struct sCacheStatistics {
+			uint64_t Hits;
+			uint64_t Misses;
+			uint64_t Insertions;
+			uint64_t Evictions; /// Entries removed to stay within the budget
+			uint64_t Bytes; /// Bytes in use, including a fixed overhead per entry
+			uint64_t Entries; /// Number of entries
+			uint64_t BudgetBytes;
+		};
+
+		/// Number of shards
+		static constexpr unsigned NrOfShards = 16;
+		/// Bytes counted per entry in addition to its data
+		static constexpr uint64_t EntryOverhead = 128;
+
+		/// <summary>
+		/// Create a cache
+		/// </summary>
+		/// <param name="BudgetBytes">Maximum bytes of all entries</param>
+		explicit bdfBlockCache(uint64_t BudgetBytes = DefaultBudget) {
+			setBudget(BudgetBytes);
+		}
+
+		bdfBlockCache(const bdfBlockCache&) = delete;
+		bdfBlockCache& operator=(const bdfBlockCache&) = delete;
+
+		/// The process wide cache, DefaultBudget bytes until changed with setBudget
+		static bdfBlockCache& global() {
+			static bdfBlockCache cache;
+			return cache;
+		}
+
+		/// <summary>
+		/// Id of a version of a file, from its path and sFileStamp. A rewritten file gets a new id.
+		/// </summary>
+		/// <returns>0 if the file cannot be read</returns>
+		static uint64_t fileId(const std::string& FileName) {
+			sFileStamp stamp;
+			if (!sFileStamp::get(FileName, stamp)) return 0;
+			uint64_t id = sFileStamp::hash(FileName.data(), FileName.size());
+			id = sFileStamp::hash(&stamp, sizeof(stamp), id);
+			return id != 0 ? id : 1;
+		}
+
+		/// <summary>
+		/// Set the byte budget, entries are evicted if the cache is larger
+		/// </summary>
+		void setBudget(uint64_t BudgetBytes) {
+			m_Budget = BudgetBytes;
+			for (sShard& shard : m_Shards) {
+				std::lock_guard<std::mutex> lock(shard.Mutex);
+				shard.Budget = BudgetBytes / NrOfShards;
+				evict(shard);
+			}
+		}
+
+		/// <summary>
+		/// Find an entry and mark it as recently used
+		/// </summary>
+		/// <returns>nullptr if not cached</returns>
+		tEntry find(const sKey& Key) {
+			sShard& shard = m_Shards[hash(Key) % NrOfShards];
+			std::lock_guard<std::mutex> lock(shard.Mutex);
+			auto it = shard.Map.find(Key);
+			if (it == shard.Map.end()) {
+				m_Misses++;
+				return nullptr;
+			}
+			shard.Lru.splice(shard.Lru.begin(), shard.Lru, it->second);
+			m_Hits++;
+			return it->second->Data;
+		}
+
+		/// <summary>
+		/// True if an entry is cached, without counting a hit or miss
+		/// </summary>
+		bool contains(const sKey& Key) {
+			sShard& shard = m_Shards[hash(Key) % NrOfShards];
+			std::lock_guard<std::mutex> lock(shard.Mutex);
+			return shard.Map.find(Key) != shard.Map.end();
+		}
+
+		/// <summary>
+		/// Insert or replace an entry. Entries larger than the budget of a shard are not cached.
+		/// </summary>
+		void insert(const sKey& Key, const tEntry& Data) {
+			const uint64_t bytes = Data->size() + EntryOverhead;
+			sShard& shard = m_Shards[hash(Key) % NrOfShards];
+			std::lock_guard<std::mutex> lock(shard.Mutex);
+			if (bytes > shard.Budget) return;
+			auto it = shard.Map.find(Key);
+			if (it != shard.Map.end()) {
+				shard.Bytes -= it->second->Bytes;
+				shard.Lru.erase(it->second);
+				shard.Map.erase(it);
+			}
+			shard.Lru.push_front(sEntry{ Key, Data, bytes });
+			shard.Map[Key] = shard.Lru.begin();
+			shard.Bytes += bytes;
+			m_Insertions++;
+			evict(shard);
+		}
+
+		/// <summary>
+		/// Remove all entries of a file
+		/// </summary>
+		void erase(uint64_t File) {
+			for (sShard& shard : m_Shards) {
+				std::lock_guard<std::mutex> lock(shard.Mutex);
+				for (auto it = shard.Lru.begin(); it != shard.Lru.end();) {
+					if (it->Key.File != File) {
+						++it;
+						continue;
+					}
+					shard.Bytes -= it->Bytes;
+					shard.Map.erase(it->Key);
+					it = shard.Lru.erase(it);
+				}
+			}
+		}
+
+		/// <summary>
+		/// Remove all entries
+		/// </summary>
+		void clear() {
+			for (sShard& shard : m_Shards) {
+				std::lock_guard<std::mutex> lock(shard.Mutex);
+				shard.Lru.clear();
+				shard.Map.clear();
+				shard.Bytes = 0;
+			}
+		}
+
+		/// <summary>
+		/// Get the counters and the current size
+		/// </summary>
+		sCacheStatistics statistics() {
+			sCacheStatistics statistics = { m_Hits, m_Misses, m_Insertions, m_Evictions, 0, 0, m_Budget };
+			for (sShard& shard : m_Shards) {
+				std::lock_guard<std::mutex> lock(shard.Mutex);
+				statistics.Bytes += shard.Bytes;
+				statistics.Entries += shard.Map.size();
+			}
+			return statistics;
+		}
+
+		/// <summary>
+		/// Reset the hit, miss, insertion and eviction counters
+		/// </summary>
+		void resetStatistics() {
+			m_Hits = 0;
+			m_Misses = 0;
+			m_Insertions = 0;
+			m_Evictions = 0;
+		}
+
+		/// Default budget of the process wide cache
+		static constexpr uint64_t DefaultBudget = 256ull * 1024 * 1024;
+
+	private:
+		struct sHash {
+			size_t operator()(const sKey& Key) const { return (size_t)hash(Key); }
+		};
+
+		struct sEntry {
+			sKey Key;
+			tEntry Data;
+			uint64_t Bytes;
+		};
+
+		struct sShard {
+			std::mutex Mutex;
+			std::list<sEntry> Lru; /// Most recently used first
+			std::unordered_map<sKey, std::list<sEntry>::iterator, sHash> Map;
+			uint64_t Bytes = 0;
+			uint64_t Budget = 0;
+		};
+
+		static uint64_t hash(const sKey& Key) {
+			uint64_t h = Key.File;
+			for (uint64_t v : { (uint64_t)Key.Group, (uint64_t)Key.Input, (uint64_t)Key.Block, (uint64_t)Key.Kind, Key.Address, Key.Size, (uint64_t)Key.Count }) {
+				h ^= v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+			}
+			return h ^ (h >> 29);
+		}
+
+		void evict(sShard& Shard) {
+			while (Shard.Bytes > Shard.Budget && !Shard.Lru.empty()) {
+				const sEntry& entry = Shard.Lru.back();
+				Shard.Bytes -= entry.Bytes;
+				Shard.Map.erase(entry.Key);
+				Shard.Lru.pop_back();
+				m_Evictions++;
+			}
+		}
+
+		sShard m_Shards[NrOfShards];
+		std::atomic<uint64_t> m_Budget{ 0 };
+		std::atomic<uint64_t> m_Hits{ 0 };
+		std::atomic<uint64_t> m_Misses{ 0 };
+		std::atomic<uint64_t> m_Insertions{ 0 };
+		std::atomic<uint64_t> m_Evictions{ 0 };
+	};
+
+	/// <summary>
+	/// Reader option which serves getRawData*, getData* and getEnv* from a bdfBlockCache. Raw data is cached in
+	/// chunks of ChunkSamples samples, getData* converts the cached raw words.
+	/// getEnv* builds every segment from cached min/max of fixed, aligned windows: EnvelopeWindow samples on the finest
+	/// level, EnvelopeFactor times more on each coarser level. One entry holds up to EnvelopePage windows but covers at
+	/// most EnvelopePageSamples samples, so a miss on a coarse level does not scan much more of the block than the
+	/// window asked for; the entry is filled with one getEnvRaw* call of the wrapped API object. The parts of a segment not covered by whole windows are read as raw words of
+	/// the finest window around them, which are cached as well. So a pan or zoom of a view reuses the windows of the
+	/// previous one instead of repeating the request. Segments shorter than 4 finest windows use the raw chunks.
+	/// The envelope is the min/max of the masked raw words like bdfArchiveReader, scaled with BinToVolt for getEnvData*
+	/// (min and max exchanged for a negative BinToVoltFactor).
+	/// On a miss, the missing chunk and up to ReadaheadChunks following chunks are read with one call of the wrapped API object.
+	/// Like an API object, a cached reader must not be used by several threads at the same time; the cache may be shared.
+	/// </summary>
+	class bdfCachedReader : public bdfAPIDecorator {
+	public:
+		/// <summary>
+		/// Wrap a reader API object
+		/// </summary>
+		/// <param name="Api">API object used for reading</param>
+		/// <param name="Cache">Cache, shared with other readers</param>
+		/// <param name="ReadaheadChunks">Chunks read ahead after a miss</param>
+		/// <param name="ChunkSamples">Samples per chunk</param>
+		/// <param name="EnvelopePageSamples">Samples covered by one entry of envelope windows, at least one window</param>
+		bdfCachedReader(bdfAPI* Api, bdfBlockCache& Cache = bdfBlockCache::global(), unsigned ReadaheadChunks = 0, unsigned ChunkSamples = 64 * 1024, uint64_t EnvelopePageSamples = 1024 * 1024)
+			: bdfAPIDecorator(Api), m_Cache(Cache), m_Readahead(ReadaheadChunks), m_ChunkSamples(ChunkSamples > 0 ? ChunkSamples : 1), m_EnvelopePageSamples(EnvelopePageSamples) {}
+
+		/// Samples per window of the finest envelope level
+		static constexpr unsigned EnvelopeWindow = 64;
+		/// Window size factor between envelope levels
+		static constexpr unsigned EnvelopeFactor = 16;
+		/// Maximum windows per envelope cache entry
+		static constexpr unsigned EnvelopePage = 256;
+
+		/// Windows per envelope cache entry of a level with Window samples per window
+		unsigned envelopePage(uint64_t Window) const {
+			const uint64_t windows = m_EnvelopePageSamples / Window;
+			return (unsigned)std::max<uint64_t>(1, std::min<uint64_t>(windows, EnvelopePage));
+		}
+
+		/// <summary>
+		/// Load a file. The file id is taken from the path and stamp of the file, so readers of the same file share entries.
+		/// </summary>
+		virtual int loadFile(const char* FileName) override {
+			closeFile();
+			int result = m_Api->loadFile(FileName);
+			if (result != -1) m_File = bdfBlockCache::fileId(FileName);
+			return result;
+		}
+
+		virtual void closeFile(int handle = -1) override {
+			m_Api->closeFile(handle);
+			m_File = 0;
+			m_InputInfos.clear();
+			m_BlockLengths.clear();
+			m_Pages.clear();
+		}
+
+		/// The cache
+		bdfBlockCache& cache() const { return m_Cache; }
+
+		virtual eErrorCode getRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint16_t* Data, unsigned Count) override {
+			return getRaw(Group, Input, Block, Address, Data, Count, false);
+		}
+
+		virtual eErrorCode getRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, int32_t* Data, unsigned Count) override {
+			return getRaw(Group, Input, Block, Address, Data, Count, true);
+		}
+
+		virtual eErrorCode getDataF(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, float* Data, unsigned Count) override {
+			const sInputInfo* inputInfo = info(Group, Input);
+			if (inputInfo == nullptr) return m_Api->getDataF(Group, Input, Block, Address, Data, Count);
+			return bdfConvert::getData(this, *inputInfo, Group, Input, Block, Address, Data, Count);
+		}
+
+		virtual eErrorCode getDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, double* Data, unsigned Count) override {
+			const sInputInfo* inputInfo = info(Group, Input);
+			if (inputInfo == nullptr) return m_Api->getDataD(Group, Input, Block, Address, Data, Count);
+			return bdfConvert::getData(this, *inputInfo, Group, Input, Block, Address, Data, Count);
+		}
+
+		virtual eErrorCode getEnvRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, uint16_t* Data, unsigned Count) override {
+			return getEnv(Group, Input, Block, Address, BlockSize, Data, Count, [](const sInputInfo&, uint32_t v) { return (uint16_t)v; },
+				[&]() { return m_Api->getEnvRawDataS(Group, Input, Block, Address, BlockSize, Data, Count); });
+		}
+
+		virtual eErrorCode getEnvRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, int32_t* Data, unsigned Count) override {
+			return getEnv(Group, Input, Block, Address, BlockSize, Data, Count, [](const sInputInfo&, uint32_t v) { return (int32_t)v; },
+				[&]() { return m_Api->getEnvRawDataL(Group, Input, Block, Address, BlockSize, Data, Count); });
+		}
+
+		virtual eErrorCode getEnvDataF(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, float* Data, unsigned Count) override {
+			return getEnv(Group, Input, Block, Address, BlockSize, Data, Count, [](const sInputInfo& Info, uint32_t v) { return (float)(v * Info.BinToVoltFactor + Info.BinToVoltConstant); },
+				[&]() { return m_Api->getEnvDataF(Group, Input, Block, Address, BlockSize, Data, Count); });
+		}
+
+		virtual eErrorCode getEnvDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, double* Data, unsigned Count) override {
+			return getEnv(Group, Input, Block, Address, BlockSize, Data, Count, [](const sInputInfo& Info, uint32_t v) { return v * Info.BinToVoltFactor + Info.BinToVoltConstant; },
+				[&]() { return m_Api->getEnvDataD(Group, Input, Block, Address, BlockSize, Data, Count); });
+		}
+
+	private:
+		const sInputInfo* info(unsigned Group, unsigned Input) {
+			const uint64_t key = ((uint64_t)Group << 32) | Input;
+			auto it = m_InputInfos.find(key);
+			if (it != m_InputInfos.end()) return &it->second;
+			sInputInfo inputInfo;
+			if (m_Api->getInputInfo(Group, Input, &inputInfo) != errNoError) return nullptr;
+			return &(m_InputInfos[key] = inputInfo);
+		}
+
+		bool blockLength(unsigned Group, unsigned Input, unsigned Block, uint64_t& Length) {
+			const std::tuple<unsigned, unsigned, unsigned> key(Group, Input, Block);
+			auto it = m_BlockLengths.find(key);
+			if (it == m_BlockLengths.end()) {
+				sBlockInfo blockInfo;
+				if (m_Api->getBlockInfo(Group, Input, Block, &blockInfo) != errNoError) return false;
+				it = m_BlockLengths.emplace(key, blockInfo.BlockLength).first;
+			}
+			Length = it->second;
+			return true;
+		}
+
+		bdfBlockCache::sKey chunkKey(unsigned Group, unsigned Input, unsigned Block, uint64_t Chunk, uint64_t Length) const {
+			const uint64_t address = Chunk * m_ChunkSamples;
+			return bdfBlockCache::sKey{ m_File, Group, Input, Block, bdfBlockCache::kindRaw, address, std::min<uint64_t>(m_ChunkSamples, Length - address), 0 };
+		}
+
+		/// Raw words through the chunk cache; 16-bit inputs are cached as uint16_t, wider inputs as int32_t
+		template <typename T>
+		eErrorCode getRaw(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, T* Data, unsigned Count, bool Wide) {
+			const sInputInfo* inputInfo = info(Group, Input);
+			uint64_t length;
+			if (m_File == 0 || inputInfo == nullptr || !blockLength(Group, Input, Block, length) || Data == nullptr || Address > length || Count > length - Address) {
+				return Wide ? m_Api->getRawDataL(Group, Input, Block, Address, reinterpret_cast<int32_t*>(Data), Count)
+					: m_Api->getRawDataS(Group, Input, Block, Address, reinterpret_cast<uint16_t*>(Data), Count);
+			}
+			const bool wideInput = inputInfo->BytesPerSample > 2;
+			if (!wideInput && Wide) {
+				// 16-bit chunks widened to 32 bits
+				uint16_t* raw = reinterpret_cast<uint16_t*>(Data) + Count;
+				eErrorCode err = getRaw(Group, Input, Block, Address, raw, Count, false);
+				if (err != errNoError) return err;
+				bdfConvert::rawToL(raw, reinterpret_cast<int32_t*>(Data), Count, 0xFFFFFFFF);
+				return errNoError;
+			}
+			if (wideInput && !Wide) return m_Api->getRawDataS(Group, Input, Block, Address, reinterpret_cast<uint16_t*>(Data), Count);
+
+			const size_t sampleSize = wideInput ? sizeof(int32_t) : sizeof(uint16_t);
+			for (uint64_t pos = Address; pos < Address + Count;) {
+				const uint64_t chunk = pos / m_ChunkSamples;
+				const bdfBlockCache::sKey key = chunkKey(Group, Input, Block, chunk, length);
+				bdfBlockCache::tEntry entry = m_Cache.find(key);
+				if (entry == nullptr) {
+					eErrorCode err = load(Group, Input, Block, chunk, length, sampleSize, entry);
+					if (err != errNoError) return err;
+				}
+				const uint64_t first = pos - key.Address;
+				const uint64_t n = std::min<uint64_t>(key.Size - first, Address + Count - pos);
+				memcpy(Data + (pos - Address), entry->data() + first * sampleSize, (size_t)(n * sampleSize));
+				pos += n;
+			}
+			return errNoError;
+		}
+
+		/// Read a missing chunk and the following uncached chunks of the readahead with one call
+		eErrorCode load(unsigned Group, unsigned Input, unsigned Block, uint64_t Chunk, uint64_t Length, size_t SampleSize, bdfBlockCache::tEntry& Entry) {
+			const uint64_t nrOfChunks = (Length + m_ChunkSamples - 1) / m_ChunkSamples;
+			uint64_t last = Chunk + 1;
+			while (last < nrOfChunks && last <= Chunk + m_Readahead && !m_Cache.contains(chunkKey(Group, Input, Block, last, Length))) last++;
+			const uint64_t address = Chunk * m_ChunkSamples;
+			const uint64_t count = std::min<uint64_t>(last * m_ChunkSamples, Length) - address;
+			try {
+				m_Buffer.resize((size_t)(count * SampleSize));
+				eErrorCode err = SampleSize > sizeof(uint16_t) ? m_Api->getRawDataL(Group, Input, Block, address, reinterpret_cast<int32_t*>(m_Buffer.data()), (unsigned)count)
+					: m_Api->getRawDataS(Group, Input, Block, address, reinterpret_cast<uint16_t*>(m_Buffer.data()), (unsigned)count);
+				if (err != errNoError) return err;
+				for (uint64_t c = Chunk; c < last; c++) {
+					const bdfBlockCache::sKey key = chunkKey(Group, Input, Block, c, Length);
+					const uint8_t* src = m_Buffer.data() + (key.Address - address) * SampleSize;
+					bdfBlockCache::tEntry entry = std::make_shared<const std::vector<uint8_t>>(src, src + key.Size * SampleSize);
+					m_Cache.insert(key, entry);
+					if (c == Chunk) Entry = entry;
+				}
+			}
+			catch (const std::bad_alloc&) {
+				return errResource;
+			}
+			return errNoError;
+		}
+
+		/// Envelope with the segment rule of bdfAPI::getEnvRawDataS from cached windows; arguments the cache cannot serve go to the wrapped API object
+		template <typename T, typename S, typename F>
+		eErrorCode getEnv(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, T* Data, unsigned Count, S Scale, F Read) {
+			const sInputInfo* inputInfo = info(Group, Input);
+			const unsigned segments = Count / 2;
+			uint64_t length;
+			if (m_File == 0 || inputInfo == nullptr || Data == nullptr || segments == 0 || BlockSize < segments || !blockLength(Group, Input, Block, length) || Address > length || BlockSize > length - Address) {
+				return Read();
+			}
+			const sEnvelope envelope{ Group, Input, Block, length, inputInfo->BytesPerSample > 2, inputInfo->AnalogMask };
+			const bool shortSegments = BlockSize / segments < 4 * EnvelopeWindow;
+			try {
+				for (unsigned s = 0; s < segments; s++) {
+					const uint64_t from = Address + BlockSize * s / segments;
+					const uint64_t to = Address + BlockSize * (s + 1) / segments;
+					uint32_t mn = UINT32_MAX, mx = 0;
+					eErrorCode err = shortSegments ? rawMinMax(envelope, from, to, mn, mx) : rangeMinMax(envelope, from, to, mn, mx);
+					if (err != errNoError) return err;
+					Data[2 * s] = Scale(*inputInfo, mn);
+					Data[2 * s + 1] = Scale(*inputInfo, mx);
+					// a negative BinToVoltFactor turns the raw minimum into the maximum
+					if (Data[2 * s + 1] < Data[2 * s]) std::swap(Data[2 * s], Data[2 * s + 1]);
+				}
+			}
+			catch (const std::bad_alloc&) {
+				return errResource;
+			}
+			return errNoError;
+		}
+
+		/// Block of an envelope request
+		struct sEnvelope {
+			unsigned Group;
+			unsigned Input;
+			unsigned Block;
+			uint64_t Length;
+			bool Wide; /// More than 2 bytes per sample
+			uint32_t Mask;
+		};
+
+		template <typename T>
+		static void minMax(const T* Data, uint64_t Count, uint32_t Mask, uint32_t& Min, uint32_t& Max) {
+			for (uint64_t k = 0; k < Count; k++) {
+				const uint32_t v = (uint32_t)Data[k] & Mask;
+				Min = std::min(Min, v);
+				Max = std::max(Max, v);
+			}
+		}
+
+		/// Masked min/max of a short range through the raw chunks
+		eErrorCode rawMinMax(const sEnvelope& Envelope, uint64_t From, uint64_t To, uint32_t& Min, uint32_t& Max) {
+			const unsigned count = (unsigned)(To - From);
+			m_Samples.resize(count);
+			if (Envelope.Wide) {
+				eErrorCode err = getRaw(Envelope.Group, Envelope.Input, Envelope.Block, From, m_Samples.data(), count, true);
+				if (err != errNoError) return err;
+				minMax(m_Samples.data(), count, Envelope.Mask, Min, Max);
+				return errNoError;
+			}
+			uint16_t* raw = reinterpret_cast<uint16_t*>(m_Samples.data());
+			eErrorCode err = getRaw(Envelope.Group, Envelope.Input, Envelope.Block, From, raw, count, false);
+			if (err != errNoError) return err;
+			minMax(raw, count, Envelope.Mask, Min, Max);
+			return errNoError;
+		}
+
+		/// Masked min/max of a range from the largest aligned windows inside it, the rest from the edge windows
+		eErrorCode rangeMinMax(const sEnvelope& Envelope, uint64_t From, uint64_t To, uint32_t& Min, uint32_t& Max) {
+			while (From < To) {
+				uint64_t window = EnvelopeWindow;
+				if (From % window != 0 || std::min(From + window, Envelope.Length) > To) {
+					const uint64_t end = std::min(To, (From / window + 1) * window);
+					eErrorCode err = edgeMinMax(Envelope, From, end, Min, Max);
+					if (err != errNoError) return err;
+					From = end;
+					continue;
+				}
+				unsigned level = 0;
+				while (window <= Envelope.Length / EnvelopeFactor && From % (window * EnvelopeFactor) == 0 && std::min(From + window * EnvelopeFactor, Envelope.Length) <= To) {
+					window *= EnvelopeFactor;
+					level++;
+				}
+				eErrorCode err = windowMinMax(Envelope, level, window, From, Min, Max);
+				if (err != errNoError) return err;
+				From = std::min(From + window, Envelope.Length);
+			}
+			return errNoError;
+		}
+
+		/// Masked min/max of a part of the finest window around it
+		eErrorCode edgeMinMax(const sEnvelope& Envelope, uint64_t From, uint64_t To, uint32_t& Min, uint32_t& Max) {
+			const uint64_t address = From / EnvelopeWindow * EnvelopeWindow;
+			const size_t sampleSize = Envelope.Wide ? sizeof(int32_t) : sizeof(uint16_t);
+			const bdfBlockCache::sKey key{ m_File, Envelope.Group, Envelope.Input, Envelope.Block, bdfBlockCache::kindEnvEdge, address, std::min<uint64_t>(EnvelopeWindow, Envelope.Length - address), 0 };
+			bdfBlockCache::tEntry entry = m_Cache.find(key);
+			if (entry == nullptr) {
+				std::vector<uint8_t> data((size_t)(key.Size * sampleSize));
+				eErrorCode err = Envelope.Wide ? m_Api->getRawDataL(Envelope.Group, Envelope.Input, Envelope.Block, address, reinterpret_cast<int32_t*>(data.data()), (unsigned)key.Size)
+					: m_Api->getRawDataS(Envelope.Group, Envelope.Input, Envelope.Block, address, reinterpret_cast<uint16_t*>(data.data()), (unsigned)key.Size);
+				if (err != errNoError) return err;
+				entry = std::make_shared<const std::vector<uint8_t>>(std::move(data));
+				m_Cache.insert(key, entry);
+			}
+			if (Envelope.Wide) minMax(reinterpret_cast<const int32_t*>(entry->data()) + (From - address), To - From, Envelope.Mask, Min, Max);
+			else minMax(reinterpret_cast<const uint16_t*>(entry->data()) + (From - address), To - From, Envelope.Mask, Min, Max);
+			return errNoError;
+		}
+
+		/// Masked min/max of one aligned window of a level. The entry of the last window of each level is kept
+		/// in m_Pages, so consecutive windows do not look up the cache.
+		eErrorCode windowMinMax(const sEnvelope& Envelope, unsigned Level, uint64_t Window, uint64_t Address, uint32_t& Min, uint32_t& Max) {
+			const unsigned windows = envelopePage(Window);
+			const uint64_t pageAddress = Address / (Window * windows) * (Window * windows);
+			const bdfBlockCache::sKey key{ m_File, Envelope.Group, Envelope.Input, Envelope.Block, bdfBlockCache::kindEnvWindows, pageAddress, Window, windows };
+			if (m_Pages.size() <= Level) m_Pages.resize(Level + 1);
+			std::pair<bdfBlockCache::sKey, bdfBlockCache::tEntry>& page = m_Pages[Level];
+			if (page.second == nullptr || !(page.first == key)) {
+				bdfBlockCache::tEntry entry = m_Cache.find(key);
+				if (entry == nullptr) {
+					eErrorCode err = loadWindows(Envelope, key, entry);
+					if (err != errNoError) return err;
+				}
+				page = std::make_pair(key, entry);
+			}
+			const uint32_t* pairs = reinterpret_cast<const uint32_t*>(page.second->data()) + 2 * ((Address - pageAddress) / Window);
+			Min = std::min(Min, pairs[0]);
+			Max = std::max(Max, pairs[1]);
+			return errNoError;
+		}
+
+		/// Read the windows of an entry with one envelope call of the wrapped API object, a shorter last window of the block with a second one
+		eErrorCode loadWindows(const sEnvelope& Envelope, const bdfBlockCache::sKey& Key, bdfBlockCache::tEntry& Entry) {
+			const uint64_t end = std::min(Key.Address + Key.Size * Key.Count, Envelope.Length);
+			const unsigned whole = (unsigned)((end - Key.Address) / Key.Size);
+			const uint64_t rest = end - Key.Address - whole * Key.Size;
+			const unsigned windows = whole + (rest > 0 ? 1 : 0);
+			std::vector<uint8_t> data(windows * 2 * sizeof(uint32_t));
+			uint32_t* pairs = reinterpret_cast<uint32_t*>(data.data());
+			auto read = [&](uint64_t Address, uint64_t Size, unsigned Windows, uint32_t* Pairs) {
+				if (Envelope.Wide) {
+					int32_t* envelope = reinterpret_cast<int32_t*>(Pairs);
+					return m_Api->getEnvRawDataL(Envelope.Group, Envelope.Input, Envelope.Block, Address, Size, envelope, 2 * Windows);
+				}
+				// 16-bit results are read into the upper half and widened forward in place
+				uint16_t* envelope = reinterpret_cast<uint16_t*>(Pairs) + 2 * Windows;
+				eErrorCode err = m_Api->getEnvRawDataS(Envelope.Group, Envelope.Input, Envelope.Block, Address, Size, envelope, 2 * Windows);
+				for (unsigned k = 0; err == errNoError && k < 2 * Windows; k++) Pairs[k] = envelope[k];
+				return err;
+			};
+			if (whole > 0) {
+				eErrorCode err = read(Key.Address, whole * Key.Size, whole, pairs);
+				if (err != errNoError) return err;
+			}
+			if (rest > 0) {
+				eErrorCode err = read(Key.Address + whole * Key.Size, rest, 1, pairs + 2 * whole);
+				if (err != errNoError) return err;
+			}
+			Entry = std::make_shared<const std::vector<uint8_t>>(std::move(data));
+			m_Cache.insert(Key, Entry);
+			return errNoError;
+		}
+
+		bdfBlockCache& m_Cache;
+		const unsigned m_Readahead;
+		const unsigned m_ChunkSamples;
+		const uint64_t m_EnvelopePageSamples;
+		uint64_t m_File = 0;
+		std::map<uint64_t, sInputInfo> m_InputInfos;
+		std::map<std::tuple<unsigned, unsigned, unsigned>, uint64_t> m_BlockLengths;
+		std::vector<uint8_t> m_Buffer;
+		std::vector<int32_t> m_Samples;
+		/// Last envelope entry per level
+		std::vector<std::pair<bdfBlockCache::sKey, bdfBlockCache::tEntry>> m_Pages;
+	};
+}
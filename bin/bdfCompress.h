@@ -0,0 +1,643 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <new>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfConvert.h"
+#include "bdfIndex.h"
+
+namespace filereader {
+	/// <summary>
+	/// Lossless codec for chunks of 16-bit raw words.
+	/// A chunk stores its first word, followed by the differences of neighbouring words (zigzag coded) in
+	/// mini blocks of 128 values. Each mini block has its own bit width and is packed vertically: 16-bit lane j
+	/// of packed word w holds bits of the values j, j + 8, ..., so 8 values are unpacked per SSE2 instruction
+	/// and the running sum is computed with vector shifts.
+	/// </summary>
+	class bdfDeltaCodec {
+	public:
+		/// Samples per chunk
+		static constexpr unsigned ChunkSamples = 4096;
+		/// Values per mini block
+		static constexpr unsigned MiniBlock = 128;
+
+		/// Maximum encoded size of a chunk
+		static size_t maxEncodedSize(size_t Count) { return 2 + (Count + MiniBlock - 1) / MiniBlock * (1 + MiniBlock * 2); }
+
+		/// <summary>
+		/// Encode a chunk
+		/// </summary>
+		/// <param name="Src">Raw words</param>
+		/// <param name="Count">Number of words, 1 to ChunkSamples</param>
+		/// <param name="Dst">Destination of maxEncodedSize(Count) bytes</param>
+		/// <returns>Encoded size in bytes</returns>
+		static size_t encode(const uint16_t* Src, size_t Count, uint8_t* Dst) {
+			uint8_t* p = Dst;
+			memcpy(p, Src, 2);
+			p += 2;
+			uint16_t previous = Src[0];
+			for (size_t block = 0; block < Count; block += MiniBlock) {
+				uint16_t z[MiniBlock] = { 0 };
+				uint16_t any = 0;
+				for (size_t k = 0; k < MiniBlock && block + k < Count; k++) {
+					const int16_t delta = (int16_t)(uint16_t)(Src[block + k] - previous);
+					z[k] = (uint16_t)(((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15));
+					previous = Src[block + k];
+					any |= z[k];
+				}
+				unsigned width = 0;
+				while (width < 16 && (any >> width) != 0) width++;
+				*p++ = (uint8_t)width;
+
+				// lane j, value i is z[8 * i + j], its bits start at bit i * width of the lane
+				uint16_t packed[16][8] = { { 0 } };
+				for (unsigned j = 0; j < 8; j++) {
+					for (unsigned i = 0; i < 16; i++) {
+						const uint32_t v = z[8 * i + j];
+						const unsigned bit = i * width;
+						packed[bit / 16][j] |= (uint16_t)(v << (bit % 16));
+						if (bit % 16 + width > 16) packed[bit / 16 + 1][j] |= (uint16_t)(v >> (16 - bit % 16));
+					}
+				}
+				memcpy(p, packed, width * 16);
+				p += width * 16;
+			}
+			return (size_t)(p - Dst);
+		}
+
+		/// <summary>
+		/// Decode a chunk
+		/// </summary>
+		/// <param name="Src">Encoded chunk</param>
+		/// <param name="Size">Encoded size in bytes</param>
+		/// <param name="Dst">Destination of Count words</param>
+		/// <param name="Count">Number of words of the chunk</param>
+		/// <param name="Isa">Kernel to use, SSE2 is used for all SIMD instruction sets</param>
+		/// <returns>false if the data is corrupt</returns>
+		static bool decode(const uint8_t* Src, size_t Size, uint16_t* Dst, size_t Count, bdfConvert::eInstructionSet Isa = bdfConvert::isaBest) {
+			if (Size < 2 || Count == 0) return false;
+			if (Isa == bdfConvert::isaBest || Isa > bdfConvert::instructionSet()) Isa = bdfConvert::instructionSet();
+			const uint8_t* p = Src + 2;
+			const uint8_t* end = Src + Size;
+			uint16_t previous;
+			memcpy(&previous, Src, 2);
+			for (size_t block = 0; block < Count; block += MiniBlock) {
+				if (p >= end) return false;
+				const unsigned width = *p++;
+				if (width > 16 || (size_t)(end - p) < width * 16) return false;
+				const size_t n = Count - block < MiniBlock ? Count - block : MiniBlock;
+#ifdef BDF_CONVERT_X86
+				if (Isa != bdfConvert::isaScalar) previous = decodeBlock_SSE2(p, width, previous, Dst + block, n);
+				else
+#endif
+					previous = decodeBlock(p, width, previous, Dst + block, n);
+				p += width * 16;
+			}
+			return true;
+		}
+
+	private:
+		static uint16_t decodeBlock(const uint8_t* Src, unsigned Width, uint16_t Previous, uint16_t* Dst, size_t Count) {
+			uint16_t packed[16][8];
+			memcpy(packed, Src, Width * 16);
+			const uint32_t mask = (1u << Width) - 1;
+			for (size_t k = 0; k < Count; k++) {
+				const unsigned i = (unsigned)(k / 8), j = (unsigned)(k % 8);
+				uint32_t v = 0;
+				if (Width > 0) {
+					const unsigned bit = i * Width;
+					v = packed[bit / 16][j] >> (bit % 16);
+					if (bit % 16 + Width > 16) v |= (uint32_t)packed[bit / 16 + 1][j] << (16 - bit % 16);
+					v &= mask;
+				}
+				const uint16_t delta = (uint16_t)((v >> 1) ^ (0u - (v & 1)));
+				Previous = (uint16_t)(Previous + delta);
+				Dst[k] = Previous;
+			}
+			return Previous;
+		}
+
+#ifdef BDF_CONVERT_X86
+		BDF_TARGET_SSE2 static uint16_t decodeBlock_SSE2(const uint8_t* Src, unsigned Width, uint16_t Previous, uint16_t* Dst, size_t Count) {
+			__m128i words[17];
+			for (unsigned w = 0; w < Width; w++) words[w] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + 16 * w));
+			words[Width] = _mm_setzero_si128();
+			const __m128i mask = _mm_set1_epi16((short)((1u << Width) - 1));
+			const __m128i one = _mm_set1_epi16(1);
+			const __m128i zero = _mm_setzero_si128();
+			__m128i carry = _mm_set1_epi16((short)Previous);
+			uint16_t tail[8];
+			for (unsigned i = 0; i * 8 < Count; i++) {
+				__m128i v = zero;
+				if (Width > 0) {
+					const unsigned bit = i * Width;
+					v = _mm_srl_epi16(words[bit / 16], _mm_cvtsi32_si128((int)(bit % 16)));
+					if (bit % 16 + Width > 16) v = _mm_or_si128(v, _mm_sll_epi16(words[bit / 16 + 1], _mm_cvtsi32_si128((int)(16 - bit % 16))));
+					v = _mm_and_si128(v, mask);
+				}
+				// zigzag decode and running sum over the 8 lanes
+				v = _mm_xor_si128(_mm_srli_epi16(v, 1), _mm_sub_epi16(zero, _mm_and_si128(v, one)));
+				v = _mm_add_epi16(v, _mm_slli_si128(v, 2));
+				v = _mm_add_epi16(v, _mm_slli_si128(v, 4));
+				v = _mm_add_epi16(v, _mm_slli_si128(v, 8));
+				v = _mm_add_epi16(v, carry);
+				carry = _mm_shufflehi_epi16(v, 0xFF);
+				carry = _mm_unpackhi_epi64(carry, carry);
+				if (i * 8 + 8 <= Count) {
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(Dst + i * 8), v);
+				}
+				else {
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(tail), v);
+					memcpy(Dst + i * 8, tail, (Count - i * 8) * sizeof(uint16_t));
+					return tail[Count - i * 8 - 1];
+				}
+			}
+			return (uint16_t)_mm_cvtsi128_si32(carry);
+		}
+#endif
+	};
+
+	/// <summary>
+	/// Compressed archive of a BDF file. The archive holds the metadata of the file (see bdfBlockIndex) and the
+	/// raw data of every block in chunks of bdfDeltaCodec::ChunkSamples samples with a chunk offset table, the
+	/// masked min/max and a hash of the stored bytes of each chunk. Inputs with more than 2 bytes per sample are
+	/// stored uncompressed.
+	///
+	/// BdFileReader writes the BDF format, so compression can not be part of the file itself. The archive is
+	/// created from a loaded file and read with bdfArchiveReader, which implements the reader part of bdfAPI.
+	/// </summary>
+	class bdfArchive {
+	public:
+		/// Result of creating an archive
+		struct sArchiveStatistics {
+			uint64_t RawBytes; /// Bytes of the raw data
+			uint64_t ArchiveBytes; /// Size of the archive file
+		};
+
+		/// <summary>
+		/// Create an archive from a loaded file
+		/// </summary>
+		/// <param name="Api">API object with the file loaded</param>
+		/// <param name="ArchiveName">Name of the archive file</param>
+		/// <param name="Statistics">Optional sizes of raw data and archive</param>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode create(bdfAPI* Api, const std::string& ArchiveName, sArchiveStatistics* Statistics = nullptr) {
+			bdfBlockIndex index;
+			bdfAPI::eErrorCode err = index.build(Api);
+			if (err != bdfAPI::errNoError) return err;
+
+			std::ofstream file(ArchiveName, std::ios::binary | std::ios::trunc);
+			if (!file) return bdfAPI::errResource;
+			file.write(Magic, sizeof(Magic));
+			uint64_t offset = sizeof(Magic), rawBytes = 0;
+			std::string directory;
+			index.serialize(directory);
+
+			try {
+				std::vector<uint16_t> dataS(bdfDeltaCodec::ChunkSamples);
+				std::vector<int32_t> dataL(bdfDeltaCodec::ChunkSamples);
+				std::vector<uint8_t> encoded(bdfDeltaCodec::maxEncodedSize(bdfDeltaCodec::ChunkSamples));
+				for (unsigned g = 0; g < index.groups().size(); g++) {
+					for (unsigned i = 0; i < index.groups()[g].Inputs.size(); i++) {
+						const bdfBlockIndex::sInput& input = index.groups()[g].Inputs[i];
+						const bool wide = input.Info.BytesPerSample > 2;
+						for (unsigned b = 0; b < input.Blocks.size(); b++) {
+							const uint64_t length = input.Blocks[b].BlockLength;
+							const uint64_t nrOfChunks = (length + bdfDeltaCodec::ChunkSamples - 1) / bdfDeltaCodec::ChunkSamples;
+							put(directory, (uint32_t)(wide ? codecRaw32 : codecDelta16));
+							put(directory, nrOfChunks);
+							for (uint64_t c = 0; c < nrOfChunks; c++) {
+								const uint64_t address = c * bdfDeltaCodec::ChunkSamples;
+								const unsigned n = (unsigned)std::min<uint64_t>(bdfDeltaCodec::ChunkSamples, length - address);
+								uint32_t mn = UINT32_MAX, mx = 0;
+								size_t size;
+								const char* bytes;
+								if (wide) {
+									err = Api->getRawDataL(g, i, b, address, dataL.data(), n);
+									if (err != bdfAPI::errNoError) return err;
+									for (unsigned k = 0; k < n; k++) {
+										const uint32_t v = (uint32_t)dataL[k] & input.Info.AnalogMask;
+										mn = std::min(mn, v);
+										mx = std::max(mx, v);
+									}
+									size = n * sizeof(int32_t);
+									bytes = reinterpret_cast<const char*>(dataL.data());
+									rawBytes += size;
+								}
+								else {
+									err = Api->getRawDataS(g, i, b, address, dataS.data(), n);
+									if (err != bdfAPI::errNoError) return err;
+									uint16_t lo = 0xFFFF, hi = 0;
+									bdfConvert::minMax(dataS.data(), n, input.Info.AnalogMask, lo, hi);
+									mn = lo;
+									mx = hi;
+									size = bdfDeltaCodec::encode(dataS.data(), n, encoded.data());
+									bytes = reinterpret_cast<const char*>(encoded.data());
+									rawBytes += n * sizeof(uint16_t);
+								}
+								file.write(bytes, (std::streamsize)size);
+								if (!file) return bdfAPI::errResource;
+								put(directory, offset);
+								put(directory, (uint32_t)size);
+								put(directory, mn);
+								put(directory, mx);
+								put(directory, sFileStamp::hash(bytes, size));
+								offset += size;
+							}
+						}
+					}
+				}
+			}
+			catch (const std::bad_alloc&) {
+				return bdfAPI::errResource;
+			}
+
+			// directory at the end: metadata, chunk tables, checksum, then its offset and the magic again
+			put(directory, sFileStamp::hash(directory.data(), directory.size()));
+			file.write(directory.data(), (std::streamsize)directory.size());
+			std::string trailer;
+			put(trailer, offset);
+			trailer.append(Magic, sizeof(Magic));
+			file.write(trailer.data(), (std::streamsize)trailer.size());
+			file.close();
+			if (!file) return bdfAPI::errResource;
+			if (Statistics != nullptr) {
+				Statistics->RawBytes = rawBytes;
+				Statistics->ArchiveBytes = offset + directory.size() + trailer.size();
+			}
+			return bdfAPI::errNoError;
+		}
+
+	protected:
+		enum eCodec {
+			codecDelta16,
+			codecRaw32
+		};
+
+		template <typename T>
+		static void put(std::string& Data, const T& Value) { Data.append(reinterpret_cast<const char*>(&Value), sizeof(T)); }
+
+		static constexpr char Magic[8] = { 'B', 'D', 'F', 'Z', 'I', 'P', 0, 2 };
+	};
+
+	/// <summary>
+	/// Reader of an archive created by bdfArchive, implementing the reader functions of bdfAPI.
+	/// Reads decode only the chunks of the requested range; the last decoded chunk is kept for consecutive reads.
+	/// getEnv* use the stored min/max of chunks fully inside a segment and decode only the chunks at the segment edges.
+	/// Every chunk read from the file is checked against its hash, a damaged chunk is reported as errInternal.
+	/// The writer functions return -1. Like an API object, a reader must not be used by several threads at the same time.
+	/// </summary>
+	class bdfArchiveReader : public bdfAPI, private bdfArchive {
+	public:
+		bdfArchiveReader() {}
+		virtual ~bdfArchiveReader() {}
+
+		/// <summary>
+		/// Open an archive
+		/// </summary>
+		/// <returns>-1 on error</returns>
+		virtual int loadFile(const char* FileName) override {
+			closeFile();
+			m_File.open(FileName, std::ios::binary);
+			if (!m_File) return -1;
+			m_File.seekg(0, std::ios::end);
+			const uint64_t size = (uint64_t)m_File.tellg();
+			const uint64_t trailer = sizeof(uint64_t) + sizeof(Magic);
+			if (size < sizeof(Magic) + trailer) return fail();
+			char magic[sizeof(Magic)];
+			uint64_t offset;
+			m_File.seekg((std::streamoff)(size - trailer));
+			m_File.read(reinterpret_cast<char*>(&offset), sizeof(offset));
+			m_File.read(magic, sizeof(magic));
+			if (!m_File || memcmp(magic, Magic, sizeof(Magic)) != 0 || offset < sizeof(Magic) || offset > size - trailer) return fail();
+
+			std::string directory((size_t)(size - trailer - offset), 0);
+			m_File.seekg((std::streamoff)offset);
+			m_File.read(&directory[0], (std::streamsize)directory.size());
+			if (!m_File || directory.size() < sizeof(uint64_t)) return fail();
+			uint64_t checksum;
+			memcpy(&checksum, directory.data() + directory.size() - sizeof(checksum), sizeof(checksum));
+			if (checksum != sFileStamp::hash(directory.data(), directory.size() - sizeof(checksum))) return fail();
+
+			size_t pos = 0;
+			if (m_Index.deserialize(directory, pos) != errNoError) return fail();
+			for (unsigned g = 0; g < m_Index.groups().size(); g++) {
+				for (unsigned i = 0; i < m_Index.groups()[g].Inputs.size(); i++) {
+					const bdfBlockIndex::sInput& input = m_Index.groups()[g].Inputs[i];
+					for (unsigned b = 0; b < input.Blocks.size(); b++) {
+						sBlock& block = m_Blocks[std::make_tuple(g, i, b)];
+						uint32_t codec;
+						uint64_t nrOfChunks;
+						if (!get(directory, pos, codec) || !get(directory, pos, nrOfChunks) || nrOfChunks > directory.size()) return fail();
+						block.Codec = (eCodec)codec;
+						block.Length = input.Blocks[b].BlockLength;
+						block.Chunks.resize((size_t)nrOfChunks);
+						for (sChunk& chunk : block.Chunks) {
+							if (!get(directory, pos, chunk.Offset) || !get(directory, pos, chunk.Size) || !get(directory, pos, chunk.Min) || !get(directory, pos, chunk.Max) || !get(directory, pos, chunk.Hash)) return fail();
+						}
+					}
+				}
+			}
+			return 0;
+		}
+
+		virtual void closeFile(int handle = -1) override {
+			(void)handle;
+			if (m_File.is_open()) m_File.close();
+			m_File.clear();
+			m_Index = bdfBlockIndex();
+			m_Blocks.clear();
+			m_Cached = nullptr;
+			m_CachedL = nullptr;
+		}
+
+		virtual int initFileWriter(unsigned, sDateTime&, eOperationMode, double, uint32_t, uint32_t) override { return -1; }
+		virtual int writeInputHeader(uint32_t, uint32_t, uint32_t, uint32_t, double, double, double, double, int = 0) override { return -1; }
+		virtual int initInputStreamer(uint32_t, uint32_t, uint32_t, int = 0) override { return -1; }
+		virtual int writeData(int, char*, unsigned int, int = 0) override { return -1; }
+		virtual int setAttribute(unsigned, const std::string&, const std::string&, int = 0) override { return -1; }
+		virtual int writeAttributes(int = 0) override { return -1; }
+		virtual void writeEORInfo(uint32_t, uint64_t, uint64_t, uint32_t, uint32_t, int = 0) override {}
+		virtual int initFileReader() override { return 0; }
+
+		virtual eErrorCode getAttribute(unsigned Group, unsigned Input, char* Key, char* Value, unsigned Size) override {
+			const bdfBlockIndex::sInput* input = m_Index.input(Group, Input);
+			if (input == nullptr || Key == nullptr || Value == nullptr || Size == 0) return errArgument;
+			for (const bdfBlockIndex::sAttribute& a : input->Attributes) {
+				if (a.Key != Key) continue;
+				size_t n = a.Value.size() < Size - 1 ? a.Value.size() : Size - 1;
+				memcpy(Value, a.Value.data(), n);
+				Value[n] = 0;
+				return errNoError;
+			}
+			return errArgument;
+		}
+
+		virtual unsigned getNumberOfGroups() override { return (unsigned)m_Index.groups().size(); }
+		virtual unsigned getNumberOfInputs(unsigned Group) override { return Group < m_Index.groups().size() ? (unsigned)m_Index.groups()[Group].Inputs.size() : 0; }
+		virtual unsigned getNumberOfBlocks(unsigned Group, unsigned Input) override {
+			const bdfBlockIndex::sInput* input = m_Index.input(Group, Input);
+			return input != nullptr ? (unsigned)input->Blocks.size() : 0;
+		}
+
+		virtual eErrorCode getInputInfo(unsigned Group, unsigned Input, sInputInfo* InputInfo) override {
+			const bdfBlockIndex::sInput* input = m_Index.input(Group, Input);
+			if (input == nullptr || InputInfo == nullptr) return errArgument;
+			*InputInfo = input->Info;
+			return errNoError;
+		}
+
+		virtual eErrorCode getBlockInfo(unsigned Group, unsigned Input, unsigned Block, sBlockInfo* BlockInfo) override {
+			const bdfBlockIndex::sInput* input = m_Index.input(Group, Input);
+			if (input == nullptr || Block >= input->Blocks.size() || BlockInfo == nullptr) return errArgument;
+			*BlockInfo = input->Blocks[Block];
+			return errNoError;
+		}
+
+		virtual eErrorCode getOperationMode(unsigned Group, eOperationMode& Mode) override {
+			if (Group >= m_Index.groups().size()) return errArgument;
+			Mode = m_Index.groups()[Group].Mode;
+			return errNoError;
+		}
+
+		virtual eErrorCode getRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint16_t* Data, unsigned Count) override {
+			sBlock* block = find(Group, Input, Block, Address, Count);
+			if (block == nullptr || Data == nullptr || block->Codec != codecDelta16) return errArgument;
+			return read(*block, Address, Count, [&](const sChunk& Chunk, uint64_t ChunkAddress, unsigned First, unsigned N) {
+				const unsigned chunkCount = chunkLength(*block, ChunkAddress);
+				uint16_t* dst = Data + (ChunkAddress + First - Address);
+				if (First == 0 && N == chunkCount && m_Cached != &Chunk) {
+					// a whole chunk is decoded straight into the destination
+					return decode(Chunk, dst, chunkCount);
+				}
+				eErrorCode err = cache(Chunk, chunkCount);
+				if (err != errNoError) return err;
+				memcpy(dst, m_DataS.data() + First, N * sizeof(uint16_t));
+				return errNoError;
+			});
+		}
+
+		virtual eErrorCode getRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, int32_t* Data, unsigned Count) override {
+			sBlock* block = find(Group, Input, Block, Address, Count);
+			if (block == nullptr || Data == nullptr) return errArgument;
+			if (block->Codec == codecDelta16) {
+				// the raw words are read into the upper half of the destination and converted forward in place
+				uint16_t* raw = reinterpret_cast<uint16_t*>(Data) + Count;
+				eErrorCode err = getRawDataS(Group, Input, Block, Address, raw, Count);
+				if (err != errNoError) return err;
+				bdfConvert::rawToL(raw, Data, Count, 0xFFFFFFFF);
+				return errNoError;
+			}
+			return read(*block, Address, Count, [&](const sChunk& Chunk, uint64_t ChunkAddress, unsigned First, unsigned N) {
+				eErrorCode err = cacheL(Chunk, chunkLength(*block, ChunkAddress));
+				if (err != errNoError) return err;
+				memcpy(Data + (ChunkAddress + First - Address), m_DataL.data() + First, N * sizeof(int32_t));
+				return errNoError;
+			});
+		}
+
+		virtual eErrorCode getDataF(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, float* Data, unsigned Count) override {
+			sInputInfo inputInfo;
+			eErrorCode err = getInputInfo(Group, Input, &inputInfo);
+			if (err != errNoError) return err;
+			return bdfConvert::getData(this, inputInfo, Group, Input, Block, Address, Data, Count);
+		}
+
+		virtual eErrorCode getDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, double* Data, unsigned Count) override {
+			sInputInfo inputInfo;
+			eErrorCode err = getInputInfo(Group, Input, &inputInfo);
+			if (err != errNoError) return err;
+			return bdfConvert::getData(this, inputInfo, Group, Input, Block, Address, Data, Count);
+		}
+
+		virtual eErrorCode getEnvRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, uint16_t* Data, unsigned Count) override {
+			return envelope(Group, Input, Block, Address, BlockSize, Data, Count, [](uint32_t v) { return (uint16_t)v; });
+		}
+
+		virtual eErrorCode getEnvRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, int32_t* Data, unsigned Count) override {
+			return envelope(Group, Input, Block, Address, BlockSize, Data, Count, [](uint32_t v) { return (int32_t)v; });
+		}
+
+		virtual eErrorCode getEnvDataF(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, float* Data, unsigned Count) override {
+			const bdfBlockIndex::sInput* input = m_Index.input(Group, Input);
+			if (input == nullptr) return errArgument;
+			const double factor = input->Info.BinToVoltFactor, constant = input->Info.BinToVoltConstant;
+			return envelope(Group, Input, Block, Address, BlockSize, Data, Count, [&](uint32_t v) { return (float)(v * factor + constant); });
+		}
+
+		virtual eErrorCode getEnvDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, double* Data, unsigned Count) override {
+			const bdfBlockIndex::sInput* input = m_Index.input(Group, Input);
+			if (input == nullptr) return errArgument;
+			const double factor = input->Info.BinToVoltFactor, constant = input->Info.BinToVoltConstant;
+			return envelope(Group, Input, Block, Address, BlockSize, Data, Count, [&](uint32_t v) { return v * factor + constant; });
+		}
+
+		/// <summary>
+		/// Does nothing, the reader is destroyed by its owner.
+		/// </summary>
+		virtual void Release() override {}
+
+	private:
+		struct sChunk {
+			uint64_t Offset;
+			uint32_t Size;
+			uint32_t Min; /// Minimum of (raw & AnalogMask)
+			uint32_t Max; /// Maximum of (raw & AnalogMask)
+			uint64_t Hash; /// sFileStamp::hash of the stored bytes
+		};
+
+		struct sBlock {
+			eCodec Codec;
+			uint64_t Length;
+			std::vector<sChunk> Chunks;
+		};
+
+		int fail() {
+			closeFile();
+			return -1;
+		}
+
+		template <typename T>
+		static bool get(const std::string& Data, size_t& Pos, T& Value) {
+			if (Data.size() - sizeof(uint64_t) < Pos + sizeof(T)) return false;
+			memcpy(&Value, Data.data() + Pos, sizeof(T));
+			Pos += sizeof(T);
+			return true;
+		}
+
+		sBlock* find(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t Count) {
+			auto it = m_Blocks.find(std::make_tuple(Group, Input, Block));
+			if (it == m_Blocks.end() || Address > it->second.Length || Count > it->second.Length - Address) return nullptr;
+			return &it->second;
+		}
+
+		static unsigned chunkLength(const sBlock& Block, uint64_t ChunkAddress) {
+			return (unsigned)std::min<uint64_t>(bdfDeltaCodec::ChunkSamples, Block.Length - ChunkAddress);
+		}
+
+		/// Call F(chunk, chunk address, first sample in the chunk, number of samples) for the chunks of a range
+		template <typename F>
+		eErrorCode read(const sBlock& Block, uint64_t Address, uint64_t Count, F Function) {
+			for (uint64_t pos = Address; pos < Address + Count;) {
+				const size_t c = (size_t)(pos / bdfDeltaCodec::ChunkSamples);
+				const uint64_t chunkAddress = (uint64_t)c * bdfDeltaCodec::ChunkSamples;
+				const unsigned first = (unsigned)(pos - chunkAddress);
+				const unsigned n = (unsigned)std::min<uint64_t>(chunkLength(Block, chunkAddress) - first, Address + Count - pos);
+				eErrorCode err = Function(Block.Chunks[c], chunkAddress, first, n);
+				if (err != errNoError) return err;
+				pos += n;
+			}
+			return errNoError;
+		}
+
+		eErrorCode decode(const sChunk& Chunk, uint16_t* Dst, unsigned Count) {
+			try {
+				m_Encoded.resize(Chunk.Size);
+			}
+			catch (const std::bad_alloc&) {
+				return errResource;
+			}
+			m_File.clear();
+			m_File.seekg((std::streamoff)Chunk.Offset);
+			m_File.read(reinterpret_cast<char*>(m_Encoded.data()), (std::streamsize)Chunk.Size);
+			if (!m_File || sFileStamp::hash(m_Encoded.data(), Chunk.Size) != Chunk.Hash) return errInternal;
+			return bdfDeltaCodec::decode(m_Encoded.data(), Chunk.Size, Dst, Count) ? errNoError : errInternal;
+		}
+
+		/// Decode a chunk into the chunk cache
+		eErrorCode cache(const sChunk& Chunk, unsigned Count) {
+			if (m_Cached == &Chunk) return errNoError;
+			m_Cached = nullptr;
+			try {
+				m_DataS.resize(bdfDeltaCodec::ChunkSamples);
+			}
+			catch (const std::bad_alloc&) {
+				return errResource;
+			}
+			eErrorCode err = decode(Chunk, m_DataS.data(), Count);
+			if (err == errNoError) m_Cached = &Chunk;
+			return err;
+		}
+
+		/// Read an uncompressed 32-bit chunk into the chunk cache, whole chunks only so the hash can be checked
+		eErrorCode cacheL(const sChunk& Chunk, unsigned Count) {
+			if (m_CachedL == &Chunk) return errNoError;
+			m_CachedL = nullptr;
+			if (Chunk.Size != Count * sizeof(int32_t)) return errInternal;
+			try {
+				m_DataL.resize(bdfDeltaCodec::ChunkSamples);
+			}
+			catch (const std::bad_alloc&) {
+				return errResource;
+			}
+			m_File.clear();
+			m_File.seekg((std::streamoff)Chunk.Offset);
+			m_File.read(reinterpret_cast<char*>(m_DataL.data()), (std::streamsize)Chunk.Size);
+			if (!m_File || sFileStamp::hash(m_DataL.data(), Chunk.Size) != Chunk.Hash) return errInternal;
+			m_CachedL = &Chunk;
+			return errNoError;
+		}
+
+		/// Masked min/max of a range, from the chunk table for whole chunks
+		eErrorCode minMax(const sBlock& Block, uint32_t Mask, uint64_t Address, uint64_t Count, uint32_t& Min, uint32_t& Max) {
+			return read(Block, Address, Count, [&](const sChunk& Chunk, uint64_t ChunkAddress, unsigned First, unsigned N) {
+				const unsigned chunkCount = chunkLength(Block, ChunkAddress);
+				if (First == 0 && N == chunkCount) {
+					Min = std::min(Min, Chunk.Min);
+					Max = std::max(Max, Chunk.Max);
+					return errNoError;
+				}
+				if (Block.Codec == codecDelta16) {
+					eErrorCode err = cache(Chunk, chunkCount);
+					if (err != errNoError) return err;
+					uint16_t lo = 0xFFFF, hi = 0;
+					bdfConvert::minMax(m_DataS.data() + First, N, Mask, lo, hi);
+					Min = std::min<uint32_t>(Min, lo);
+					Max = std::max<uint32_t>(Max, hi);
+					return errNoError;
+				}
+				eErrorCode err = cacheL(Chunk, chunkCount);
+				if (err != errNoError) return err;
+				for (unsigned k = First; k < First + N; k++) {
+					Min = std::min(Min, (uint32_t)m_DataL[k] & Mask);
+					Max = std::max(Max, (uint32_t)m_DataL[k] & Mask);
+				}
+				return errNoError;
+			});
+		}
+
+		/// Envelope with the segment rule of bdfAPI::getEnvRawDataS
+		template <typename T, typename F>
+		eErrorCode envelope(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, T* Data, unsigned Count, F Scale) {
+			const bdfBlockIndex::sInput* input = m_Index.input(Group, Input);
+			sBlock* block = find(Group, Input, Block, Address, BlockSize);
+			const unsigned segments = Count / 2;
+			if (input == nullptr || block == nullptr || Data == nullptr || segments == 0 || BlockSize < segments) return errArgument;
+			for (unsigned s = 0; s < segments; s++) {
+				const uint64_t from = Address + BlockSize * s / segments;
+				const uint64_t to = Address + BlockSize * (s + 1) / segments;
+				uint32_t mn = UINT32_MAX, mx = 0;
+				eErrorCode err = minMax(*block, input->Info.AnalogMask, from, to - from, mn, mx);
+				if (err != errNoError) return err;
+				Data[2 * s] = Scale(mn);
+				Data[2 * s + 1] = Scale(mx);
+			}
+			return errNoError;
+		}
+
+		std::ifstream m_File;
+		bdfBlockIndex m_Index;
+		std::map<std::tuple<unsigned, unsigned, unsigned>, sBlock> m_Blocks;
+		std::vector<uint8_t> m_Encoded;
+		std::vector<uint16_t> m_DataS;
+		std::vector<int32_t> m_DataL;
+		const sChunk* m_Cached = nullptr;
+		const sChunk* m_CachedL = nullptr;
+	};
+}
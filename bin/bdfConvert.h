@@ -0,0 +1,588 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "bdfAPI.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BDF_CONVERT_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define BDF_TARGET_SSE2
+#define BDF_TARGET_AVX2
+#define BDF_TARGET_AVX512
+#else
+#include <cpuid.h>
+#define BDF_TARGET_SSE2 __attribute__((target("sse2")))
+#define BDF_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define BDF_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#endif
+#endif
+
+namespace filereader {
+	/// <summary>
+	/// Conversion kernels from 16-bit raw ADC words to 32-bit integers, float and double, and a min/max kernel.
+	/// The kernels fuse masking, widening and scaling into one pass and are selected at runtime
+	/// by CPU feature detection (AVX-512, AVX2/FMA, SSE2, scalar).
+	/// The source may also be placed at the end of the destination buffer (both ending at the
+	/// same address), which allows converting in place without a separate raw buffer.
+	/// </summary>
+	class bdfConvert {
+	public:
+		/// Instruction set of a conversion kernel
+		enum eInstructionSet {
+			isaScalar,
+			isaSSE2,
+			isaAVX2,
+			isaAVX512,
+			isaBest /// The best instruction set supported by the CPU
+		};
+
+		/// Unit of converted data
+		enum eUnit {
+			unitVolt,	/// (binary & AnalogMask) * BinToVoltFactor + BinToVoltConstant
+			unitPhysical /// (binary & AnalogMask) * BinToPhysicalFactor + BinToPhysicalConstant
+		};
+
+		/// <summary>
+		/// Get the best instruction set supported by this CPU and operating system
+		/// </summary>
+		static eInstructionSet instructionSet() {
+			static const eInstructionSet isa = detectInstructionSet();
+			return isa;
+		}
+
+		/// <summary>
+		/// Mask raw words and widen them to 32-bit integers
+		/// </summary>
+		/// <param name="Src">Raw words</param>
+		/// <param name="Dst">Converted words</param>
+		/// <param name="Count">Number of samples</param>
+		/// <param name="Mask">Bit mask applied to each word, 0xFFFFFFFF keeps the marker bits</param>
+		/// <param name="Isa">Kernel to use</param>
+		static void rawToL(const uint16_t* Src, int32_t* Dst, size_t Count, uint32_t Mask, eInstructionSet Isa = isaBest) {
+			size_t done = 0;
+			switch (resolve(Isa)) {
+#ifdef BDF_CONVERT_X86
+			case isaAVX512: done = rawToL_AVX512(Src, Dst, Count, Mask); break;
+			case isaAVX2: done = rawToL_AVX2(Src, Dst, Count, Mask); break;
+			case isaSSE2: done = rawToL_SSE2(Src, Dst, Count, Mask); break;
+#endif
+			default: break;
+			}
+			for (size_t k = done; k < Count; k++) Dst[k] = (int32_t)(load(Src + k) & Mask);
+		}
+
+		/// <summary>
+		/// Convert raw words to float: (Src & Mask) * Factor + Constant
+		/// </summary>
+		/// <param name="Src">Raw words</param>
+		/// <param name="Dst">Converted samples</param>
+		/// <param name="Count">Number of samples</param>
+		/// <param name="Mask">Bit mask applied to each word, usually AnalogMask</param>
+		/// <param name="Factor"></param>
+		/// <param name="Constant"></param>
+		/// <param name="Isa">Kernel to use</param>
+		static void rawToF(const uint16_t* Src, float* Dst, size_t Count, uint32_t Mask, double Factor, double Constant, eInstructionSet Isa = isaBest) {
+			size_t done = 0;
+			switch (resolve(Isa)) {
+#ifdef BDF_CONVERT_X86
+			case isaAVX512: done = rawToF_AVX512(Src, Dst, Count, Mask, (float)Factor, (float)Constant); break;
+			case isaAVX2: done = rawToF_AVX2(Src, Dst, Count, Mask, (float)Factor, (float)Constant); break;
+			case isaSSE2: done = rawToF_SSE2(Src, Dst, Count, Mask, (float)Factor, (float)Constant); break;
+#endif
+			default: break;
+			}
+			const float factor = (float)Factor;
+			const float constant = (float)Constant;
+			for (size_t k = done; k < Count; k++) Dst[k] = (float)(load(Src + k) & Mask) * factor + constant;
+		}
+
+		/// <summary>
+		/// Convert raw words to double: (Src & Mask) * Factor + Constant
+		/// </summary>
+		/// <param name="Src">Raw words</param>
+		/// <param name="Dst">Converted samples</param>
+		/// <param name="Count">Number of samples</param>
+		/// <param name="Mask">Bit mask applied to each word, usually AnalogMask</param>
+		/// <param name="Factor"></param>
+		/// <param name="Constant"></param>
+		/// <param name="Isa">Kernel to use</param>
+		static void rawToD(const uint16_t* Src, double* Dst, size_t Count, uint32_t Mask, double Factor, double Constant, eInstructionSet Isa = isaBest) {
+			size_t done = 0;
+			switch (resolve(Isa)) {
+#ifdef BDF_CONVERT_X86
+			case isaAVX512: done = rawToD_AVX512(Src, Dst, Count, Mask, Factor, Constant); break;
+			case isaAVX2: done = rawToD_AVX2(Src, Dst, Count, Mask, Factor, Constant); break;
+			case isaSSE2: done = rawToD_SSE2(Src, Dst, Count, Mask, Factor, Constant); break;
+#endif
+			default: break;
+			}
+			for (size_t k = done; k < Count; k++) Dst[k] = (double)(load(Src + k) & Mask) * Factor + Constant;
+		}
+
+		/// <summary>
+		/// Get minimum and maximum of masked raw words. Min and Max are not changed if Count is 0.
+		/// </summary>
+		/// <param name="Src">Raw words</param>
+		/// <param name="Count">Number of samples</param>
+		/// <param name="Mask">Bit mask applied to each word, usually AnalogMask</param>
+		/// <param name="Min">Receives the minimum of (Src & Mask)</param>
+		/// <param name="Max">Receives the maximum of (Src & Mask)</param>
+		/// <param name="Isa">Kernel to use</param>
+		static void minMax(const uint16_t* Src, size_t Count, uint32_t Mask, uint16_t& Min, uint16_t& Max, eInstructionSet Isa = isaBest) {
+			if (Count == 0) return;
+			uint16_t mn = 0xFFFF, mx = 0;
+			size_t done = 0;
+			switch (resolve(Isa)) {
+#ifdef BDF_CONVERT_X86
+			case isaAVX512:
+			case isaAVX2: done = minMax_AVX2(Src, Count, (uint16_t)Mask, mn, mx); break;
+			case isaSSE2: done = minMax_SSE2(Src, Count, (uint16_t)Mask, mn, mx); break;
+#endif
+			default: break;
+			}
+			for (size_t k = done; k < Count; k++) {
+				uint16_t v = (uint16_t)(Src[k] & Mask);
+				if (v < mn) mn = v;
+				if (v > mx) mx = v;
+			}
+			Min = mn;
+			Max = mx;
+		}
+
+		/// <summary>
+		/// Get minimum and maximum of consecutive windows of masked raw words in one pass, e.g. the
+		/// first envelope level of a buffer. Windows of a multiple of 8 samples are reduced 8 at a time.
+		/// </summary>
+		/// <param name="Src">Raw words, NrOfWindows * Window samples</param>
+		/// <param name="NrOfWindows">Number of windows</param>
+		/// <param name="Window">Number of samples per window, at least 1</param>
+		/// <param name="Mask">Bit mask applied to each word, usually AnalogMask</param>
+		/// <param name="Pairs">Receives 2 * NrOfWindows words [min, max, min, max, ...]</param>
+		/// <param name="Isa">Kernel to use</param>
+		static void minMaxWindows(const uint16_t* Src, size_t NrOfWindows, unsigned Window, uint32_t Mask, uint16_t* Pairs, eInstructionSet Isa = isaBest) {
+			if (Window == 0) return;
+			size_t done = 0;
+			switch (resolve(Isa)) {
+#ifdef BDF_CONVERT_X86
+			case isaAVX512:
+			case isaAVX2:
+				if (Window % 16 == 0) {
+					done = minMaxWindows_AVX2(Src, NrOfWindows, Window, (uint16_t)Mask, Pairs);
+					break;
+				}
+				// fall through
+			case isaSSE2:
+				if (Window % 8 == 0) done = minMaxWindows_SSE2(Src, NrOfWindows, Window, (uint16_t)Mask, Pairs);
+				break;
+#endif
+			default: break;
+			}
+			for (size_t w = done; w < NrOfWindows; w++) {
+				uint16_t mn = 0xFFFF, mx = 0;
+				const uint16_t* src = Src + w * Window;
+				for (unsigned k = 0; k < Window; k++) {
+					uint16_t v = (uint16_t)(src[k] & Mask);
+					if (v < mn) mn = v;
+					if (v > mx) mx = v;
+				}
+				Pairs[2 * w] = mn;
+				Pairs[2 * w + 1] = mx;
+			}
+		}
+
+		/// <summary>
+		/// Get the scaling of an input for a unit
+		/// </summary>
+		static void scaling(const bdfAPI::sInputInfo& InputInfo, eUnit Unit, double& Factor, double& Constant) {
+			Factor = Unit == unitPhysical ? InputInfo.BinToPhysicalFactor : InputInfo.BinToVoltFactor;
+			Constant = Unit == unitPhysical ? InputInfo.BinToPhysicalConstant : InputInfo.BinToVoltConstant;
+		}
+
+		/// <summary>
+		/// Same as bdfAPI::getRawDataL, but reads 16-bit words and widens them with the vectorized kernel.
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode getRawDataL(bdfAPI* Api, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, int32_t* Data, unsigned Count) {
+			bdfAPI::sInputInfo inputInfo;
+			bdfAPI::eErrorCode err = Api->getInputInfo(Group, Input, &inputInfo);
+			if (err != bdfAPI::errNoError) return err;
+			if (inputInfo.BytesPerSample > 2) return Api->getRawDataL(Group, Input, Block, Address, Data, Count);
+
+			// the raw words are read into the upper half of the destination and converted forward in place
+			uint16_t* raw = reinterpret_cast<uint16_t*>(Data) + Count;
+			err = Api->getRawDataS(Group, Input, Block, Address, raw, Count);
+			if (err != bdfAPI::errNoError) return err;
+			rawToL(raw, Data, Count, 0xFFFFFFFF);
+			return bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Same as bdfAPI::getDataF, with a vectorized conversion and an optional scaling to the physical unit.
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode getDataF(bdfAPI* Api, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, float* Data, unsigned Count, eUnit Unit = unitVolt) {
+			bdfAPI::sInputInfo inputInfo;
+			bdfAPI::eErrorCode err = Api->getInputInfo(Group, Input, &inputInfo);
+			if (err != bdfAPI::errNoError) return err;
+			return getData(Api, inputInfo, Group, Input, Block, Address, Data, Count, Unit);
+		}
+
+		/// <summary>
+		/// Same as bdfAPI::getDataD, with a vectorized conversion and an optional scaling to the physical unit.
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode getDataD(bdfAPI* Api, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, double* Data, unsigned Count, eUnit Unit = unitVolt) {
+			bdfAPI::sInputInfo inputInfo;
+			bdfAPI::eErrorCode err = Api->getInputInfo(Group, Input, &inputInfo);
+			if (err != bdfAPI::errNoError) return err;
+			return getData(Api, inputInfo, Group, Input, Block, Address, Data, Count, Unit);
+		}
+
+		/// <summary>
+		/// Read and convert samples to float or double with an already known input info.
+		/// </summary>
+		/// <param name="Api"></param>
+		/// <param name="InputInfo">Input info of Group/Input, as returned by getInputInfo</param>
+		/// <returns>eErrorCode</returns>
+		template <typename T>
+		static bdfAPI::eErrorCode getData(bdfAPI* Api, const bdfAPI::sInputInfo& InputInfo, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, T* Data, unsigned Count, eUnit Unit = unitVolt) {
+			double factor, constant;
+			scaling(InputInfo, Unit, factor, constant);
+
+			if (InputInfo.BytesPerSample > 2) {
+				// the 32-bit words are read into the upper part of the destination
+				int32_t* raw = reinterpret_cast<int32_t*>(Data + Count) - Count;
+				bdfAPI::eErrorCode err = Api->getRawDataL(Group, Input, Block, Address, raw, Count);
+				if (err != bdfAPI::errNoError) return err;
+				for (unsigned k = 0; k < Count; k++) Data[k] = (T)((load(raw + k) & InputInfo.AnalogMask) * factor + constant);
+				return bdfAPI::errNoError;
+			}
+
+			uint16_t* raw = reinterpret_cast<uint16_t*>(Data + Count) - Count;
+			bdfAPI::eErrorCode err = Api->getRawDataS(Group, Input, Block, Address, raw, Count);
+			if (err != bdfAPI::errNoError) return err;
+			rawTo(raw, Data, Count, InputInfo.AnalogMask, factor, constant);
+			return bdfAPI::errNoError;
+		}
+
+		/// Overloads of rawToF/rawToD for generic code
+		static void rawTo(const uint16_t* Src, float* Dst, size_t Count, uint32_t Mask, double Factor, double Constant, eInstructionSet Isa = isaBest) {
+			rawToF(Src, Dst, Count, Mask, Factor, Constant, Isa);
+		}
+		static void rawTo(const uint16_t* Src, double* Dst, size_t Count, uint32_t Mask, double Factor, double Constant, eInstructionSet Isa = isaBest) {
+			rawToD(Src, Dst, Count, Mask, Factor, Constant, Isa);
+		}
+
+	private:
+		/// Loads a source word through memcpy, so the compiler never moves it behind a store into an overlapping destination
+		template <typename T>
+		static T load(const T* Src) {
+			T v;
+			memcpy(&v, Src, sizeof(T));
+			return v;
+		}
+
+		static eInstructionSet resolve(eInstructionSet Isa) {
+			eInstructionSet best = instructionSet();
+			return Isa == isaBest || Isa > best ? best : Isa;
+		}
+
+		static eInstructionSet detectInstructionSet() {
+#ifdef BDF_CONVERT_X86
+			unsigned r1[4] = { 0 }, r7[4] = { 0 };
+			cpuid(1, r1);
+			if ((r1[3] & (1u << 26)) == 0) return isaScalar;
+			// AVX needs the OS to save the YMM (and ZMM) registers
+			const bool osxsave = (r1[2] & (1u << 27)) != 0;
+			const bool fma = (r1[2] & (1u << 12)) != 0;
+			if (!osxsave) return isaSSE2;
+			const uint64_t xcr0 = xgetbv();
+			cpuid(7, r7);
+			const bool avx2 = (r7[1] & (1u << 5)) != 0 && (xcr0 & 0x06) == 0x06;
+			const bool avx512 = (r7[1] & (1u << 16)) != 0 && (xcr0 & 0xE6) == 0xE6;
+			if (avx2 && fma && avx512) return isaAVX512;
+			if (avx2 && fma) return isaAVX2;
+			return isaSSE2;
+#else
+			return isaScalar;
+#endif
+		}
+
+#ifdef BDF_CONVERT_X86
+		static void cpuid(unsigned Leaf, unsigned Regs[4]) {
+#ifdef _MSC_VER
+			int r[4];
+			__cpuidex(r, (int)Leaf, 0);
+			for (int k = 0; k < 4; k++) Regs[k] = (unsigned)r[k];
+#else
+			__cpuid_count(Leaf, 0, Regs[0], Regs[1], Regs[2], Regs[3]);
+#endif
+		}
+
+#ifndef _MSC_VER
+		__attribute__((target("xsave")))
+#endif
+		static uint64_t xgetbv() {
+			return _xgetbv(0);
+		}
+
+		BDF_TARGET_SSE2 static size_t rawToL_SSE2(const uint16_t* Src, int32_t* Dst, size_t Count, uint32_t Mask) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i mask = _mm_set1_epi32((int)Mask);
+			size_t k = 0;
+			for (; k + 8 <= Count; k += 8) {
+				__m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + k));
+				__m128i lo = _mm_and_si128(_mm_unpacklo_epi16(raw, zero), mask);
+				__m128i hi = _mm_and_si128(_mm_unpackhi_epi16(raw, zero), mask);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(Dst + k), lo);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(Dst + k + 4), hi);
+			}
+			return k;
+		}
+
+		BDF_TARGET_SSE2 static size_t rawToF_SSE2(const uint16_t* Src, float* Dst, size_t Count, uint32_t Mask, float Factor, float Constant) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i mask = _mm_set1_epi32((int)Mask);
+			const __m128 factor = _mm_set1_ps(Factor);
+			const __m128 constant = _mm_set1_ps(Constant);
+			size_t k = 0;
+			for (; k + 8 <= Count; k += 8) {
+				__m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + k));
+				__m128 lo = _mm_cvtepi32_ps(_mm_and_si128(_mm_unpacklo_epi16(raw, zero), mask));
+				__m128 hi = _mm_cvtepi32_ps(_mm_and_si128(_mm_unpackhi_epi16(raw, zero), mask));
+				_mm_storeu_ps(Dst + k, _mm_add_ps(_mm_mul_ps(lo, factor), constant));
+				_mm_storeu_ps(Dst + k + 4, _mm_add_ps(_mm_mul_ps(hi, factor), constant));
+			}
+			return k;
+		}
+
+		BDF_TARGET_SSE2 static size_t rawToD_SSE2(const uint16_t* Src, double* Dst, size_t Count, uint32_t Mask, double Factor, double Constant) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i mask = _mm_set1_epi32((int)Mask);
+			const __m128d factor = _mm_set1_pd(Factor);
+			const __m128d constant = _mm_set1_pd(Constant);
+			size_t k = 0;
+			for (; k + 8 <= Count; k += 8) {
+				__m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + k));
+				__m128i lo = _mm_and_si128(_mm_unpacklo_epi16(raw, zero), mask);
+				__m128i hi = _mm_and_si128(_mm_unpackhi_epi16(raw, zero), mask);
+				__m128d d0 = _mm_cvtepi32_pd(lo);
+				__m128d d1 = _mm_cvtepi32_pd(_mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+				__m128d d2 = _mm_cvtepi32_pd(hi);
+				__m128d d3 = _mm_cvtepi32_pd(_mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+				_mm_storeu_pd(Dst + k, _mm_add_pd(_mm_mul_pd(d0, factor), constant));
+				_mm_storeu_pd(Dst + k + 2, _mm_add_pd(_mm_mul_pd(d1, factor), constant));
+				_mm_storeu_pd(Dst + k + 4, _mm_add_pd(_mm_mul_pd(d2, factor), constant));
+				_mm_storeu_pd(Dst + k + 6, _mm_add_pd(_mm_mul_pd(d3, factor), constant));
+			}
+			return k;
+		}
+
+		BDF_TARGET_AVX2 static size_t rawToL_AVX2(const uint16_t* Src, int32_t* Dst, size_t Count, uint32_t Mask) {
+			const __m256i mask = _mm256_set1_epi32((int)Mask);
+			size_t k = 0;
+			for (; k + 8 <= Count; k += 8) {
+				__m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + k)));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(Dst + k), _mm256_and_si256(v, mask));
+			}
+			return k;
+		}
+
+		BDF_TARGET_AVX2 static size_t rawToF_AVX2(const uint16_t* Src, float* Dst, size_t Count, uint32_t Mask, float Factor, float Constant) {
+			const __m256i mask = _mm256_set1_epi32((int)Mask);
+			const __m256 factor = _mm256_set1_ps(Factor);
+			const __m256 constant = _mm256_set1_ps(Constant);
+			size_t k = 0;
+			for (; k + 8 <= Count; k += 8) {
+				__m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + k)));
+				__m256 f = _mm256_cvtepi32_ps(_mm256_and_si256(v, mask));
+				_mm256_storeu_ps(Dst + k, _mm256_fmadd_ps(f, factor, constant));
+			}
+			return k;
+		}
+
+		BDF_TARGET_AVX2 static size_t rawToD_AVX2(const uint16_t* Src, double* Dst, size_t Count, uint32_t Mask, double Factor, double Constant) {
+			const __m128i mask = _mm_set1_epi32((int)Mask);
+			const __m256d factor = _mm256_set1_pd(Factor);
+			const __m256d constant = _mm256_set1_pd(Constant);
+			size_t k = 0;
+			for (; k + 8 <= Count; k += 8) {
+				__m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + k));
+				__m256d lo = _mm256_cvtepi32_pd(_mm_and_si128(_mm_cvtepu16_epi32(raw), mask));
+				__m256d hi = _mm256_cvtepi32_pd(_mm_and_si128(_mm_cvtepu16_epi32(_mm_srli_si128(raw, 8)), mask));
+				_mm256_storeu_pd(Dst + k, _mm256_fmadd_pd(lo, factor, constant));
+				_mm256_storeu_pd(Dst + k + 4, _mm256_fmadd_pd(hi, factor, constant));
+			}
+			return k;
+		}
+
+		BDF_TARGET_AVX512 static size_t rawToL_AVX512(const uint16_t* Src, int32_t* Dst, size_t Count, uint32_t Mask) {
+			const __m512i mask = _mm512_set1_epi32((int)Mask);
+			size_t k = 0;
+			for (; k + 16 <= Count; k += 16) {
+				__m512i v = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(Src + k)));
+				_mm512_storeu_si512(Dst + k, _mm512_and_si512(v, mask));
+			}
+			return k;
+		}
+
+		BDF_TARGET_AVX512 static size_t rawToF_AVX512(const uint16_t* Src, float* Dst, size_t Count, uint32_t Mask, float Factor, float Constant) {
+			const __m512i mask = _mm512_set1_epi32((int)Mask);
+			const __m512 factor = _mm512_set1_ps(Factor);
+			const __m512 constant = _mm512_set1_ps(Constant);
+			size_t k = 0;
+			for (; k + 16 <= Count; k += 16) {
+				__m512i v = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(Src + k)));
+				__m512 f = _mm512_cvtepi32_ps(_mm512_and_si512(v, mask));
+				_mm512_storeu_ps(Dst + k, _mm512_fmadd_ps(f, factor, constant));
+			}
+			return k;
+		}
+
+		BDF_TARGET_AVX512 static size_t rawToD_AVX512(const uint16_t* Src, double* Dst, size_t Count, uint32_t Mask, double Factor, double Constant) {
+			const __m256i mask = _mm256_set1_epi32((int)Mask);
+			const __m512d factor = _mm512_set1_pd(Factor);
+			const __m512d constant = _mm512_set1_pd(Constant);
+			size_t k = 0;
+			for (; k + 16 <= Count; k += 16) {
+				__m256i raw = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Src + k));
+				__m512d lo = _mm512_cvtepi32_pd(_mm256_and_si256(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(raw)), mask));
+				__m512d hi = _mm512_cvtepi32_pd(_mm256_and_si256(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(raw, 1)), mask));
+				_mm512_storeu_pd(Dst + k, _mm512_fmadd_pd(lo, factor, constant));
+				_mm512_storeu_pd(Dst + k + 8, _mm512_fmadd_pd(hi, factor, constant));
+			}
+			return k;
+		}
+
+		BDF_TARGET_SSE2 static size_t minMax_SSE2(const uint16_t* Src, size_t Count, uint16_t Mask, uint16_t& Min, uint16_t& Max) {
+			if (Count < 8) return 0;
+			// SSE2 has only signed 16-bit min/max, the sign bit is flipped to compare unsigned words
+			const __m128i mask = _mm_set1_epi16((short)Mask);
+			const __m128i bias = _mm_set1_epi16((short)0x8000);
+			__m128i mn = _mm_set1_epi16(0x7FFF);
+			__m128i mx = _mm_set1_epi16((short)0x8000);
+			size_t k = 0;
+			for (; k + 8 <= Count; k += 8) {
+				__m128i v = _mm_xor_si128(_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + k)), mask), bias);
+				mn = _mm_min_epi16(mn, v);
+				mx = _mm_max_epi16(mx, v);
+			}
+			int16_t a[8], b[8];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(a), mn);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(b), mx);
+			for (int n = 0; n < 8; n++) {
+				uint16_t lo = (uint16_t)(a[n] ^ 0x8000), hi = (uint16_t)(b[n] ^ 0x8000);
+				if (lo < Min) Min = lo;
+				if (hi > Max) Max = hi;
+			}
+			return k;
+		}
+
+		/// Reduce the vertical results of 8 windows (one vector per window) to one vector holding the result of window n in lane n
+		template <bool Max>
+		BDF_TARGET_SSE2 static __m128i reduceWindows_SSE2(const __m128i V[8]) {
+			__m128i r[4], s[2];
+			for (int n = 0; n < 4; n++) {
+				__m128i a = _mm_unpacklo_epi16(V[2 * n], V[2 * n + 1]), b = _mm_unpackhi_epi16(V[2 * n], V[2 * n + 1]);
+				r[n] = Max ? _mm_max_epi16(a, b) : _mm_min_epi16(a, b);
+			}
+			for (int n = 0; n < 2; n++) {
+				__m128i a = _mm_unpacklo_epi32(r[2 * n], r[2 * n + 1]), b = _mm_unpackhi_epi32(r[2 * n], r[2 * n + 1]);
+				s[n] = Max ? _mm_max_epi16(a, b) : _mm_min_epi16(a, b);
+			}
+			__m128i a = _mm_unpacklo_epi64(s[0], s[1]), b = _mm_unpackhi_epi64(s[0], s[1]);
+			return Max ? _mm_max_epi16(a, b) : _mm_min_epi16(a, b);
+		}
+
+		/// Same as reduceWindows_SSE2 for unsigned words
+		template <bool Max>
+		BDF_TARGET_AVX2 static __m128i reduceWindows_AVX2(const __m128i V[8]) {
+			__m128i r[4], s[2];
+			for (int n = 0; n < 4; n++) {
+				__m128i a = _mm_unpacklo_epi16(V[2 * n], V[2 * n + 1]), b = _mm_unpackhi_epi16(V[2 * n], V[2 * n + 1]);
+				r[n] = Max ? _mm_max_epu16(a, b) : _mm_min_epu16(a, b);
+			}
+			for (int n = 0; n < 2; n++) {
+				__m128i a = _mm_unpacklo_epi32(r[2 * n], r[2 * n + 1]), b = _mm_unpackhi_epi32(r[2 * n], r[2 * n + 1]);
+				s[n] = Max ? _mm_max_epu16(a, b) : _mm_min_epu16(a, b);
+			}
+			__m128i a = _mm_unpacklo_epi64(s[0], s[1]), b = _mm_unpackhi_epi64(s[0], s[1]);
+			return Max ? _mm_max_epu16(a, b) : _mm_min_epu16(a, b);
+		}
+
+		BDF_TARGET_SSE2 static size_t minMaxWindows_SSE2(const uint16_t* Src, size_t NrOfWindows, unsigned Window, uint16_t Mask, uint16_t* Pairs) {
+			// signed 16-bit min/max on words with flipped sign bit, as in minMax_SSE2
+			const __m128i mask = _mm_set1_epi16((short)Mask);
+			const __m128i bias = _mm_set1_epi16((short)0x8000);
+			size_t w = 0;
+			for (; w + 8 <= NrOfWindows; w += 8) {
+				__m128i mn[8], mx[8];
+				for (int n = 0; n < 8; n++) {
+					const uint16_t* src = Src + (w + n) * Window;
+					mn[n] = _mm_set1_epi16(0x7FFF);
+					mx[n] = _mm_set1_epi16((short)0x8000);
+					for (unsigned k = 0; k < Window; k += 8) {
+						__m128i v = _mm_xor_si128(_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k)), mask), bias);
+						mn[n] = _mm_min_epi16(mn[n], v);
+						mx[n] = _mm_max_epi16(mx[n], v);
+					}
+				}
+				__m128i lo = _mm_xor_si128(reduceWindows_SSE2<false>(mn), bias);
+				__m128i hi = _mm_xor_si128(reduceWindows_SSE2<true>(mx), bias);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(Pairs + 2 * w), _mm_unpacklo_epi16(lo, hi));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(Pairs + 2 * w + 8), _mm_unpackhi_epi16(lo, hi));
+			}
+			return w;
+		}
+
+		BDF_TARGET_AVX2 static size_t minMaxWindows_AVX2(const uint16_t* Src, size_t NrOfWindows, unsigned Window, uint16_t Mask, uint16_t* Pairs) {
+			const __m256i mask = _mm256_set1_epi16((short)Mask);
+			size_t w = 0;
+			for (; w + 8 <= NrOfWindows; w += 8) {
+				__m128i mn[8], mx[8];
+				for (int n = 0; n < 8; n++) {
+					const uint16_t* src = Src + (w + n) * Window;
+					__m256i a = _mm256_set1_epi16((short)0xFFFF);
+					__m256i b = _mm256_setzero_si256();
+					for (unsigned k = 0; k < Window; k += 16) {
+						__m256i v = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + k)), mask);
+						a = _mm256_min_epu16(a, v);
+						b = _mm256_max_epu16(b, v);
+					}
+					mn[n] = _mm_min_epu16(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+					mx[n] = _mm_max_epu16(_mm256_castsi256_si128(b), _mm256_extracti128_si256(b, 1));
+				}
+				__m128i lo = reduceWindows_AVX2<false>(mn);
+				__m128i hi = reduceWindows_AVX2<true>(mx);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(Pairs + 2 * w), _mm_unpacklo_epi16(lo, hi));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(Pairs + 2 * w + 8), _mm_unpackhi_epi16(lo, hi));
+			}
+			return w;
+		}
+
+		BDF_TARGET_AVX2 static size_t minMax_AVX2(const uint16_t* Src, size_t Count, uint16_t Mask, uint16_t& Min, uint16_t& Max) {
+			if (Count < 16) return 0;
+			const __m256i mask = _mm256_set1_epi16((short)Mask);
+			__m256i mn = _mm256_set1_epi16((short)0xFFFF);
+			__m256i mx = _mm256_setzero_si256();
+			size_t k = 0;
+			for (; k + 16 <= Count; k += 16) {
+				__m256i v = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(Src + k)), mask);
+				mn = _mm256_min_epu16(mn, v);
+				mx = _mm256_max_epu16(mx, v);
+			}
+			uint16_t a[16], b[16];
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(a), mn);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(b), mx);
+			for (int n = 0; n < 16; n++) {
+				if (a[n] < Min) Min = a[n];
+				if (b[n] > Max) Max = b[n];
+			}
+			return k;
+		}
+#endif
+	};
+}
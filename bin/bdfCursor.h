@@ -0,0 +1,235 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfConvert.h"
+
+namespace filereader {
+	/// <summary>
+	/// Sequential reader for one block of one or more inputs of a group.
+	/// The cursor keeps a 64-bit position and a readahead buffer per input of PreferredTransferSize samples,
+	/// so consecutive small reads are served from memory and the file is read in large chunks.
+	/// Reads larger than the readahead buffer go directly into the caller's buffer.
+	/// All buffers are allocated when the cursor is created, next() and seek() do not allocate.
+	/// Several inputs are returned planar: Data[input index * Count + sample].
+	/// </summary>
+	class bdfSampleCursor {
+	public:
+		/// <summary>
+		/// Create a cursor at the start of a block
+		/// </summary>
+		/// <param name="Api">API object with a loaded file, used only by this cursor while reading</param>
+		/// <param name="Group"></param>
+		/// <param name="Inputs">Inputs to read, empty for all inputs of the group</param>
+		/// <param name="Block"></param>
+		/// <param name="Unit">Scaling of float and double reads</param>
+		/// <param name="ReadaheadSamples">Readahead per input, 0 for the PreferredTransferSize of the block</param>
+		bdfSampleCursor(bdfAPI* Api, unsigned Group, const std::vector<unsigned>& Inputs, unsigned Block, bdfConvert::eUnit Unit = bdfConvert::unitVolt, unsigned ReadaheadSamples = 0)
+			: m_Api(Api), m_Group(Group), m_Block(Block), m_Unit(Unit) {
+			m_Error = open(Inputs, Unit, ReadaheadSamples);
+		}
+
+		bdfSampleCursor(const bdfSampleCursor&) = delete;
+		bdfSampleCursor& operator=(const bdfSampleCursor&) = delete;
+
+		/// Error of the creation, errNoError if the cursor can be used
+		bdfAPI::eErrorCode error() const { return m_Error; }
+
+		/// Number of inputs read by the cursor
+		unsigned numberOfInputs() const { return (unsigned)m_Channels.size(); }
+
+		/// Length of the block in samples
+		uint64_t length() const { return m_Length; }
+
+		/// Sample address of the next read
+		uint64_t position() const { return m_Position; }
+
+		/// Samples from the position to the end of the block
+		uint64_t remaining() const { return m_Length - m_Position; }
+
+		/// Readahead buffer size in samples per input
+		unsigned readaheadSamples() const { return m_Readahead; }
+
+		/// <summary>
+		/// Move the cursor. Buffered samples stay valid, seeking inside the buffer does not read the file.
+		/// </summary>
+		/// <param name="Position">Sample address, at most length()</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode seek(uint64_t Position) {
+			if (m_Error != bdfAPI::errNoError) return m_Error;
+			if (Position > m_Length) return bdfAPI::errArgument;
+			m_Position = Position;
+			return bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Read the next samples and advance the cursor.
+		/// uint16_t returns the raw words of inputs with up to 2 bytes per sample, int32_t the raw values,
+		/// float and double the samples in the unit of the cursor.
+		/// </summary>
+		/// <param name="Data">Destination, Count samples per input</param>
+		/// <param name="Count">Samples per input</param>
+		/// <param name="Read">Samples read per input, less than Count at the end of the block</param>
+		/// <returns>eErrorCode</returns>
+		template <typename T>
+		bdfAPI::eErrorCode next(T* Data, unsigned Count, unsigned& Read) {
+			Read = 0;
+			if (m_Error != bdfAPI::errNoError) return m_Error;
+			if (Data == nullptr) return bdfAPI::errArgument;
+			const unsigned n = (unsigned)(remaining() < Count ? remaining() : Count);
+
+			while (Read < n) {
+				const unsigned todo = n - Read;
+				bdfAPI::eErrorCode err = bdfAPI::errNoError;
+				if (m_Position >= m_BufferStart && m_Position < m_BufferEnd) {
+					const unsigned offset = (unsigned)(m_Position - m_BufferStart);
+					const unsigned avail = (unsigned)(m_BufferEnd - m_Position);
+					const unsigned count = avail < todo ? avail : todo;
+					for (size_t c = 0; c < m_Channels.size(); c++) {
+						err = fromBuffer(m_Channels[c], offset, Data + c * (size_t)Count + Read, count);
+						if (err != bdfAPI::errNoError) return err;
+					}
+					m_Position += count;
+					Read += count;
+				}
+				else if (todo >= m_Readahead) {
+					for (size_t c = 0; c < m_Channels.size(); c++) {
+						err = direct(m_Channels[c], m_Position, Data + c * (size_t)Count + Read, todo);
+						if (err != bdfAPI::errNoError) return err;
+					}
+					m_Position += todo;
+					Read += todo;
+				}
+				else {
+					err = fill();
+					if (err != bdfAPI::errNoError) return err;
+				}
+			}
+			return bdfAPI::errNoError;
+		}
+
+	private:
+		struct sChannel {
+			unsigned Input;
+			bdfAPI::sInputInfo Info;
+			double Factor;
+			double Constant;
+			std::vector<uint16_t> DataS; /// readahead of inputs with up to 2 bytes per sample
+			std::vector<int32_t> DataL; /// readahead of wider inputs
+		};
+
+		bdfAPI::eErrorCode open(const std::vector<unsigned>& Inputs, bdfConvert::eUnit Unit, unsigned ReadaheadSamples) {
+			if (m_Api == nullptr) return bdfAPI::errInvalidHandle;
+			std::vector<unsigned> inputs = Inputs;
+			if (inputs.empty()) {
+				for (unsigned i = 0; i < m_Api->getNumberOfInputs(m_Group); i++) inputs.push_back(i);
+			}
+			if (inputs.empty()) return bdfAPI::errArgument;
+
+			unsigned preferred = 0;
+			m_Length = UINT64_MAX;
+			m_Channels.resize(inputs.size());
+			for (size_t c = 0; c < inputs.size(); c++) {
+				sChannel& channel = m_Channels[c];
+				channel.Input = inputs[c];
+				bdfAPI::eErrorCode err = m_Api->getInputInfo(m_Group, channel.Input, &channel.Info);
+				if (err != bdfAPI::errNoError) return err;
+				bdfAPI::sBlockInfo blockInfo;
+				err = m_Api->getBlockInfo(m_Group, channel.Input, m_Block, &blockInfo);
+				if (err != bdfAPI::errNoError) return err;
+				bdfConvert::scaling(channel.Info, Unit, channel.Factor, channel.Constant);
+				if (blockInfo.BlockLength < m_Length) m_Length = blockInfo.BlockLength;
+				if (blockInfo.PreferredTransferSize > preferred) preferred = blockInfo.PreferredTransferSize;
+			}
+
+			m_Readahead = ReadaheadSamples > 0 ? ReadaheadSamples : (preferred > 0 ? preferred : DefaultReadahead);
+			if (m_Readahead > m_Length && m_Length > 0) m_Readahead = (unsigned)m_Length;
+			if (m_Readahead == 0) m_Readahead = 1;
+			try {
+				for (sChannel& channel : m_Channels) {
+					if (channel.Info.BytesPerSample <= 2) channel.DataS.resize(m_Readahead);
+					else channel.DataL.resize(m_Readahead);
+				}
+			}
+			catch (const std::bad_alloc&) {
+				return bdfAPI::errResource;
+			}
+			return bdfAPI::errNoError;
+		}
+
+		/// Read the readahead buffers from the position
+		bdfAPI::eErrorCode fill() {
+			const unsigned count = (unsigned)(remaining() < m_Readahead ? remaining() : m_Readahead);
+			m_BufferStart = m_BufferEnd = 0;
+			for (sChannel& channel : m_Channels) {
+				bdfAPI::eErrorCode err = channel.Info.BytesPerSample <= 2
+					? m_Api->getRawDataS(m_Group, channel.Input, m_Block, m_Position, channel.DataS.data(), count)
+					: m_Api->getRawDataL(m_Group, channel.Input, m_Block, m_Position, channel.DataL.data(), count);
+				if (err != bdfAPI::errNoError) return err;
+			}
+			m_BufferStart = m_Position;
+			m_BufferEnd = m_Position + count;
+			return bdfAPI::errNoError;
+		}
+
+		bdfAPI::eErrorCode fromBuffer(const sChannel& Channel, unsigned Offset, uint16_t* Data, unsigned Count) const {
+			if (Channel.Info.BytesPerSample > 2) return bdfAPI::errArgument;
+			memcpy(Data, Channel.DataS.data() + Offset, Count * sizeof(uint16_t));
+			return bdfAPI::errNoError;
+		}
+
+		bdfAPI::eErrorCode fromBuffer(const sChannel& Channel, unsigned Offset, int32_t* Data, unsigned Count) const {
+			if (Channel.Info.BytesPerSample > 2) memcpy(Data, Channel.DataL.data() + Offset, Count * sizeof(int32_t));
+			else bdfConvert::rawToL(Channel.DataS.data() + Offset, Data, Count, 0xFFFFFFFF);
+			return bdfAPI::errNoError;
+		}
+
+		template <typename T>
+		bdfAPI::eErrorCode fromBuffer(const sChannel& Channel, unsigned Offset, T* Data, unsigned Count) const {
+			if (Channel.Info.BytesPerSample > 2) {
+				const int32_t* raw = Channel.DataL.data() + Offset;
+				for (unsigned k = 0; k < Count; k++) Data[k] = (T)((raw[k] & Channel.Info.AnalogMask) * Channel.Factor + Channel.Constant);
+			}
+			else {
+				bdfConvert::rawTo(Channel.DataS.data() + Offset, Data, Count, Channel.Info.AnalogMask, Channel.Factor, Channel.Constant);
+			}
+			return bdfAPI::errNoError;
+		}
+
+		bdfAPI::eErrorCode direct(const sChannel& Channel, uint64_t Address, uint16_t* Data, unsigned Count) {
+			if (Channel.Info.BytesPerSample > 2) return bdfAPI::errArgument;
+			return m_Api->getRawDataS(m_Group, Channel.Input, m_Block, Address, Data, Count);
+		}
+
+		bdfAPI::eErrorCode direct(const sChannel& Channel, uint64_t Address, int32_t* Data, unsigned Count) {
+			if (Channel.Info.BytesPerSample > 2) return m_Api->getRawDataL(m_Group, Channel.Input, m_Block, Address, Data, Count);
+			// the raw words are read into the upper half of the destination and converted forward in place
+			uint16_t* raw = reinterpret_cast<uint16_t*>(Data) + Count;
+			bdfAPI::eErrorCode err = m_Api->getRawDataS(m_Group, Channel.Input, m_Block, Address, raw, Count);
+			if (err != bdfAPI::errNoError) return err;
+			bdfConvert::rawToL(raw, Data, Count, 0xFFFFFFFF);
+			return bdfAPI::errNoError;
+		}
+
+		template <typename T>
+		bdfAPI::eErrorCode direct(const sChannel& Channel, uint64_t Address, T* Data, unsigned Count) {
+			return bdfConvert::getData(m_Api, Channel.Info, m_Group, Channel.Input, m_Block, Address, Data, Count, m_Unit);
+		}
+
+		static constexpr unsigned DefaultReadahead = 1024 * 1024;
+
+		bdfAPI* m_Api;
+		const unsigned m_Group;
+		const unsigned m_Block;
+		const bdfConvert::eUnit m_Unit;
+		bdfAPI::eErrorCode m_Error = bdfAPI::errNoError;
+		std::vector<sChannel> m_Channels;
+		uint64_t m_Length = 0;
+		uint64_t m_Position = 0;
+		unsigned m_Readahead = 0;
+		uint64_t m_BufferStart = 0;
+		uint64_t m_BufferEnd = 0;
+	};
+}
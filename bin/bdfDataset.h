@@ -0,0 +1,631 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfConvert.h"
+#include "bdfIndex.h"
+
+namespace filereader {
+	/// <summary>
+	/// One view of a set of BDF files, e.g. the heap files of one measurement (heap0_..., heap1_...) and
+	/// consecutive recordings of a test.
+	///
+	/// Files are assigned to a source by the "heapN_" prefix of their name (files without the prefix form one
+	/// source). The files of a source must have the same groups and inputs; their blocks are appended in the order
+	/// of the recording start. The groups of the dataset are the groups of all sources, so the dataset
+	/// block b of (group, input) is a block of one of the files.
+	///
+	/// All blocks share one time axis in seconds relative to the earliest first sample of the dataset, from StartTime,
+	/// TriggerTimeSeconds and TriggerSample of each block. The samples of the blocks of an input are also
+	/// concatenated to a position axis, which allows reads and envelopes across block and file boundaries.
+	///
+	/// Opening uses the index files of bdfBlockIndex (built and stored if missing), so a large set of files is
+	/// opened without loading them. Data is read through a pool of at most MaxOpenFiles API objects, the least
+	/// recently used file is closed when another file is needed. Reads may be called from several threads;
+	/// open and close must not be called while reads are running.
+	/// </summary>
+	class bdfDataset {
+	public:
+		/// <summary>
+		/// Create an empty dataset
+		/// </summary>
+		/// <param name="MaxOpenFiles">Maximum number of files loaded at the same time</param>
+		/// <param name="NrOfThreads">Threads used to open the files, 0 for the number of hardware threads</param>
+		bdfDataset(unsigned MaxOpenFiles = 16, unsigned NrOfThreads = 0) : m_MaxOpenFiles(MaxOpenFiles > 0 ? MaxOpenFiles : 1), m_NrOfThreads(NrOfThreads) {
+			if (m_NrOfThreads == 0) m_NrOfThreads = std::thread::hardware_concurrency();
+			if (m_NrOfThreads == 0) m_NrOfThreads = 1;
+			m_Handles.reserve(m_MaxOpenFiles);
+		}
+
+		virtual ~bdfDataset() {
+			close();
+		}
+
+		bdfDataset(const bdfDataset&) = delete;
+		bdfDataset& operator=(const bdfDataset&) = delete;
+
+		/// <summary>
+		/// Open a set of files
+		/// </summary>
+		/// <param name="FileNames">BDF files</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode open(const std::vector<std::string>& FileNames) {
+			close();
+			try {
+				m_Files.resize(FileNames.size());
+				for (size_t f = 0; f < FileNames.size(); f++) m_Files[f].FileName = FileNames[f];
+				bdfAPI::eErrorCode err = openFiles();
+				if (err == bdfAPI::errNoError) err = buildLayout();
+				if (err != bdfAPI::errNoError) close();
+				return err;
+			}
+			catch (const std::bad_alloc&) {
+				close();
+				return bdfAPI::errResource;
+			}
+		}
+
+		/// <summary>
+		/// Open all .bdf files of a directory
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode openDirectory(const std::string& Directory) {
+			std::vector<std::string> fileNames;
+			std::error_code ec;
+			for (std::filesystem::directory_iterator it(Directory, ec), end; !ec && it != end; it.increment(ec)) {
+				if (it->is_regular_file(ec) && it->path().extension() == ".bdf") fileNames.push_back(it->path().string());
+			}
+			if (ec) return bdfAPI::errArgument;
+			std::sort(fileNames.begin(), fileNames.end());
+			return open(fileNames);
+		}
+
+		/// <summary>
+		/// Close all files
+		/// </summary>
+		void close() {
+			for (sHandle& handle : m_Handles) {
+				if (handle.Api == nullptr) continue;
+				handle.Api->closeFile();
+				DestroyBDFAPIObj(handle.Api);
+			}
+			m_Handles.clear();
+			m_Files.clear();
+			m_Groups.clear();
+			m_Base = 0;
+			m_Origin = 0;
+		}
+
+		/// Number of files
+		unsigned numberOfFiles() const { return (unsigned)m_Files.size(); }
+		/// Name of a file
+		const std::string& fileName(unsigned File) const { return m_Files[File].FileName; }
+		/// Metadata of a file, e.g. for the channel attributes
+		const bdfBlockIndex& fileIndex(unsigned File) const { return m_Files[File].Index; }
+
+		/// Start of the time axis in seconds since 1970-01-01 of the StartTime clock
+		double originSeconds() const { return (double)m_Base + m_Origin; }
+
+		unsigned getNumberOfGroups() const { return (unsigned)m_Groups.size(); }
+		unsigned getNumberOfInputs(unsigned Group) const { return Group < m_Groups.size() ? (unsigned)m_Groups[Group].Inputs.size() : 0; }
+		unsigned getNumberOfBlocks(unsigned Group, unsigned Input) const {
+			const sInput* input = find(Group, Input);
+			return input != nullptr ? (unsigned)input->Blocks.size() : 0;
+		}
+
+		/// Source of a group ("heap0", ...)
+		const std::string& groupSource(unsigned Group) const { return m_Groups[Group].Source; }
+
+		/// <summary>
+		/// Input info of the first file of the group
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getInputInfo(unsigned Group, unsigned Input, bdfAPI::sInputInfo* InputInfo) const {
+			if (find(Group, Input) == nullptr || InputInfo == nullptr) return bdfAPI::errArgument;
+			const sGroup& group = m_Groups[Group];
+			*InputInfo = m_Files[group.FirstFile].Index.input(group.FileGroup, Input)->Info;
+			return bdfAPI::errNoError;
+		}
+
+		bdfAPI::eErrorCode getBlockInfo(unsigned Group, unsigned Input, unsigned Block, bdfAPI::sBlockInfo* BlockInfo) const {
+			const sBlock* block = find(Group, Input, Block);
+			if (block == nullptr || BlockInfo == nullptr) return bdfAPI::errArgument;
+			*BlockInfo = m_Files[block->File].Index.input(m_Groups[Group].FileGroup, Input)->Blocks[block->Block];
+			return bdfAPI::errNoError;
+		}
+
+		bdfAPI::eErrorCode getOperationMode(unsigned Group, bdfAPI::eOperationMode& Mode) const {
+			if (Group >= m_Groups.size()) return bdfAPI::errArgument;
+			Mode = m_Files[m_Groups[Group].FirstFile].Index.groups()[m_Groups[Group].FileGroup].Mode;
+			return bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Get the file of a dataset block
+		/// </summary>
+		/// <param name="File">Index of the file</param>
+		/// <param name="FileGroup">Group in the file</param>
+		/// <param name="FileBlock">Block in the file</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getLocation(unsigned Group, unsigned Input, unsigned Block, unsigned& File, unsigned& FileGroup, unsigned& FileBlock) const {
+			const sBlock* block = find(Group, Input, Block);
+			if (block == nullptr) return bdfAPI::errArgument;
+			File = block->File;
+			FileGroup = m_Groups[Group].FileGroup;
+			FileBlock = block->Block;
+			return bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Get the time of the first sample and the first position of a block
+		/// </summary>
+		/// <param name="Seconds">Time of sample 0 on the time axis of the dataset</param>
+		/// <param name="Position">Position of sample 0 on the position axis of the input</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getBlockTime(unsigned Group, unsigned Input, unsigned Block, double& Seconds, uint64_t& Position) const {
+			const sBlock* block = find(Group, Input, Block);
+			if (block == nullptr) return bdfAPI::errArgument;
+			Seconds = block->Seconds - m_Origin;
+			Position = block->Position;
+			return bdfAPI::errNoError;
+		}
+
+		/// Number of samples of all blocks of an input
+		uint64_t length(unsigned Group, unsigned Input) const {
+			const sInput* input = find(Group, Input);
+			return input != nullptr ? input->Length : 0;
+		}
+
+		/// <summary>
+		/// Find the sample at a time. In a gap between blocks the first sample of the next block is returned.
+		/// </summary>
+		/// <param name="Seconds">Time on the time axis of the dataset</param>
+		/// <param name="Block">Dataset block</param>
+		/// <param name="Sample">Sample in the block</param>
+		/// <returns>errArgument if the time is after the last block</returns>
+		bdfAPI::eErrorCode findTime(unsigned Group, unsigned Input, double Seconds, unsigned& Block, uint64_t& Sample) const {
+			const sInput* input = find(Group, Input);
+			if (input == nullptr) return bdfAPI::errArgument;
+			const double t = Seconds + m_Origin;
+			for (size_t b = 0; b < input->Blocks.size(); b++) {
+				const sBlock& block = input->Blocks[b];
+				const double end = block.Seconds + block.Length / block.SampleRateHertz;
+				if (t >= end) continue;
+				Block = (unsigned)b;
+				// a time exactly at a sample must not fall to the previous sample by rounding
+				const double position = std::floor((t - block.Seconds) * block.SampleRateHertz + 1e-6);
+				Sample = position <= 0 ? 0 : std::min<uint64_t>((uint64_t)position, block.Length - 1);
+				return bdfAPI::errNoError;
+			}
+			return bdfAPI::errArgument;
+		}
+
+		/// <summary>
+		/// Same as bdfAPI::getRawDataS for a dataset block
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint16_t* Data, unsigned Count) {
+			return withBlock(Group, Input, Block, [&](bdfAPI* Api, unsigned FileGroup, unsigned FileBlock) {
+				return Api->getRawDataS(FileGroup, Input, FileBlock, Address, Data, Count);
+			});
+		}
+
+		/// <summary>
+		/// Same as bdfAPI::getRawDataL for a dataset block
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, int32_t* Data, unsigned Count) {
+			return withBlock(Group, Input, Block, [&](bdfAPI* Api, unsigned FileGroup, unsigned FileBlock) {
+				return bdfConvert::getRawDataL(Api, FileGroup, Input, FileBlock, Address, Data, Count);
+			});
+		}
+
+		/// <summary>
+		/// Read float or double samples of a dataset block
+		/// </summary>
+		/// <param name="Unit">Scaling to volt or physical unit</param>
+		/// <returns>eErrorCode</returns>
+		template <typename T>
+		bdfAPI::eErrorCode getData(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, T* Data, unsigned Count, bdfConvert::eUnit Unit = bdfConvert::unitVolt) {
+			return withBlock(Group, Input, Block, [&](bdfAPI* Api, unsigned FileGroup, unsigned FileBlock) {
+				const bdfBlockIndex::sInput* input = m_Files[find(Group, Input, Block)->File].Index.input(FileGroup, Input);
+				return bdfConvert::getData(Api, input->Info, FileGroup, Input, FileBlock, Address, Data, Count, Unit);
+			});
+		}
+
+		/// <summary>
+		/// Read float or double samples on the position axis of an input, across blocks and files
+		/// </summary>
+		/// <param name="Position">First position</param>
+		/// <param name="Unit">Scaling to volt or physical unit</param>
+		/// <returns>eErrorCode</returns>
+		template <typename T>
+		bdfAPI::eErrorCode getData(unsigned Group, unsigned Input, uint64_t Position, T* Data, unsigned Count, bdfConvert::eUnit Unit = bdfConvert::unitVolt) {
+			const sInput* input = find(Group, Input);
+			if (input == nullptr || Data == nullptr || Position > input->Length || Count > input->Length - Position) return bdfAPI::errArgument;
+			sLease lease(*this);
+			return pieces(*input, Position, Count, [&](const sBlock& Block, uint64_t Address, unsigned N, uint64_t Offset) {
+				if (!lease.acquire(Block.File)) return bdfAPI::errInvalidHandle;
+				const bdfBlockIndex::sInput* fileInput = m_Files[Block.File].Index.input(m_Groups[Group].FileGroup, Input);
+				return bdfConvert::getData(lease.api(), fileInput->Info, m_Groups[Group].FileGroup, Input, Block.Block, Address, Data + Offset, N, Unit);
+			});
+		}
+
+		/// <summary>
+		/// Envelope on the position axis of an input, across blocks and files. Same segments as bdfAPI::getEnvDataD:
+		/// segment s starts at Position + floor(s * Size / (Count / 2)).
+		/// </summary>
+		/// <param name="Position">First position</param>
+		/// <param name="Size">Number of positions</param>
+		/// <param name="Data">Count values, a (min, max) pair per segment</param>
+		/// <param name="Unit">Scaling to volt or physical unit</param>
+		/// <returns>eErrorCode</returns>
+		template <typename T>
+		bdfAPI::eErrorCode getEnvData(unsigned Group, unsigned Input, uint64_t Position, uint64_t Size, T* Data, unsigned Count, bdfConvert::eUnit Unit = bdfConvert::unitVolt) {
+			const sInput* input = find(Group, Input);
+			const unsigned segments = Count / 2;
+			if (input == nullptr || Data == nullptr || segments == 0 || Size < segments || Position > input->Length || Size > input->Length - Position) return bdfAPI::errArgument;
+			sLease lease(*this);
+			const unsigned fileGroup = m_Groups[Group].FileGroup;
+			for (unsigned s = 0; s < segments; s++) {
+				const uint64_t from = Position + Size * s / segments;
+				const uint64_t to = Position + Size * (s + 1) / segments;
+				bool first = true;
+				T mn = 0, mx = 0;
+				bdfAPI::eErrorCode err = pieces(*input, from, to - from, [&](const sBlock& Block, uint64_t Address, unsigned N, uint64_t) {
+					if (!lease.acquire(Block.File)) return bdfAPI::errInvalidHandle;
+					const bdfAPI::sInputInfo& info = m_Files[Block.File].Index.input(fileGroup, Input)->Info;
+					int64_t raw[2];
+					const bdfAPI::eErrorCode result = envelope(lease.api(), info, fileGroup, Input, Block.Block, Address, N, raw);
+					if (result != bdfAPI::errNoError) return result;
+					double factor, constant;
+					bdfConvert::scaling(info, Unit, factor, constant);
+					T lo = (T)(raw[0] * factor + constant), hi = (T)(raw[1] * factor + constant);
+					if (lo > hi) std::swap(lo, hi);
+					mn = first || lo < mn ? lo : mn;
+					mx = first || hi > mx ? hi : mx;
+					first = false;
+					return bdfAPI::errNoError;
+				});
+				if (err != bdfAPI::errNoError) return err;
+				Data[2 * s] = mn;
+				Data[2 * s + 1] = mx;
+			}
+			return bdfAPI::errNoError;
+		}
+
+	private:
+		struct sFile {
+			std::string FileName;
+			std::string Source;
+			bdfBlockIndex Index;
+			double Seconds = 0; /// First sample of the file since 1970-01-01, for the order of the files
+			int64_t Base = 0; /// Earliest StartTime of the file in whole seconds since 1970-01-01
+		};
+
+		struct sBlock {
+			unsigned File;
+			unsigned Block; /// Block in the file
+			uint64_t Length;
+			uint64_t Position; /// First position on the position axis
+			double Seconds; /// Time of sample 0 relative to the base second of the dataset
+			double SampleRateHertz; /// Effective sample rate
+		};
+
+		struct sInput {
+			std::vector<sBlock> Blocks;
+			uint64_t Length = 0;
+		};
+
+		struct sGroup {
+			std::string Source;
+			unsigned FirstFile;
+			unsigned FileGroup;
+			std::vector<sInput> Inputs;
+		};
+
+		/// Pooled API object, Busy while leased to a reader
+		struct sHandle {
+			bdfAPI* Api;
+			unsigned File;
+			bool Busy;
+			uint64_t LastUse;
+		};
+
+		static constexpr unsigned NoFile = 0xFFFFFFFF;
+
+		/// Exclusive use of a pooled API object; a new file releases the previous one
+		struct sLease {
+			explicit sLease(bdfDataset& Owner) : m_Owner(Owner) {}
+			~sLease() { release(); }
+			sLease(const sLease&) = delete;
+			sLease& operator=(const sLease&) = delete;
+
+			bool acquire(unsigned File) {
+				if (m_Api != nullptr && m_File == File) return true;
+				release();
+				m_Api = m_Owner.acquire(File, m_Slot);
+				m_File = File;
+				return m_Api != nullptr;
+			}
+
+			void release() {
+				if (m_Api != nullptr) m_Owner.release(m_Slot);
+				m_Api = nullptr;
+			}
+
+			bdfAPI* api() const { return m_Api; }
+
+		private:
+			bdfDataset& m_Owner;
+			bdfAPI* m_Api = nullptr;
+			unsigned m_File = NoFile;
+			size_t m_Slot = 0;
+		};
+
+		/// Read the index files of all files in parallel, build missing ones
+		bdfAPI::eErrorCode openFiles() {
+			std::atomic<size_t> next{ 0 };
+			std::atomic<int> error{ bdfAPI::errNoError };
+			auto worker = [&]() {
+				for (;;) {
+					const size_t f = next.fetch_add(1);
+					if (f >= m_Files.size() || error != bdfAPI::errNoError) return;
+					bdfAPI::eErrorCode err = openFile(m_Files[f]);
+					if (err != bdfAPI::errNoError) {
+						int expected = bdfAPI::errNoError;
+						error.compare_exchange_strong(expected, err);
+					}
+				}
+			};
+			const size_t nrOfThreads = std::min<size_t>(m_NrOfThreads, m_Files.size());
+			std::vector<std::thread> threads;
+			for (size_t t = 1; t < nrOfThreads; t++) threads.emplace_back(worker);
+			worker();
+			for (auto& t : threads) t.join();
+			return (bdfAPI::eErrorCode)error.load();
+		}
+
+		static bdfAPI::eErrorCode openFile(sFile& File) {
+			const std::string name = std::filesystem::path(File.FileName).filename().string();
+			if (name.compare(0, 4, "heap") == 0) {
+				const size_t end = name.find_first_not_of("0123456789", 4);
+				if (end != std::string::npos && end > 4 && name[end] == '_') File.Source = name.substr(0, end);
+			}
+
+			sFileStamp stamp;
+			if (!sFileStamp::get(File.FileName, stamp)) return bdfAPI::errArgument;
+			if (File.Index.load(bdfBlockIndex::indexFileName(File.FileName), stamp) != bdfAPI::errNoError) {
+				bdfAPI* api = CreateBDFAPIObj();
+				if (api == nullptr) return bdfAPI::errResource;
+				bdfAPI::eErrorCode err = api->loadFile(File.FileName.c_str()) == -1 ? bdfAPI::errArgument : File.Index.build(api);
+				api->closeFile();
+				DestroyBDFAPIObj(api);
+				if (err != bdfAPI::errNoError) return err;
+				File.Index.save(bdfBlockIndex::indexFileName(File.FileName), stamp);
+			}
+
+			File.Seconds = 0;
+			File.Base = 0;
+			bool first = true;
+			for (const bdfBlockIndex::sGroup& group : File.Index.groups()) {
+				for (const bdfBlockIndex::sInput& input : group.Inputs) {
+					for (const bdfAPI::sBlockInfo& blockInfo : input.Blocks) {
+						const double seconds = blockSeconds(blockInfo, 0);
+						const int64_t base = wholeSeconds(blockInfo.StartTime);
+						if (first || seconds < File.Seconds) File.Seconds = seconds;
+						if (first || base < File.Base) File.Base = base;
+						first = false;
+					}
+				}
+			}
+			return bdfAPI::errNoError;
+		}
+
+		/// Assign the files to sources and append their blocks
+		bdfAPI::eErrorCode buildLayout() {
+			std::map<std::string, std::vector<unsigned>> sources;
+			for (unsigned f = 0; f < m_Files.size(); f++) sources[m_Files[f].Source].push_back(f);
+
+			// block times are relative to the earliest whole second, absolute seconds in a double are too coarse for high sample rates
+			m_Base = m_Files.empty() ? 0 : m_Files[0].Base;
+			for (const sFile& file : m_Files) m_Base = std::min(m_Base, file.Base);
+			bool first = true;
+			for (auto& source : sources) {
+				std::vector<unsigned>& files = source.second;
+				std::stable_sort(files.begin(), files.end(), [&](unsigned a, unsigned b) { return m_Files[a].Seconds < m_Files[b].Seconds; });
+				const bdfBlockIndex& layout = m_Files[files[0]].Index;
+				for (unsigned f : files) {
+					const bdfBlockIndex& index = m_Files[f].Index;
+					if (index.groups().size() != layout.groups().size()) return bdfAPI::errArgument;
+					for (size_t g = 0; g < layout.groups().size(); g++) {
+						if (index.groups()[g].Inputs.size() != layout.groups()[g].Inputs.size()) return bdfAPI::errArgument;
+					}
+				}
+
+				for (unsigned g = 0; g < layout.groups().size(); g++) {
+					sGroup group;
+					group.Source = source.first;
+					group.FirstFile = files[0];
+					group.FileGroup = g;
+					group.Inputs.resize(layout.groups()[g].Inputs.size());
+					for (unsigned i = 0; i < group.Inputs.size(); i++) {
+						sInput& input = group.Inputs[i];
+						for (unsigned f : files) {
+							const std::vector<bdfAPI::sBlockInfo>& blocks = m_Files[f].Index.input(g, i)->Blocks;
+							for (unsigned b = 0; b < blocks.size(); b++) {
+								const sBlock block{ f, b, blocks[b].BlockLength, input.Length, blockSeconds(blocks[b], m_Base), sampleRate(blocks[b]) };
+								if (first || block.Seconds < m_Origin) m_Origin = block.Seconds;
+								first = false;
+								input.Blocks.push_back(block);
+								input.Length += block.Length;
+							}
+						}
+					}
+					m_Groups.push_back(std::move(group));
+				}
+			}
+			return bdfAPI::errNoError;
+		}
+
+		static double sampleRate(const bdfAPI::sBlockInfo& BlockInfo) {
+			const double divisor = BlockInfo.TimebaseDivisor > 0 ? BlockInfo.TimebaseDivisor : 1;
+			return BlockInfo.SampleRateHertz > 0 ? BlockInfo.SampleRateHertz / divisor : 1;
+		}
+
+		/// Time of sample 0 of a block relative to Base seconds since 1970-01-01
+		static double blockSeconds(const bdfAPI::sBlockInfo& BlockInfo, int64_t Base) {
+			return (double)(wholeSeconds(BlockInfo.StartTime) - Base) + BlockInfo.StartTime.MilliSecond / 1000.0 + BlockInfo.TriggerTimeSeconds - BlockInfo.TriggerSample / sampleRate(BlockInfo);
+		}
+
+		/// Whole seconds since 1970-01-01 of a date and time (proleptic Gregorian calendar)
+		static int64_t wholeSeconds(const bdfAPI::sDateTime& Time) {
+			const unsigned month = Time.Month >= 1 && Time.Month <= 12 ? Time.Month : 1;
+			const int64_t year = (int64_t)Time.Year - (month <= 2 ? 1 : 0);
+			const int64_t era = (year >= 0 ? year : year - 399) / 400;
+			const int64_t yearOfEra = year - era * 400;
+			const int64_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + (Time.Day >= 1 ? Time.Day : 1) - 1;
+			const int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+			const int64_t days = era * 146097 + dayOfEra - 719468;
+			return days * 86400 + Time.Hour * 3600 + Time.Minute * 60 + Time.Second;
+		}
+
+		const sInput* find(unsigned Group, unsigned Input) const {
+			if (Group >= m_Groups.size() || Input >= m_Groups[Group].Inputs.size()) return nullptr;
+			return &m_Groups[Group].Inputs[Input];
+		}
+
+		const sBlock* find(unsigned Group, unsigned Input, unsigned Block) const {
+			const sInput* input = find(Group, Input);
+			if (input == nullptr || Block >= input->Blocks.size()) return nullptr;
+			return &input->Blocks[Block];
+		}
+
+		template <typename F>
+		bdfAPI::eErrorCode withBlock(unsigned Group, unsigned Input, unsigned Block, F Function) {
+			const sBlock* block = find(Group, Input, Block);
+			if (block == nullptr) return bdfAPI::errArgument;
+			sLease lease(*this);
+			if (!lease.acquire(block->File)) return bdfAPI::errInvalidHandle;
+			return Function(lease.api(), m_Groups[Group].FileGroup, block->Block);
+		}
+
+		/// Call F(block, address in the block, number of samples, offset in the request) for the blocks of a range of positions
+		template <typename F>
+		static bdfAPI::eErrorCode pieces(const sInput& Input, uint64_t Position, uint64_t Count, F Function) {
+			auto it = std::upper_bound(Input.Blocks.begin(), Input.Blocks.end(), Position, [](uint64_t p, const sBlock& b) { return p < b.Position; });
+			size_t b = it == Input.Blocks.begin() ? 0 : (size_t)(it - Input.Blocks.begin()) - 1;
+			for (uint64_t offset = 0; offset < Count; b++) {
+				const sBlock& block = Input.Blocks[b];
+				const uint64_t address = Position + offset - block.Position;
+				if (address >= block.Length) continue;
+				const unsigned n = (unsigned)std::min(block.Length - address, Count - offset);
+				bdfAPI::eErrorCode err = Function(block, address, n, offset);
+				if (err != bdfAPI::errNoError) return err;
+				offset += n;
+			}
+			return bdfAPI::errNoError;
+		}
+
+		/// Raw (min, max) of a range of one block
+		static bdfAPI::eErrorCode envelope(bdfAPI* Api, const bdfAPI::sInputInfo& InputInfo, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t Size, int64_t MinMax[2]) {
+			if (InputInfo.BytesPerSample > 2) {
+				int32_t data[2];
+				bdfAPI::eErrorCode err = Api->getEnvRawDataL(Group, Input, Block, Address, Size, data, 2);
+				MinMax[0] = (uint32_t)data[0];
+				MinMax[1] = (uint32_t)data[1];
+				return err;
+			}
+			uint16_t data[2];
+			bdfAPI::eErrorCode err = Api->getEnvRawDataS(Group, Input, Block, Address, Size, data, 2);
+			MinMax[0] = data[0];
+			MinMax[1] = data[1];
+			return err;
+		}
+
+		/// Lease an API object with a file loaded, waits while all objects are leased
+		bdfAPI* acquire(unsigned File, size_t& Slot) {
+			bdfAPI* api = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				for (;;) {
+					size_t lru = m_Handles.size();
+					for (size_t n = 0; n < m_Handles.size(); n++) {
+						sHandle& handle = m_Handles[n];
+						if (handle.Busy) continue;
+						if (handle.File == File) {
+							handle.Busy = true;
+							handle.LastUse = ++m_Clock;
+							Slot = n;
+							return handle.Api;
+						}
+						if (lru == m_Handles.size() || handle.LastUse < m_Handles[lru].LastUse) lru = n;
+					}
+					if (m_Handles.size() < m_MaxOpenFiles) {
+						// no reallocation, the capacity is MaxOpenFiles
+						m_Handles.push_back(sHandle{ nullptr, File, true, ++m_Clock });
+						Slot = m_Handles.size() - 1;
+						break;
+					}
+					if (lru < m_Handles.size()) {
+						sHandle& handle = m_Handles[lru];
+						handle.File = File;
+						handle.Busy = true;
+						handle.LastUse = ++m_Clock;
+						api = handle.Api;
+						Slot = lru;
+						break;
+					}
+					m_Released.wait(lock);
+				}
+			}
+
+			// the file is loaded outside of the lock, the slot is busy
+			if (api != nullptr) api->closeFile();
+			else api = CreateBDFAPIObj();
+			if (api != nullptr && api->loadFile(m_Files[File].FileName.c_str()) == -1) {
+				DestroyBDFAPIObj(api);
+				api = nullptr;
+			}
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Handles[Slot].Api = api;
+			if (api == nullptr) {
+				m_Handles[Slot].File = NoFile;
+				m_Handles[Slot].Busy = false;
+				m_Released.notify_one();
+			}
+			return api;
+		}
+
+		void release(size_t Slot) {
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Handles[Slot].Busy = false;
+			}
+			m_Released.notify_one();
+		}
+
+		const unsigned m_MaxOpenFiles;
+		unsigned m_NrOfThreads;
+		std::vector<sFile> m_Files;
+		std::vector<sGroup> m_Groups;
+		int64_t m_Base = 0;
+		double m_Origin = 0; /// Earliest sample 0 of all blocks, relative to m_Base
+
+		std::mutex m_Mutex;
+		std::condition_variable m_Released;
+		std::vector<sHandle> m_Handles;
+		uint64_t m_Clock = 0;
+	};
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "bdfAPI.h"
+
+namespace filereader {
+	/// <summary>
+	/// Base class for helpers which extend an API object. Every call is forwarded to the wrapped
+	/// object, derived classes override only the functions they extend. Decorators can be stacked.
+	/// The wrapped object is not owned and must outlive the decorator.
+	/// </summary>
+	class bdfAPIDecorator : public bdfAPI {
+	public:
+		/// <summary>
+		/// Wrap an API object
+		/// </summary>
+		/// <param name="Api">API object created by CreateBDFAPIObj or another decorator</param>
+		explicit bdfAPIDecorator(bdfAPI* Api) : m_Api(Api) {}
+		virtual ~bdfAPIDecorator() {}
+
+		/// The wrapped API object
+		bdfAPI* api() const { return m_Api; }
+
+		virtual int loadFile(const char* FileName) override { return m_Api->loadFile(FileName); }
+		virtual int initFileWriter(unsigned Group, sDateTime& StartTime, eOperationMode OperationMode, double SampleRate, uint32_t TimebaseDivisor, uint32_t TriggerSample) override {
+			return m_Api->initFileWriter(Group, StartTime, OperationMode, SampleRate, TimebaseDivisor, TriggerSample);
+		}
+		virtual int writeInputHeader(uint32_t BoardNumber, uint32_t InputNumber, uint32_t AnalogMask, uint32_t MarkerMask, double Range, double Offset, double VoltToPhysicalFactor, double VoltToPhysicalConstant, int Handle = 0) override {
+			return m_Api->writeInputHeader(BoardNumber, InputNumber, AnalogMask, MarkerMask, Range, Offset, VoltToPhysicalFactor, VoltToPhysicalConstant, Handle);
+		}
+		virtual int initInputStreamer(uint32_t BoardNumber, uint32_t InputNumber, uint32_t BlockNr, int Handle = 0) override {
+			return m_Api->initInputStreamer(BoardNumber, InputNumber, BlockNr, Handle);
+		}
+		virtual int writeData(int StreamerHandle, char* Data, unsigned int count, int Handle = 0) override { return m_Api->writeData(StreamerHandle, Data, count, Handle); }
+		virtual int setAttribute(unsigned Input, const std::string& Key, const std::string& Value, int GroupHandle = 0) override { return m_Api->setAttribute(Input, Key, Value, GroupHandle); }
+		virtual int writeAttributes(int GroupHandle = 0) override { return m_Api->writeAttributes(GroupHandle); }
+		virtual void writeEORInfo(uint32_t BlockNr, uint64_t TriggerTime, uint64_t DataCntr, uint32_t Input, uint32_t Board, int GroupHandle = 0) override {
+			m_Api->writeEORInfo(BlockNr, TriggerTime, DataCntr, Input, Board, GroupHandle);
+		}
+		virtual void closeFile(int handle = -1) override { m_Api->closeFile(handle); }
+		virtual int initFileReader() override { return m_Api->initFileReader(); }
+		virtual eErrorCode getAttribute(unsigned Group, unsigned Input, char* Key, char* Value, unsigned Size) override { return m_Api->getAttribute(Group, Input, Key, Value, Size); }
+		virtual unsigned getNumberOfGroups() override { return m_Api->getNumberOfGroups(); }
+		virtual unsigned getNumberOfInputs(unsigned Group) override { return m_Api->getNumberOfInputs(Group); }
+		virtual unsigned getNumberOfBlocks(unsigned Group, unsigned Input) override { return m_Api->getNumberOfBlocks(Group, Input); }
+		virtual eErrorCode getInputInfo(unsigned Group, unsigned Input, sInputInfo* InputInfo) override { return m_Api->getInputInfo(Group, Input, InputInfo); }
+		virtual eErrorCode getBlockInfo(unsigned Group, unsigned Input, unsigned Block, sBlockInfo* BlockInfo) override { return m_Api->getBlockInfo(Group, Input, Block, BlockInfo); }
+		virtual eErrorCode getOperationMode(unsigned Group, eOperationMode& Mode) override { return m_Api->getOperationMode(Group, Mode); }
+		virtual eErrorCode getRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint16_t* Data, unsigned Count) override {
+			return m_Api->getRawDataS(Group, Input, Block, Address, Data, Count);
+		}
+		virtual eErrorCode getRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, int32_t* Data, unsigned Count) override {
+			return m_Api->getRawDataL(Group, Input, Block, Address, Data, Count);
+		}
+		virtual eErrorCode getDataF(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, float* Data, unsigned Count) override {
+			return m_Api->getDataF(Group, Input, Block, Address, Data, Count);
+		}
+		virtual eErrorCode getDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, double* Data, unsigned Count) override {
+			return m_Api->getDataD(Group, Input, Block, Address, Data, Count);
+		}
+		virtual eErrorCode getEnvRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, uint16_t* Data, unsigned Count) override {
+			return m_Api->getEnvRawDataS(Group, Input, Block, Address, BlockSize, Data, Count);
+		}
+		virtual eErrorCode getEnvRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, int32_t* Data, unsigned Count) override {
+			return m_Api->getEnvRawDataL(Group, Input, Block, Address, BlockSize, Data, Count);
+		}
+		virtual eErrorCode getEnvDataF(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, float* Data, unsigned Count) override {
+			return m_Api->getEnvDataF(Group, Input, Block, Address, BlockSize, Data, Count);
+		}
+		virtual eErrorCode getEnvDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, double* Data, unsigned Count) override {
+			return m_Api->getEnvDataD(Group, Input, Block, Address, BlockSize, Data, Count);
+		}
+
+		/// <summary>
+		/// Does nothing, the wrapped object is released by its owner (DestroyBDFAPIObj).
+		/// </summary>
+		virtual void Release() override {}
+
+	protected:
+		bdfAPI* m_Api;
+	};
+}
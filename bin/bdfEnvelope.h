@@ -0,0 +1,792 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfConvert.h"
+#include "bdfDecorator.h"
+#include "bdfIndex.h"
+
+namespace filereader {
+	/// <summary>
+	/// Envelope level estimate for the getEnv* functions.
+	///
+	/// A BDF file stores \ref bdfAPI::sBlockInfo::NumberOfReductions envelope curves. Level 0 are the samples,
+	/// each min/max pair of level L covers ReductionFactor^L aligned samples. A segment of the
+	/// getEnv* segmentation can be answered exactly by the pairs of the coarsest level that fits into
+	/// the smallest segment, only the ragged segment edges need finer levels.
+	/// The estimate is derived from the block info alone: it is the level an implementation following
+	/// this scheme would use, not a report of what the DLL actually read. BdFileReader does not tell
+	/// which level or how many values a getEnv* call read, so the estimate can be used to pick a view
+	/// width but not to measure or bound the cost of a call.
+	/// </summary>
+	class bdfEnvelope {
+	public:
+		/// Estimated level of one getEnv* request
+		struct sEnvelopeEstimate {
+			/// The coarsest envelope level that gives exact min/max values, 0 for the samples
+			unsigned Level;
+			/// Number of samples covered by one min/max pair of \ref Level, 0 if no estimate could be made
+			uint64_t SamplesPerPair;
+			/// Number of samples of the smallest segment
+			uint64_t MinSegmentSize;
+			/// Upper bound of min/max values or samples needed to answer the request at \ref Level
+			uint64_t MaxValuesRead;
+		};
+
+		/// <summary>
+		/// Estimate the envelope level of a getEnv* request. Segments smaller than one sample are
+		/// estimated at level 0.
+		/// </summary>
+		/// <param name="BlockInfo">Block info of the block to read</param>
+		/// <param name="BlockSize">The number of samples from which the envelope is calculated</param>
+		/// <param name="Count">Twice the number of min/max pairs</param>
+		/// <param name="Estimate">Receives the estimated level</param>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode estimateLevel(const bdfAPI::sBlockInfo& BlockInfo, uint64_t BlockSize, unsigned Count, sEnvelopeEstimate* Estimate) {
+			const unsigned nrOfSegments = Count / 2;
+			if (Estimate == nullptr || nrOfSegments == 0) return bdfAPI::errArgument;
+
+			const uint64_t minSegment = BlockSize / nrOfSegments;
+			const uint64_t maxSegment = minSegment + (BlockSize % nrOfSegments != 0 ? 1 : 0);
+			const uint64_t factor = BlockInfo.ReductionFactor;
+
+			unsigned level = 0;
+			uint64_t samplesPerPair = 1;
+			if (factor >= 2) {
+				while (level < BlockInfo.NumberOfReductions && samplesPerPair * factor <= minSegment) {
+					samplesPerPair *= factor;
+					level++;
+				}
+			}
+
+			// interior pairs of the segment plus at most (factor - 1) values per finer level on both edges
+			uint64_t perSegment = maxSegment / samplesPerPair + 2;
+			if (level > 0) perSegment += 2 * (factor - 1) * level;
+			if (perSegment > maxSegment) perSegment = maxSegment;
+
+			Estimate->Level = level;
+			Estimate->SamplesPerPair = samplesPerPair;
+			Estimate->MinSegmentSize = minSegment;
+			Estimate->MaxValuesRead = perSegment * nrOfSegments;
+			return bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Same as bdfAPI::getEnvRawDataS, together with an estimate of the envelope level of the request.
+		/// The request is always forwarded, the result is the one of the DLL.
+		/// </summary>
+		/// <param name="Estimate">Optional, receives the estimated level</param>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode getEnvRawDataSEstimated(bdfAPI* Api, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, uint16_t* Data, unsigned Count, sEnvelopeEstimate* Estimate = nullptr) {
+			if (Api == nullptr) return bdfAPI::errInvalidHandle;
+			estimate(Api, Group, Input, Block, Address, BlockSize, Count, Estimate);
+			return Api->getEnvRawDataS(Group, Input, Block, Address, BlockSize, Data, Count);
+		}
+
+		/// <summary>
+		/// Same as bdfAPI::getEnvRawDataL, together with an estimate of the envelope level of the request.
+		/// The request is always forwarded, the result is the one of the DLL.
+		/// </summary>
+		/// <param name="Estimate">Optional, receives the estimated level</param>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode getEnvRawDataLEstimated(bdfAPI* Api, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, int32_t* Data, unsigned Count, sEnvelopeEstimate* Estimate = nullptr) {
+			if (Api == nullptr) return bdfAPI::errInvalidHandle;
+			estimate(Api, Group, Input, Block, Address, BlockSize, Count, Estimate);
+			return Api->getEnvRawDataL(Group, Input, Block, Address, BlockSize, Data, Count);
+		}
+
+		/// <summary>
+		/// Same as bdfAPI::getEnvDataF, together with an estimate of the envelope level of the request.
+		/// The request is always forwarded, the result is the one of the DLL.
+		/// </summary>
+		/// <param name="Estimate">Optional, receives the estimated level</param>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode getEnvDataFEstimated(bdfAPI* Api, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, float* Data, unsigned Count, sEnvelopeEstimate* Estimate = nullptr) {
+			if (Api == nullptr) return bdfAPI::errInvalidHandle;
+			estimate(Api, Group, Input, Block, Address, BlockSize, Count, Estimate);
+			return Api->getEnvDataF(Group, Input, Block, Address, BlockSize, Data, Count);
+		}
+
+		/// <summary>
+		/// Same as bdfAPI::getEnvDataD, together with an estimate of the envelope level of the request.
+		/// The request is always forwarded, the result is the one of the DLL.
+		/// </summary>
+		/// <param name="Estimate">Optional, receives the estimated level</param>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode getEnvDataDEstimated(bdfAPI* Api, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, double* Data, unsigned Count, sEnvelopeEstimate* Estimate = nullptr) {
+			if (Api == nullptr) return bdfAPI::errInvalidHandle;
+			estimate(Api, Group, Input, Block, Address, BlockSize, Count, Estimate);
+			return Api->getEnvDataD(Group, Input, Block, Address, BlockSize, Data, Count);
+		}
+
+	private:
+		/// Fill Estimate if the request can be estimated, otherwise leave it zeroed; the DLL decides about the request
+		static void estimate(bdfAPI* Api, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, unsigned Count, sEnvelopeEstimate* Estimate) {
+			if (Estimate == nullptr) return;
+			*Estimate = sEnvelopeEstimate();
+			bdfAPI::sBlockInfo blockInfo;
+			if (Api->getBlockInfo(Group, Input, Block, &blockInfo) != bdfAPI::errNoError) return;
+			if (Address > blockInfo.BlockLength || BlockSize > blockInfo.BlockLength - Address) return;
+			estimateLevel(blockInfo, BlockSize, Count, Estimate);
+		}
+	};
+
+	/// <summary>
+	/// Builds the min/max envelope pyramid of one input block while its samples are streamed.
+	/// Each pair of level 1 covers ReductionFactor samples, each pair of level L covers ReductionFactor
+	/// pairs of level L-1. Level 1 of all complete windows of an append is reduced in one pass of the
+	/// vectorized kernel bdfConvert::minMaxWindows, the higher levels cost 1/ReductionFactor of the level
+	/// below. The last pair of a level covers the remaining samples after \ref finish.
+	/// The pyramid can be read from other threads while samples are appended.
+	/// </summary>
+	class bdfEnvelopeBuilder {
+	public:
+		/// <summary>
+		/// Create an empty pyramid
+		/// </summary>
+		/// <param name="ReductionFactor">Number of samples or pairs reduced into one pair, at least 2</param>
+		/// <param name="NumberOfReductions">Number of envelope levels</param>
+		/// <param name="AnalogMask">Mask to blind out the marker bits</param>
+		bdfEnvelopeBuilder(unsigned ReductionFactor, unsigned NumberOfReductions, uint32_t AnalogMask)
+			: m_ReductionFactor(ReductionFactor < 2 ? 2 : ReductionFactor), m_AnalogMask(AnalogMask),
+			m_Levels(NumberOfReductions), m_Pending(NumberOfReductions) {}
+
+		/// <summary>
+		/// Append samples to the block
+		/// </summary>
+		/// <param name="Samples">Raw words</param>
+		/// <param name="Count">Number of samples</param>
+		void append(const uint16_t* Samples, size_t Count) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Finished || m_Levels.empty()) {
+				m_NumberOfSamples += Count;
+				return;
+			}
+			size_t pos = 0;
+			sPending& first = m_Pending[0];
+			if (first.Count > 0) {
+				// complete the window started by the previous call
+				size_t n = m_ReductionFactor - first.Count;
+				if (n > Count) n = Count;
+				uint16_t mn = 0xFFFF, mx = 0;
+				bdfConvert::minMax(Samples, n, m_AnalogMask, mn, mx);
+				merge(first, mn, mx, (unsigned)n);
+				pos = n;
+				if (first.Count == m_ReductionFactor) flush(0);
+			}
+			// all complete windows in one pass of the vectorized kernel
+			const size_t windows = (Count - pos) / m_ReductionFactor;
+			if (windows > 0) {
+				m_Scratch.resize(2 * windows);
+				bdfConvert::minMaxWindows(Samples + pos, windows, m_ReductionFactor, m_AnalogMask, m_Scratch.data());
+				for (size_t w = 0; w < windows; w++) {
+					merge(first, m_Scratch[2 * w], m_Scratch[2 * w + 1], m_ReductionFactor);
+					flush(0);
+				}
+				pos += windows * m_ReductionFactor;
+			}
+			if (pos < Count) {
+				uint16_t mn = 0xFFFF, mx = 0;
+				bdfConvert::minMax(Samples + pos, Count - pos, m_AnalogMask, mn, mx);
+				merge(first, mn, mx, (unsigned)(Count - pos));
+			}
+			m_NumberOfSamples += Count;
+		}
+
+		/// <summary>
+		/// Close the block, the partial windows are emitted as last pair of each level
+		/// </summary>
+		void finish() {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Finished) return;
+			for (size_t level = 0; level < m_Pending.size(); level++) {
+				if (m_Pending[level].Count > 0) flush(level);
+			}
+			m_Finished = true;
+		}
+
+		/// True after finish
+		bool finished() const { std::lock_guard<std::mutex> lock(m_Mutex); return m_Finished; }
+		/// Number of samples appended
+		uint64_t numberOfSamples() const { std::lock_guard<std::mutex> lock(m_Mutex); return m_NumberOfSamples; }
+		/// Number of samples or pairs reduced into one pair
+		unsigned reductionFactor() const { return m_ReductionFactor; }
+		/// Number of envelope levels
+		unsigned numberOfReductions() const { return (unsigned)m_Levels.size(); }
+		/// Mask applied to the samples
+		uint32_t analogMask() const { return m_AnalogMask; }
+
+		/// <summary>
+		/// Get the number of completed min/max pairs of a level
+		/// </summary>
+		/// <param name="Level">1 to numberOfReductions</param>
+		uint64_t numberOfPairs(unsigned Level) const {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			return Level >= 1 && Level <= m_Levels.size() ? m_Levels[Level - 1].size() / 2 : 0;
+		}
+
+		/// <summary>
+		/// Copy min/max pairs of a level as raw words [min, max, min, max, ...]
+		/// </summary>
+		/// <param name="Level">1 to numberOfReductions</param>
+		/// <param name="FirstPair">Index of the first pair</param>
+		/// <param name="Data">Receives 2 * NrOfPairs words</param>
+		/// <param name="NrOfPairs">Number of pairs to copy</param>
+		/// <returns>Number of pairs copied</returns>
+		size_t getPairs(unsigned Level, uint64_t FirstPair, uint16_t* Data, size_t NrOfPairs) const {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (Level < 1 || Level > m_Levels.size()) return 0;
+			const std::vector<uint16_t>& pairs = m_Levels[Level - 1];
+			const uint64_t available = pairs.size() / 2;
+			if (FirstPair >= available) return 0;
+			size_t n = available - FirstPair < NrOfPairs ? (size_t)(available - FirstPair) : NrOfPairs;
+			memcpy(Data, pairs.data() + 2 * FirstPair, n * 2 * sizeof(uint16_t));
+			return n;
+		}
+
+	private:
+		struct sPending {
+			uint16_t Min = 0xFFFF;
+			uint16_t Max = 0;
+			unsigned Count = 0;
+		};
+
+		static void merge(sPending& Pending, uint16_t Min, uint16_t Max, unsigned Count) {
+			if (Min < Pending.Min) Pending.Min = Min;
+			if (Max > Pending.Max) Pending.Max = Max;
+			Pending.Count += Count;
+		}
+
+		/// Emit the pending pair of a level (index 0 = level 1) and reduce it into the next level
+		void flush(size_t Level) {
+			sPending pending = m_Pending[Level];
+			m_Pending[Level] = sPending();
+			m_Levels[Level].push_back(pending.Min);
+			m_Levels[Level].push_back(pending.Max);
+			if (Level + 1 < m_Pending.size()) {
+				merge(m_Pending[Level + 1], pending.Min, pending.Max, 1);
+				if (m_Pending[Level + 1].Count == m_ReductionFactor) flush(Level + 1);
+			}
+		}
+
+		const unsigned m_ReductionFactor;
+		const uint32_t m_AnalogMask;
+		mutable std::mutex m_Mutex;
+		std::vector<std::vector<uint16_t>> m_Levels;
+		std::vector<sPending> m_Pending;
+		/// Level 1 pairs of the windows of one append
+		std::vector<uint16_t> m_Scratch;
+		uint64_t m_NumberOfSamples = 0;
+		bool m_Finished = false;
+	};
+
+	/// <summary>
+	/// Envelope sidecar of a BDF file (FileName + ".env"): the envelope pyramids built by bdfEnvelopeWriter,
+	/// stored next to the file and valid as long as the stamp of the file is unchanged. Each pyramid is
+	/// identified by the group number given to initFileWriter, the board and input number and the block.
+	/// </summary>
+	class bdfEnvelopeFile {
+	public:
+		/// Pyramid of one input block
+		struct sPyramid {
+			uint32_t Group;
+			uint32_t Board;
+			uint32_t Input;
+			uint32_t Block;
+			uint32_t ReductionFactor;
+			uint32_t AnalogMask;
+			uint64_t NumberOfSamples;
+			/// Pairs [min, max, ...] of level 1 to NumberOfReductions
+			std::vector<std::vector<uint16_t>> Levels;
+		};
+
+		/// Sidecar file name of a BDF file
+		static std::string envelopeFileName(const std::string& FileName) { return FileName + ".env"; }
+
+		/// Copy the pyramid of a finished builder
+		static sPyramid pyramid(const bdfEnvelopeBuilder& Builder, uint32_t Group, uint32_t Board, uint32_t Input, uint32_t Block) {
+			sPyramid p{ Group, Board, Input, Block, Builder.reductionFactor(), Builder.analogMask(), Builder.numberOfSamples(), {} };
+			p.Levels.resize(Builder.numberOfReductions());
+			for (unsigned level = 1; level <= p.Levels.size(); level++) {
+				std::vector<uint16_t>& pairs = p.Levels[level - 1];
+				pairs.resize((size_t)(2 * Builder.numberOfPairs(level)));
+				pairs.resize(2 * Builder.getPairs(level, 0, pairs.data(), pairs.size() / 2));
+			}
+			return p;
+		}
+
+		/// <summary>
+		/// Write the sidecar file
+		/// </summary>
+		/// <param name="EnvelopeFileName"></param>
+		/// <param name="Stamp">Stamp of the BDF file</param>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode save(const std::string& EnvelopeFileName, const sFileStamp& Stamp, const std::vector<sPyramid>& Pyramids) {
+			std::string data(Magic, sizeof(Magic));
+			put(data, Version);
+			put(data, Stamp.Size);
+			put(data, Stamp.ModifiedTime);
+			put(data, Stamp.Hash);
+			put(data, (uint32_t)Pyramids.size());
+			for (const sPyramid& p : Pyramids) {
+				const uint32_t words[] = { p.Group, p.Board, p.Input, p.Block, p.ReductionFactor, p.AnalogMask, (uint32_t)p.Levels.size() };
+				for (uint32_t w : words) put(data, w);
+				put(data, p.NumberOfSamples);
+				for (const std::vector<uint16_t>& pairs : p.Levels) {
+					put(data, (uint64_t)(pairs.size() / 2));
+					data.append(reinterpret_cast<const char*>(pairs.data()), (pairs.size() / 2) * 2 * sizeof(uint16_t));
+				}
+			}
+			put(data, sFileStamp::hash(data.data(), data.size()));
+
+			// write to a temporary file first, so a reader never sees a partial sidecar
+			const std::string tmp = EnvelopeFileName + ".tmp";
+			{
+				std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+				if (!file) return bdfAPI::errResource;
+				file.write(data.data(), (std::streamsize)data.size());
+				if (!file) return bdfAPI::errResource;
+			}
+			std::error_code ec;
+			std::filesystem::rename(tmp, EnvelopeFileName, ec);
+			return ec ? bdfAPI::errResource : bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Read the sidecar file
+		/// </summary>
+		/// <param name="EnvelopeFileName"></param>
+		/// <param name="Stamp">Current stamp of the BDF file</param>
+		/// <returns>errArgument if the sidecar is missing, corrupt or does not match the stamp</returns>
+		static bdfAPI::eErrorCode load(const std::string& EnvelopeFileName, const sFileStamp& Stamp, std::vector<sPyramid>& Pyramids) {
+			Pyramids.clear();
+			std::ifstream file(EnvelopeFileName, std::ios::binary);
+			if (!file) return bdfAPI::errArgument;
+			std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			if (data.size() < sizeof(Magic) + sizeof(uint64_t) || memcmp(data.data(), Magic, sizeof(Magic)) != 0) return bdfAPI::errArgument;
+			uint64_t checksum;
+			memcpy(&checksum, data.data() + data.size() - sizeof(checksum), sizeof(checksum));
+			if (checksum != sFileStamp::hash(data.data(), data.size() - sizeof(checksum))) return bdfAPI::errArgument;
+
+			size_t pos = sizeof(Magic);
+			uint32_t version, count;
+			sFileStamp stamp;
+			if (!get(data, pos, version) || version != Version) return bdfAPI::errArgument;
+			if (!get(data, pos, stamp.Size) || !get(data, pos, stamp.ModifiedTime) || !get(data, pos, stamp.Hash)) return bdfAPI::errArgument;
+			if (stamp != Stamp) return bdfAPI::errArgument;
+			if (!get(data, pos, count) || count > data.size()) return bdfAPI::errArgument;
+			std::vector<sPyramid> pyramids(count);
+			for (sPyramid& p : pyramids) {
+				uint32_t levels;
+				if (!get(data, pos, p.Group) || !get(data, pos, p.Board) || !get(data, pos, p.Input) || !get(data, pos, p.Block)
+					|| !get(data, pos, p.ReductionFactor) || !get(data, pos, p.AnalogMask) || !get(data, pos, levels)
+					|| !get(data, pos, p.NumberOfSamples) || levels > data.size() || p.ReductionFactor < 2) return bdfAPI::errArgument;
+				p.Levels.resize(levels);
+				for (std::vector<uint16_t>& pairs : p.Levels) {
+					uint64_t nrOfPairs;
+					if (!get(data, pos, nrOfPairs) || nrOfPairs > data.size() || data.size() - sizeof(uint64_t) < pos + nrOfPairs * 4) return bdfAPI::errArgument;
+					pairs.resize((size_t)(2 * nrOfPairs));
+					memcpy(pairs.data(), data.data() + pos, (size_t)(nrOfPairs * 4));
+					pos += (size_t)(nrOfPairs * 4);
+				}
+			}
+			Pyramids.swap(pyramids);
+			return bdfAPI::errNoError;
+		}
+
+	private:
+		static constexpr char Magic[8] = { 'B', 'D', 'F', 'E', 'N', 'V', 0, 0 };
+		static constexpr uint32_t Version = 1;
+
+		template <typename T>
+		static void put(std::string& Data, const T& Value) { Data.append(reinterpret_cast<const char*>(&Value), sizeof(T)); }
+
+		template <typename T>
+		static bool get(const std::string& Data, size_t& Pos, T& Value) {
+			if (Data.size() - sizeof(uint64_t) < Pos + sizeof(T)) return false;
+			memcpy(&Value, Data.data() + Pos, sizeof(T));
+			Pos += sizeof(T);
+			return true;
+		}
+	};
+
+	/// <summary>
+	/// Writer option which keeps the envelope pyramid of every written block up to date during writeData.
+	/// Wrap the writer API object and use this object for all writer calls. writeEORInfo and closeFile
+	/// finish the pyramids of the closed blocks, which stay available until the object is destroyed.
+	///
+	/// The file format is written by BdFileReader, so the pyramids can not be stored in the file. After
+	/// closeFile, \ref saveEnvelopeFile stores them in a sidecar next to the file (bdfEnvelopeFile), from
+	/// which a bdfEnvelopeReader answers getEnv* for every later reader of the file.
+	///
+	/// The reduction runs in writeData after the data was passed on. To keep it off the acquisition
+	/// thread, wrap this object in a bdfAsyncWriter: its I/O thread is then the only caller of writeData
+	/// here and builds the pyramids while the producers only copy into its buffers.
+	///
+	/// Only 16-bit samples are reduced. Streamers of inputs whose AnalogMask needs more than 16 bits
+	/// (4 bytes per sample) are passed through without a pyramid, getEnvelope returns nullptr for them.
+	/// </summary>
+	class bdfEnvelopeWriter : public bdfAPIDecorator {
+	public:
+		/// <summary>
+		/// Wrap a writer API object
+		/// </summary>
+		/// <param name="Api">API object used for writing</param>
+		/// <param name="ReductionFactor">Number of samples or pairs reduced into one pair</param>
+		/// <param name="NumberOfReductions">Number of envelope levels</param>
+		bdfEnvelopeWriter(bdfAPI* Api, unsigned ReductionFactor = 16, unsigned NumberOfReductions = 4)
+			: bdfAPIDecorator(Api), m_ReductionFactor(ReductionFactor), m_NumberOfReductions(NumberOfReductions) {}
+
+		virtual int initFileWriter(unsigned Group, sDateTime& StartTime, eOperationMode OperationMode, double SampleRate, uint32_t TimebaseDivisor, uint32_t TriggerSample) override {
+			int handle = m_Api->initFileWriter(Group, StartTime, OperationMode, SampleRate, TimebaseDivisor, TriggerSample);
+			if (handle < 0) return handle;
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Groups[handle] = Group;
+			return handle;
+		}
+
+		virtual int writeInputHeader(uint32_t BoardNumber, uint32_t InputNumber, uint32_t AnalogMask, uint32_t MarkerMask, double Range, double Offset, double VoltToPhysicalFactor, double VoltToPhysicalConstant, int Handle = 0) override {
+			int result = m_Api->writeInputHeader(BoardNumber, InputNumber, AnalogMask, MarkerMask, Range, Offset, VoltToPhysicalFactor, VoltToPhysicalConstant, Handle);
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_AnalogMasks[std::make_tuple(Handle, BoardNumber, InputNumber)] = AnalogMask;
+			return result;
+		}
+
+		virtual int initInputStreamer(uint32_t BoardNumber, uint32_t InputNumber, uint32_t BlockNr, int Handle = 0) override {
+			int streamer = m_Api->initInputStreamer(BoardNumber, InputNumber, BlockNr, Handle);
+			if (streamer < 0) return streamer;
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			std::shared_ptr<sStreamer>& s = m_Streamers[std::make_pair(Handle, streamer)];
+			if (!s) s = std::make_shared<sStreamer>();
+			auto mask = m_AnalogMasks.find(std::make_tuple(Handle, BoardNumber, InputNumber));
+			std::lock_guard<std::mutex> stream(s->Mutex);
+			s->AnalogMask = mask != m_AnalogMasks.end() ? mask->second : 0xFFFF;
+			s->Board = BoardNumber;
+			s->Input = InputNumber;
+			s->Block = BlockNr;
+			s->HasOddByte = false;
+			s->Builder = newBuilder(Handle, streamer, *s);
+			return streamer;
+		}
+
+		virtual int writeData(int StreamerHandle, char* Data, unsigned int count, int Handle = 0) override {
+			int result = m_Api->writeData(StreamerHandle, Data, count, Handle);
+			if (result != errNoError) return result;
+
+			// the state of a streamer is owned by its mutex, taken before the map lock is released
+			std::shared_ptr<sStreamer> s;
+			std::unique_lock<std::mutex> stream;
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				auto it = m_Streamers.find(std::make_pair(Handle, StreamerHandle));
+				if (it == m_Streamers.end()) return result;
+				s = it->second;
+				stream = std::unique_lock<std::mutex>(s->Mutex);
+				if (!s->Builder) s->Builder = newBuilder(Handle, StreamerHandle, *s);
+			}
+			if (!s->Builder) return result;
+
+			// samples are 16-bit words, a word split between two calls is carried over
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(Data);
+			if (s->HasOddByte && count > 0) {
+				uint16_t word = (uint16_t)(s->OddByte | (bytes[0] << 8));
+				s->Builder->append(&word, 1);
+				bytes++;
+				count--;
+				s->HasOddByte = false;
+			}
+			const size_t words = count / 2;
+			if (reinterpret_cast<uintptr_t>(bytes) % alignof(uint16_t) == 0) {
+				s->Builder->append(reinterpret_cast<const uint16_t*>(bytes), words);
+			}
+			else {
+				s->Aligned.resize(words);
+				memcpy(s->Aligned.data(), bytes, words * 2);
+				s->Builder->append(s->Aligned.data(), words);
+			}
+			if (count % 2 != 0) {
+				s->OddByte = bytes[count - 1];
+				s->HasOddByte = true;
+			}
+			return result;
+		}
+
+		virtual void writeEORInfo(uint32_t BlockNr, uint64_t TriggerTime, uint64_t DataCntr, uint32_t Input, uint32_t Board, int GroupHandle = 0) override {
+			m_Api->writeEORInfo(BlockNr, TriggerTime, DataCntr, Input, Board, GroupHandle);
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			for (auto& it : m_Streamers) {
+				if (it.first.first != GroupHandle) continue;
+				sStreamer& s = *it.second;
+				std::lock_guard<std::mutex> stream(s.Mutex);
+				if (s.Block != BlockNr || s.Input != Input || s.Board != Board) continue;
+				if (s.Builder) s.Builder->finish();
+				// the streamer continues with the next block
+				s.Builder.reset();
+				s.HasOddByte = false;
+				s.Block++;
+			}
+		}
+
+		/// Finish the pyramids of the group of handle, of all groups for -1
+		virtual void closeFile(int handle = -1) override {
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				for (auto& it : m_Envelopes) {
+					if (handle == -1 || std::get<0>(it.first) == handle) it.second->finish();
+				}
+			}
+			m_Api->closeFile(handle);
+		}
+
+		/// <summary>
+		/// Store the finished pyramids in the sidecar of the written file (bdfEnvelopeFile::envelopeFileName).
+		/// Call after closeFile, once the DLL renamed the file to its final name; the sidecar is bound
+		/// to the stamp of that file.
+		/// </summary>
+		/// <param name="FileName">The written BDF file</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode saveEnvelopeFile(const std::string& FileName) const {
+			sFileStamp stamp;
+			if (!sFileStamp::get(FileName, stamp)) return errArgument;
+			std::vector<bdfEnvelopeFile::sPyramid> pyramids;
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				for (auto& it : m_Envelopes) {
+					if (!it.second->finished()) continue;
+					auto streamer = m_Streamers.find(std::make_pair(std::get<0>(it.first), std::get<1>(it.first)));
+					if (streamer == m_Streamers.end()) continue;
+					auto group = m_Groups.find(std::get<0>(it.first));
+					const uint32_t groupNr = group != m_Groups.end() ? group->second : (uint32_t)std::get<0>(it.first);
+					uint32_t board, input;
+					{
+						std::lock_guard<std::mutex> stream(streamer->second->Mutex);
+						board = streamer->second->Board;
+						input = streamer->second->Input;
+					}
+					pyramids.push_back(bdfEnvelopeFile::pyramid(*it.second, groupNr, board, input, std::get<2>(it.first)));
+				}
+			}
+			return bdfEnvelopeFile::save(bdfEnvelopeFile::envelopeFileName(FileName), stamp, pyramids);
+		}
+
+		/// <summary>
+		/// Get the envelope pyramid of a written block. The pyramid is complete after writeEORInfo or closeFile.
+		/// </summary>
+		/// <param name="StreamerHandle">from the initInputStreamer function</param>
+		/// <param name="BlockNr">Block number</param>
+		/// <param name="Handle">only used if more than 1 group present</param>
+		/// <returns>nullptr if no data was written to the block or the input has more than 16 bits</returns>
+		std::shared_ptr<const bdfEnvelopeBuilder> getEnvelope(int StreamerHandle, uint32_t BlockNr, int Handle = 0) const {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			auto it = m_Envelopes.find(std::make_tuple(Handle, StreamerHandle, BlockNr));
+			return it != m_Envelopes.end() ? it->second : nullptr;
+		}
+
+	private:
+		/// State of a streamer, guarded by its Mutex
+		struct sStreamer {
+			std::mutex Mutex;
+			uint32_t AnalogMask = 0xFFFF;
+			uint32_t Board = 0;
+			uint32_t Input = 0;
+			uint32_t Block = 0;
+			std::shared_ptr<bdfEnvelopeBuilder> Builder;
+			/// Copy of unaligned data
+			std::vector<uint16_t> Aligned;
+			unsigned char OddByte = 0;
+			bool HasOddByte = false;
+		};
+
+		/// Called with m_Mutex and the streamer locked, nullptr for inputs of more than 16 bits
+		std::shared_ptr<bdfEnvelopeBuilder> newBuilder(int Handle, int Streamer, const sStreamer& S) {
+			if (S.AnalogMask > 0xFFFF) return nullptr;
+			auto builder = std::make_shared<bdfEnvelopeBuilder>(m_ReductionFactor, m_NumberOfReductions, S.AnalogMask);
+			m_Envelopes[std::make_tuple(Handle, Streamer, S.Block)] = builder;
+			return builder;
+		}
+
+		const unsigned m_ReductionFactor;
+		const unsigned m_NumberOfReductions;
+		mutable std::mutex m_Mutex;
+		/// Group number of each writer handle
+		std::map<int, uint32_t> m_Groups;
+		std::map<std::tuple<int, uint32_t, uint32_t>, uint32_t> m_AnalogMasks;
+		std::map<std::pair<int, int>, std::shared_ptr<sStreamer>> m_Streamers;
+		std::map<std::tuple<int, int, uint32_t>, std::shared_ptr<bdfEnvelopeBuilder>> m_Envelopes;
+	};
+
+	/// <summary>
+	/// Reader which answers getEnv* from the envelope sidecar written by bdfEnvelopeWriter::saveEnvelopeFile.
+	/// loadFile loads the sidecar if its stamp matches the file. A request is answered from the pyramid
+	/// of its block when each segment spans at least two level 1 pairs: the aligned interior of a
+	/// segment comes from the coarsest fitting level, only the ragged edges below one level 1 pair are
+	/// read as raw samples, one short getRawDataS per segment boundary. The results equal those of the
+	/// DLL. Blocks without a pyramid, inputs of more than 16 bits and short segments are forwarded.
+	/// </summary>
+	class bdfEnvelopeReader : public bdfAPIDecorator {
+	public:
+		/// <summary>
+		/// Wrap a reader API object
+		/// </summary>
+		/// <param name="Api">API object used for reading</param>
+		explicit bdfEnvelopeReader(bdfAPI* Api) : bdfAPIDecorator(Api) {}
+
+		virtual int loadFile(const char* FileName) override {
+			m_Pyramids.clear();
+			int result = m_Api->loadFile(FileName);
+			if (result == -1) return result;
+			sFileStamp stamp;
+			std::vector<bdfEnvelopeFile::sPyramid> pyramids;
+			if (!sFileStamp::get(FileName, stamp) || bdfEnvelopeFile::load(bdfEnvelopeFile::envelopeFileName(FileName), stamp, pyramids) != errNoError) return result;
+
+			// the sidecar identifies inputs by board and input number, the reader by their index
+			for (bdfEnvelopeFile::sPyramid& p : pyramids) {
+				const unsigned nrOfInputs = m_Api->getNumberOfInputs(p.Group);
+				for (unsigned i = 0; i < nrOfInputs; i++) {
+					sInputInfo inputInfo;
+					sBlockInfo blockInfo;
+					if (m_Api->getInputInfo(p.Group, i, &inputInfo) != errNoError || inputInfo.BoardNumber != p.Board || inputInfo.InputNumber != p.Input) continue;
+					if (inputInfo.BytesPerSample > 2 || m_Api->getBlockInfo(p.Group, i, p.Block, &blockInfo) != errNoError || blockInfo.BlockLength != p.NumberOfSamples) break;
+					m_Pyramids[std::make_tuple((unsigned)p.Group, i, (unsigned)p.Block)] = std::move(p);
+					break;
+				}
+			}
+			return result;
+		}
+
+		virtual void closeFile(int handle = -1) override {
+			m_Pyramids.clear();
+			m_Api->closeFile(handle);
+		}
+
+		/// Number of blocks answered from the sidecar
+		size_t numberOfPyramids() const { return m_Pyramids.size(); }
+
+		virtual eErrorCode getEnvRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, uint16_t* Data, unsigned Count) override {
+			const bdfEnvelopeFile::sPyramid* p = pyramid(Group, Input, Block, Address, BlockSize, Count);
+			if (p == nullptr || Data == nullptr) return m_Api->getEnvRawDataS(Group, Input, Block, Address, BlockSize, Data, Count);
+			return envelope(*p, Group, Input, Block, Address, BlockSize, Data, Count, [](uint16_t v) { return v; });
+		}
+
+		virtual eErrorCode getEnvRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, int32_t* Data, unsigned Count) override {
+			const bdfEnvelopeFile::sPyramid* p = pyramid(Group, Input, Block, Address, BlockSize, Count);
+			if (p == nullptr || Data == nullptr) return m_Api->getEnvRawDataL(Group, Input, Block, Address, BlockSize, Data, Count);
+			return envelope(*p, Group, Input, Block, Address, BlockSize, Data, Count, [](uint16_t v) { return (int32_t)v; });
+		}
+
+		virtual eErrorCode getEnvDataF(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, float* Data, unsigned Count) override {
+			const bdfEnvelopeFile::sPyramid* p = pyramid(Group, Input, Block, Address, BlockSize, Count);
+			sInputInfo inputInfo;
+			if (p == nullptr || Data == nullptr || m_Api->getInputInfo(Group, Input, &inputInfo) != errNoError) return m_Api->getEnvDataF(Group, Input, Block, Address, BlockSize, Data, Count);
+			const eErrorCode err = envelope(*p, Group, Input, Block, Address, BlockSize, Data, Count, [&](uint16_t v) { return (float)(v * inputInfo.BinToVoltFactor + inputInfo.BinToVoltConstant); });
+			if (inputInfo.BinToVoltFactor < 0) swapPairs(Data, Count);
+			return err;
+		}
+
+		virtual eErrorCode getEnvDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, double* Data, unsigned Count) override {
+			const bdfEnvelopeFile::sPyramid* p = pyramid(Group, Input, Block, Address, BlockSize, Count);
+			sInputInfo inputInfo;
+			if (p == nullptr || Data == nullptr || m_Api->getInputInfo(Group, Input, &inputInfo) != errNoError) return m_Api->getEnvDataD(Group, Input, Block, Address, BlockSize, Data, Count);
+			const eErrorCode err = envelope(*p, Group, Input, Block, Address, BlockSize, Data, Count, [&](uint16_t v) { return v * inputInfo.BinToVoltFactor + inputInfo.BinToVoltConstant; });
+			if (inputInfo.BinToVoltFactor < 0) swapPairs(Data, Count);
+			return err;
+		}
+
+	private:
+		/// Pyramid that can answer a request, nullptr to forward it
+		const bdfEnvelopeFile::sPyramid* pyramid(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, unsigned Count) const {
+			auto it = m_Pyramids.find(std::make_tuple(Group, Input, Block));
+			if (it == m_Pyramids.end() || it->second.Levels.empty()) return nullptr;
+			const bdfEnvelopeFile::sPyramid& p = it->second;
+			const unsigned nrOfSegments = Count / 2;
+			if (nrOfSegments == 0 || Address > p.NumberOfSamples || BlockSize > p.NumberOfSamples - Address) return nullptr;
+			if (BlockSize / nrOfSegments < 2 * (uint64_t)p.ReductionFactor) return nullptr;
+			return &p;
+		}
+
+		template <typename T>
+		static void swapPairs(T* Data, unsigned Count) {
+			for (unsigned s = 0; s + 1 < Count; s += 2) std::swap(Data[s], Data[s + 1]);
+		}
+
+		/// Masked min/max of the samples [First, Last) of a pyramid block
+		struct sRange {
+			const bdfEnvelopeFile::sPyramid& Pyramid;
+			unsigned Group, Input, Block;
+			/// Raw samples of the last level 1 window read, a segment boundary is read once for both segments
+			std::vector<uint16_t> Window;
+			uint64_t WindowStart = UINT64_MAX;
+		};
+
+		eErrorCode rawMinMax(sRange& R, uint64_t First, uint64_t Last, uint16_t& Min, uint16_t& Max) {
+			const uint64_t factor = R.Pyramid.ReductionFactor;
+			while (First < Last) {
+				const uint64_t start = First / factor * factor;
+				if (start != R.WindowStart) {
+					const uint64_t count = std::min<uint64_t>(factor, R.Pyramid.NumberOfSamples - start);
+					R.Window.resize((size_t)count);
+					eErrorCode err = m_Api->getRawDataS(R.Group, R.Input, R.Block, start, R.Window.data(), (unsigned)count);
+					if (err != errNoError) return err;
+					R.WindowStart = start;
+				}
+				const uint64_t end = std::min(Last, start + R.Window.size());
+				for (uint64_t k = First; k < end; k++) {
+					const uint16_t v = (uint16_t)(R.Window[(size_t)(k - start)] & R.Pyramid.AnalogMask);
+					if (v < Min) Min = v;
+					if (v > Max) Max = v;
+				}
+				First = end;
+			}
+			return errNoError;
+		}
+
+		/// Aligned pairs of the coarsest fitting level, the edges from the finer levels and the raw samples
+		eErrorCode rangeMinMax(sRange& R, uint64_t First, uint64_t Last, unsigned Level, uint16_t& Min, uint16_t& Max) {
+			if (First >= Last) return errNoError;
+			if (Level == 0) return rawMinMax(R, First, Last, Min, Max);
+			uint64_t size = 1;
+			for (unsigned l = 0; l < Level; l++) size *= R.Pyramid.ReductionFactor;
+			const uint64_t first = (First + size - 1) / size * size;
+			// the last pair of a level covers the remaining samples of the block
+			const uint64_t last = Last == R.Pyramid.NumberOfSamples ? Last : Last / size * size;
+			if (first >= last) return rangeMinMax(R, First, Last, Level - 1, Min, Max);
+			const std::vector<uint16_t>& pairs = R.Pyramid.Levels[Level - 1];
+			const uint64_t lastPair = std::min<uint64_t>((last + size - 1) / size, pairs.size() / 2);
+			for (uint64_t k = first / size; k < lastPair; k++) {
+				if (pairs[(size_t)(2 * k)] < Min) Min = pairs[(size_t)(2 * k)];
+				if (pairs[(size_t)(2 * k + 1)] > Max) Max = pairs[(size_t)(2 * k + 1)];
+			}
+			eErrorCode err = rangeMinMax(R, First, first, Level - 1, Min, Max);
+			if (err != errNoError) return err;
+			return rangeMinMax(R, last, Last, Level - 1, Min, Max);
+		}
+
+		/// getEnv* segmentation: segment s covers [Address + s * BlockSize / n, Address + (s + 1) * BlockSize / n)
+		template <typename T, typename F>
+		eErrorCode envelope(const bdfEnvelopeFile::sPyramid& P, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, T* Data, unsigned Count, F Scale) {
+			sRange range{ P, Group, Input, Block, {}, UINT64_MAX };
+			const unsigned nrOfSegments = Count / 2;
+			for (unsigned s = 0; s < nrOfSegments; s++) {
+				const uint64_t first = Address + BlockSize * s / nrOfSegments;
+				const uint64_t last = Address + BlockSize * (s + 1) / nrOfSegments;
+				uint16_t mn = 0xFFFF, mx = 0;
+				eErrorCode err = rangeMinMax(range, first, last, (unsigned)P.Levels.size(), mn, mx);
+				if (err != errNoError) return err;
+				Data[2 * s] = Scale(mn);
+				Data[2 * s + 1] = Scale(mx);
+			}
+			return errNoError;
+		}
+
+		std::map<std::tuple<unsigned, unsigned, unsigned>, bdfEnvelopeFile::sPyramid> m_Pyramids;
+	};
+}
@@ -0,0 +1,527 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfDecorator.h"
+
+namespace filereader {
+	/// <summary>
+	/// Identifies one version of a file: size, modification time and a hash of the first and last 64 KiB.
+	/// </summary>
+	struct sFileStamp {
+		uint64_t Size;
+		int64_t ModifiedTime;
+		uint64_t Hash;
+
+		bool operator==(const sFileStamp& Other) const { return Size == Other.Size && ModifiedTime == Other.ModifiedTime && Hash == Other.Hash; }
+		bool operator!=(const sFileStamp& Other) const { return !(*this == Other); }
+
+		/// <summary>
+		/// Get the stamp of a file
+		/// </summary>
+		/// <returns>false if the file cannot be read</returns>
+		static bool get(const std::string& FileName, sFileStamp& Stamp) {
+			std::error_code ec;
+			const uint64_t size = std::filesystem::file_size(FileName, ec);
+			if (ec) return false;
+			const auto time = std::filesystem::last_write_time(FileName, ec);
+			if (ec) return false;
+
+			std::ifstream file(FileName, std::ios::binary);
+			if (!file) return false;
+			const uint64_t part = 64 * 1024;
+			std::vector<char> buffer((size_t)(size < 2 * part ? size : 2 * part));
+			if (size < 2 * part) {
+				file.read(buffer.data(), (std::streamsize)size);
+			}
+			else {
+				file.read(buffer.data(), (std::streamsize)part);
+				file.seekg((std::streamoff)(size - part));
+				file.read(buffer.data() + part, (std::streamsize)part);
+			}
+			if (!file) return false;
+
+			Stamp.Size = size;
+			Stamp.ModifiedTime = (int64_t)time.time_since_epoch().count();
+			Stamp.Hash = hash(buffer.data(), buffer.size());
+			return true;
+		}
+
+		/// FNV-1a hash
+		static uint64_t hash(const void* Data, size_t Size, uint64_t Hash = 14695981039346656037ull) {
+			const unsigned char* p = static_cast<const unsigned char*>(Data);
+			for (size_t n = 0; n < Size; n++) Hash = (Hash ^ p[n]) * 1099511628211ull;
+			return Hash;
+		}
+	};
+
+	/// <summary>
+	/// Compact binary index of the metadata of a BDF file: operation modes, input infos, channel
+	/// attributes and the block info of every group, input and block. The index is stored next to the
+	/// file (FileName + ".idx") and is valid as long as the stamp of the file is unchanged.
+	/// With a valid index, opening and listing a file with many thousands of blocks does not need loadFile.
+	/// </summary>
+	class bdfBlockIndex {
+	public:
+		/// Attribute keys stored in the index
+		static const std::vector<std::string>& attributeKeys() {
+			static const std::vector<std::string> keys = { "ChName", "ChPhysUnit", "ChPhysUnitExt", "MrkName1", "MrkName2" };
+			return keys;
+		}
+
+		struct sAttribute {
+			std::string Key;
+			std::string Value;
+		};
+
+		struct sInput {
+			bdfAPI::sInputInfo Info;
+			std::vector<sAttribute> Attributes;
+			std::vector<bdfAPI::sBlockInfo> Blocks;
+		};
+
+		struct sGroup {
+			bdfAPI::eOperationMode Mode;
+			std::vector<sInput> Inputs;
+		};
+
+		/// Index file name of a BDF file
+		static std::string indexFileName(const std::string& FileName) { return FileName + ".idx"; }
+
+		/// <summary>
+		/// Read the metadata of all groups, inputs and blocks from an API object with a loaded file
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode build(bdfAPI* Api) {
+			m_Groups.clear();
+			const unsigned nrOfGroups = Api->getNumberOfGroups();
+			m_Groups.resize(nrOfGroups);
+			for (unsigned g = 0; g < nrOfGroups; g++) {
+				sGroup& group = m_Groups[g];
+				bdfAPI::eErrorCode err = Api->getOperationMode(g, group.Mode);
+				if (err != bdfAPI::errNoError) return err;
+				group.Inputs.resize(Api->getNumberOfInputs(g));
+				for (unsigned i = 0; i < group.Inputs.size(); i++) {
+					sInput& input = group.Inputs[i];
+					err = Api->getInputInfo(g, i, &input.Info);
+					if (err != bdfAPI::errNoError) return err;
+					for (const std::string& key : attributeKeys()) {
+						char value[AttributeSize] = { 0 };
+						std::vector<char> k(key.begin(), key.end());
+						k.push_back(0);
+						if (Api->getAttribute(g, i, k.data(), value, AttributeSize) == bdfAPI::errNoError) {
+							value[AttributeSize - 1] = 0;
+							input.Attributes.push_back(sAttribute{ key, value });
+						}
+					}
+					input.Blocks.resize(Api->getNumberOfBlocks(g, i));
+					for (unsigned b = 0; b < input.Blocks.size(); b++) {
+						err = Api->getBlockInfo(g, i, b, &input.Blocks[b]);
+						if (err != bdfAPI::errNoError) return err;
+					}
+				}
+			}
+			return bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Write the index file
+		/// </summary>
+		/// <param name="IndexFileName"></param>
+		/// <param name="Stamp">Stamp of the indexed BDF file</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode save(const std::string& IndexFileName, const sFileStamp& Stamp) const {
+			std::string data;
+			data.append(Magic, sizeof(Magic));
+			put(data, Version);
+			put(data, Stamp.Size);
+			put(data, Stamp.ModifiedTime);
+			put(data, Stamp.Hash);
+			serialize(data);
+			put(data, sFileStamp::hash(data.data(), data.size()));
+
+			// write to a temporary file first, so a reader never sees a partial index
+			const std::string tmp = IndexFileName + ".tmp";
+			{
+				std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+				if (!file) return bdfAPI::errResource;
+				file.write(data.data(), (std::streamsize)data.size());
+				if (!file) return bdfAPI::errResource;
+			}
+			std::error_code ec;
+			std::filesystem::rename(tmp, IndexFileName, ec);
+			return ec ? bdfAPI::errResource : bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Read the index file
+		/// </summary>
+		/// <param name="IndexFileName"></param>
+		/// <param name="Stamp">Current stamp of the indexed BDF file</param>
+		/// <returns>errArgument if the index is missing, corrupt or does not match the stamp</returns>
+		bdfAPI::eErrorCode load(const std::string& IndexFileName, const sFileStamp& Stamp) {
+			m_Groups.clear();
+			std::ifstream file(IndexFileName, std::ios::binary);
+			if (!file) return bdfAPI::errArgument;
+			std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			if (data.size() < sizeof(Magic) + sizeof(uint64_t) || memcmp(data.data(), Magic, sizeof(Magic)) != 0) return bdfAPI::errArgument;
+			uint64_t checksum;
+			memcpy(&checksum, data.data() + data.size() - sizeof(checksum), sizeof(checksum));
+			if (checksum != sFileStamp::hash(data.data(), data.size() - sizeof(checksum))) return bdfAPI::errArgument;
+
+			size_t pos = sizeof(Magic);
+			uint32_t version;
+			sFileStamp stamp;
+			if (!get(data, pos, version) || version != Version) return bdfAPI::errArgument;
+			if (!get(data, pos, stamp.Size) || !get(data, pos, stamp.ModifiedTime) || !get(data, pos, stamp.Hash)) return bdfAPI::errArgument;
+			if (stamp != Stamp) return bdfAPI::errArgument;
+			return deserialize(data, pos);
+		}
+
+		/// <summary>
+		/// Append the metadata to a buffer, e.g. to embed it into another file
+		/// </summary>
+		void serialize(std::string& Data) const {
+			put(Data, (uint32_t)m_Groups.size());
+			for (const sGroup& group : m_Groups) {
+				put(Data, (uint32_t)group.Mode);
+				put(Data, (uint32_t)group.Inputs.size());
+				for (const sInput& input : group.Inputs) {
+					put(Data, input);
+				}
+			}
+		}
+
+		/// <summary>
+		/// Read the metadata written by serialize
+		/// </summary>
+		/// <param name="Data">Buffer ending with a 64-bit checksum</param>
+		/// <param name="Pos">Position of the metadata, moved behind it</param>
+		/// <returns>errArgument if the data is corrupt</returns>
+		bdfAPI::eErrorCode deserialize(const std::string& Data, size_t& Pos) {
+			m_Groups.clear();
+			uint32_t nrOfGroups;
+			if (!get(Data, Pos, nrOfGroups) || nrOfGroups > Data.size()) return bdfAPI::errArgument;
+			std::vector<sGroup> groups(nrOfGroups);
+			for (sGroup& group : groups) {
+				uint32_t mode, nrOfInputs;
+				if (!get(Data, Pos, mode) || !get(Data, Pos, nrOfInputs) || nrOfInputs > Data.size()) return bdfAPI::errArgument;
+				group.Mode = (bdfAPI::eOperationMode)mode;
+				group.Inputs.resize(nrOfInputs);
+				for (sInput& input : group.Inputs) {
+					if (!get(Data, Pos, input)) return bdfAPI::errArgument;
+				}
+			}
+			m_Groups.swap(groups);
+			return bdfAPI::errNoError;
+		}
+
+		/// The indexed groups
+		const std::vector<sGroup>& groups() const { return m_Groups; }
+
+		/// Input of the index, nullptr if it does not exist
+		const sInput* input(unsigned Group, unsigned Input) const {
+			if (Group >= m_Groups.size() || Input >= m_Groups[Group].Inputs.size()) return nullptr;
+			return &m_Groups[Group].Inputs[Input];
+		}
+
+	private:
+		static constexpr char Magic[8] = { 'B', 'D', 'F', 'I', 'D', 'X', 0, 0 };
+		static constexpr uint32_t Version = 1;
+		static constexpr unsigned AttributeSize = 256;
+
+		template <typename T>
+		static void put(std::string& Data, const T& Value) { Data.append(reinterpret_cast<const char*>(&Value), sizeof(T)); }
+
+		static void put(std::string& Data, const std::string& Value) {
+			put(Data, (uint32_t)Value.size());
+			Data.append(Value);
+		}
+
+		static void put(std::string& Data, const bdfAPI::sDateTime& Value) {
+			const unsigned fields[] = { Value.Year, Value.Month, Value.Day, Value.Hour, Value.Minute, Value.Second, Value.MilliSecond };
+			for (unsigned f : fields) put(Data, (uint32_t)f);
+		}
+
+		static void put(std::string& Data, const sInput& Input) {
+			const bdfAPI::sInputInfo& i = Input.Info;
+			const uint32_t words[] = { i.BytesPerSample, i.AnalogMask, i.MarkerMask, i.NumberOfMarkerBits, i.ResolutionInBits, i.BoardNumber, i.InputNumber };
+			for (uint32_t w : words) put(Data, w);
+			const double factors[] = { i.BinToVoltFactor, i.BinToVoltConstant, i.VoltToPhysicalFactor, i.VoltToPhysicalConstant, i.BinToPhysicalFactor, i.BinToPhysicalConstant };
+			for (double f : factors) put(Data, f);
+
+			put(Data, (uint32_t)Input.Attributes.size());
+			for (const sAttribute& a : Input.Attributes) {
+				put(Data, a.Key);
+				put(Data, a.Value);
+			}
+
+			put(Data, (uint32_t)Input.Blocks.size());
+			for (const bdfAPI::sBlockInfo& b : Input.Blocks) {
+				put(Data, (uint32_t)b.ReductionFactor);
+				put(Data, (uint32_t)b.NumberOfReductions);
+				put(Data, (uint32_t)b.PreferredTransferSize);
+				put(Data, b.BlockLength);
+				put(Data, (uint32_t)(b.ExternalTimebase ? 1 : 0));
+				put(Data, b.SampleRateHertz);
+				put(Data, (uint32_t)b.TimebaseDivisor);
+				put(Data, b.StartTime);
+				put(Data, b.TriggerTimeSeconds);
+				put(Data, b.TriggerSample);
+				put(Data, b.StopTriggerSample);
+			}
+		}
+
+		template <typename T>
+		static bool get(const std::string& Data, size_t& Pos, T& Value) {
+			if (Data.size() - sizeof(uint64_t) < Pos + sizeof(T)) return false;
+			memcpy(&Value, Data.data() + Pos, sizeof(T));
+			Pos += sizeof(T);
+			return true;
+		}
+
+		static bool get(const std::string& Data, size_t& Pos, std::string& Value) {
+			uint32_t size;
+			if (!get(Data, Pos, size) || Data.size() - sizeof(uint64_t) < Pos + size) return false;
+			Value.assign(Data.data() + Pos, size);
+			Pos += size;
+			return true;
+		}
+
+		static bool get(const std::string& Data, size_t& Pos, bdfAPI::sDateTime& Value) {
+			unsigned* fields[] = { &Value.Year, &Value.Month, &Value.Day, &Value.Hour, &Value.Minute, &Value.Second, &Value.MilliSecond };
+			for (unsigned* f : fields) {
+				uint32_t v;
+				if (!get(Data, Pos, v)) return false;
+				*f = v;
+			}
+			return true;
+		}
+
+		static bool get(const std::string& Data, size_t& Pos, sInput& Input) {
+			bdfAPI::sInputInfo& i = Input.Info;
+			unsigned* words[] = { &i.BytesPerSample, &i.AnalogMask, &i.MarkerMask, &i.NumberOfMarkerBits, &i.ResolutionInBits, &i.BoardNumber, &i.InputNumber };
+			for (unsigned* w : words) {
+				uint32_t v;
+				if (!get(Data, Pos, v)) return false;
+				*w = v;
+			}
+			double* factors[] = { &i.BinToVoltFactor, &i.BinToVoltConstant, &i.VoltToPhysicalFactor, &i.VoltToPhysicalConstant, &i.BinToPhysicalFactor, &i.BinToPhysicalConstant };
+			for (double* f : factors) {
+				if (!get(Data, Pos, *f)) return false;
+			}
+
+			uint32_t nrOfAttributes, nrOfBlocks;
+			if (!get(Data, Pos, nrOfAttributes) || nrOfAttributes > Data.size()) return false;
+			Input.Attributes.resize(nrOfAttributes);
+			for (sAttribute& a : Input.Attributes) {
+				if (!get(Data, Pos, a.Key) || !get(Data, Pos, a.Value)) return false;
+			}
+
+			if (!get(Data, Pos, nrOfBlocks) || nrOfBlocks > Data.size()) return false;
+			Input.Blocks.resize(nrOfBlocks);
+			for (bdfAPI::sBlockInfo& b : Input.Blocks) {
+				uint32_t reductionFactor, numberOfReductions, preferredTransferSize, externalTimebase, timebaseDivisor;
+				if (!get(Data, Pos, reductionFactor) || !get(Data, Pos, numberOfReductions) || !get(Data, Pos, preferredTransferSize)
+					|| !get(Data, Pos, b.BlockLength) || !get(Data, Pos, externalTimebase) || !get(Data, Pos, b.SampleRateHertz)
+					|| !get(Data, Pos, timebaseDivisor) || !get(Data, Pos, b.StartTime) || !get(Data, Pos, b.TriggerTimeSeconds)
+					|| !get(Data, Pos, b.TriggerSample) || !get(Data, Pos, b.StopTriggerSample)) return false;
+				b.ReductionFactor = reductionFactor;
+				b.NumberOfReductions = numberOfReductions;
+				b.PreferredTransferSize = preferredTransferSize;
+				b.ExternalTimebase = externalTimebase != 0;
+				b.TimebaseDivisor = timebaseDivisor;
+			}
+			return true;
+		}
+
+		std::vector<sGroup> m_Groups;
+	};
+
+	/// <summary>
+	/// Reader which answers all metadata queries from the block index.
+	///
+	/// In the default mode loadFile uses a valid index file and defers the loadFile of the wrapped API
+	/// object to the first data access. Without a valid index the file is loaded, the index is built
+	/// and stored next to the file for the next open.
+	/// In the lazy mode a missing index is not built and loadFile does not load the file either: the
+	/// wrapped object loads it on the first metadata query or data access, and no index file is written.
+	/// A file the wrapped object cannot open is then reported by that first access (errInvalidHandle).
+	/// </summary>
+	class bdfIndexedReader : public bdfAPIDecorator {
+	public:
+		/// Handling of a missing or outdated index
+		enum eIndexMode {
+			indexBuild, /// build and store the index
+			indexLazy /// query the metadata on demand, do not store an index
+		};
+
+		/// <summary>
+		/// Wrap a reader API object
+		/// </summary>
+		/// <param name="Api">API object used for reading</param>
+		/// <param name="Mode">Handling of a missing or outdated index</param>
+		bdfIndexedReader(bdfAPI* Api, eIndexMode Mode = indexBuild) : bdfAPIDecorator(Api), m_Mode(Mode) {}
+
+		/// <summary>
+		/// Build the index file of a BDF file, e.g. after the writer closed it
+		/// </summary>
+		/// <param name="Api">API object with the file loaded</param>
+		/// <param name="FileName">Name of the loaded file</param>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode buildIndex(bdfAPI* Api, const std::string& FileName) {
+			sFileStamp stamp;
+			if (!sFileStamp::get(FileName, stamp)) return errArgument;
+			bdfBlockIndex index;
+			eErrorCode err = index.build(Api);
+			if (err != errNoError) return err;
+			return index.save(bdfBlockIndex::indexFileName(FileName), stamp);
+		}
+
+		/// <summary>
+		/// Open a file, from its index file if valid. In the lazy mode the wrapped object loads the file
+		/// on the first access.
+		/// </summary>
+		/// <returns>-1 on error</returns>
+		virtual int loadFile(const char* FileName) override {
+			closeFile();
+			m_FileName = FileName;
+			sFileStamp stamp;
+			if (!sFileStamp::get(m_FileName, stamp)) return -1;
+			if (m_Index.load(bdfBlockIndex::indexFileName(m_FileName), stamp) == errNoError) {
+				m_Indexed = true;
+				return 0;
+			}
+			if (m_Mode == indexLazy) return 0;
+			if (!ensureLoaded()) return -1;
+			if (m_Mode == indexBuild && m_Index.build(m_Api) == errNoError) {
+				m_Indexed = true;
+				m_Index.save(bdfBlockIndex::indexFileName(m_FileName), stamp);
+			}
+			return 0;
+		}
+
+		virtual void closeFile(int handle = -1) override {
+			if (m_Loaded) m_Api->closeFile(handle);
+			m_Loaded = false;
+			m_Indexed = false;
+			m_Index = bdfBlockIndex();
+		}
+
+		/// True if the metadata is answered from the index
+		bool isIndexed() const { return m_Indexed; }
+		/// True if the file was loaded by the wrapped API object
+		bool isLoaded() const { return m_Loaded; }
+
+		virtual eErrorCode getAttribute(unsigned Group, unsigned Input, char* Key, char* Value, unsigned Size) override {
+			if (m_Indexed) {
+				const bdfBlockIndex::sInput* input = m_Index.input(Group, Input);
+				if (input == nullptr || Key == nullptr || Value == nullptr || Size == 0) return errArgument;
+				for (const bdfBlockIndex::sAttribute& a : input->Attributes) {
+					if (a.Key != Key) continue;
+					size_t n = a.Value.size() < Size - 1 ? a.Value.size() : Size - 1;
+					memcpy(Value, a.Value.data(), n);
+					Value[n] = 0;
+					return errNoError;
+				}
+				bool indexedKey = false;
+				for (const std::string& k : bdfBlockIndex::attributeKeys()) indexedKey |= k == Key;
+				if (indexedKey) return errArgument;
+			}
+			if (!ensureLoaded()) return errInvalidHandle;
+			return m_Api->getAttribute(Group, Input, Key, Value, Size);
+		}
+
+		virtual unsigned getNumberOfGroups() override {
+			if (m_Indexed) return (unsigned)m_Index.groups().size();
+			return ensureLoaded() ? m_Api->getNumberOfGroups() : 0;
+		}
+
+		virtual unsigned getNumberOfInputs(unsigned Group) override {
+			if (m_Indexed) return Group < m_Index.groups().size() ? (unsigned)m_Index.groups()[Group].Inputs.size() : 0;
+			return ensureLoaded() ? m_Api->getNumberOfInputs(Group) : 0;
+		}
+
+		virtual unsigned getNumberOfBlocks(unsigned Group, unsigned Input) override {
+			if (m_Indexed) {
+				const bdfBlockIndex::sInput* input = m_Index.input(Group, Input);
+				return input != nullptr ? (unsigned)input->Blocks.size() : 0;
+			}
+			return ensureLoaded() ? m_Api->getNumberOfBlocks(Group, Input) : 0;
+		}
+
+		virtual eErrorCode getInputInfo(unsigned Group, unsigned Input, sInputInfo* InputInfo) override {
+			if (m_Indexed) {
+				const bdfBlockIndex::sInput* input = m_Index.input(Group, Input);
+				if (input == nullptr || InputInfo == nullptr) return errArgument;
+				*InputInfo = input->Info;
+				return errNoError;
+			}
+			return ensureLoaded() ? m_Api->getInputInfo(Group, Input, InputInfo) : errInvalidHandle;
+		}
+
+		virtual eErrorCode getBlockInfo(unsigned Group, unsigned Input, unsigned Block, sBlockInfo* BlockInfo) override {
+			if (m_Indexed) {
+				const bdfBlockIndex::sInput* input = m_Index.input(Group, Input);
+				if (input == nullptr || Block >= input->Blocks.size() || BlockInfo == nullptr) return errArgument;
+				*BlockInfo = input->Blocks[Block];
+				return errNoError;
+			}
+			return ensureLoaded() ? m_Api->getBlockInfo(Group, Input, Block, BlockInfo) : errInvalidHandle;
+		}
+
+		virtual eErrorCode getOperationMode(unsigned Group, eOperationMode& Mode) override {
+			if (m_Indexed) {
+				if (Group >= m_Index.groups().size()) return errArgument;
+				Mode = m_Index.groups()[Group].Mode;
+				return errNoError;
+			}
+			return ensureLoaded() ? m_Api->getOperationMode(Group, Mode) : errInvalidHandle;
+		}
+
+		virtual eErrorCode getRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint16_t* Data, unsigned Count) override {
+			return ensureLoaded() ? m_Api->getRawDataS(Group, Input, Block, Address, Data, Count) : errInvalidHandle;
+		}
+		virtual eErrorCode getRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, int32_t* Data, unsigned Count) override {
+			return ensureLoaded() ? m_Api->getRawDataL(Group, Input, Block, Address, Data, Count) : errInvalidHandle;
+		}
+		virtual eErrorCode getDataF(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, float* Data, unsigned Count) override {
+			return ensureLoaded() ? m_Api->getDataF(Group, Input, Block, Address, Data, Count) : errInvalidHandle;
+		}
+		virtual eErrorCode getDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, double* Data, unsigned Count) override {
+			return ensureLoaded() ? m_Api->getDataD(Group, Input, Block, Address, Data, Count) : errInvalidHandle;
+		}
+		virtual eErrorCode getEnvRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, uint16_t* Data, unsigned Count) override {
+			return ensureLoaded() ? m_Api->getEnvRawDataS(Group, Input, Block, Address, BlockSize, Data, Count) : errInvalidHandle;
+		}
+		virtual eErrorCode getEnvRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, int32_t* Data, unsigned Count) override {
+			return ensureLoaded() ? m_Api->getEnvRawDataL(Group, Input, Block, Address, BlockSize, Data, Count) : errInvalidHandle;
+		}
+		virtual eErrorCode getEnvDataF(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, float* Data, unsigned Count) override {
+			return ensureLoaded() ? m_Api->getEnvDataF(Group, Input, Block, Address, BlockSize, Data, Count) : errInvalidHandle;
+		}
+		virtual eErrorCode getEnvDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, double* Data, unsigned Count) override {
+			return ensureLoaded() ? m_Api->getEnvDataD(Group, Input, Block, Address, BlockSize, Data, Count) : errInvalidHandle;
+		}
+
+	private:
+		/// Load the file into the wrapped API object on the first access
+		bool ensureLoaded() {
+			if (m_Loaded) return true;
+			if (m_FileName.empty() || m_Api->loadFile(m_FileName.c_str()) == -1) return false;
+			m_Loaded = true;
+			return true;
+		}
+
+		const eIndexMode m_Mode;
+		std::string m_FileName;
+		bdfBlockIndex m_Index;
+		bool m_Indexed = false;
+		bool m_Loaded = false;
+	};
+}
@@ -0,0 +1,346 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfDecorator.h"
+#include "bdfIndex.h"
+
+namespace filereader {
+	/// <summary>
+	/// Writer option which lets readers in the same process follow a recording while it is written.
+	/// Wrap the writer API object and use this object for all writer calls. Every successful writeData
+	/// is appended to a ring of the most recent bytes of its streamer, and every writeData and writeEORInfo
+	/// advances a sequence number. Readers wait for the sequence number to change and then read the new
+	/// bytes by their offset in the stream, without touching the file.
+	///
+	/// Stream offsets are monotonic per streamer: calling initInputStreamer again for an existing streamer
+	/// starts a new block at the current offset and keeps the ring, so offsets held by readers stay valid.
+	///
+	/// The file stays a *.tmp file without a valid header until closeFile, so other processes can not read
+	/// its samples. They can follow the progress through a progress file (\ref setProgressFile), which is
+	/// replaced atomically after every initInputStreamer, writeEORInfo and closeFile, and by writeData at
+	/// most once per publish interval. It is read with \ref readProgressFile.
+	/// </summary>
+	class bdfLiveTap : public bdfAPIDecorator {
+	public:
+		/// Progress of one streamer
+		struct sLiveProgress {
+			uint32_t Block; /// Block currently written
+			uint32_t BlocksCompleted; /// Blocks finished by writeEORInfo
+			uint64_t BlockStartOffset; /// Stream offset of the first byte of the current block
+			uint64_t TotalBytes; /// Bytes written by the streamer, the stream offset of the next byte
+			uint64_t FirstRetained; /// Oldest stream offset still in the ring
+		};
+
+		/// Progress of one streamer in a progress file
+		struct sLiveStreamer {
+			int Handle;
+			int Streamer;
+			uint32_t Board;
+			uint32_t Input;
+			sLiveProgress Progress;
+		};
+
+		/// Content of a progress file
+		struct sLiveSnapshot {
+			uint64_t Sequence = 0;
+			bool Closed = false;
+			std::vector<sLiveStreamer> Streamers;
+		};
+
+		/// Progress file name of a recording
+		static std::string progressFileName(const std::string& FileName) { return FileName + ".live"; }
+
+		/// <summary>
+		/// Wrap a writer API object
+		/// </summary>
+		/// <param name="Api">API object used for writing</param>
+		/// <param name="HistoryBytes">Ring size per streamer</param>
+		bdfLiveTap(bdfAPI* Api, size_t HistoryBytes = 4 * 1024 * 1024) : bdfAPIDecorator(Api), m_HistoryBytes(HistoryBytes > 0 ? HistoryBytes : 1) {}
+
+		virtual int initInputStreamer(uint32_t BoardNumber, uint32_t InputNumber, uint32_t BlockNr, int Handle = 0) override {
+			int streamer = m_Api->initInputStreamer(BoardNumber, InputNumber, BlockNr, Handle);
+			if (streamer < 0) return streamer;
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				sStreamer& s = m_Streamers[std::make_pair(Handle, streamer)];
+				// a known streamer continues at its current offset, the ring keeps its history
+				if (s.Ring.empty()) s.Ring.assign(m_HistoryBytes, 0);
+				s.Board = BoardNumber;
+				s.Input = InputNumber;
+				s.Progress.Block = BlockNr;
+				s.Progress.BlockStartOffset = s.Progress.TotalBytes;
+				m_Sequence++;
+			}
+			m_Update.notify_all();
+			writeProgressFile();
+			return streamer;
+		}
+
+		virtual int writeData(int StreamerHandle, char* Data, unsigned int count, int Handle = 0) override {
+			int result = m_Api->writeData(StreamerHandle, Data, count, Handle);
+			if (result != errNoError || count == 0) return result;
+			bool publish = false;
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				auto it = m_Streamers.find(std::make_pair(Handle, StreamerHandle));
+				if (it == m_Streamers.end()) return result;
+				sStreamer& s = it->second;
+				// only the last ring size bytes of a large write are kept
+				const size_t keep = count < m_HistoryBytes ? count : m_HistoryBytes;
+				const char* src = Data + (count - keep);
+				size_t pos = (size_t)((s.Progress.TotalBytes + count - keep) % m_HistoryBytes);
+				size_t first = m_HistoryBytes - pos < keep ? m_HistoryBytes - pos : keep;
+				memcpy(s.Ring.data() + pos, src, first);
+				memcpy(s.Ring.data(), src + first, keep - first);
+				s.Progress.TotalBytes += count;
+				if (s.Progress.TotalBytes > m_HistoryBytes) s.Progress.FirstRetained = s.Progress.TotalBytes - m_HistoryBytes;
+				m_Sequence++;
+				if (m_Publishing) {
+					const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+					publish = now >= m_NextPublish;
+					if (publish) m_NextPublish = now + m_PublishInterval;
+				}
+			}
+			m_Update.notify_all();
+			if (publish) writeProgressFile();
+			return result;
+		}
+
+		virtual void writeEORInfo(uint32_t BlockNr, uint64_t TriggerTime, uint64_t DataCntr, uint32_t Input, uint32_t Board, int GroupHandle = 0) override {
+			m_Api->writeEORInfo(BlockNr, TriggerTime, DataCntr, Input, Board, GroupHandle);
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				for (auto& it : m_Streamers) {
+					sStreamer& s = it.second;
+					sLiveProgress& p = s.Progress;
+					if (it.first.first != GroupHandle || p.Block != BlockNr || s.Input != Input || s.Board != Board) continue;
+					// the streamer continues with the next block
+					p.Block++;
+					p.BlocksCompleted++;
+					p.BlockStartOffset = p.TotalBytes;
+				}
+				m_Sequence++;
+			}
+			m_Update.notify_all();
+			writeProgressFile();
+		}
+
+		virtual void closeFile(int handle = -1) override {
+			m_Api->closeFile(handle);
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Closed = true;
+				m_Sequence++;
+			}
+			m_Update.notify_all();
+			writeProgressFile();
+		}
+
+		/// <summary>
+		/// Publish the progress of all streamers for other processes, e.g. next to the recording
+		/// (\ref progressFileName). The file is written after every initInputStreamer, writeEORInfo and
+		/// closeFile, and by writeData when the publish interval has passed since the last writeData publish.
+		/// </summary>
+		/// <param name="ProgressFileName">Progress file, empty to stop publishing</param>
+		/// <param name="IntervalMilliseconds">Minimum time between two publishes by writeData, 0 to publish every writeData</param>
+		/// <returns>eErrorCode of the first write</returns>
+		bdfAPI::eErrorCode setProgressFile(const std::string& ProgressFileName, unsigned IntervalMilliseconds = 100) {
+			{
+				std::lock_guard<std::mutex> file(m_FileMutex);
+				m_ProgressFileName = ProgressFileName;
+				m_FileSequence = 0;
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Publishing = !ProgressFileName.empty();
+				m_PublishInterval = std::chrono::milliseconds(IntervalMilliseconds);
+				m_NextPublish = std::chrono::steady_clock::now() + m_PublishInterval;
+			}
+			return ProgressFileName.empty() ? bdfAPI::errNoError : writeProgressFile();
+		}
+
+		/// <summary>
+		/// Read a progress file written by another process
+		/// </summary>
+		/// <param name="ProgressFileName"></param>
+		/// <param name="Snapshot">Receives the progress</param>
+		/// <returns>errArgument if the file is missing or corrupt</returns>
+		static bdfAPI::eErrorCode readProgressFile(const std::string& ProgressFileName, sLiveSnapshot& Snapshot) {
+			std::ifstream file(ProgressFileName, std::ios::binary);
+			if (!file) return bdfAPI::errArgument;
+			std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			if (data.size() < sizeof(Magic) + sizeof(uint64_t) || memcmp(data.data(), Magic, sizeof(Magic)) != 0) return bdfAPI::errArgument;
+			uint64_t checksum;
+			memcpy(&checksum, data.data() + data.size() - sizeof(checksum), sizeof(checksum));
+			if (checksum != sFileStamp::hash(data.data(), data.size() - sizeof(checksum))) return bdfAPI::errArgument;
+
+			size_t pos = sizeof(Magic);
+			uint64_t sequence;
+			uint32_t closed, count;
+			if (!get(data, pos, sequence) || !get(data, pos, closed) || !get(data, pos, count) || count > data.size()) return bdfAPI::errArgument;
+			std::vector<sLiveStreamer> streamers(count);
+			for (sLiveStreamer& s : streamers) {
+				sLiveProgress& p = s.Progress;
+				if (!get(data, pos, s.Handle) || !get(data, pos, s.Streamer) || !get(data, pos, s.Board) || !get(data, pos, s.Input)
+					|| !get(data, pos, p.Block) || !get(data, pos, p.BlocksCompleted) || !get(data, pos, p.BlockStartOffset)
+					|| !get(data, pos, p.TotalBytes) || !get(data, pos, p.FirstRetained)) return bdfAPI::errArgument;
+			}
+			if (pos != data.size() - sizeof(checksum)) return bdfAPI::errArgument;
+			Snapshot.Sequence = sequence;
+			Snapshot.Closed = closed != 0;
+			Snapshot.Streamers.swap(streamers);
+			return bdfAPI::errNoError;
+		}
+
+		/// Sequence number, changes with every writeData, writeEORInfo and closeFile
+		uint64_t sequence() const {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			return m_Sequence;
+		}
+
+		/// True after closeFile
+		bool closed() const {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			return m_Closed;
+		}
+
+		/// <summary>
+		/// Wait until the sequence number differs from a known one
+		/// </summary>
+		/// <param name="Sequence">Sequence number seen by the reader</param>
+		/// <param name="TimeoutMilliseconds">Maximum wait time</param>
+		/// <returns>Current sequence number, equal to Sequence on timeout</returns>
+		uint64_t waitForUpdate(uint64_t Sequence, unsigned TimeoutMilliseconds) const {
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Update.wait_for(lock, std::chrono::milliseconds(TimeoutMilliseconds), [&] { return m_Sequence != Sequence; });
+			return m_Sequence;
+		}
+
+		/// <summary>
+		/// Get the progress of a streamer
+		/// </summary>
+		/// <param name="StreamerHandle">from the initInputStreamer function</param>
+		/// <param name="Handle">only used if more than 1 group present</param>
+		/// <returns>false if the streamer does not exist</returns>
+		bool getProgress(int StreamerHandle, sLiveProgress& Progress, int Handle = 0) const {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			auto it = m_Streamers.find(std::make_pair(Handle, StreamerHandle));
+			if (it == m_Streamers.end()) return false;
+			Progress = it->second.Progress;
+			return true;
+		}
+
+		/// <summary>
+		/// Copy written bytes of a streamer from the ring
+		/// </summary>
+		/// <param name="StreamerHandle">from the initInputStreamer function</param>
+		/// <param name="Offset">Stream offset of the first byte, not older than sLiveProgress::FirstRetained</param>
+		/// <param name="Data">Destination</param>
+		/// <param name="Size">Maximum number of bytes</param>
+		/// <param name="Handle">only used if more than 1 group present</param>
+		/// <returns>Number of bytes copied, 0 if the offset is no longer retained or not yet written</returns>
+		size_t read(int StreamerHandle, uint64_t Offset, char* Data, size_t Size, int Handle = 0) const {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			auto it = m_Streamers.find(std::make_pair(Handle, StreamerHandle));
+			if (it == m_Streamers.end()) return 0;
+			const sStreamer& s = it->second;
+			if (Offset < s.Progress.FirstRetained || Offset >= s.Progress.TotalBytes) return 0;
+			const uint64_t available = s.Progress.TotalBytes - Offset;
+			const size_t count = available < Size ? (size_t)available : Size;
+			const size_t pos = (size_t)(Offset % m_HistoryBytes);
+			const size_t first = m_HistoryBytes - pos < count ? m_HistoryBytes - pos : count;
+			memcpy(Data, s.Ring.data() + pos, first);
+			memcpy(Data + first, s.Ring.data(), count - first);
+			return count;
+		}
+
+	private:
+		struct sStreamer {
+			uint32_t Board = 0;
+			uint32_t Input = 0;
+			sLiveProgress Progress = {};
+			std::vector<char> Ring;
+		};
+
+		static constexpr char Magic[8] = { 'B', 'D', 'F', 'L', 'I', 'V', 'E', '2' };
+
+		template <typename T>
+		static void put(std::string& Data, const T& Value) { Data.append(reinterpret_cast<const char*>(&Value), sizeof(T)); }
+
+		template <typename T>
+		static bool get(const std::string& Data, size_t& Pos, T& Value) {
+			if (Data.size() - sizeof(uint64_t) < Pos + sizeof(T)) return false;
+			memcpy(&Value, Data.data() + Pos, sizeof(T));
+			Pos += sizeof(T);
+			return true;
+		}
+
+		/// Replace the progress file with the current progress, older snapshots never overwrite newer ones
+		bdfAPI::eErrorCode writeProgressFile() {
+			std::lock_guard<std::mutex> file(m_FileMutex);
+			if (m_ProgressFileName.empty()) return bdfAPI::errNoError;
+			std::string data(Magic, sizeof(Magic));
+			uint64_t sequence;
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				sequence = m_Sequence;
+				put(data, sequence);
+				put(data, (uint32_t)(m_Closed ? 1 : 0));
+				put(data, (uint32_t)m_Streamers.size());
+				// field by field, the file does not depend on the padding of sLiveStreamer
+				for (auto& it : m_Streamers) {
+					const sLiveProgress& p = it.second.Progress;
+					put(data, (int32_t)it.first.first);
+					put(data, (int32_t)it.first.second);
+					put(data, it.second.Board);
+					put(data, it.second.Input);
+					put(data, p.Block);
+					put(data, p.BlocksCompleted);
+					put(data, p.BlockStartOffset);
+					put(data, p.TotalBytes);
+					put(data, p.FirstRetained);
+				}
+			}
+			if (m_FileSequence != 0 && sequence <= m_FileSequence) return bdfAPI::errNoError;
+			put(data, sFileStamp::hash(data.data(), data.size()));
+
+			// write to a temporary file first, so a reader never sees a partial progress file
+			const std::string tmp = m_ProgressFileName + ".tmp";
+			{
+				std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+				if (!out) return bdfAPI::errResource;
+				out.write(data.data(), (std::streamsize)data.size());
+				if (!out) return bdfAPI::errResource;
+			}
+			std::error_code ec;
+			std::filesystem::rename(tmp, m_ProgressFileName, ec);
+			if (ec) return bdfAPI::errResource;
+			m_FileSequence = sequence;
+			return bdfAPI::errNoError;
+		}
+
+		const size_t m_HistoryBytes;
+		mutable std::mutex m_Mutex;
+		mutable std::condition_variable m_Update;
+		std::map<std::pair<int, int>, sStreamer> m_Streamers;
+		uint64_t m_Sequence = 0;
+		bool m_Closed = false;
+		/// Publishing of the progress file by writeData, guarded by m_Mutex
+		bool m_Publishing = false;
+		std::chrono::steady_clock::duration m_PublishInterval{};
+		std::chrono::steady_clock::time_point m_NextPublish;
+		/// Progress file, guarded by m_FileMutex which is taken before m_Mutex
+		std::mutex m_FileMutex;
+		std::string m_ProgressFileName;
+		uint64_t m_FileSequence = 0;
+	};
+}
@@ -0,0 +1,325 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <new>
+#include <tuple>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfConvert.h"
+
+namespace filereader {
+	/// <summary>
+	/// Marker bits of raw samples. A marker is one bit of MarkerMask, marker 0 is the lowest set bit
+	/// (MrkName1), marker 1 the next one (MrkName2) and so on.
+	///
+	/// extractBits packs one bit of every sample into a bitset, sample k at bit (k % 64) of word k / 64,
+	/// with SIMD kernels selected like the bdfConvert kernels.
+	/// bdfMarkerIndex builds the list of marker edges of a block once and answers edge queries by binary search.
+	/// </summary>
+	class bdfMarker {
+	public:
+		/// <summary>
+		/// Get the bit position of a marker in the raw word
+		/// </summary>
+		/// <param name="MarkerMask">MarkerMask of the input</param>
+		/// <param name="Marker">Marker number, from 0</param>
+		/// <returns>Bit position, or -1 if the mask has not enough marker bits</returns>
+		static int markerBit(uint32_t MarkerMask, unsigned Marker) {
+			for (int bit = 0; bit < 32; bit++) {
+				if ((MarkerMask & (1u << bit)) == 0) continue;
+				if (Marker == 0) return bit;
+				Marker--;
+			}
+			return -1;
+		}
+
+		/// <summary>
+		/// Pack one bit of every raw word into a bitset
+		/// </summary>
+		/// <param name="Src">Raw words</param>
+		/// <param name="Count">Number of samples</param>
+		/// <param name="Bit">Bit position in the raw word, 0..15</param>
+		/// <param name="Bits">Destination, (Count + 63) / 64 words, unused bits of the last word are cleared</param>
+		/// <param name="Isa">Kernel to use</param>
+		static void extractBits(const uint16_t* Src, size_t Count, unsigned Bit, uint64_t* Bits, bdfConvert::eInstructionSet Isa = bdfConvert::isaBest) {
+			if (Isa == bdfConvert::isaBest || Isa > bdfConvert::instructionSet()) Isa = bdfConvert::instructionSet();
+			size_t done = 0;
+			switch (Isa) {
+#ifdef BDF_CONVERT_X86
+			case bdfConvert::isaAVX512:
+			case bdfConvert::isaAVX2: done = extractBits_AVX2(Src, Count, Bit, Bits); break;
+			case bdfConvert::isaSSE2: done = extractBits_SSE2(Src, Count, Bit, Bits); break;
+#endif
+			default: break;
+			}
+			extractBitsScalar(Src + done, Count - done, Bit, Bits + done / 64);
+		}
+
+		/// <summary>
+		/// Pack one bit of every 32-bit raw value into a bitset
+		/// </summary>
+		/// <param name="Bit">Bit position in the raw value, 0..31</param>
+		static void extractBits(const int32_t* Src, size_t Count, unsigned Bit, uint64_t* Bits) {
+			extractBitsScalar(Src, Count, Bit, Bits);
+		}
+
+		/// Number of the lowest set bit, Value must not be 0
+		static unsigned lowestBit(uint64_t Value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+			unsigned long index;
+			_BitScanForward64(&index, Value);
+			return (unsigned)index;
+#elif defined(__GNUC__)
+			return (unsigned)__builtin_ctzll(Value);
+#else
+			unsigned index = 0;
+			while ((Value & 1) == 0) {
+				Value >>= 1;
+				index++;
+			}
+			return index;
+#endif
+		}
+
+	private:
+		template <typename T>
+		static void extractBitsScalar(const T* Src, size_t Count, unsigned Bit, uint64_t* Bits) {
+			for (size_t w = 0; w * 64 < Count; w++) {
+				const size_t n = Count - w * 64 < 64 ? Count - w * 64 : 64;
+				uint64_t word = 0;
+				for (size_t k = 0; k < n; k++) word |= (uint64_t)((Src[w * 64 + k] >> Bit) & 1) << k;
+				Bits[w] = word;
+			}
+		}
+
+#ifdef BDF_CONVERT_X86
+		BDF_TARGET_SSE2 static size_t extractBits_SSE2(const uint16_t* Src, size_t Count, unsigned Bit, uint64_t* Bits) {
+			// the bit is shifted to the sign bit, packed to bytes with signed saturation and collected by movemask
+			const __m128i shift = _mm_cvtsi32_si128((int)(15 - Bit));
+			size_t k = 0;
+			for (; k + 64 <= Count; k += 64) {
+				uint64_t word = 0;
+				for (int part = 0; part < 4; part++) {
+					const __m128i* p = reinterpret_cast<const __m128i*>(Src + k + part * 16);
+					__m128i a = _mm_sll_epi16(_mm_loadu_si128(p), shift);
+					__m128i b = _mm_sll_epi16(_mm_loadu_si128(p + 1), shift);
+					word |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_packs_epi16(a, b)) << (part * 16);
+				}
+				Bits[k / 64] = word;
+			}
+			return k;
+		}
+
+		BDF_TARGET_AVX2 static size_t extractBits_AVX2(const uint16_t* Src, size_t Count, unsigned Bit, uint64_t* Bits) {
+			const __m128i shift = _mm_cvtsi32_si128((int)(15 - Bit));
+			size_t k = 0;
+			for (; k + 64 <= Count; k += 64) {
+				uint64_t word = 0;
+				for (int part = 0; part < 2; part++) {
+					const __m256i* p = reinterpret_cast<const __m256i*>(Src + k + part * 32);
+					__m256i a = _mm256_sll_epi16(_mm256_loadu_si256(p), shift);
+					__m256i b = _mm256_sll_epi16(_mm256_loadu_si256(p + 1), shift);
+					// packs works per 128-bit lane, the permute restores the sample order
+					__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8);
+					word |= (uint64_t)(uint32_t)_mm256_movemask_epi8(packed) << (part * 32);
+				}
+				Bits[k / 64] = word;
+			}
+			return k;
+		}
+#endif
+	};
+
+	/// <summary>
+	/// Cached marker edges of blocks. An edge is a sample index k where the marker bit differs from sample k - 1.
+	/// The edges of all markers of a block are found in one pass over the block on the first query
+	/// and kept until closeFile. Like the API object, the index must not be used by several threads at the same time.
+	/// </summary>
+	class bdfMarkerIndex {
+	public:
+		/// Edges of one marker of a block
+		struct sMarkerEdges {
+			bool InitialLevel; /// Marker bit of sample 0
+			std::vector<uint64_t> Edges; /// Sample indices of the edges, ascending
+		};
+
+		/// <summary>
+		/// Create an index reading through an API object
+		/// </summary>
+		/// <param name="Api">API object with a loaded file</param>
+		explicit bdfMarkerIndex(bdfAPI* Api) : m_Api(Api) {}
+
+		/// <summary>
+		/// Read the packed marker bits of a sample range
+		/// </summary>
+		/// <param name="Marker">Marker number, from 0</param>
+		/// <param name="Bits">Receives (Count + 63) / 64 words, sample Address + k at bit (k % 64) of word k / 64</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getMarkerBits(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, unsigned Count, unsigned Marker, std::vector<uint64_t>& Bits) {
+			bdfAPI::sInputInfo inputInfo;
+			bdfAPI::eErrorCode err = m_Api->getInputInfo(Group, Input, &inputInfo);
+			if (err != bdfAPI::errNoError) return err;
+			const int bit = bdfMarker::markerBit(inputInfo.MarkerMask, Marker);
+			if (bit < 0) return bdfAPI::errArgument;
+			try {
+				Bits.resize(((size_t)Count + 63) / 64);
+				return read(inputInfo, Group, Input, Block, Address, Count, [&](const auto* Raw, size_t Offset, size_t N) {
+					// chunks start at multiples of 64 samples
+					bdfMarker::extractBits(Raw, N, (unsigned)bit, Bits.data() + Offset / 64);
+				});
+			}
+			catch (const std::bad_alloc&) {
+				return bdfAPI::errResource;
+			}
+		}
+
+		/// <summary>
+		/// Get the edges of a marker of a block, built on the first call
+		/// </summary>
+		/// <param name="Marker">Marker number, from 0</param>
+		/// <param name="Edges">Receives a pointer to the edges, valid until closeFile</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getEdges(unsigned Group, unsigned Input, unsigned Block, unsigned Marker, const sMarkerEdges** Edges) {
+			const std::vector<sMarkerEdges>* markers;
+			bdfAPI::eErrorCode err = getBlock(Group, Input, Block, &markers);
+			if (err != bdfAPI::errNoError) return err;
+			if (Marker >= markers->size() || Edges == nullptr) return bdfAPI::errArgument;
+			*Edges = &(*markers)[Marker];
+			return bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Find the first edge of a marker at or after a sample index
+		/// </summary>
+		/// <param name="Marker">Marker number, from 0</param>
+		/// <param name="From">First sample index to consider</param>
+		/// <param name="Edge">Receives the sample index of the edge, or the block length if there is no further edge</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode nextEdge(unsigned Group, unsigned Input, unsigned Block, unsigned Marker, uint64_t From, uint64_t& Edge) {
+			const sMarkerEdges* edges;
+			bdfAPI::eErrorCode err = getEdges(Group, Input, Block, Marker, &edges);
+			if (err != bdfAPI::errNoError) return err;
+			auto it = std::lower_bound(edges->Edges.begin(), edges->Edges.end(), From);
+			Edge = it != edges->Edges.end() ? *it : m_Lengths[std::make_tuple(Group, Input, Block)];
+			return bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Get the marker bit of a sample from the edges, without reading samples
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getLevel(unsigned Group, unsigned Input, unsigned Block, unsigned Marker, uint64_t Address, bool& Level) {
+			const sMarkerEdges* edges;
+			bdfAPI::eErrorCode err = getEdges(Group, Input, Block, Marker, &edges);
+			if (err != bdfAPI::errNoError) return err;
+			// every edge up to and including Address toggles the level
+			size_t toggles = std::upper_bound(edges->Edges.begin(), edges->Edges.end(), Address) - edges->Edges.begin();
+			Level = edges->InitialLevel != (toggles % 2 != 0);
+			return bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Drop all cached edges, call before the file of the API object is closed or changed
+		/// </summary>
+		void closeFile() {
+			m_Blocks.clear();
+			m_Lengths.clear();
+		}
+
+	private:
+		typedef std::tuple<unsigned, unsigned, unsigned> tKey;
+
+		bdfAPI::eErrorCode getBlock(unsigned Group, unsigned Input, unsigned Block, const std::vector<sMarkerEdges>** Markers) {
+			const tKey key = std::make_tuple(Group, Input, Block);
+			auto it = m_Blocks.find(key);
+			if (it != m_Blocks.end()) {
+				*Markers = &it->second;
+				return bdfAPI::errNoError;
+			}
+
+			bdfAPI::sInputInfo inputInfo;
+			bdfAPI::eErrorCode err = m_Api->getInputInfo(Group, Input, &inputInfo);
+			if (err != bdfAPI::errNoError) return err;
+			bdfAPI::sBlockInfo blockInfo;
+			err = m_Api->getBlockInfo(Group, Input, Block, &blockInfo);
+			if (err != bdfAPI::errNoError) return err;
+
+			std::vector<int> bits;
+			for (unsigned m = 0; bdfMarker::markerBit(inputInfo.MarkerMask, m) >= 0; m++) bits.push_back(bdfMarker::markerBit(inputInfo.MarkerMask, m));
+			std::vector<sMarkerEdges> markers(bits.size(), sMarkerEdges{ false, {} });
+			std::vector<uint64_t> chunkBits;
+			bool previous[32] = { false };
+			try {
+				err = read(inputInfo, Group, Input, Block, 0, blockInfo.BlockLength, [&](const auto* Raw, size_t Offset, size_t N) {
+					chunkBits.resize((N + 63) / 64);
+					for (size_t m = 0; m < bits.size(); m++) {
+						bdfMarker::extractBits(Raw, N, (unsigned)bits[m], chunkBits.data());
+						if (Offset == 0) markers[m].InitialLevel = previous[m] = (chunkBits[0] & 1) != 0;
+						addEdges(chunkBits, N, Offset, previous[m], markers[m].Edges);
+					}
+				});
+			}
+			catch (const std::bad_alloc&) {
+				return bdfAPI::errResource;
+			}
+			if (err != bdfAPI::errNoError) return err;
+
+			m_Lengths[key] = blockInfo.BlockLength;
+			*Markers = &(m_Blocks[key] = std::move(markers));
+			return bdfAPI::errNoError;
+		}
+
+		/// Append the edges of a bitset of N samples starting at sample Offset
+		static void addEdges(const std::vector<uint64_t>& Bits, size_t N, uint64_t Offset, bool& Previous, std::vector<uint64_t>& Edges) {
+			for (size_t w = 0; w * 64 < N; w++) {
+				uint64_t word = Bits[w];
+				// each bit is compared with the bit of the previous sample
+				uint64_t diff = word ^ ((word << 1) | (Previous ? 1 : 0));
+				const size_t valid = N - w * 64;
+				if (valid < 64) diff &= (1ull << valid) - 1;
+				Previous = ((word >> (valid < 64 ? valid - 1 : 63)) & 1) != 0;
+				while (diff != 0) {
+					Edges.push_back(Offset + w * 64 + bdfMarker::lowestBit(diff));
+					diff &= diff - 1;
+				}
+			}
+		}
+
+		/// Read a sample range in chunks of PreferredTransferSize samples (a multiple of 64) and pass the raw words to Sink
+		template <typename F>
+		bdfAPI::eErrorCode read(const bdfAPI::sInputInfo& InputInfo, unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t Count, F Sink) {
+			bdfAPI::sBlockInfo blockInfo;
+			bdfAPI::eErrorCode err = m_Api->getBlockInfo(Group, Input, Block, &blockInfo);
+			if (err != bdfAPI::errNoError) return err;
+			uint64_t chunk = blockInfo.PreferredTransferSize > 0 ? blockInfo.PreferredTransferSize : DefaultTransferSize;
+			chunk = chunk < 64 ? 64 : chunk / 64 * 64;
+			if (chunk > Count) chunk = Count;
+
+			for (uint64_t pos = 0; pos < Count; pos += chunk) {
+				const unsigned n = (unsigned)(Count - pos < chunk ? Count - pos : chunk);
+				if (InputInfo.BytesPerSample <= 2) {
+					m_DataS.resize(n);
+					err = m_Api->getRawDataS(Group, Input, Block, Address + pos, m_DataS.data(), n);
+					if (err != bdfAPI::errNoError) return err;
+					Sink(m_DataS.data(), (size_t)pos, (size_t)n);
+				}
+				else {
+					m_DataL.resize(n);
+					err = m_Api->getRawDataL(Group, Input, Block, Address + pos, m_DataL.data(), n);
+					if (err != bdfAPI::errNoError) return err;
+					Sink(m_DataL.data(), (size_t)pos, (size_t)n);
+				}
+			}
+			return bdfAPI::errNoError;
+		}
+
+		static constexpr uint64_t DefaultTransferSize = 1024 * 1024;
+
+		bdfAPI* m_Api;
+		std::map<tKey, std::vector<sMarkerEdges>> m_Blocks;
+		std::map<tKey, uint64_t> m_Lengths;
+		std::vector<uint16_t> m_DataS;
+		std::vector<int32_t> m_DataL;
+	};
+}
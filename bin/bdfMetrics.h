@@ -0,0 +1,509 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfCache.h"
+#include "bdfDecorator.h"
+#include "bdfEnvelope.h"
+
+namespace filereader {
+	/// <summary>
+	/// Opt-in metrics of bdfAPI calls: call and error counts, log2 latency histograms, bytes read and
+	/// written, data calls into the wrapped object and the envelope levels getEnv* is estimated to use, optionally
+	/// a trace of every call that can be written as Chrome trace JSON (chrome://tracing, Perfetto).
+	///
+	/// Every thread records into its own counters, which only that thread writes, so recording needs no
+	/// lock and no atomic read-modify-write. statistics() sums the counters of all threads. One collector
+	/// is usually shared by the bdfInstrumentedAPI objects of all threads.
+	/// </summary>
+	class bdfMetrics {
+	public:
+		/// Instrumented bdfAPI functions
+		enum eFunction {
+			fnLoadFile,
+			fnInitFileWriter,
+			fnWriteInputHeader,
+			fnInitInputStreamer,
+			fnWriteData,
+			fnSetAttribute,
+			fnWriteAttributes,
+			fnWriteEORInfo,
+			fnCloseFile,
+			fnInitFileReader,
+			fnGetAttribute,
+			fnGetNumberOfGroups,
+			fnGetNumberOfInputs,
+			fnGetNumberOfBlocks,
+			fnGetInputInfo,
+			fnGetBlockInfo,
+			fnGetOperationMode,
+			fnGetRawDataS,
+			fnGetRawDataL,
+			fnGetDataF,
+			fnGetDataD,
+			fnGetEnvRawDataS,
+			fnGetEnvRawDataL,
+			fnGetEnvDataF,
+			fnGetEnvDataD
+		};
+
+		/// Number of instrumented functions
+		static constexpr unsigned NrOfFunctions = fnGetEnvDataD + 1;
+		/// Latency histogram buckets, bucket k counts calls of [2^k, 2^(k+1)) ns, the last one all longer calls
+		static constexpr unsigned NrOfBuckets = 40;
+		/// Envelope levels counted, coarser levels are counted in the last one
+		static constexpr unsigned NrOfEnvelopeLevels = 16;
+
+		/// Counters of one function
+		struct sFunctionStatistics {
+			uint64_t Calls;
+			uint64_t Errors;
+			uint64_t Nanoseconds; /// Sum of the call durations
+			uint64_t Histogram[NrOfBuckets];
+		};
+
+		struct sMetricsStatistics {
+			sFunctionStatistics Functions[NrOfFunctions];
+			uint64_t BytesRead; /// Bytes returned by the read functions
+			uint64_t BytesWritten; /// Bytes passed to writeData
+			uint64_t SamplesRead; /// Samples covered by the read functions, BlockSize for getEnv*
+			uint64_t IoCalls; /// Calls that read or write sample data through the wrapped object
+			/// getEnv* calls per envelope level, 0 for the samples. The level is the one bdfEnvelope::estimateLevel
+			/// picks for the request, not necessarily the one the DLL used.
+			uint64_t EstimatedEnvelopeLevels[NrOfEnvelopeLevels];
+			uint64_t CacheHits; /// From the attached bdfBlockCache, since attachCache or the last resetStatistics
+			uint64_t CacheMisses;
+			uint64_t Threads; /// Threads that recorded
+			uint64_t TraceEvents;
+			uint64_t TraceEventsDropped; /// Events beyond the per thread limit of setTrace
+		};
+
+		/// Arguments of one call
+		struct sCall {
+			unsigned Group;
+			unsigned Input;
+			unsigned Block;
+			uint64_t Address;
+			uint64_t Samples;
+			uint64_t BytesRead;
+			uint64_t BytesWritten;
+			int EnvelopeLevel; /// Estimated by bdfEnvelope::estimateLevel, -1 if not an envelope call
+			bool Io;
+		};
+
+		bdfMetrics() : m_Id(nextId()), m_Epoch(now()) {}
+
+		bdfMetrics(const bdfMetrics&) = delete;
+		bdfMetrics& operator=(const bdfMetrics&) = delete;
+
+		/// Steady clock in nanoseconds
+		static uint64_t now() {
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		static const char* functionName(eFunction Function) {
+			static const char* const names[NrOfFunctions] = {
+				"loadFile", "initFileWriter", "writeInputHeader", "initInputStreamer", "writeData", "setAttribute", "writeAttributes",
+				"writeEORInfo", "closeFile", "initFileReader", "getAttribute", "getNumberOfGroups", "getNumberOfInputs", "getNumberOfBlocks",
+				"getInputInfo", "getBlockInfo", "getOperationMode", "getRawDataS", "getRawDataL", "getDataF", "getDataD",
+				"getEnvRawDataS", "getEnvRawDataL", "getEnvDataF", "getEnvDataD"
+			};
+			return (unsigned)Function < NrOfFunctions ? names[Function] : "unknown";
+		}
+
+		/// <summary>
+		/// Latency below which the given fraction of the calls completed, from the histogram
+		/// </summary>
+		/// <param name="Fraction">0 to 1, e.g. 0.99</param>
+		/// <returns>Upper bound of the histogram bucket in nanoseconds, 0 without calls</returns>
+		static uint64_t percentile(const sFunctionStatistics& Statistics, double Fraction) {
+			uint64_t total = 0;
+			for (uint64_t n : Statistics.Histogram) total += n;
+			if (total == 0) return 0;
+			const double target = Fraction * (double)total;
+			uint64_t sum = 0;
+			for (unsigned k = 0; k < NrOfBuckets; k++) {
+				sum += Statistics.Histogram[k];
+				if ((double)sum >= target) return (uint64_t)1 << (k + 1);
+			}
+			return (uint64_t)1 << NrOfBuckets;
+		}
+
+		/// Enable or disable recording. Disabled, an instrumented call costs one relaxed load.
+		void setEnabled(bool Enabled) { m_Enabled.store(Enabled, std::memory_order_relaxed); }
+		bool enabled() const { return m_Enabled.load(std::memory_order_relaxed); }
+
+		/// <summary>
+		/// Enable or disable the trace of every call
+		/// </summary>
+		/// <param name="MaxEventsPerThread">Events kept per thread, later events are counted as dropped</param>
+		void setTrace(bool Enabled, size_t MaxEventsPerThread = 1 << 20) {
+			m_MaxTraceEvents.store(MaxEventsPerThread, std::memory_order_relaxed);
+			m_Trace.store(Enabled, std::memory_order_relaxed);
+		}
+		bool tracing() const { return m_Trace.load(std::memory_order_relaxed); }
+
+		/// Report the hits and misses of a cache with the statistics, nullptr to detach
+		void attachCache(bdfBlockCache* Cache) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Cache = Cache;
+			if (m_Cache) m_CacheBaseline = m_Cache->statistics();
+		}
+
+		/// <summary>
+		/// Record one call. Called by bdfInstrumentedAPI, or by other code that wants its calls counted.
+		/// </summary>
+		/// <param name="Start">now() at the start of the call</param>
+		void record(eFunction Function, uint64_t Start, bool Error, const sCall& Call) {
+			const uint64_t end = now();
+			const uint64_t duration = end - Start;
+			sThreadCounters& c = counters();
+			sFunctionCounters& f = c.Functions[Function];
+			add(f.Calls, 1);
+			if (Error) add(f.Errors, 1);
+			add(f.Nanoseconds, duration);
+			add(f.Histogram[bucket(duration)], 1);
+			if (Call.BytesRead) add(c.BytesRead, Call.BytesRead);
+			if (Call.BytesWritten) add(c.BytesWritten, Call.BytesWritten);
+			if (Call.Samples) add(c.SamplesRead, Call.Samples);
+			if (Call.Io) add(c.IoCalls, 1);
+			if (Call.EnvelopeLevel >= 0) add(c.EstimatedEnvelopeLevels[std::min<unsigned>(Call.EnvelopeLevel, NrOfEnvelopeLevels - 1)], 1);
+
+			if (tracing()) {
+				std::lock_guard<std::mutex> lock(c.TraceMutex);
+				if (c.Trace.size() < m_MaxTraceEvents.load(std::memory_order_relaxed)) c.Trace.push_back(sTraceEvent{ Function, Error, Start - m_Epoch, duration, Call });
+				else c.TraceDropped++;
+			}
+		}
+
+		/// <summary>
+		/// Sum of the counters of all threads since the last resetStatistics
+		/// </summary>
+		sMetricsStatistics statistics() const {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			sMetricsStatistics s = total();
+			subtract(s, m_Baseline);
+			if (m_Cache) {
+				const bdfBlockCache::sCacheStatistics cache = m_Cache->statistics();
+				// the cache counters may have been reset by their owner since the baseline was taken
+				const bool reset = cache.Hits < m_CacheBaseline.Hits || cache.Misses < m_CacheBaseline.Misses;
+				s.CacheHits = reset ? cache.Hits : cache.Hits - m_CacheBaseline.Hits;
+				s.CacheMisses = reset ? cache.Misses : cache.Misses - m_CacheBaseline.Misses;
+			}
+			return s;
+		}
+
+		/// Restart the statistics and clear the trace. The counters of an attached cache are left alone, other users may read them.
+		void resetStatistics() {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Baseline = total();
+			for (auto& c : m_Threads) {
+				std::lock_guard<std::mutex> traceLock(c->TraceMutex);
+				c->Trace.clear();
+				c->TraceDropped = 0;
+			}
+			if (m_Cache) m_CacheBaseline = m_Cache->statistics();
+		}
+
+		/// <summary>
+		/// Write the trace as Chrome trace JSON (chrome://tracing, Perfetto), one complete event per call
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode writeTrace(const std::string& FileName) const {
+			std::ofstream file(FileName, std::ios::binary | std::ios::trunc);
+			if (!file) return bdfAPI::errResource;
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+			bool first = true;
+			char line[512];
+			for (const auto& c : m_Threads) {
+				snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"bdfAPI thread %u\"}}", first ? "" : ",\n", c->ThreadId, c->ThreadId);
+				file << line;
+				first = false;
+				std::lock_guard<std::mutex> traceLock(c->TraceMutex);
+				for (const sTraceEvent& e : c->Trace) {
+					snprintf(line, sizeof(line),
+						",\n{\"name\":\"%s\",\"cat\":\"bdfAPI\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+						"\"args\":{\"group\":%u,\"input\":%u,\"block\":%u,\"address\":%llu,\"samples\":%llu,\"bytes\":%llu,\"level\":%d,\"error\":%d}}",
+						functionName(e.Function), c->ThreadId, e.Start / 1000.0, e.Duration / 1000.0,
+						e.Call.Group, e.Call.Input, e.Call.Block, (unsigned long long)e.Call.Address, (unsigned long long)e.Call.Samples,
+						(unsigned long long)(e.Call.BytesRead + e.Call.BytesWritten), e.Call.EnvelopeLevel, e.Error ? 1 : 0);
+					file << line;
+				}
+			}
+			file << "\n]}\n";
+			return file ? bdfAPI::errNoError : bdfAPI::errResource;
+		}
+
+	private:
+		struct sFunctionCounters {
+			std::atomic<uint64_t> Calls{ 0 };
+			std::atomic<uint64_t> Errors{ 0 };
+			std::atomic<uint64_t> Nanoseconds{ 0 };
+			std::atomic<uint64_t> Histogram[NrOfBuckets] = {};
+		};
+
+		struct sTraceEvent {
+			eFunction Function;
+			bool Error;
+			uint64_t Start; /// ns since the construction of the collector
+			uint64_t Duration;
+			sCall Call;
+		};
+
+		/// Counters written only by their thread
+		struct sThreadCounters {
+			unsigned ThreadId = 0;
+			sFunctionCounters Functions[NrOfFunctions];
+			std::atomic<uint64_t> BytesRead{ 0 };
+			std::atomic<uint64_t> BytesWritten{ 0 };
+			std::atomic<uint64_t> SamplesRead{ 0 };
+			std::atomic<uint64_t> IoCalls{ 0 };
+			std::atomic<uint64_t> EstimatedEnvelopeLevels[NrOfEnvelopeLevels] = {};
+			std::mutex TraceMutex; /// Only contended while the trace is read
+			std::vector<sTraceEvent> Trace;
+			uint64_t TraceDropped = 0;
+		};
+
+		static uint64_t nextId() {
+			static std::atomic<uint64_t> id{ 0 };
+			return ++id;
+		}
+
+		/// Single writer increment, a plain load and store instead of a locked read-modify-write
+		static void add(std::atomic<uint64_t>& Counter, uint64_t Value) {
+			Counter.store(Counter.load(std::memory_order_relaxed) + Value, std::memory_order_relaxed);
+		}
+
+		/// Histogram bucket, the number of the highest set bit
+		static unsigned bucket(uint64_t Nanoseconds) {
+			if (Nanoseconds <= 1) return 0;
+#if defined(_MSC_VER) && defined(_M_X64)
+			unsigned long index;
+			_BitScanReverse64(&index, Nanoseconds);
+			const unsigned k = (unsigned)index;
+#elif defined(__GNUC__)
+			const unsigned k = 63 - (unsigned)__builtin_clzll(Nanoseconds);
+#else
+			unsigned k = 0;
+			while (Nanoseconds > 1) {
+				Nanoseconds >>= 1;
+				k++;
+			}
+#endif
+			return k < NrOfBuckets - 1 ? k : NrOfBuckets - 1;
+		}
+
+		/// Counters of the calling thread, registered on first use
+		sThreadCounters& counters() {
+			// collector ids are never reused, so entries of destroyed collectors never match
+			thread_local std::vector<std::pair<uint64_t, sThreadCounters*>> threadCounters;
+			for (const auto& entry : threadCounters) {
+				if (entry.first == m_Id) return *entry.second;
+			}
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Threads.push_back(std::make_unique<sThreadCounters>());
+			sThreadCounters* c = m_Threads.back().get();
+			c->ThreadId = (unsigned)m_Threads.size();
+			threadCounters.emplace_back(m_Id, c);
+			return *c;
+		}
+
+		/// Sum over all threads, m_Mutex must be held
+		sMetricsStatistics total() const {
+			sMetricsStatistics s{};
+			for (const auto& c : m_Threads) {
+				for (unsigned f = 0; f < NrOfFunctions; f++) {
+					s.Functions[f].Calls += c->Functions[f].Calls.load(std::memory_order_relaxed);
+					s.Functions[f].Errors += c->Functions[f].Errors.load(std::memory_order_relaxed);
+					s.Functions[f].Nanoseconds += c->Functions[f].Nanoseconds.load(std::memory_order_relaxed);
+					for (unsigned k = 0; k < NrOfBuckets; k++) s.Functions[f].Histogram[k] += c->Functions[f].Histogram[k].load(std::memory_order_relaxed);
+				}
+				s.BytesRead += c->BytesRead.load(std::memory_order_relaxed);
+				s.BytesWritten += c->BytesWritten.load(std::memory_order_relaxed);
+				s.SamplesRead += c->SamplesRead.load(std::memory_order_relaxed);
+				s.IoCalls += c->IoCalls.load(std::memory_order_relaxed);
+				for (unsigned l = 0; l < NrOfEnvelopeLevels; l++) s.EstimatedEnvelopeLevels[l] += c->EstimatedEnvelopeLevels[l].load(std::memory_order_relaxed);
+				std::lock_guard<std::mutex> traceLock(c->TraceMutex);
+				s.TraceEvents += c->Trace.size();
+				s.TraceEventsDropped += c->TraceDropped;
+			}
+			s.Threads = m_Threads.size();
+			return s;
+		}
+
+		static void subtract(sMetricsStatistics& S, const sMetricsStatistics& Baseline) {
+			for (unsigned f = 0; f < NrOfFunctions; f++) {
+				S.Functions[f].Calls -= Baseline.Functions[f].Calls;
+				S.Functions[f].Errors -= Baseline.Functions[f].Errors;
+				S.Functions[f].Nanoseconds -= Baseline.Functions[f].Nanoseconds;
+				for (unsigned k = 0; k < NrOfBuckets; k++) S.Functions[f].Histogram[k] -= Baseline.Functions[f].Histogram[k];
+			}
+			S.BytesRead -= Baseline.BytesRead;
+			S.BytesWritten -= Baseline.BytesWritten;
+			S.SamplesRead -= Baseline.SamplesRead;
+			S.IoCalls -= Baseline.IoCalls;
+			for (unsigned l = 0; l < NrOfEnvelopeLevels; l++) S.EstimatedEnvelopeLevels[l] -= Baseline.EstimatedEnvelopeLevels[l];
+		}
+
+		const uint64_t m_Id;
+		const uint64_t m_Epoch;
+		std::atomic<bool> m_Enabled{ true };
+		std::atomic<bool> m_Trace{ false };
+		std::atomic<size_t> m_MaxTraceEvents{ 1 << 20 };
+		mutable std::mutex m_Mutex;
+		std::vector<std::unique_ptr<sThreadCounters>> m_Threads;
+		sMetricsStatistics m_Baseline{};
+		bdfBlockCache* m_Cache = nullptr;
+		bdfBlockCache::sCacheStatistics m_CacheBaseline{};
+	};
+
+	/// <summary>
+	/// Decorator recording every call into a bdfMetrics collector. Like any bdfAPI object it is used
+	/// by one thread at a time; the collector can be shared by the decorators of many threads.
+	/// </summary>
+	class bdfInstrumentedAPI : public bdfAPIDecorator {
+	public:
+		/// <summary>
+		/// Wrap an API object
+		/// </summary>
+		/// <param name="Api">API object to instrument</param>
+		/// <param name="Metrics">Collector, must outlive the decorator</param>
+		bdfInstrumentedAPI(bdfAPI* Api, bdfMetrics& Metrics) : bdfAPIDecorator(Api), m_Metrics(Metrics) {}
+
+		/// The collector
+		bdfMetrics& metrics() const { return m_Metrics; }
+
+		virtual int loadFile(const char* FileName) override {
+			m_BlockInfos.clear();
+			return measure(bdfMetrics::fnLoadFile, call(), [&] { return m_Api->loadFile(FileName); }, [](int r) { return r < 0; });
+		}
+		virtual int initFileWriter(unsigned Group, sDateTime& StartTime, eOperationMode OperationMode, double SampleRate, uint32_t TimebaseDivisor, uint32_t TriggerSample) override {
+			return measure(bdfMetrics::fnInitFileWriter, call(Group), [&] { return m_Api->initFileWriter(Group, StartTime, OperationMode, SampleRate, TimebaseDivisor, TriggerSample); }, [](int r) { return r < 0; });
+		}
+		virtual int writeInputHeader(uint32_t BoardNumber, uint32_t InputNumber, uint32_t AnalogMask, uint32_t MarkerMask, double Range, double Offset, double VoltToPhysicalFactor, double VoltToPhysicalConstant, int Handle = 0) override {
+			return measure(bdfMetrics::fnWriteInputHeader, call(), [&] { return m_Api->writeInputHeader(BoardNumber, InputNumber, AnalogMask, MarkerMask, Range, Offset, VoltToPhysicalFactor, VoltToPhysicalConstant, Handle); }, failed);
+		}
+		virtual int initInputStreamer(uint32_t BoardNumber, uint32_t InputNumber, uint32_t BlockNr, int Handle = 0) override {
+			return measure(bdfMetrics::fnInitInputStreamer, call(0, InputNumber, BlockNr), [&] { return m_Api->initInputStreamer(BoardNumber, InputNumber, BlockNr, Handle); }, [](int r) { return r < 0; });
+		}
+		virtual int writeData(int StreamerHandle, char* Data, unsigned int count, int Handle = 0) override {
+			bdfMetrics::sCall c = call();
+			c.BytesWritten = count;
+			c.Io = true;
+			return measure(bdfMetrics::fnWriteData, c, [&] { return m_Api->writeData(StreamerHandle, Data, count, Handle); }, failed);
+		}
+		virtual int setAttribute(unsigned Input, const std::string& Key, const std::string& Value, int GroupHandle = 0) override {
+			return measure(bdfMetrics::fnSetAttribute, call(0, Input), [&] { return m_Api->setAttribute(Input, Key, Value, GroupHandle); }, failed);
+		}
+		virtual int writeAttributes(int GroupHandle = 0) override {
+			return measure(bdfMetrics::fnWriteAttributes, call(), [&] { return m_Api->writeAttributes(GroupHandle); }, failed);
+		}
+		virtual void writeEORInfo(uint32_t BlockNr, uint64_t TriggerTime, uint64_t DataCntr, uint32_t Input, uint32_t Board, int GroupHandle = 0) override {
+			measure(bdfMetrics::fnWriteEORInfo, call(0, Input, BlockNr), [&] { m_Api->writeEORInfo(BlockNr, TriggerTime, DataCntr, Input, Board, GroupHandle); return 0; }, never);
+		}
+		virtual void closeFile(int handle = -1) override {
+			m_BlockInfos.clear();
+			measure(bdfMetrics::fnCloseFile, call(), [&] { m_Api->closeFile(handle); return 0; }, never);
+		}
+		virtual int initFileReader() override {
+			return measure(bdfMetrics::fnInitFileReader, call(), [&] { return m_Api->initFileReader(); }, [](int r) { return r < 0; });
+		}
+		virtual eErrorCode getAttribute(unsigned Group, unsigned Input, char* Key, char* Value, unsigned Size) override {
+			return measure(bdfMetrics::fnGetAttribute, call(Group, Input), [&] { return m_Api->getAttribute(Group, Input, Key, Value, Size); }, failed);
+		}
+		virtual unsigned getNumberOfGroups() override {
+			return measure(bdfMetrics::fnGetNumberOfGroups, call(), [&] { return m_Api->getNumberOfGroups(); }, never);
+		}
+		virtual unsigned getNumberOfInputs(unsigned Group) override {
+			return measure(bdfMetrics::fnGetNumberOfInputs, call(Group), [&] { return m_Api->getNumberOfInputs(Group); }, never);
+		}
+		virtual unsigned getNumberOfBlocks(unsigned Group, unsigned Input) override {
+			return measure(bdfMetrics::fnGetNumberOfBlocks, call(Group, Input), [&] { return m_Api->getNumberOfBlocks(Group, Input); }, never);
+		}
+		virtual eErrorCode getInputInfo(unsigned Group, unsigned Input, sInputInfo* InputInfo) override {
+			return measure(bdfMetrics::fnGetInputInfo, call(Group, Input), [&] { return m_Api->getInputInfo(Group, Input, InputInfo); }, failed);
+		}
+		virtual eErrorCode getBlockInfo(unsigned Group, unsigned Input, unsigned Block, sBlockInfo* BlockInfo) override {
+			return measure(bdfMetrics::fnGetBlockInfo, call(Group, Input, Block), [&] { return m_Api->getBlockInfo(Group, Input, Block, BlockInfo); }, failed);
+		}
+		virtual eErrorCode getOperationMode(unsigned Group, eOperationMode& Mode) override {
+			return measure(bdfMetrics::fnGetOperationMode, call(Group), [&] { return m_Api->getOperationMode(Group, Mode); }, failed);
+		}
+		virtual eErrorCode getRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint16_t* Data, unsigned Count) override {
+			return measure(bdfMetrics::fnGetRawDataS, read(Group, Input, Block, Address, Count, Count * sizeof(*Data)), [&] { return m_Api->getRawDataS(Group, Input, Block, Address, Data, Count); }, failed);
+		}
+		virtual eErrorCode getRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, int32_t* Data, unsigned Count) override {
+			return measure(bdfMetrics::fnGetRawDataL, read(Group, Input, Block, Address, Count, Count * sizeof(*Data)), [&] { return m_Api->getRawDataL(Group, Input, Block, Address, Data, Count); }, failed);
+		}
+		virtual eErrorCode getDataF(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, float* Data, unsigned Count) override {
+			return measure(bdfMetrics::fnGetDataF, read(Group, Input, Block, Address, Count, Count * sizeof(*Data)), [&] { return m_Api->getDataF(Group, Input, Block, Address, Data, Count); }, failed);
+		}
+		virtual eErrorCode getDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, double* Data, unsigned Count) override {
+			return measure(bdfMetrics::fnGetDataD, read(Group, Input, Block, Address, Count, Count * sizeof(*Data)), [&] { return m_Api->getDataD(Group, Input, Block, Address, Data, Count); }, failed);
+		}
+		virtual eErrorCode getEnvRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, uint16_t* Data, unsigned Count) override {
+			return measure(bdfMetrics::fnGetEnvRawDataS, envelope(Group, Input, Block, Address, BlockSize, Count, Count * sizeof(*Data)), [&] { return m_Api->getEnvRawDataS(Group, Input, Block, Address, BlockSize, Data, Count); }, failed);
+		}
+		virtual eErrorCode getEnvRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, int32_t* Data, unsigned Count) override {
+			return measure(bdfMetrics::fnGetEnvRawDataL, envelope(Group, Input, Block, Address, BlockSize, Count, Count * sizeof(*Data)), [&] { return m_Api->getEnvRawDataL(Group, Input, Block, Address, BlockSize, Data, Count); }, failed);
+		}
+		virtual eErrorCode getEnvDataF(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, float* Data, unsigned Count) override {
+			return measure(bdfMetrics::fnGetEnvDataF, envelope(Group, Input, Block, Address, BlockSize, Count, Count * sizeof(*Data)), [&] { return m_Api->getEnvDataF(Group, Input, Block, Address, BlockSize, Data, Count); }, failed);
+		}
+		virtual eErrorCode getEnvDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, double* Data, unsigned Count) override {
+			return measure(bdfMetrics::fnGetEnvDataD, envelope(Group, Input, Block, Address, BlockSize, Count, Count * sizeof(*Data)), [&] { return m_Api->getEnvDataD(Group, Input, Block, Address, BlockSize, Data, Count); }, failed);
+		}
+
+	private:
+		static bool failed(int Result) { return Result != errNoError; }
+		static bool never(unsigned) { return false; }
+
+		template <typename Body, typename IsError>
+		auto measure(bdfMetrics::eFunction Function, const bdfMetrics::sCall& Call, Body&& Run, IsError&& Error) -> decltype(Run()) {
+			if (!m_Metrics.enabled()) return Run();
+			const uint64_t start = bdfMetrics::now();
+			auto result = Run();
+			m_Metrics.record(Function, start, Error(result), Call);
+			return result;
+		}
+
+		static bdfMetrics::sCall call(unsigned Group = 0, unsigned Input = 0, unsigned Block = 0) {
+			return bdfMetrics::sCall{ Group, Input, Block, 0, 0, 0, 0, -1, false };
+		}
+
+		static bdfMetrics::sCall read(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t Samples, uint64_t Bytes) {
+			return bdfMetrics::sCall{ Group, Input, Block, Address, Samples, Bytes, 0, -1, true };
+		}
+
+		/// Envelope call with the level bdfEnvelope selects for it; the block info is read once per block
+		bdfMetrics::sCall envelope(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, unsigned Count, uint64_t Bytes) {
+			bdfMetrics::sCall c = read(Group, Input, Block, Address, BlockSize, Bytes);
+			if (!m_Metrics.enabled()) return c;
+			auto key = std::make_tuple(Group, Input, Block);
+			auto it = m_BlockInfos.find(key);
+			if (it == m_BlockInfos.end()) {
+				sBlockInfo blockInfo;
+				if (m_Api->getBlockInfo(Group, Input, Block, &blockInfo) != errNoError) return c;
+				it = m_BlockInfos.emplace(key, blockInfo).first;
+			}
+			bdfEnvelope::sEnvelopeEstimate estimate;
+			if (bdfEnvelope::estimateLevel(it->second, BlockSize, Count, &estimate) == errNoError) c.EnvelopeLevel = (int)estimate.Level;
+			return c;
+		}
+
+		bdfMetrics& m_Metrics;
+		std::map<std::tuple<unsigned, unsigned, unsigned>, sBlockInfo> m_BlockInfos;
+	};
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfConvert.h"
+
+namespace filereader {
+	/// <summary>
+	/// Parallel reads from one file. A bdfAPI object must not be used by several threads at the same
+	/// time, so the reader opens the file once per worker thread. Each worker reads only through its own
+	/// API object and has no state shared with the other workers; the file metadata is read only.
+	/// Requests over several inputs or blocks are split into tasks and fanned out across the workers.
+	/// </summary>
+	class bdfParallelReader {
+	public:
+		/// Task function, called with the API object of the worker and the task index
+		typedef std::function<bdfAPI::eErrorCode(bdfAPI* Api, size_t Task)> tTask;
+
+		/// <summary>
+		/// Open a file once per worker thread
+		/// </summary>
+		/// <param name="FileName">BDF file to read</param>
+		/// <param name="NrOfThreads">Number of worker threads, 0 for the number of hardware threads</param>
+		bdfParallelReader(const char* FileName, unsigned NrOfThreads = 0) {
+			if (NrOfThreads == 0) NrOfThreads = std::thread::hardware_concurrency();
+			if (NrOfThreads == 0) NrOfThreads = 1;
+			for (unsigned n = 0; n < NrOfThreads; n++) {
+				bdfAPI* api = CreateBDFAPIObj();
+				if (api == nullptr) break;
+				if (api->loadFile(FileName) == -1) {
+					DestroyBDFAPIObj(api);
+					break;
+				}
+				m_Apis.push_back(api);
+			}
+			m_OwnsApis = true;
+			start();
+		}
+
+		/// <summary>
+		/// Use already opened API objects, one worker thread per object. The objects are not owned.
+		/// </summary>
+		/// <param name="Apis">API objects with the same file loaded</param>
+		explicit bdfParallelReader(const std::vector<bdfAPI*>& Apis) : m_Apis(Apis), m_OwnsApis(false) {
+			start();
+		}
+
+		virtual ~bdfParallelReader() {
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Stop = true;
+			}
+			m_StartCondition.notify_all();
+			for (auto& t : m_Threads) t.join();
+			if (m_OwnsApis) {
+				for (bdfAPI* api : m_Apis) {
+					api->closeFile();
+					DestroyBDFAPIObj(api);
+				}
+			}
+		}
+
+		bdfParallelReader(const bdfParallelReader&) = delete;
+		bdfParallelReader& operator=(const bdfParallelReader&) = delete;
+
+		/// True if the file could be opened by at least one worker
+		bool isOpen() const { return !m_Apis.empty(); }
+
+		/// Number of worker threads
+		unsigned numberOfThreads() const { return (unsigned)m_Apis.size(); }
+
+		/// API object of the first worker, for metadata queries while no tasks are running
+		bdfAPI* api() const { return m_Apis.empty() ? nullptr : m_Apis[0]; }
+
+		/// <summary>
+		/// Run tasks on the worker threads and wait until all are done. Tasks are handed out in index
+		/// order. After the first failed task no further tasks are started.
+		/// Must not be called from several threads at the same time.
+		/// </summary>
+		/// <param name="NrOfTasks">Number of tasks</param>
+		/// <param name="Task">Called once per task index</param>
+		/// <returns>eErrorCode of the first failed task</returns>
+		bdfAPI::eErrorCode run(size_t NrOfTasks, const tTask& Task) {
+			if (m_Apis.empty()) return bdfAPI::errInvalidHandle;
+			if (NrOfTasks == 0) return bdfAPI::errNoError;
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Task = &Task;
+			m_NrOfTasks = NrOfTasks;
+			m_NextTask = 0;
+			m_Error = bdfAPI::errNoError;
+			m_Running = (unsigned)m_Apis.size();
+			m_Generation++;
+			m_StartCondition.notify_all();
+			m_DoneCondition.wait(lock, [this] { return m_Running == 0; });
+			m_Task = nullptr;
+			return m_Error;
+		}
+
+		/// <summary>
+		/// Read the same range of several inputs in parallel, planar (Data[input * Count + sample])
+		/// </summary>
+		/// <param name="Inputs">Inputs to read</param>
+		/// <param name="Unit">Scaling to volt or physical unit</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getDataD(unsigned Group, unsigned Block, uint64_t Address, unsigned Count, const std::vector<unsigned>& Inputs, double* Data, bdfConvert::eUnit Unit = bdfConvert::unitVolt) {
+			return run(Inputs.size(), [&](bdfAPI* api, size_t n) {
+				return bdfConvert::getDataD(api, Group, Inputs[n], Block, Address, Data + n * (size_t)Count, Count, Unit);
+			});
+		}
+
+		/// <summary>
+		/// Read the same range of several blocks of one input in parallel (Data[block index * Count + sample])
+		/// </summary>
+		/// <param name="Blocks">Blocks to read</param>
+		/// <param name="Unit">Scaling to volt or physical unit</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getDataD(unsigned Group, unsigned Input, const std::vector<unsigned>& Blocks, uint64_t Address, unsigned Count, double* Data, bdfConvert::eUnit Unit = bdfConvert::unitVolt) {
+			return run(Blocks.size(), [&](bdfAPI* api, size_t n) {
+				return bdfConvert::getDataD(api, Group, Input, Blocks[n], Address, Data + n * (size_t)Count, Count, Unit);
+			});
+		}
+
+		/// <summary>
+		/// Read the envelope of several inputs in parallel (Data[input * Count + value])
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getEnvDataD(unsigned Group, unsigned Block, uint64_t Address, uint64_t BlockSize, unsigned Count, const std::vector<unsigned>& Inputs, double* Data) {
+			return run(Inputs.size(), [&](bdfAPI* api, size_t n) {
+				return api->getEnvDataD(Group, Inputs[n], Block, Address, BlockSize, Data + n * (size_t)Count, Count);
+			});
+		}
+
+	private:
+		void start() {
+			for (size_t n = 0; n < m_Apis.size(); n++) m_Threads.emplace_back(&bdfParallelReader::worker, this, m_Apis[n]);
+		}
+
+		void worker(bdfAPI* Api) {
+			uint64_t generation = 0;
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			for (;;) {
+				m_StartCondition.wait(lock, [&] { return m_Stop || m_Generation != generation; });
+				if (m_Stop) return;
+				generation = m_Generation;
+				const tTask* task = m_Task;
+				const size_t nrOfTasks = m_NrOfTasks;
+				lock.unlock();
+
+				for (;;) {
+					size_t n = m_NextTask.fetch_add(1);
+					if (n >= nrOfTasks) break;
+					bdfAPI::eErrorCode err = (*task)(Api, n);
+					if (err != bdfAPI::errNoError) {
+						std::lock_guard<std::mutex> errorLock(m_Mutex);
+						if (m_Error == bdfAPI::errNoError) m_Error = err;
+						m_NextTask = nrOfTasks;
+					}
+				}
+
+				lock.lock();
+				if (--m_Running == 0) m_DoneCondition.notify_all();
+			}
+		}
+
+		std::vector<bdfAPI*> m_Apis;
+		bool m_OwnsApis = false;
+		std::vector<std::thread> m_Threads;
+		std::mutex m_Mutex;
+		std::condition_variable m_StartCondition;
+		std::condition_variable m_DoneCondition;
+		const tTask* m_Task = nullptr;
+		size_t m_NrOfTasks = 0;
+		std::atomic<size_t> m_NextTask{ 0 };
+		unsigned m_Running = 0;
+		uint64_t m_Generation = 0;
+		bool m_Stop = false;
+		bdfAPI::eErrorCode m_Error = bdfAPI::errNoError;
+	};
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <vector>
+#include "bdfAPI.h"
+
+namespace filereader {
+	/// <summary>
+	/// Read-only view on a contiguous range of raw samples of one input block.
+	/// The samples are stored in their native word size (\ref bdfAPI::sInputInfo::BytesPerSample):
+	/// 16-bit words are accessible through samplesS(), wider words through samplesL().
+	/// </summary>
+	class bdfRawView {
+	public:
+		/// Pointer to the first sample of the view
+		const void* data() const { return m_BytesPerSample <= 2 ? (const void*)m_DataS.data() : (const void*)m_DataL.data(); }
+		/// 16-bit raw words, nullptr if the input uses more than 2 bytes per sample
+		const uint16_t* samplesS() const { return m_BytesPerSample <= 2 ? m_DataS.data() : nullptr; }
+		/// 32-bit raw words, nullptr if the input uses 2 bytes per sample or less
+		const int32_t* samplesL() const { return m_BytesPerSample > 2 ? m_DataL.data() : nullptr; }
+		/// Number of samples in the view
+		uint64_t size() const { return m_Count; }
+		/// Size of the view in bytes
+		uint64_t sizeInBytes() const { return m_Count * (m_BytesPerSample <= 2 ? sizeof(uint16_t) : sizeof(int32_t)); }
+		/// Number of bytes representing one sample in the file
+		unsigned bytesPerSample() const { return m_BytesPerSample; }
+		/// The sample address of the first sample inside the block
+		uint64_t address() const { return m_Address; }
+
+	private:
+		friend class bdfRawViewStore;
+		uint64_t m_Address = 0;
+		uint64_t m_Count = 0;
+		unsigned m_BytesPerSample = 2;
+		std::vector<uint16_t> m_DataS;
+		std::vector<int32_t> m_DataL;
+	};
+
+	/// <summary>
+	/// Owns the raw views of one loaded file. A view is read once in transfers of
+	/// \ref bdfAPI::sBlockInfo::PreferredTransferSize samples, without any caller side
+	/// buffer limit, and stays valid until \ref closeFile is called. Requesting the same
+	/// range twice returns the same view without reading the file again.
+	///
+	/// Each view holds a full copy of its range in memory until \ref closeFile, so a view over a
+	/// multi-GB range costs as much memory as the range itself; overlapping views are not shared.
+	///
+	/// The sample layout of a BDF file is private to BdFileReader, so the views are filled
+	/// through getRawDataS/getRawDataL rather than mapped from the file.
+	/// </summary>
+	class bdfRawViewStore {
+	public:
+		/// <summary>
+		/// Create a view store for an API object with a loaded file.
+		/// </summary>
+		/// <param name="Api">API object on which loadFile and initFileReader were called</param>
+		explicit bdfRawViewStore(bdfAPI* Api) : m_Api(Api) {}
+
+		bdfRawViewStore(const bdfRawViewStore&) = delete;
+		bdfRawViewStore& operator=(const bdfRawViewStore&) = delete;
+
+		/// <summary>
+		/// Get a read-only view on the raw samples of a block range
+		/// </summary>
+		/// <param name="Group"></param>
+		/// <param name="Input"></param>
+		/// <param name="Block"></param>
+		/// <param name="Address">The starting sample address offset inside the block</param>
+		/// <param name="Count">Number of samples, may exceed the range of an unsigned</param>
+		/// <param name="View">Receives the view, valid until closeFile</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getView(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t Count, const bdfRawView** View) {
+			if (m_Api == nullptr) return bdfAPI::errInvalidHandle;
+			if (View == nullptr || Count == 0) return bdfAPI::errArgument;
+
+			auto key = std::make_tuple(Group, Input, Block, Address, Count);
+			auto it = m_Views.find(key);
+			if (it != m_Views.end()) {
+				*View = it->second.get();
+				return bdfAPI::errNoError;
+			}
+
+			bdfAPI::sInputInfo inputInfo;
+			bdfAPI::sBlockInfo blockInfo;
+			bdfAPI::eErrorCode err = m_Api->getInputInfo(Group, Input, &inputInfo);
+			if (err != bdfAPI::errNoError) return err;
+			err = m_Api->getBlockInfo(Group, Input, Block, &blockInfo);
+			if (err != bdfAPI::errNoError) return err;
+			if (Address > blockInfo.BlockLength || Count > blockInfo.BlockLength - Address) return bdfAPI::errArgument;
+
+			std::unique_ptr<bdfRawView> view(new bdfRawView());
+			view->m_Address = Address;
+			view->m_Count = Count;
+			view->m_BytesPerSample = inputInfo.BytesPerSample;
+			try {
+				if (inputInfo.BytesPerSample <= 2) view->m_DataS.resize((size_t)Count);
+				else view->m_DataL.resize((size_t)Count);
+			}
+			catch (const std::bad_alloc&) {
+				return bdfAPI::errResource;
+			}
+
+			const uint64_t chunk = blockInfo.PreferredTransferSize > 0 ? blockInfo.PreferredTransferSize : DefaultTransferSize;
+			for (uint64_t pos = 0; pos < Count; pos += chunk) {
+				unsigned n = (unsigned)(Count - pos < chunk ? Count - pos : chunk);
+				if (inputInfo.BytesPerSample <= 2) err = m_Api->getRawDataS(Group, Input, Block, Address + pos, view->m_DataS.data() + pos, n);
+				else err = m_Api->getRawDataL(Group, Input, Block, Address + pos, view->m_DataL.data() + pos, n);
+				if (err != bdfAPI::errNoError) return err;
+			}
+
+			*View = view.get();
+			m_Views.emplace(key, std::move(view));
+			return bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Release all views and close the file of the API object. All view pointers become invalid.
+		/// </summary>
+		void closeFile() {
+			m_Views.clear();
+			if (m_Api != nullptr) m_Api->closeFile();
+		}
+
+	private:
+		/// Transfer size used if the block does not report one
+		static const uint64_t DefaultTransferSize = 1024 * 1024;
+
+		bdfAPI* m_Api;
+		std::map<std::tuple<unsigned, unsigned, unsigned, uint64_t, uint64_t>, std::unique_ptr<bdfRawView>> m_Views;
+	};
+}
@@ -0,0 +1,282 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfConvert.h"
+
+namespace filereader {
+	/// <summary>
+	/// Reads a block on a uniform time axis chosen by the caller.
+	/// The time axis starts at StartSeconds relative to the trigger sample (time zero) and has RateHertz
+	/// points per second. Each output point covers the samples from its time to the time of the next point:
+	/// decimation takes one sample, the mean (boxcar anti-aliasing) or the min/max pair of these samples,
+	/// and an output rate above the sample rate holds the last sample. The reduction works on the raw words
+	/// of one chunked pass over the block, only the output values are scaled. Points outside of the block are NaN.
+	///
+	/// The sample clock of the block is given by timebase segments. By default the block has one segment with
+	/// the effective rate SampleRateHertz / TimebaseDivisor. A block of a *Dual operation mode is recorded with
+	/// SampleRateHertz from the trigger sample to the stop trigger sample and with SampleRateHertz / TimebaseDivisor
+	/// outside of it (\ref dualTimebase); pass explicit segments if the timebase of a file switches elsewhere.
+	/// </summary>
+	class bdfResample {
+	public:
+		/// Reduction of the samples of one output point
+		enum eMethod {
+			methodSample, /// First sample of the point, or the last sample before it (stride decimation, hold upsampling)
+			methodMean, /// Mean of the samples of the point
+			methodMinMax /// Minimum and maximum of the samples of the point, two values per point
+		};
+
+		/// Part of a block with one sample rate
+		struct sTimebaseSegment {
+			uint64_t FirstSample; /// First sample with this rate
+			double SampleRateHertz; /// Effective sample rate
+		};
+
+		/// <summary>
+		/// Get the default timebase of a block, one segment with SampleRateHertz / TimebaseDivisor
+		/// </summary>
+		static std::vector<sTimebaseSegment> timebase(const bdfAPI::sBlockInfo& BlockInfo) {
+			const double divisor = BlockInfo.TimebaseDivisor > 0 ? BlockInfo.TimebaseDivisor : 1;
+			return std::vector<sTimebaseSegment>{ sTimebaseSegment{ 0, BlockInfo.SampleRateHertz / divisor } };
+		}
+
+		/// <summary>
+		/// Get the timebase of a block in a *Dual operation mode: SampleRateHertz from the trigger sample up to
+		/// the stop trigger sample (the end of the block without a stop trigger), SampleRateHertz / TimebaseDivisor
+		/// before and after
+		/// </summary>
+		static std::vector<sTimebaseSegment> dualTimebase(const bdfAPI::sBlockInfo& BlockInfo) {
+			const double fast = BlockInfo.SampleRateHertz;
+			const double slow = BlockInfo.SampleRateHertz / (BlockInfo.TimebaseDivisor > 0 ? BlockInfo.TimebaseDivisor : 1);
+			std::vector<sTimebaseSegment> segments;
+			if (BlockInfo.TriggerSample > 0) segments.push_back(sTimebaseSegment{ 0, slow });
+			segments.push_back(sTimebaseSegment{ BlockInfo.TriggerSample, fast });
+			if (BlockInfo.StopTriggerSample > BlockInfo.TriggerSample && BlockInfo.StopTriggerSample < BlockInfo.BlockLength) {
+				segments.push_back(sTimebaseSegment{ BlockInfo.StopTriggerSample, slow });
+			}
+			return segments;
+		}
+
+		/// <summary>
+		/// Read a block on a uniform time axis
+		/// </summary>
+		/// <param name="Api">API object with a loaded file</param>
+		/// <param name="StartSeconds">Time of the first point relative to the trigger sample</param>
+		/// <param name="RateHertz">Points per second</param>
+		/// <param name="Data">Count values, 2 * Count (min, max) for methodMinMax</param>
+		/// <param name="Count">Number of points</param>
+		/// <param name="Method">Reduction of the samples of a point</param>
+		/// <param name="Unit">Scaling to volt or physical unit</param>
+		/// <param name="Timebase">Timebase segments sorted by FirstSample, nullptr for the timebase of the block (\ref timebase, \ref dualTimebase)</param>
+		/// <returns>eErrorCode</returns>
+		template <typename T>
+		static bdfAPI::eErrorCode getData(bdfAPI* Api, unsigned Group, unsigned Input, unsigned Block, double StartSeconds, double RateHertz, T* Data, unsigned Count,
+			eMethod Method = methodSample, bdfConvert::eUnit Unit = bdfConvert::unitVolt, const std::vector<sTimebaseSegment>* Timebase = nullptr) {
+			if (!(RateHertz > 0) || Data == nullptr) return bdfAPI::errArgument;
+			bdfAPI::sInputInfo inputInfo;
+			bdfAPI::eErrorCode err = Api->getInputInfo(Group, Input, &inputInfo);
+			if (err != bdfAPI::errNoError) return err;
+			bdfAPI::sBlockInfo blockInfo;
+			err = Api->getBlockInfo(Group, Input, Block, &blockInfo);
+			if (err != bdfAPI::errNoError) return err;
+
+			std::vector<sTimebaseSegment> segments;
+			if (Timebase != nullptr) segments = *Timebase;
+			else {
+				bdfAPI::eOperationMode mode;
+				err = Api->getOperationMode(Group, mode);
+				if (err != bdfAPI::errNoError) return err;
+				const bool dual = mode == bdfAPI::singleEventRecorderDual || mode == bdfAPI::multiEventRecorderDual;
+				segments = dual ? dualTimebase(blockInfo) : timebase(blockInfo);
+			}
+			if (segments.empty() || segments[0].FirstSample != 0) return bdfAPI::errArgument;
+			for (size_t n = 0; n < segments.size(); n++) {
+				if (!(segments[n].SampleRateHertz > 0) || (n > 0 && segments[n].FirstSample <= segments[n - 1].FirstSample)) return bdfAPI::errArgument;
+			}
+
+			sContext<T> context(Api, inputInfo, blockInfo, Group, Input, Block, Unit, segments);
+			try {
+				if (inputInfo.BytesPerSample > 2) return context.template run<int32_t>(StartSeconds, RateHertz, Data, Count, Method);
+				return context.template run<uint16_t>(StartSeconds, RateHertz, Data, Count, Method);
+			}
+			catch (const std::bad_alloc&) {
+				return bdfAPI::errResource;
+			}
+		}
+
+	private:
+		template <typename T>
+		struct sContext {
+			sContext(bdfAPI* Api, const bdfAPI::sInputInfo& InputInfo, const bdfAPI::sBlockInfo& BlockInfo, unsigned Group, unsigned Input, unsigned Block, bdfConvert::eUnit Unit, const std::vector<sTimebaseSegment>& Segments)
+				: Api(Api), InputInfo(InputInfo), Group(Group), Input(Input), Block(Block), Length(BlockInfo.BlockLength), Segments(Segments) {
+				bdfConvert::scaling(InputInfo, Unit, Factor, Constant);
+				Chunk = BlockInfo.PreferredTransferSize > 0 ? BlockInfo.PreferredTransferSize : DefaultTransferSize;
+				// start time of each segment, sample 0 at time 0
+				Times.resize(Segments.size());
+				Times[0] = 0;
+				for (size_t n = 1; n < Segments.size(); n++) {
+					Times[n] = Times[n - 1] + (double)(Segments[n].FirstSample - Segments[n - 1].FirstSample) / Segments[n - 1].SampleRateHertz;
+				}
+				TriggerTime = timeOf((double)BlockInfo.TriggerSample);
+			}
+
+			/// Time of a (fractional) sample position, sample 0 at time 0
+			double timeOf(double Position) const {
+				size_t n = Segments.size() - 1;
+				while (n > 0 && Position < (double)Segments[n].FirstSample) n--;
+				return Times[n] + (Position - (double)Segments[n].FirstSample) / Segments[n].SampleRateHertz;
+			}
+
+			/// Fractional sample position of a time relative to the trigger
+			double positionOf(double Seconds) const {
+				const double t = Seconds + TriggerTime;
+				size_t n = Segments.size() - 1;
+				while (n > 0 && t < Times[n]) n--;
+				double position = (double)Segments[n].FirstSample + (t - Times[n]) * Segments[n].SampleRateHertz;
+				// a point exactly at a sample must not fall to the previous sample by rounding
+				const double rounded = std::floor(position + 0.5);
+				if (std::fabs(position - rounded) < 1e-6) position = rounded;
+				return position;
+			}
+
+			template <typename R>
+			bdfAPI::eErrorCode run(double StartSeconds, double RateHertz, T* Data, unsigned Count, eMethod Method) {
+				std::vector<R> buffer;
+				uint64_t bufferStart = 0, bufferEnd = 0;
+				const T nan = std::numeric_limits<T>::quiet_NaN();
+				const uint32_t mask = InputInfo.AnalogMask;
+				// single samples far apart are read one by one instead of a chunk per sample
+				const double step = (positionOf(StartSeconds + Count / RateHertz) - positionOf(StartSeconds)) / (Count > 0 ? Count : 1);
+				const uint64_t sampleChunk = step >= SparseStep ? 1 : Chunk;
+				auto sample = [&](uint64_t Address, bdfAPI::eErrorCode& Err) -> int64_t {
+					if (Address < bufferStart || Address >= bufferEnd) {
+						Err = fill(buffer, Address, sampleChunk, bufferStart, bufferEnd);
+						if (Err != bdfAPI::errNoError) return 0;
+					}
+					return (int64_t)((uint32_t)buffer[(size_t)(Address - bufferStart)] & mask);
+				};
+
+				double begin = positionOf(StartSeconds);
+				for (unsigned k = 0; k < Count; k++) {
+					const double end = positionOf(StartSeconds + (k + 1) / RateHertz);
+					// samples of the point: [first, last)
+					const double first = std::ceil(begin);
+					const double last = std::max(std::ceil(end), first);
+					const double held = std::floor(begin);
+					bdfAPI::eErrorCode err = bdfAPI::errNoError;
+
+					if (Method == methodSample || first >= last) {
+						const double position = first < last ? first : held;
+						if (position < 0 || position >= (double)Length) {
+							Data[Method == methodMinMax ? 2 * k : k] = nan;
+							if (Method == methodMinMax) Data[2 * k + 1] = nan;
+						}
+						else {
+							const T value = scale(sample((uint64_t)position, err));
+							if (err != bdfAPI::errNoError) return err;
+							if (Method == methodMinMax) {
+								Data[2 * k] = value;
+								Data[2 * k + 1] = value;
+							}
+							else {
+								Data[k] = value;
+							}
+						}
+					}
+					else {
+						const uint64_t from = (uint64_t)std::max(first, 0.0);
+						const uint64_t to = (uint64_t)std::min(last, (double)Length);
+						if (from >= to) {
+							Data[Method == methodMinMax ? 2 * k : k] = nan;
+							if (Method == methodMinMax) Data[2 * k + 1] = nan;
+						}
+						else {
+							uint64_t sum = 0;
+							uint32_t mn = UINT32_MAX, mx = 0;
+							for (uint64_t pos = from; pos < to;) {
+								if (pos < bufferStart || pos >= bufferEnd) {
+									err = fill(buffer, pos, Chunk, bufferStart, bufferEnd);
+									if (err != bdfAPI::errNoError) return err;
+								}
+								const size_t offset = (size_t)(pos - bufferStart);
+								const size_t n = (size_t)(std::min(to, bufferEnd) - pos);
+								if (Method == methodMean) sum += sumOf(buffer.data() + offset, n, mask);
+								else minMaxOf(buffer.data() + offset, n, mask, mn, mx);
+								pos += n;
+							}
+							if (Method == methodMean) {
+								Data[k] = (T)((double)sum / (double)(to - from) * Factor + Constant);
+							}
+							else {
+								Data[2 * k] = scale(mn);
+								Data[2 * k + 1] = scale(mx);
+							}
+						}
+					}
+					begin = end;
+				}
+				return bdfAPI::errNoError;
+			}
+
+			T scale(int64_t Raw) const { return (T)((double)Raw * Factor + Constant); }
+
+			template <typename R>
+			bdfAPI::eErrorCode fill(std::vector<R>& Buffer, uint64_t Address, uint64_t Size, uint64_t& Start, uint64_t& End) {
+				const unsigned n = (unsigned)std::min(Size, Length - Address);
+				Buffer.resize(n);
+				Start = End = 0;
+				bdfAPI::eErrorCode err = read(Address, Buffer.data(), n);
+				if (err != bdfAPI::errNoError) return err;
+				Start = Address;
+				End = Address + n;
+				return bdfAPI::errNoError;
+			}
+
+			bdfAPI::eErrorCode read(uint64_t Address, uint16_t* Buffer, unsigned N) { return Api->getRawDataS(Group, Input, Block, Address, Buffer, N); }
+			bdfAPI::eErrorCode read(uint64_t Address, int32_t* Buffer, unsigned N) { return Api->getRawDataL(Group, Input, Block, Address, Buffer, N); }
+
+			template <typename R>
+			static uint64_t sumOf(const R* Src, size_t N, uint32_t Mask) {
+				uint64_t sum = 0;
+				for (size_t k = 0; k < N; k++) sum += (uint32_t)Src[k] & Mask;
+				return sum;
+			}
+
+			static void minMaxOf(const uint16_t* Src, size_t N, uint32_t Mask, uint32_t& Min, uint32_t& Max) {
+				uint16_t mn = 0xFFFF, mx = 0;
+				bdfConvert::minMax(Src, N, Mask, mn, mx);
+				Min = std::min<uint32_t>(Min, mn);
+				Max = std::max<uint32_t>(Max, mx);
+			}
+
+			static void minMaxOf(const int32_t* Src, size_t N, uint32_t Mask, uint32_t& Min, uint32_t& Max) {
+				for (size_t k = 0; k < N; k++) {
+					const uint32_t v = (uint32_t)Src[k] & Mask;
+					Min = std::min(Min, v);
+					Max = std::max(Max, v);
+				}
+			}
+
+			bdfAPI* Api;
+			const bdfAPI::sInputInfo& InputInfo;
+			const unsigned Group;
+			const unsigned Input;
+			const unsigned Block;
+			const uint64_t Length;
+			const std::vector<sTimebaseSegment>& Segments;
+			std::vector<double> Times;
+			double TriggerTime = 0;
+			double Factor = 1;
+			double Constant = 0;
+			uint64_t Chunk = 0;
+		};
+
+		static constexpr uint64_t DefaultTransferSize = 1024 * 1024;
+		static constexpr double SparseStep = 4096;
+	};
+}
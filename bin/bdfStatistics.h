@@ -0,0 +1,498 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfConvert.h"
+#include "bdfIndex.h"
+#include "bdfParallel.h"
+
+namespace filereader {
+	/// <summary>
+	/// Summary statistics of blocks: minimum, maximum, mean, RMS, standard deviation and the number of samples
+	/// at the rails of the ADC ((raw & AnalogMask) == 0 or == AnalogMask).
+	/// The statistics are accumulated on the masked raw words in one pass with SIMD kernels selected like the
+	/// bdfConvert kernels, and scaled to volt or physical unit afterwards.
+	/// </summary>
+	class bdfStatistics {
+	public:
+		/// Statistics of masked raw words
+		struct sRawStatistics {
+			uint64_t Count;
+			uint32_t Min;
+			uint32_t Max;
+			double Mean;
+			double M2; /// Sum of squared differences from the mean
+			uint64_t ClipLow; /// Samples with (raw & AnalogMask) == 0
+			uint64_t ClipHigh; /// Samples with (raw & AnalogMask) == AnalogMask
+		};
+
+		/// Statistics in volt or physical unit, NaN if Count is 0
+		struct sStatistics {
+			uint64_t Count;
+			double Min;
+			double Max;
+			double Mean;
+			double Rms;
+			double StdDev; /// Standard deviation of all samples (population)
+			uint64_t ClipLow;
+			uint64_t ClipHigh;
+		};
+
+		/// Empty raw statistics
+		static sRawStatistics empty() { return sRawStatistics{ 0, UINT32_MAX, 0, 0, 0, 0, 0 }; }
+
+		/// <summary>
+		/// Add raw words to statistics
+		/// </summary>
+		/// <param name="Src">Raw words</param>
+		/// <param name="Count">Number of samples</param>
+		/// <param name="Mask">AnalogMask of the input</param>
+		/// <param name="Statistics">Statistics to update</param>
+		/// <param name="Isa">Kernel to use</param>
+		static void accumulate(const uint16_t* Src, size_t Count, uint32_t Mask, sRawStatistics& Statistics, bdfConvert::eInstructionSet Isa = bdfConvert::isaBest) {
+			if (Isa == bdfConvert::isaBest || Isa > bdfConvert::instructionSet()) Isa = bdfConvert::instructionSet();
+			Mask &= 0xFFFF;
+			for (size_t pos = 0; pos < Count; pos += SubBlock) {
+				// integer sums of a sub-block are exact, sub-blocks are merged in floating point
+				const size_t n = Count - pos < SubBlock ? Count - pos : SubBlock;
+				sSums sums = { 0, 0, 0, 0, UINT32_MAX, 0 };
+				size_t done = 0;
+				switch (Isa) {
+#ifdef BDF_CONVERT_X86
+				case bdfConvert::isaAVX512:
+				case bdfConvert::isaAVX2: done = sums_AVX2(Src + pos, n, (uint16_t)Mask, sums); break;
+				case bdfConvert::isaSSE2: done = sums_SSE2(Src + pos, n, (uint16_t)Mask, sums); break;
+#endif
+				default: break;
+				}
+				for (size_t k = pos + done; k < pos + n; k++) {
+					const uint32_t v = Src[k] & Mask;
+					add(sums, v, Mask);
+					sums.SumSquares += (uint64_t)v * v;
+				}
+				const double mean = (double)sums.Sum / (double)n;
+				double m2 = (double)sums.SumSquares - (double)sums.Sum * mean;
+				merge(Statistics, sRawStatistics{ (uint64_t)n, sums.Min, sums.Max, mean, m2 > 0 ? m2 : 0, sums.ClipLow, sums.ClipHigh });
+			}
+		}
+
+		/// <summary>
+		/// Add 32-bit raw values to statistics
+		/// </summary>
+		static void accumulate(const int32_t* Src, size_t Count, uint32_t Mask, sRawStatistics& Statistics) {
+			for (size_t pos = 0; pos < Count; pos += SubBlock) {
+				const size_t n = Count - pos < SubBlock ? Count - pos : SubBlock;
+				sSums sums = { 0, 0, 0, 0, UINT32_MAX, 0 };
+				for (size_t k = pos; k < pos + n; k++) add(sums, (uint32_t)Src[k] & Mask, Mask);
+				// the squares of 32-bit values do not fit into 64 bits, so M2 is summed around the mean
+				const double mean = (double)sums.Sum / (double)n;
+				double m2 = 0;
+				for (size_t k = pos; k < pos + n; k++) {
+					const double d = (double)((uint32_t)Src[k] & Mask) - mean;
+					m2 += d * d;
+				}
+				merge(Statistics, sRawStatistics{ (uint64_t)n, sums.Min, sums.Max, mean, m2, sums.ClipLow, sums.ClipHigh });
+			}
+		}
+
+		/// <summary>
+		/// Merge statistics of two disjoint sets of samples
+		/// </summary>
+		static void merge(sRawStatistics& A, const sRawStatistics& B) {
+			if (B.Count == 0) return;
+			if (A.Count == 0) {
+				A = B;
+				return;
+			}
+			const double count = (double)(A.Count + B.Count);
+			const double delta = B.Mean - A.Mean;
+			A.Mean += delta * (double)B.Count / count;
+			A.M2 += B.M2 + delta * delta * (double)A.Count * (double)B.Count / count;
+			A.Count += B.Count;
+			if (B.Min < A.Min) A.Min = B.Min;
+			if (B.Max > A.Max) A.Max = B.Max;
+			A.ClipLow += B.ClipLow;
+			A.ClipHigh += B.ClipHigh;
+		}
+
+		/// <summary>
+		/// Scale raw statistics
+		/// </summary>
+		/// <param name="Factor">BinToVoltFactor or BinToPhysicalFactor of the input</param>
+		/// <param name="Constant">BinToVoltConstant or BinToPhysicalConstant of the input</param>
+		static sStatistics scale(const sRawStatistics& Raw, double Factor, double Constant) {
+			sStatistics s;
+			s.Count = Raw.Count;
+			s.ClipLow = Raw.ClipLow;
+			s.ClipHigh = Raw.ClipHigh;
+			if (Raw.Count == 0) {
+				s.Min = s.Max = s.Mean = s.Rms = s.StdDev = std::numeric_limits<double>::quiet_NaN();
+				return s;
+			}
+			const double a = Raw.Min * Factor + Constant, b = Raw.Max * Factor + Constant;
+			s.Min = a < b ? a : b;
+			s.Max = a < b ? b : a;
+			s.Mean = Raw.Mean * Factor + Constant;
+			s.StdDev = std::sqrt(Raw.M2 / (double)Raw.Count) * std::fabs(Factor);
+			s.Rms = std::sqrt(s.StdDev * s.StdDev + s.Mean * s.Mean);
+			return s;
+		}
+
+		/// <summary>
+		/// Compute the raw statistics of a block in one chunked pass
+		/// </summary>
+		/// <param name="Api">API object with a loaded file</param>
+		/// <returns>eErrorCode</returns>
+		static bdfAPI::eErrorCode compute(bdfAPI* Api, unsigned Group, unsigned Input, unsigned Block, sRawStatistics& Statistics) {
+			bdfAPI::sInputInfo inputInfo;
+			bdfAPI::eErrorCode err = Api->getInputInfo(Group, Input, &inputInfo);
+			if (err != bdfAPI::errNoError) return err;
+			bdfAPI::sBlockInfo blockInfo;
+			err = Api->getBlockInfo(Group, Input, Block, &blockInfo);
+			if (err != bdfAPI::errNoError) return err;
+
+			Statistics = empty();
+			const uint64_t chunk = blockInfo.PreferredTransferSize > 0 ? blockInfo.PreferredTransferSize : DefaultTransferSize;
+			try {
+				std::vector<uint16_t> dataS;
+				std::vector<int32_t> dataL;
+				for (uint64_t pos = 0; pos < blockInfo.BlockLength; pos += chunk) {
+					const unsigned n = (unsigned)(blockInfo.BlockLength - pos < chunk ? blockInfo.BlockLength - pos : chunk);
+					if (inputInfo.BytesPerSample <= 2) {
+						dataS.resize(n);
+						err = Api->getRawDataS(Group, Input, Block, pos, dataS.data(), n);
+						if (err != bdfAPI::errNoError) return err;
+						accumulate(dataS.data(), n, inputInfo.AnalogMask, Statistics);
+					}
+					else {
+						dataL.resize(n);
+						err = Api->getRawDataL(Group, Input, Block, pos, dataL.data(), n);
+						if (err != bdfAPI::errNoError) return err;
+						accumulate(dataL.data(), n, inputInfo.AnalogMask, Statistics);
+					}
+				}
+			}
+			catch (const std::bad_alloc&) {
+				return bdfAPI::errResource;
+			}
+			return bdfAPI::errNoError;
+		}
+
+	private:
+		/// Exact integer sums of a sub-block
+		struct sSums {
+			uint64_t Sum;
+			uint64_t SumSquares;
+			uint64_t ClipLow;
+			uint64_t ClipHigh;
+			uint32_t Min;
+			uint32_t Max;
+		};
+
+		static void add(sSums& Sums, uint32_t Value, uint32_t Mask) {
+			Sums.Sum += Value;
+			if (Value < Sums.Min) Sums.Min = Value;
+			if (Value > Sums.Max) Sums.Max = Value;
+			if (Value == 0) Sums.ClipLow++;
+			if (Value == Mask) Sums.ClipHigh++;
+		}
+
+		static constexpr size_t SubBlock = 65536;
+		static constexpr uint64_t DefaultTransferSize = 1024 * 1024;
+
+#ifdef BDF_CONVERT_X86
+		// The kernels work on v' = (raw & Mask) ^ 0x8000, the raw word as signed 16-bit value minus 32768.
+		// madd(v', 1) sums pairs and madd(v', v') squares pairs (at most 2^31, read as unsigned), signed min/max
+		// of v' order like the raw words. The raw sums follow from sum(v) = sum(v') + 32768 n and
+		// sum(v^2) = sum(v'^2) + 65536 sum(v') + 2^30 n.
+
+		BDF_TARGET_SSE2 static size_t sums_SSE2(const uint16_t* Src, size_t Count, uint16_t Mask, sSums& Sums) {
+			const __m128i mask = _mm_set1_epi16((short)Mask);
+			const __m128i bias = _mm_set1_epi16((short)0x8000);
+			const __m128i ones = _mm_set1_epi16(1);
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i high = _mm_set1_epi16((short)(Mask ^ 0x8000));
+			__m128i sum = zero, squares = zero, clipLow = zero, clipHigh = zero;
+			__m128i mn = _mm_set1_epi16(0x7FFF), mx = _mm_set1_epi16((short)0x8000);
+			size_t k = 0;
+			for (; k + 8 <= Count; k += 8) {
+				__m128i v = _mm_xor_si128(_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(Src + k)), mask), bias);
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(v, ones));
+				__m128i sq = _mm_madd_epi16(v, v);
+				squares = _mm_add_epi64(squares, _mm_add_epi64(_mm_unpacklo_epi32(sq, zero), _mm_unpackhi_epi32(sq, zero)));
+				mn = _mm_min_epi16(mn, v);
+				mx = _mm_max_epi16(mx, v);
+				clipLow = _mm_sub_epi16(clipLow, _mm_cmpeq_epi16(v, bias));
+				clipHigh = _mm_sub_epi16(clipHigh, _mm_cmpeq_epi16(v, high));
+			}
+			int32_t s[4];
+			uint64_t q[2];
+			int16_t a[8], b[8];
+			uint16_t lo[8], hi[8];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(s), sum);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(q), squares);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(a), mn);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(b), mx);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lo), clipLow);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(hi), clipHigh);
+			int64_t sumBiased = 0;
+			for (int n = 0; n < 4; n++) sumBiased += s[n];
+			uint64_t squaresBiased = q[0] + q[1];
+			for (int n = 0; n < 8; n++) {
+				const uint32_t minRaw = (uint16_t)(a[n] ^ 0x8000), maxRaw = (uint16_t)(b[n] ^ 0x8000);
+				if (k > 0 && minRaw < Sums.Min) Sums.Min = minRaw;
+				if (k > 0 && maxRaw > Sums.Max) Sums.Max = maxRaw;
+				Sums.ClipLow += lo[n];
+				Sums.ClipHigh += hi[n];
+			}
+			unbias(Sums, sumBiased, squaresBiased, k);
+			return k;
+		}
+
+		BDF_TARGET_AVX2 static size_t sums_AVX2(const uint16_t* Src, size_t Count, uint16_t Mask, sSums& Sums) {
+			const __m256i mask = _mm256_set1_epi16((short)Mask);
+			const __m256i bias = _mm256_set1_epi16((short)0x8000);
+			const __m256i ones = _mm256_set1_epi16(1);
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i high = _mm256_set1_epi16((short)(Mask ^ 0x8000));
+			__m256i sum = zero, squares = zero, clipLow = zero, clipHigh = zero;
+			__m256i mn = _mm256_set1_epi16(0x7FFF), mx = _mm256_set1_epi16((short)0x8000);
+			size_t k = 0;
+			for (; k + 16 <= Count; k += 16) {
+				__m256i v = _mm256_xor_si256(_mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(Src + k)), mask), bias);
+				sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, ones));
+				__m256i sq = _mm256_madd_epi16(v, v);
+				squares = _mm256_add_epi64(squares, _mm256_add_epi64(_mm256_unpacklo_epi32(sq, zero), _mm256_unpackhi_epi32(sq, zero)));
+				mn = _mm256_min_epi16(mn, v);
+				mx = _mm256_max_epi16(mx, v);
+				clipLow = _mm256_sub_epi16(clipLow, _mm256_cmpeq_epi16(v, bias));
+				clipHigh = _mm256_sub_epi16(clipHigh, _mm256_cmpeq_epi16(v, high));
+			}
+			int32_t s[8];
+			uint64_t q[4];
+			int16_t a[16], b[16];
+			uint16_t lo[16], hi[16];
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(s), sum);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(q), squares);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(a), mn);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(b), mx);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(lo), clipLow);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(hi), clipHigh);
+			int64_t sumBiased = 0;
+			for (int n = 0; n < 8; n++) sumBiased += s[n];
+			uint64_t squaresBiased = q[0] + q[1] + q[2] + q[3];
+			for (int n = 0; n < 16; n++) {
+				const uint32_t minRaw = (uint16_t)(a[n] ^ 0x8000), maxRaw = (uint16_t)(b[n] ^ 0x8000);
+				if (k > 0 && minRaw < Sums.Min) Sums.Min = minRaw;
+				if (k > 0 && maxRaw > Sums.Max) Sums.Max = maxRaw;
+				Sums.ClipLow += lo[n];
+				Sums.ClipHigh += hi[n];
+			}
+			unbias(Sums, sumBiased, squaresBiased, k);
+			return k;
+		}
+
+		static void unbias(sSums& Sums, int64_t SumBiased, uint64_t SquaresBiased, size_t Count) {
+			Sums.Sum += (uint64_t)(SumBiased + 32768 * (int64_t)Count);
+			Sums.SumSquares += SquaresBiased + (uint64_t)(65536 * SumBiased) + ((uint64_t)Count << 30);
+		}
+#endif
+	};
+
+	/// <summary>
+	/// Statistics of the blocks of a file, cached in a file next to the BDF file (FileName + ".stats").
+	/// Cached statistics are returned without opening the BDF file. Missing statistics are computed in
+	/// parallel over inputs and blocks with one API object per worker thread and added to the cache file.
+	/// The cache is valid as long as the stamp of the BDF file is unchanged.
+	/// </summary>
+	class bdfStatisticsCache {
+	public:
+		/// <summary>
+		/// Open the cache of a file
+		/// </summary>
+		/// <param name="FileName">BDF file</param>
+		/// <param name="NrOfThreads">Worker threads for computing, 0 for the number of hardware threads</param>
+		bdfStatisticsCache(const std::string& FileName, unsigned NrOfThreads = 0) : m_FileName(FileName), m_NrOfThreads(NrOfThreads) {
+			m_Valid = sFileStamp::get(m_FileName, m_Stamp);
+			if (m_Valid) load();
+		}
+
+		/// Cache file name of a BDF file
+		static std::string cacheFileName(const std::string& FileName) { return FileName + ".stats"; }
+
+		/// <summary>
+		/// Get the statistics of a block, computed and cached if not yet known
+		/// </summary>
+		/// <param name="Unit">Scaling to volt or physical unit</param>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode getStatistics(unsigned Group, unsigned Input, unsigned Block, bdfStatistics::sStatistics& Statistics, bdfConvert::eUnit Unit = bdfConvert::unitVolt) {
+			auto it = m_Entries.find(std::make_tuple(Group, Input, Block));
+			if (it == m_Entries.end()) {
+				bdfAPI::eErrorCode err = compute({ std::make_tuple(Group, Input, Block) });
+				if (err != bdfAPI::errNoError) return err;
+				it = m_Entries.find(std::make_tuple(Group, Input, Block));
+			}
+			const sEntry& e = it->second;
+			Statistics = Unit == bdfConvert::unitPhysical ? bdfStatistics::scale(e.Raw, e.PhysicalFactor, e.PhysicalConstant) : bdfStatistics::scale(e.Raw, e.VoltFactor, e.VoltConstant);
+			return bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Compute and cache the statistics of all blocks of all inputs which are not cached yet
+		/// </summary>
+		/// <returns>eErrorCode</returns>
+		bdfAPI::eErrorCode computeAll() {
+			bdfAPI::eErrorCode err = open();
+			if (err != bdfAPI::errNoError) return err;
+			bdfAPI* api = m_Reader->api();
+			std::vector<tKey> keys;
+			for (unsigned g = 0; g < api->getNumberOfGroups(); g++) {
+				for (unsigned i = 0; i < api->getNumberOfInputs(g); i++) {
+					for (unsigned b = 0; b < api->getNumberOfBlocks(g, i); b++) {
+						if (m_Entries.find(std::make_tuple(g, i, b)) == m_Entries.end()) keys.push_back(std::make_tuple(g, i, b));
+					}
+				}
+			}
+			return compute(keys);
+		}
+
+	private:
+		typedef std::tuple<unsigned, unsigned, unsigned> tKey;
+
+		struct sEntry {
+			bdfStatistics::sRawStatistics Raw;
+			double VoltFactor;
+			double VoltConstant;
+			double PhysicalFactor;
+			double PhysicalConstant;
+		};
+
+		bdfAPI::eErrorCode open() {
+			if (!m_Valid) return bdfAPI::errArgument;
+			if (!m_Reader) m_Reader.reset(new bdfParallelReader(m_FileName.c_str(), m_NrOfThreads));
+			return m_Reader->isOpen() ? bdfAPI::errNoError : bdfAPI::errInvalidHandle;
+		}
+
+		bdfAPI::eErrorCode compute(const std::vector<tKey>& Keys) {
+			if (Keys.empty()) return bdfAPI::errNoError;
+			bdfAPI::eErrorCode err = open();
+			if (err != bdfAPI::errNoError) return err;
+			std::vector<sEntry> entries(Keys.size());
+			err = m_Reader->run(Keys.size(), [&](bdfAPI* api, size_t n) {
+				const unsigned group = std::get<0>(Keys[n]), input = std::get<1>(Keys[n]), block = std::get<2>(Keys[n]);
+				bdfAPI::sInputInfo inputInfo;
+				bdfAPI::eErrorCode e = api->getInputInfo(group, input, &inputInfo);
+				if (e != bdfAPI::errNoError) return e;
+				entries[n].VoltFactor = inputInfo.BinToVoltFactor;
+				entries[n].VoltConstant = inputInfo.BinToVoltConstant;
+				entries[n].PhysicalFactor = inputInfo.BinToPhysicalFactor;
+				entries[n].PhysicalConstant = inputInfo.BinToPhysicalConstant;
+				return bdfStatistics::compute(api, group, input, block, entries[n].Raw);
+			});
+			if (err != bdfAPI::errNoError) return err;
+			for (size_t n = 0; n < Keys.size(); n++) m_Entries[Keys[n]] = entries[n];
+			save();
+			return bdfAPI::errNoError;
+		}
+
+		void load() {
+			std::ifstream file(cacheFileName(m_FileName), std::ios::binary);
+			if (!file) return;
+			std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			if (data.size() < sizeof(Magic) + sizeof(uint64_t) || memcmp(data.data(), Magic, sizeof(Magic)) != 0) return;
+			uint64_t checksum;
+			memcpy(&checksum, data.data() + data.size() - sizeof(checksum), sizeof(checksum));
+			if (checksum != sFileStamp::hash(data.data(), data.size() - sizeof(checksum))) return;
+
+			size_t pos = sizeof(Magic);
+			uint32_t version;
+			uint64_t count;
+			sFileStamp stamp;
+			if (!get(data, pos, version) || version != Version) return;
+			if (!get(data, pos, stamp.Size) || !get(data, pos, stamp.ModifiedTime) || !get(data, pos, stamp.Hash) || stamp != m_Stamp) return;
+			if (!get(data, pos, count)) return;
+			std::map<tKey, sEntry> entries;
+			for (uint64_t n = 0; n < count; n++) {
+				uint32_t g, i, b;
+				sEntry e;
+				if (!get(data, pos, g) || !get(data, pos, i) || !get(data, pos, b)) return;
+				if (!get(data, pos, e.Raw.Count) || !get(data, pos, e.Raw.Min) || !get(data, pos, e.Raw.Max) || !get(data, pos, e.Raw.Mean) || !get(data, pos, e.Raw.M2)
+					|| !get(data, pos, e.Raw.ClipLow) || !get(data, pos, e.Raw.ClipHigh)) return;
+				if (!get(data, pos, e.VoltFactor) || !get(data, pos, e.VoltConstant) || !get(data, pos, e.PhysicalFactor) || !get(data, pos, e.PhysicalConstant)) return;
+				entries[std::make_tuple(g, i, b)] = e;
+			}
+			m_Entries.swap(entries);
+		}
+
+		void save() const {
+			std::string data;
+			data.append(Magic, sizeof(Magic));
+			put(data, Version);
+			put(data, m_Stamp.Size);
+			put(data, m_Stamp.ModifiedTime);
+			put(data, m_Stamp.Hash);
+			put(data, (uint64_t)m_Entries.size());
+			for (const auto& it : m_Entries) {
+				const sEntry& e = it.second;
+				put(data, (uint32_t)std::get<0>(it.first));
+				put(data, (uint32_t)std::get<1>(it.first));
+				put(data, (uint32_t)std::get<2>(it.first));
+				put(data, e.Raw.Count);
+				put(data, e.Raw.Min);
+				put(data, e.Raw.Max);
+				put(data, e.Raw.Mean);
+				put(data, e.Raw.M2);
+				put(data, e.Raw.ClipLow);
+				put(data, e.Raw.ClipHigh);
+				put(data, e.VoltFactor);
+				put(data, e.VoltConstant);
+				put(data, e.PhysicalFactor);
+				put(data, e.PhysicalConstant);
+			}
+			put(data, sFileStamp::hash(data.data(), data.size()));
+
+			// the cache is only an optimization, a failed write is ignored
+			const std::string name = cacheFileName(m_FileName), tmp = name + ".tmp";
+			{
+				std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+				if (!file) return;
+				file.write(data.data(), (std::streamsize)data.size());
+				if (!file) return;
+			}
+			std::error_code ec;
+			std::filesystem::rename(tmp, name, ec);
+		}
+
+		template <typename T>
+		static void put(std::string& Data, const T& Value) { Data.append(reinterpret_cast<const char*>(&Value), sizeof(T)); }
+
+		template <typename T>
+		static bool get(const std::string& Data, size_t& Pos, T& Value) {
+			if (Data.size() - sizeof(uint64_t) < Pos + sizeof(T)) return false;
+			memcpy(&Value, Data.data() + Pos, sizeof(T));
+			Pos += sizeof(T);
+			return true;
+		}
+
+		static constexpr char Magic[8] = { 'B', 'D', 'F', 'S', 'T', 'A', 'T', 0 };
+		static constexpr uint32_t Version = 1;
+
+		const std::string m_FileName;
+		const unsigned m_NrOfThreads;
+		sFileStamp m_Stamp = {};
+		bool m_Valid = false;
+		std::map<tKey, sEntry> m_Entries;
+		std::unique_ptr<bdfParallelReader> m_Reader;
+	};
+}
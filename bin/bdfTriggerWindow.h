@@ -0,0 +1,128 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfConvert.h"
+#include "bdfParallel.h"
+
+namespace filereader {
+	/// <summary>
+	/// Trigger aligned windows of many blocks, e.g. for overlaying the events of a multiEventRecorder file.
+	/// A window starts at TriggerSample + Offset of each block (Offset &lt; 0 for pre-trigger samples) and
+	/// has the same length for all blocks. The result is a dense array Data[(block index * inputs + input index) * Length + sample].
+	/// Samples of a window outside of its block are set to a padding value and marked invalid in the optional mask.
+	/// Blocks are read in ascending order, which is the order in the file; the parallel version reads one block per task.
+	/// </summary>
+	class bdfTriggerWindows {
+	public:
+		/// <summary>
+		/// Read the windows through one API object
+		/// </summary>
+		/// <param name="Api">API object with a loaded file</param>
+		/// <param name="Group"></param>
+		/// <param name="Blocks">Blocks to read, empty for all blocks</param>
+		/// <param name="Inputs">Inputs to read, empty for all inputs of the group</param>
+		/// <param name="Offset">Start of the window relative to the trigger sample</param>
+		/// <param name="Length">Samples per window</param>
+		/// <param name="Data">Blocks * Inputs * Length values</param>
+		/// <param name="Valid">Optional mask of the same size, 1 for samples of the block, 0 for padding</param>
+		/// <param name="Unit">Scaling to volt or physical unit</param>
+		/// <param name="Padding">Value of samples outside of the block</param>
+		/// <returns>eErrorCode</returns>
+		template <typename T>
+		static bdfAPI::eErrorCode getWindows(bdfAPI* Api, unsigned Group, const std::vector<unsigned>& Blocks, const std::vector<unsigned>& Inputs, int64_t Offset, unsigned Length, T* Data, uint8_t* Valid = nullptr,
+			bdfConvert::eUnit Unit = bdfConvert::unitVolt, T Padding = std::numeric_limits<T>::quiet_NaN()) {
+			sRequest request;
+			bdfAPI::eErrorCode err = prepare(Api, Group, Blocks, Inputs, request);
+			if (err != bdfAPI::errNoError) return err;
+			for (size_t n = 0; n < request.Order.size(); n++) {
+				err = readBlock(Api, request, n, Offset, Length, Data, Valid, Unit, Padding);
+				if (err != bdfAPI::errNoError) return err;
+			}
+			return bdfAPI::errNoError;
+		}
+
+		/// <summary>
+		/// Read the windows in parallel, one block per task
+		/// </summary>
+		/// <param name="Reader">Parallel reader of the file</param>
+		/// <returns>eErrorCode</returns>
+		template <typename T>
+		static bdfAPI::eErrorCode getWindows(bdfParallelReader& Reader, unsigned Group, const std::vector<unsigned>& Blocks, const std::vector<unsigned>& Inputs, int64_t Offset, unsigned Length, T* Data, uint8_t* Valid = nullptr,
+			bdfConvert::eUnit Unit = bdfConvert::unitVolt, T Padding = std::numeric_limits<T>::quiet_NaN()) {
+			if (!Reader.isOpen()) return bdfAPI::errInvalidHandle;
+			sRequest request;
+			bdfAPI::eErrorCode err = prepare(Reader.api(), Group, Blocks, Inputs, request);
+			if (err != bdfAPI::errNoError) return err;
+			return Reader.run(request.Order.size(), [&](bdfAPI* api, size_t n) {
+				return readBlock(api, request, n, Offset, Length, Data, Valid, Unit, Padding);
+			});
+		}
+
+	private:
+		struct sRequest {
+			unsigned Group;
+			std::vector<unsigned> Blocks;
+			std::vector<unsigned> Inputs;
+			std::vector<bdfAPI::sInputInfo> InputInfos;
+			std::vector<size_t> Order; /// Indices into Blocks, by ascending block number
+		};
+
+		static bdfAPI::eErrorCode prepare(bdfAPI* Api, unsigned Group, const std::vector<unsigned>& Blocks, const std::vector<unsigned>& Inputs, sRequest& Request) {
+			Request.Group = Group;
+			Request.Inputs = Inputs;
+			if (Request.Inputs.empty()) {
+				for (unsigned i = 0; i < Api->getNumberOfInputs(Group); i++) Request.Inputs.push_back(i);
+			}
+			if (Request.Inputs.empty()) return bdfAPI::errArgument;
+			Request.Blocks = Blocks;
+			if (Request.Blocks.empty()) {
+				for (unsigned b = 0; b < Api->getNumberOfBlocks(Group, Request.Inputs[0]); b++) Request.Blocks.push_back(b);
+			}
+
+			Request.InputInfos.resize(Request.Inputs.size());
+			for (size_t i = 0; i < Request.Inputs.size(); i++) {
+				bdfAPI::eErrorCode err = Api->getInputInfo(Group, Request.Inputs[i], &Request.InputInfos[i]);
+				if (err != bdfAPI::errNoError) return err;
+			}
+
+			Request.Order.resize(Request.Blocks.size());
+			for (size_t n = 0; n < Request.Order.size(); n++) Request.Order[n] = n;
+			std::stable_sort(Request.Order.begin(), Request.Order.end(), [&](size_t a, size_t b) { return Request.Blocks[a] < Request.Blocks[b]; });
+			return bdfAPI::errNoError;
+		}
+
+		/// Read the windows of all inputs of the n-th block in file order
+		template <typename T>
+		static bdfAPI::eErrorCode readBlock(bdfAPI* Api, const sRequest& Request, size_t N, int64_t Offset, unsigned Length, T* Data, uint8_t* Valid, bdfConvert::eUnit Unit, T Padding) {
+			const size_t index = Request.Order[N];
+			const unsigned block = Request.Blocks[index];
+			for (size_t i = 0; i < Request.Inputs.size(); i++) {
+				const size_t base = (index * Request.Inputs.size() + i) * (size_t)Length;
+				bdfAPI::sBlockInfo blockInfo;
+				bdfAPI::eErrorCode err = Api->getBlockInfo(Request.Group, Request.Inputs[i], block, &blockInfo);
+				if (err != bdfAPI::errNoError) return err;
+
+				// part of the window inside the block: [first, last) relative to the window start
+				const int64_t start = (int64_t)blockInfo.TriggerSample + Offset;
+				const int64_t length = (int64_t)blockInfo.BlockLength;
+				const int64_t first = std::min<int64_t>(std::max<int64_t>(-start, 0), Length);
+				const int64_t last = std::max<int64_t>(std::min<int64_t>(length - start, Length), first);
+
+				std::fill(Data + base, Data + base + first, Padding);
+				std::fill(Data + base + last, Data + base + Length, Padding);
+				if (Valid != nullptr) {
+					std::fill(Valid + base, Valid + base + Length, (uint8_t)0);
+					std::fill(Valid + base + first, Valid + base + last, (uint8_t)1);
+				}
+				if (last > first) {
+					err = bdfConvert::getData(Api, Request.InputInfos[i], Request.Group, Request.Inputs[i], block, (uint64_t)(start + first), Data + base + first, (unsigned)(last - first), Unit);
+					if (err != bdfAPI::errNoError) return err;
+				}
+			}
+			return bdfAPI::errNoError;
+		}
+	};
+}
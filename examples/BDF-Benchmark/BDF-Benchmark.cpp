@@ -0,0 +1,458 @@
+// ********************************************************************************/
+/* BDF Benchmark
+/*
+/* Generates a synthetic BDF file with the writer API (or takes an existing file) and
+/* times loadFile, sequential and random getRawDataS/getDataD and getEnv* at several
+/* zoom levels, first and warm. The first pass runs on a freshly loaded API object; with
+/* --drop-cache the file is also dropped from the operating system page cache before it,
+/* which makes it a cold pass (Linux only). The results are written as JSON to compare
+/* releases of the DLL.
+/*
+/* Usage: BDF-Benchmark [--mode continuous|ser|mer|ser-dual|mer-dual] [--channels N]
+/*        [--blocks N] [--samples N] [--rate Hz] [--divisor N] [--dir D] [--file F]
+/*        [--repetitions N] [--random N] [--seed N] [--json F] [--drop-cache]
+/*
+/* Contact: email: info@elsys.ch
+/*
+// ********************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "bdfAPI.h"
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace filereader;
+
+// Benchmark settings, set from the command line
+struct sSettings {
+    bdfAPI::eOperationMode Mode = bdfAPI::multiEventRecorder;
+    unsigned Channels = 4;
+    unsigned Blocks = 16;
+    uint64_t Samples = 1 << 20;         // per block and channel
+    double SampleRate = 10e6;
+    unsigned TimebaseDivisor = 10;      // dual modes only
+    string Directory = ".";             // where the DLL writes the generated file
+    string File;                        // existing file, no generation
+    unsigned Repetitions = 5;           // warm passes, the fastest counts
+    unsigned RandomReads = 1000;
+    unsigned Seed = 1;
+    string Json;                        // JSON output file, empty for stdout
+    bool DropCache = false;             // drop the file from the page cache before every first pass
+};
+
+// One measurement
+struct sResult {
+    string Name;
+    string Phase;                       // "first": first pass on a freshly loaded API object, "cold" if the page cache was dropped before it, "warm": fastest repeated pass
+    double Seconds;
+    uint64_t Calls;
+    uint64_t Samples;
+    uint64_t Bytes;
+};
+
+// Work done by one pass
+struct sWork {
+    uint64_t Calls = 0;
+    uint64_t Samples = 0;
+    uint64_t Bytes = 0;
+    bool Ok = true;
+};
+
+// Samples per sequential read
+const unsigned ChunkSamples = 64 * 1024;
+// Samples per random read
+const unsigned RandomSamples = 4096;
+// Envelope pairs per getEnv* request, one screen width
+const unsigned ScreenPixels = 2000;
+
+static const char* modeName(bdfAPI::eOperationMode mode)
+{
+    switch (mode) {
+    case bdfAPI::continuous: return "continuous";
+    case bdfAPI::singleEventRecorder: return "ser";
+    case bdfAPI::multiEventRecorder: return "mer";
+    case bdfAPI::singleEventRecorderDual: return "ser-dual";
+    case bdfAPI::multiEventRecorderDual: return "mer-dual";
+    }
+    return "unknown";
+}
+
+static bool parse(int argc, char* argv[], sSettings& settings)
+{
+    for (int n = 1; n < argc; n += 2) {
+        const string key = argv[n];
+        if (key == "--drop-cache") {
+            settings.DropCache = true;
+            n--;                        // no value
+            continue;
+        }
+        if (n + 1 == argc) return false;    // a key without a value
+        const string value = argv[n + 1];
+        if (key == "--mode") {
+            bool found = false;
+            for (int m = bdfAPI::continuous; m <= bdfAPI::multiEventRecorderDual; m++) {
+                if (value == modeName((bdfAPI::eOperationMode)m)) {
+                    settings.Mode = (bdfAPI::eOperationMode)m;
+                    found = true;
+                }
+            }
+            if (!found) return false;
+        }
+        else if (key == "--channels") settings.Channels = stoul(value);
+        else if (key == "--blocks") settings.Blocks = stoul(value);
+        else if (key == "--samples") settings.Samples = stoull(value);
+        else if (key == "--rate") settings.SampleRate = stod(value);
+        else if (key == "--divisor") settings.TimebaseDivisor = stoul(value);
+        else if (key == "--dir") settings.Directory = value;
+        else if (key == "--file") settings.File = value;
+        else if (key == "--repetitions") settings.Repetitions = stoul(value);
+        else if (key == "--random") settings.RandomReads = stoul(value);
+        else if (key == "--seed") settings.Seed = stoul(value);
+        else if (key == "--json") settings.Json = value;
+        else return false;
+    }
+    if (settings.Mode == bdfAPI::continuous || settings.Mode == bdfAPI::singleEventRecorder || settings.Mode == bdfAPI::singleEventRecorderDual) settings.Blocks = 1;
+    return settings.Channels > 0 && settings.Blocks > 0 && settings.Samples > 0 && settings.SampleRate > 0 && settings.Repetitions > 0;
+}
+
+static double seconds(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Drop the file from the operating system page cache, so the next read comes from the disk
+static bool dropCache(const string& fileName)
+{
+#if defined(__linux__)
+    const int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    // only clean pages are dropped
+    bool ok = fdatasync(fd) == 0;
+    ok = ok && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return ok;
+#else
+    // purging the standby list on Windows needs administrator rights, not supported
+    (void)fileName;
+    return false;
+#endif
+}
+
+static set<string> listFiles(const string& directory)
+{
+    set<string> files;
+    error_code ec;
+    for (const auto& entry : filesystem::directory_iterator(directory, ec)) {
+        if (entry.path().extension() == ".bdf") files.insert(entry.path().string());
+    }
+    return files;
+}
+
+// Write the synthetic file with the writer API, returns the name of the new file or an empty string
+static string generate(const sSettings& settings, vector<sResult>& results)
+{
+    const set<string> before = listFiles(settings.Directory);
+    bdfAPI* api = CreateBDFAPIObj();
+
+    time_t now = time(nullptr);
+    tm local = *localtime(&now);
+    bdfAPI::sDateTime startTime = { (unsigned)local.tm_year + 1900, (unsigned)local.tm_mon + 1, (unsigned)local.tm_mday, (unsigned)local.tm_hour, (unsigned)local.tm_min, (unsigned)local.tm_sec, 0 };
+    const bool dual = settings.Mode == bdfAPI::singleEventRecorderDual || settings.Mode == bdfAPI::multiEventRecorderDual;
+    const uint32_t triggerSample = settings.Mode == bdfAPI::continuous ? 0 : (uint32_t)(settings.Samples / 4);
+
+    auto start = chrono::steady_clock::now();
+    int group = api->initFileWriter(0, startTime, settings.Mode, settings.SampleRate, dual ? settings.TimebaseDivisor : 1, triggerSample);
+    if (group < 0) {
+        DestroyBDFAPIObj(api);
+        return string();
+    }
+    for (unsigned i = 0; i < settings.Channels; i++) {
+        api->writeInputHeader(0, i, 0xFFFC, 0x0003, 10.0, 0.0, 1.0, 0.0, group);
+        api->setAttribute(i, "ChName", "A" + to_string(i + 1), group);
+        api->setAttribute(i, "ChPhysUnit", "V", group);
+    }
+    api->writeAttributes(group);
+
+    // sine with noise, different per channel; the two marker bits stay 0
+    vector<vector<uint16_t>> chunks(settings.Channels, vector<uint16_t>(ChunkSamples));
+    mt19937 random(settings.Seed);
+    for (unsigned i = 0; i < settings.Channels; i++) {
+        for (unsigned k = 0; k < ChunkSamples; k++) {
+            double v = 32768 + 20000 * sin(2 * 3.14159265358979 * 16 * k / ChunkSamples + i) + (double)(random() % 2048) - 1024;
+            chunks[i][k] = (uint16_t)v & 0xFFFC;
+        }
+    }
+
+    uint64_t bytes = 0;
+    uint64_t calls = 0;
+    bool ok = true;
+    const double blockSeconds = settings.Samples / settings.SampleRate;
+    for (unsigned b = 0; b < settings.Blocks && ok; b++) {
+        vector<int> streamers(settings.Channels);
+        for (unsigned i = 0; i < settings.Channels && ok; i++) {
+            streamers[i] = api->initInputStreamer(0, i, b, group);
+            ok = streamers[i] >= 0;
+        }
+        for (uint64_t address = 0; address < settings.Samples && ok; address += ChunkSamples) {
+            const unsigned count = (unsigned)min<uint64_t>(ChunkSamples, settings.Samples - address);
+            for (unsigned i = 0; i < settings.Channels && ok; i++) {
+                ok = api->writeData(streamers[i], (char*)chunks[i].data(), count * sizeof(uint16_t), group) == bdfAPI::errNoError;
+                bytes += count * sizeof(uint16_t);
+                calls++;
+            }
+        }
+        const uint64_t triggerTime = (uint64_t)((2 * b * blockSeconds + triggerSample / settings.SampleRate) * 1e12);
+        for (unsigned i = 0; i < settings.Channels && ok; i++) api->writeEORInfo(b, triggerTime, settings.Samples * sizeof(uint16_t), i, 0, group);
+    }
+    api->closeFile(group);
+    DestroyBDFAPIObj(api);
+    if (!ok) {
+        cerr << "writing block data failed" << endl;
+        return string();
+    }
+    results.push_back({ "write", "first", seconds(start), calls, bytes / sizeof(uint16_t), bytes });
+
+    // the DLL names the file, take the newest new one
+    string file;
+    filesystem::file_time_type newest;
+    for (const string& name : listFiles(settings.Directory)) {
+        if (before.count(name)) continue;
+        error_code ec;
+        auto time = filesystem::last_write_time(name, ec);
+        if (!ec && (file.empty() || time > newest)) {
+            file = name;
+            newest = time;
+        }
+    }
+    return file;
+}
+
+// Time one kind of access: the first pass on a freshly loaded API object, cold with --drop-cache, then the fastest
+// of the repeated passes
+static bool measure(const sSettings& settings, const string& fileName, const string& name, const function<sWork(bdfAPI*)>& pass, vector<sResult>& results)
+{
+    bdfAPI* api = CreateBDFAPIObj();
+    if (api->loadFile(fileName.c_str()) == -1 || (settings.DropCache && !dropCache(fileName))) {
+        DestroyBDFAPIObj(api);
+        return false;
+    }
+    auto start = chrono::steady_clock::now();
+    sWork work = pass(api);
+    if (work.Ok) results.push_back({ name, settings.DropCache ? "cold" : "first", seconds(start), work.Calls, work.Samples, work.Bytes });
+    double best = 1e30;
+    for (unsigned r = 0; r < settings.Repetitions && work.Ok; r++) {
+        start = chrono::steady_clock::now();
+        work = pass(api);
+        best = min(best, seconds(start));
+    }
+    if (work.Ok) results.push_back({ name, "warm", best, work.Calls, work.Samples, work.Bytes });
+    api->closeFile();
+    DestroyBDFAPIObj(api);
+    return work.Ok;
+}
+
+// Read every block of every input from start to end
+template <typename T>
+static sWork sequential(bdfAPI* api, bdfAPI::eErrorCode (bdfAPI::*read)(unsigned, unsigned, unsigned, uint64_t, T*, unsigned))
+{
+    sWork work;
+    vector<T> data(ChunkSamples);
+    for (unsigned g = 0; g < api->getNumberOfGroups(); g++) {
+        for (unsigned i = 0; i < api->getNumberOfInputs(g); i++) {
+            for (unsigned b = 0; b < api->getNumberOfBlocks(g, i); b++) {
+                bdfAPI::sBlockInfo blockInfo;
+                if (api->getBlockInfo(g, i, b, &blockInfo) != bdfAPI::errNoError) return sWork{ 0, 0, 0, false };
+                for (uint64_t address = 0; address < blockInfo.BlockLength; address += ChunkSamples) {
+                    const unsigned count = (unsigned)min<uint64_t>(ChunkSamples, blockInfo.BlockLength - address);
+                    work.Ok &= (api->*read)(g, i, b, address, data.data(), count) == bdfAPI::errNoError;
+                    work.Calls++;
+                    work.Samples += count;
+                    work.Bytes += count * sizeof(T);
+                }
+            }
+        }
+    }
+    return work;
+}
+
+// Short reads at random inputs, blocks and positions, the same sequence in every pass
+template <typename T>
+static sWork randomReads(bdfAPI* api, const sSettings& settings, bdfAPI::eErrorCode (bdfAPI::*read)(unsigned, unsigned, unsigned, uint64_t, T*, unsigned))
+{
+    sWork work;
+    vector<T> data(RandomSamples);
+    mt19937_64 random(settings.Seed);
+    const unsigned groups = api->getNumberOfGroups();
+    for (unsigned n = 0; n < settings.RandomReads && groups > 0; n++) {
+        const unsigned g = (unsigned)(random() % groups);
+        const unsigned inputs = api->getNumberOfInputs(g);
+        if (inputs == 0) continue;
+        const unsigned i = (unsigned)(random() % inputs);
+        const unsigned blocks = api->getNumberOfBlocks(g, i);
+        if (blocks == 0) continue;
+        const unsigned b = (unsigned)(random() % blocks);
+        bdfAPI::sBlockInfo blockInfo;
+        if (api->getBlockInfo(g, i, b, &blockInfo) != bdfAPI::errNoError) return sWork{ 0, 0, 0, false };
+        const unsigned count = (unsigned)min<uint64_t>(RandomSamples, blockInfo.BlockLength);
+        const uint64_t address = blockInfo.BlockLength > count ? random() % (blockInfo.BlockLength - count + 1) : 0;
+        work.Ok &= (api->*read)(g, i, b, address, data.data(), count) == bdfAPI::errNoError;
+        work.Calls++;
+        work.Samples += count;
+        work.Bytes += count * sizeof(T);
+    }
+    return work;
+}
+
+// Envelope of 1/Zoom of every block, as a viewer panning at that zoom level would request it
+template <typename T>
+static sWork envelope(bdfAPI* api, unsigned zoom, bdfAPI::eErrorCode (bdfAPI::*read)(unsigned, unsigned, unsigned, uint64_t, uint64_t, T*, unsigned))
+{
+    sWork work;
+    vector<T> data(2 * ScreenPixels);
+    const unsigned views = min(zoom, 16u);
+    for (unsigned g = 0; g < api->getNumberOfGroups(); g++) {
+        for (unsigned i = 0; i < api->getNumberOfInputs(g); i++) {
+            for (unsigned b = 0; b < api->getNumberOfBlocks(g, i); b++) {
+                bdfAPI::sBlockInfo blockInfo;
+                if (api->getBlockInfo(g, i, b, &blockInfo) != bdfAPI::errNoError) return sWork{ 0, 0, 0, false };
+                const uint64_t window = blockInfo.BlockLength / zoom;
+                if (window < 2 * ScreenPixels) continue;
+                for (unsigned v = 0; v < views; v++) {
+                    const uint64_t address = (blockInfo.BlockLength - window) * v / max(views - 1, 1u);
+                    work.Ok &= (api->*read)(g, i, b, address, window, data.data(), (unsigned)data.size()) == bdfAPI::errNoError;
+                    work.Calls++;
+                    work.Samples += window;
+                    work.Bytes += data.size() * sizeof(T);
+                }
+            }
+        }
+    }
+    return work;
+}
+
+static string escape(const string& text)
+{
+    string result;
+    for (char c : text) {
+        if (c == '"' || c == '\\') result += '\\';
+        if ((unsigned char)c < 0x20) continue;
+        result += c;
+    }
+    return result;
+}
+
+static void writeJson(ostream& out, const sSettings& settings, const string& fileName, bool generated, const vector<sResult>& results)
+{
+    time_t now = time(nullptr);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    error_code ec;
+    const uintmax_t fileBytes = filesystem::file_size(fileName, ec);
+
+    out.precision(9);
+    out << "{\n"
+        << "  \"benchmark\": \"BDF-Benchmark\",\n"
+        << "  \"version\": 3,\n"
+        << "  \"timestamp\": \"" << timestamp << "\",\n"
+        << "  \"file\": { \"name\": \"" << escape(fileName) << "\", \"bytes\": " << (ec ? 0 : fileBytes) << ", \"generated\": " << (generated ? "true" : "false") << " },\n"
+        << "  \"settings\": { \"repetitions\": " << settings.Repetitions << ", \"randomReads\": " << settings.RandomReads << ", \"seed\": " << settings.Seed
+        << ", \"dropCache\": " << (settings.DropCache ? "true" : "false") << " },\n"
+        // what precedes the first pass: a fresh API object, and with --drop-cache the page cache dropped
+        << "  \"first\": \"" << (settings.DropCache ? "page-cache" : "api") << "\",\n";
+    if (generated) {
+        out << "  \"generator\": { \"mode\": \"" << modeName(settings.Mode) << "\", \"channels\": " << settings.Channels << ", \"blocks\": " << settings.Blocks
+            << ", \"samples\": " << settings.Samples << ", \"sampleRate\": " << settings.SampleRate << " },\n";
+    }
+    out << "  \"results\": [\n";
+    for (size_t n = 0; n < results.size(); n++) {
+        const sResult& r = results[n];
+        const double s = r.Seconds > 0 ? r.Seconds : 1e-12;
+        out << "    { \"name\": \"" << r.Name << "\", \"phase\": \"" << r.Phase << "\", \"seconds\": " << r.Seconds
+            << ", \"calls\": " << r.Calls << ", \"samples\": " << r.Samples << ", \"bytes\": " << r.Bytes
+            << ", \"callsPerSecond\": " << r.Calls / s << ", \"samplesPerSecond\": " << r.Samples / s << ", \"bytesPerSecond\": " << r.Bytes / s
+            << " }" << (n + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+    sSettings settings;
+    if (!parse(argc, argv, settings)) {
+        cerr << "usage: BDF-Benchmark [--mode continuous|ser|mer|ser-dual|mer-dual] [--channels N] [--blocks N] [--samples N] [--rate Hz]"
+            " [--divisor N] [--dir D] [--file F] [--repetitions N] [--random N] [--seed N] [--json F] [--drop-cache]" << endl;
+        return 1;
+    }
+
+    vector<sResult> results;
+    string fileName = settings.File;
+    if (fileName.empty()) {
+        fileName = generate(settings, results);
+        if (fileName.empty()) {
+            cerr << "no file generated in " << settings.Directory << endl;
+            return 1;
+        }
+    }
+
+    // loadFile on fresh objects, the first one is cold with --drop-cache
+    if (settings.DropCache && !dropCache(fileName)) {
+        cerr << "can not drop " << fileName << " from the page cache (--drop-cache is supported on Linux only)" << endl;
+        return 1;
+    }
+    double best = 1e30;
+    for (unsigned r = 0; r <= settings.Repetitions; r++) {
+        bdfAPI* api = CreateBDFAPIObj();
+        auto start = chrono::steady_clock::now();
+        const int error = api->loadFile(fileName.c_str());
+        const double s = seconds(start);
+        if (error == -1) {
+            cerr << "can not load " << fileName << endl;
+            DestroyBDFAPIObj(api);
+            return 1;
+        }
+        if (r == 0) results.push_back({ "loadFile", settings.DropCache ? "cold" : "first", s, 1, 0, 0 });
+        else best = min(best, s);
+        api->closeFile();
+        DestroyBDFAPIObj(api);
+    }
+    results.push_back({ "loadFile", "warm", best, 1, 0, 0 });
+
+    bool ok = true;
+    ok &= measure(settings, fileName, "getRawDataS.sequential", [&](bdfAPI* api) { return sequential(api, &bdfAPI::getRawDataS); }, results);
+    ok &= measure(settings, fileName, "getRawDataS.random", [&](bdfAPI* api) { return randomReads(api, settings, &bdfAPI::getRawDataS); }, results);
+    ok &= measure(settings, fileName, "getDataD.sequential", [&](bdfAPI* api) { return sequential(api, &bdfAPI::getDataD); }, results);
+    ok &= measure(settings, fileName, "getDataD.random", [&](bdfAPI* api) { return randomReads(api, settings, &bdfAPI::getDataD); }, results);
+    for (unsigned zoom : { 1u, 16u, 256u, 4096u }) {
+        ok &= measure(settings, fileName, "getEnvRawDataS.zoom" + to_string(zoom), [&](bdfAPI* api) { return envelope(api, zoom, &bdfAPI::getEnvRawDataS); }, results);
+        ok &= measure(settings, fileName, "getEnvDataD.zoom" + to_string(zoom), [&](bdfAPI* api) { return envelope(api, zoom, &bdfAPI::getEnvDataD); }, results);
+    }
+    if (!ok) cerr << "some reads failed" << endl;
+
+    if (settings.Json.empty()) {
+        writeJson(cout, settings, fileName, settings.File.empty(), results);
+    }
+    else {
+        ofstream out(settings.Json);
+        writeJson(out, settings, fileName, settings.File.empty(), results);
+        if (!out) {
+            cerr << "can not write " << settings.Json << endl;
+            return 1;
+        }
+    }
+    return ok ? 0 : 2;
+}
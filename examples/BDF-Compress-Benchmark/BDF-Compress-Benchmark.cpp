@@ -0,0 +1,192 @@
+// ********************************************************************************/
+/* BDF Compression Benchmark
+/*
+/* Creates a compressed archive (bdfCompress.h) of the example files and compares
+/* size and read throughput of the archive with the original file.
+/*
+/* Contact: email: info@elsys.ch
+/*
+// ********************************************************************************/
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "bdfAPI.h"
+#include "bdfCompress.h"
+
+using namespace std;
+using namespace filereader;
+
+// Number of repetitions per measurement
+const int Repetitions = 5;
+
+// Number of min/max pairs of the envelope reads
+const unsigned EnvelopePairs = 2000;
+
+// Run Read on all blocks of all inputs, returns false if a read fails.
+// Seconds is the fastest repetition, Bytes the raw bytes (BytesPerSample of the input) covered by one repetition.
+template <typename F>
+static bool measure(bdfAPI* api, F Read, double& seconds, uint64_t& bytes)
+{
+    seconds = 1e30;
+    for (int r = 0; r < Repetitions; r++) {
+        bytes = 0;
+        auto start = chrono::steady_clock::now();
+        for (unsigned g = 0; g < api->getNumberOfGroups(); g++) {
+            for (unsigned i = 0; i < api->getNumberOfInputs(g); i++) {
+                bdfAPI::sInputInfo inputInfo;
+                if (api->getInputInfo(g, i, &inputInfo) != bdfAPI::errNoError) return false;
+                for (unsigned b = 0; b < api->getNumberOfBlocks(g, i); b++) {
+                    bdfAPI::sBlockInfo blockInfo;
+                    if (api->getBlockInfo(g, i, b, &blockInfo) != bdfAPI::errNoError) return false;
+                    if (Read(g, i, b, blockInfo) != bdfAPI::errNoError) return false;
+                    bytes += blockInfo.BlockLength * inputInfo.BytesPerSample;
+                }
+            }
+        }
+        double s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (s < seconds) seconds = s;
+    }
+    return true;
+}
+
+// Throughput of the reads of one API object
+struct sReadResult {
+    bool Ok = false;
+    double Raw = 0;         // getRawDataL, GB/s
+    double Double = 0;      // getDataD, GB/s
+    double Envelope = 0;    // getEnvDataD with EnvelopePairs pairs per block, GB/s of covered raw data
+};
+
+static sReadResult readAll(bdfAPI* api)
+{
+    sReadResult result;
+    vector<int32_t> dataL;
+    vector<double> dataD, envelope(2 * EnvelopePairs);
+    double seconds;
+    uint64_t bytes;
+    auto gbs = [&]() { return bytes / seconds / 1e9; };
+
+    if (!measure(api, [&](unsigned g, unsigned i, unsigned b, const bdfAPI::sBlockInfo& blockInfo) {
+        dataL.resize((size_t)blockInfo.BlockLength);
+        return bdfConvert::getRawDataL(api, g, i, b, 0, dataL.data(), (unsigned)blockInfo.BlockLength);
+    }, seconds, bytes)) return result;
+    result.Raw = gbs();
+
+    if (!measure(api, [&](unsigned g, unsigned i, unsigned b, const bdfAPI::sBlockInfo& blockInfo) {
+        dataD.resize((size_t)blockInfo.BlockLength);
+        return api->getDataD(g, i, b, 0, dataD.data(), (unsigned)blockInfo.BlockLength);
+    }, seconds, bytes)) return result;
+    result.Double = gbs();
+
+    if (!measure(api, [&](unsigned g, unsigned i, unsigned b, const bdfAPI::sBlockInfo& blockInfo) {
+        const unsigned pairs = (unsigned)min<uint64_t>(EnvelopePairs, blockInfo.BlockLength);
+        return api->getEnvDataD(g, i, b, 0, blockInfo.BlockLength, envelope.data(), 2 * pairs);
+    }, seconds, bytes)) return result;
+    result.Envelope = gbs();
+
+    result.Ok = true;
+    return result;
+}
+
+// Decode-only throughput of bdfDeltaCodec on the 16-bit inputs of the file, in GB/s of decoded raw data.
+// Returns 0 if the file has no 16-bit input.
+static double decodeAll(bdfAPI* api)
+{
+    vector<uint16_t> chunk(bdfDeltaCodec::ChunkSamples), decoded(bdfDeltaCodec::ChunkSamples);
+    vector<vector<uint8_t>> encoded;
+    vector<unsigned> counts;
+    for (unsigned g = 0; g < api->getNumberOfGroups(); g++) {
+        for (unsigned i = 0; i < api->getNumberOfInputs(g); i++) {
+            bdfAPI::sInputInfo inputInfo;
+            if (api->getInputInfo(g, i, &inputInfo) != bdfAPI::errNoError || inputInfo.BytesPerSample > 2) continue;
+            for (unsigned b = 0; b < api->getNumberOfBlocks(g, i); b++) {
+                bdfAPI::sBlockInfo blockInfo;
+                if (api->getBlockInfo(g, i, b, &blockInfo) != bdfAPI::errNoError) continue;
+                for (uint64_t address = 0; address < blockInfo.BlockLength; address += bdfDeltaCodec::ChunkSamples) {
+                    const unsigned n = (unsigned)min<uint64_t>(bdfDeltaCodec::ChunkSamples, blockInfo.BlockLength - address);
+                    if (api->getRawDataS(g, i, b, address, chunk.data(), n) != bdfAPI::errNoError) return 0;
+                    encoded.emplace_back(bdfDeltaCodec::maxEncodedSize(n));
+                    encoded.back().resize(bdfDeltaCodec::encode(chunk.data(), n, encoded.back().data()));
+                    counts.push_back(n);
+                }
+            }
+        }
+    }
+    if (encoded.empty()) return 0;
+
+    double best = 1e30;
+    uint64_t bytes = 0;
+    for (int r = 0; r < Repetitions; r++) {
+        bytes = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t c = 0; c < encoded.size(); c++) {
+            if (!bdfDeltaCodec::decode(encoded[c].data(), encoded[c].size(), decoded.data(), counts[c])) return 0;
+            bytes += counts[c] * sizeof(uint16_t);
+        }
+        double s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (s < best) best = s;
+    }
+    return bytes / best / 1e9;
+}
+
+static void benchmark(const string& fileName)
+{
+    cout << fileName << endl;
+    bdfAPI* api = CreateBDFAPIObj();
+    if (api->loadFile(fileName.c_str()) != 0) {
+        cout << "  can not load file" << endl;
+        DestroyBDFAPIObj(api);
+        return;
+    }
+
+    const string archiveName = fileName + ".bdfz";
+    bdfArchive::sArchiveStatistics statistics;
+    auto start = chrono::steady_clock::now();
+    bdfAPI::eErrorCode err = bdfArchive::create(api, archiveName, &statistics);
+    double createSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (err != bdfAPI::errNoError) {
+        cout << "  can not create archive, error " << err << endl;
+        DestroyBDFAPIObj(api);
+        return;
+    }
+
+    sReadResult file = readAll(api);
+    double decode = decodeAll(api);
+    DestroyBDFAPIObj(api);
+
+    bdfArchiveReader archive;
+    if (archive.loadFile(archiveName.c_str()) != 0) {
+        cout << "  can not load archive" << endl;
+        return;
+    }
+    sReadResult compressed = readAll(&archive);
+
+    cout << fixed << setprecision(2)
+        << "  raw data      " << setw(10) << statistics.RawBytes / 1e6 << " MB" << endl
+        << "  archive       " << setw(10) << statistics.ArchiveBytes / 1e6 << " MB, ratio " << (double)statistics.RawBytes / statistics.ArchiveBytes << endl
+        << "  create        " << setw(10) << statistics.RawBytes / createSeconds / 1e9 << " GB/s" << endl
+        << "  decode codec  " << setw(10) << decode << " GB/s (in memory, no file access)" << endl;
+    // Both files were just written or read, the reads below come from the page cache and do not show disk throughput
+    cout << "  reads from the page cache (warm), GB/s of raw data:" << endl;
+    auto print = [](const char* name, const sReadResult& result) {
+        if (!result.Ok) {
+            cout << "  " << name << "  read failed" << endl;
+            return;
+        }
+        cout << "  " << name << "  raw " << setw(8) << result.Raw << "  double " << setw(8) << result.Double << "  envelope " << setw(8) << result.Envelope << endl;
+    };
+    print("file   ", file);
+    print("archive", compressed);
+}
+
+int main()
+{
+    cout << "BDF Compression Benchmark\n";
+    benchmark("..\\bdf\\heap0_ECR-2-Channel-10-Blocks.bdf");
+    benchmark("..\\bdf\\heap0_ECR-2-Channel-10-Blocks-Dual.bdf");
+    return 0;
+}
@@ -0,0 +1,85 @@
+// ********************************************************************************/
+/* BDF Conversion Benchmark
+/*
+/* Measures the raw to 32-bit / float / double conversion kernels of bdfConvert.h
+/* for every instruction set supported by the CPU against the scalar path.
+/*
+/* Contact: email: info@elsys.ch
+/*
+// ********************************************************************************/
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "bdfConvert.h"
+
+using namespace std;
+using namespace filereader;
+
+// Number of samples per conversion and number of repetitions per kernel
+const size_t NrOfSamples = 16 * 1024 * 1024;
+const int Repetitions = 20;
+
+static const char* isaName(bdfConvert::eInstructionSet isa)
+{
+    switch (isa) {
+    case bdfConvert::isaScalar: return "scalar";
+    case bdfConvert::isaSSE2: return "SSE2";
+    case bdfConvert::isaAVX2: return "AVX2";
+    case bdfConvert::isaAVX512: return "AVX-512";
+    default: return "?";
+    }
+}
+
+// Run a kernel several times and print the throughput of the fastest run
+template <typename Kernel>
+static void measure(const char* name, bdfConvert::eInstructionSet isa, size_t bytesPerOutput, Kernel kernel)
+{
+    double best = 1e30;
+    for (int r = 0; r < Repetitions; r++) {
+        auto start = chrono::steady_clock::now();
+        kernel(isa);
+        double s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (s < best) best = s;
+    }
+    double inGBs = NrOfSamples * sizeof(uint16_t) / best / 1e9;
+    double outGBs = NrOfSamples * bytesPerOutput / best / 1e9;
+    cout << left << setw(10) << name << setw(10) << isaName(isa) << right << fixed << setprecision(2)
+        << setw(10) << NrOfSamples / best / 1e9 << " GS/s"
+        << setw(10) << inGBs << " GB/s in"
+        << setw(10) << outGBs << " GB/s out" << endl;
+}
+
+int main()
+{
+    cout << "BDF Conversion Benchmark\n";
+    cout << "Best instruction set: " << isaName(bdfConvert::instructionSet()) << endl;
+
+    // synthetic ADC words with marker bits
+    vector<uint16_t> raw(NrOfSamples);
+    uint32_t seed = 1;
+    for (size_t k = 0; k < NrOfSamples; k++) {
+        seed = seed * 1664525u + 1013904223u;
+        raw[k] = (uint16_t)(seed >> 16);
+    }
+    vector<int32_t> dataL(NrOfSamples);
+    vector<float> dataF(NrOfSamples);
+    vector<double> dataD(NrOfSamples);
+
+    const uint32_t analogMask = 0xFFFC;
+    const double factor = 7.8125e-5;
+    const double constant = -2.56;
+
+    for (int i = bdfConvert::isaScalar; i <= bdfConvert::instructionSet(); i++) {
+        bdfConvert::eInstructionSet isa = (bdfConvert::eInstructionSet)i;
+        measure("RawToL", isa, sizeof(int32_t), [&](bdfConvert::eInstructionSet k) { bdfConvert::rawToL(raw.data(), dataL.data(), NrOfSamples, analogMask, k); });
+        measure("RawToF", isa, sizeof(float), [&](bdfConvert::eInstructionSet k) { bdfConvert::rawToF(raw.data(), dataF.data(), NrOfSamples, analogMask, factor, constant, k); });
+        measure("RawToD", isa, sizeof(double), [&](bdfConvert::eInstructionSet k) { bdfConvert::rawToD(raw.data(), dataD.data(), NrOfSamples, analogMask, factor, constant, k); });
+    }
+
+    // keep the results alive
+    cout << "Check: " << dataL[1] << " " << dataF[1] << " " << dataD[1] << endl;
+    return 0;
+}
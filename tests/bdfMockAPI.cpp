@@ -0,0 +1,13 @@
+#include "bdfMockAPI.h"
+
+// The tests link against the mock instead of the BDF DLL
+
+namespace filereader {
+	extern "C" BDF_API bdfAPI* FR_CC CreateBDFAPIObj() {
+		return bdfMockAPI::factory()();
+	}
+
+	extern "C" BDF_API void FR_CC DestroyBDFAPIObj(bdfAPI* pbdfAPI) {
+		delete static_cast<bdfMockAPI*>(pbdfAPI);
+	}
+}
@@ -0,0 +1,232 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "bdfAPI.h"
+
+namespace filereader {
+	/// <summary>
+	/// In-memory bdfAPI for the helper tests. Blocks hold deterministic 16-bit samples with marker bit 0
+	/// toggling every 1000 samples; the writer side records the written bytes per streamer handle.
+	/// </summary>
+	class bdfMockAPI : public bdfAPI {
+	public:
+		struct sBlock {
+			std::vector<uint16_t> Samples;
+			sBlockInfo Info;
+		};
+
+		struct sInput {
+			sInputInfo Info;
+			std::vector<sBlock> Blocks;
+		};
+
+		struct sStreamer {
+			int Group;
+			unsigned Input;
+			unsigned Block;
+		};
+
+		std::vector<std::vector<sInput>> Groups;
+		std::vector<eOperationMode> Modes;
+		std::vector<sStreamer> Streamers;
+		std::vector<std::vector<uint8_t>> Written; /// Bytes per streamer handle
+		int Calls = 0; /// Sample data read calls
+		int EndOfRecords = 0;
+		int Closed = 0;
+
+		virtual ~bdfMockAPI() {}
+
+		/// <summary>
+		/// Groups x Inputs x Blocks of Length samples
+		/// </summary>
+		static bdfMockAPI* make(unsigned Groups, unsigned Inputs, unsigned Blocks, uint64_t Length, unsigned Seed = 1) {
+			bdfMockAPI* m = new bdfMockAPI();
+			m->fill(Groups, Inputs, Blocks, Length, Seed);
+			return m;
+		}
+
+		void fill(unsigned NrOfGroups, unsigned NrOfInputs, unsigned NrOfBlocks, uint64_t Length, unsigned Seed = 1) {
+			Groups.clear();
+			Modes.clear();
+			for (unsigned g = 0; g < NrOfGroups; g++) {
+				Groups.emplace_back();
+				Modes.push_back(multiEventRecorder);
+				for (unsigned i = 0; i < NrOfInputs; i++) {
+					sInput input{};
+					input.Info.BytesPerSample = 2;
+					input.Info.AnalogMask = 0xFFFC;
+					input.Info.MarkerMask = 3;
+					input.Info.NumberOfMarkerBits = 2;
+					input.Info.ResolutionInBits = 14;
+					input.Info.BinToVoltFactor = 2.0 / 65536;
+					input.Info.BinToVoltConstant = -1.0;
+					input.Info.VoltToPhysicalFactor = 10;
+					input.Info.VoltToPhysicalConstant = 1;
+					input.Info.BinToPhysicalFactor = 20.0 / 65536;
+					input.Info.BinToPhysicalConstant = -9;
+					input.Info.InputNumber = i;
+					for (unsigned b = 0; b < NrOfBlocks; b++) {
+						sBlock block{};
+						block.Info.ReductionFactor = 16;
+						block.Info.NumberOfReductions = 3;
+						block.Info.PreferredTransferSize = 4096;
+						block.Info.BlockLength = Length;
+						block.Info.SampleRateHertz = 1e6;
+						block.Info.TimebaseDivisor = 1;
+						block.Info.TriggerSample = Length / 4;
+						block.Info.TriggerTimeSeconds = b * 0.5;
+						block.Info.StartTime = { 2022, 6, 13, 11, 33, 3, 0 };
+						block.Samples.resize((size_t)Length);
+						uint32_t s = Seed * 2654435761u + g * 97 + i * 13 + b;
+						for (uint64_t k = 0; k < Length; k++) {
+							s = s * 1664525u + 1013904223u;
+							uint16_t v = (uint16_t)(32768 + 8000 * std::sin(k * 0.001 + i) + (s >> 28));
+							if ((k / 1000) % 3 == 0) v |= 1;
+							else v &= ~1;
+							block.Samples[(size_t)k] = v;
+						}
+						input.Blocks.push_back(std::move(block));
+					}
+					Groups.back().push_back(std::move(input));
+				}
+			}
+		}
+
+		/// Samples of one block
+		std::vector<uint16_t>& samples(unsigned Group, unsigned Input, unsigned Block) { return Groups[Group][Input].Blocks[Block].Samples; }
+
+		virtual int loadFile(const char*) override { return 0; }
+		virtual int initFileWriter(unsigned, sDateTime&, eOperationMode, double, uint32_t, uint32_t) override { return 0; }
+		virtual int writeInputHeader(uint32_t, uint32_t, uint32_t, uint32_t, double, double, double, double, int) override { return 0; }
+		virtual int initInputStreamer(uint32_t, uint32_t InputNumber, uint32_t BlockNr, int Handle = 0) override {
+			Streamers.push_back(sStreamer{ Handle, InputNumber, BlockNr });
+			Written.emplace_back();
+			return (int)Streamers.size() - 1;
+		}
+		virtual int writeData(int StreamerHandle, char* Data, unsigned int count, int = 0) override {
+			if (StreamerHandle < 0 || StreamerHandle >= (int)Written.size()) return errInvalidHandle;
+			Written[StreamerHandle].insert(Written[StreamerHandle].end(), Data, Data + count);
+			return errNoError;
+		}
+		virtual int setAttribute(unsigned, const std::string&, const std::string&, int) override { return 0; }
+		virtual int writeAttributes(int) override { return 0; }
+		virtual void writeEORInfo(uint32_t, uint64_t, uint64_t, uint32_t, uint32_t, int) override { EndOfRecords++; }
+		virtual void closeFile(int) override { Closed++; }
+		virtual int initFileReader() override { return 0; }
+
+		/// ChName is "A<input + 1>", ChPhysUnit is "V"
+		virtual eErrorCode getAttribute(unsigned, unsigned Input, char* Key, char* Value, unsigned Size) override {
+			const std::string key = Key;
+			const std::string value = key == "ChName" ? "A" + std::to_string(Input + 1) : (key == "ChPhysUnit" ? "V" : "");
+			if (value.empty() || Size == 0) return errArgument;
+			strncpy(Value, value.c_str(), Size);
+			Value[Size - 1] = 0;
+			return errNoError;
+		}
+		virtual unsigned getNumberOfGroups() override { return (unsigned)Groups.size(); }
+		virtual unsigned getNumberOfInputs(unsigned Group) override { return Group < Groups.size() ? (unsigned)Groups[Group].size() : 0; }
+		virtual unsigned getNumberOfBlocks(unsigned Group, unsigned Input) override {
+			return Group < Groups.size() && Input < Groups[Group].size() ? (unsigned)Groups[Group][Input].Blocks.size() : 0;
+		}
+		virtual eErrorCode getInputInfo(unsigned Group, unsigned Input, sInputInfo* InputInfo) override {
+			if (Group >= Groups.size() || Input >= Groups[Group].size()) return errArgument;
+			*InputInfo = Groups[Group][Input].Info;
+			return errNoError;
+		}
+		virtual eErrorCode getBlockInfo(unsigned Group, unsigned Input, unsigned Block, sBlockInfo* BlockInfo) override {
+			if (Group >= Groups.size() || Input >= Groups[Group].size() || Block >= Groups[Group][Input].Blocks.size()) return errArgument;
+			*BlockInfo = Groups[Group][Input].Blocks[Block].Info;
+			return errNoError;
+		}
+		virtual eErrorCode getOperationMode(unsigned Group, eOperationMode& Mode) override {
+			if (Group >= Modes.size()) return errArgument;
+			Mode = Modes[Group];
+			return errNoError;
+		}
+		virtual eErrorCode getRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint16_t* Data, unsigned Count) override {
+			const sBlock* b = block(Group, Input, Block, Address, Count);
+			if (b == nullptr) return errArgument;
+			memcpy(Data, &b->Samples[(size_t)Address], Count * sizeof(uint16_t));
+			return errNoError;
+		}
+		virtual eErrorCode getRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, int32_t* Data, unsigned Count) override {
+			const sBlock* b = block(Group, Input, Block, Address, Count);
+			if (b == nullptr) return errArgument;
+			for (unsigned k = 0; k < Count; k++) Data[k] = b->Samples[(size_t)Address + k];
+			return errNoError;
+		}
+		virtual eErrorCode getDataF(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, float* Data, unsigned Count) override {
+			const sBlock* b = block(Group, Input, Block, Address, Count);
+			if (b == nullptr) return errArgument;
+			const sInputInfo& f = Groups[Group][Input].Info;
+			for (unsigned k = 0; k < Count; k++) Data[k] = (float)((b->Samples[(size_t)Address + k] & f.AnalogMask) * f.BinToVoltFactor + f.BinToVoltConstant);
+			return errNoError;
+		}
+		virtual eErrorCode getDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, double* Data, unsigned Count) override {
+			const sBlock* b = block(Group, Input, Block, Address, Count);
+			if (b == nullptr) return errArgument;
+			const sInputInfo& f = Groups[Group][Input].Info;
+			for (unsigned k = 0; k < Count; k++) Data[k] = (b->Samples[(size_t)Address + k] & f.AnalogMask) * f.BinToVoltFactor + f.BinToVoltConstant;
+			return errNoError;
+		}
+		virtual eErrorCode getEnvRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, uint16_t* Data, unsigned Count) override {
+			return envelope(Group, Input, Block, Address, BlockSize, Data, Count, [](uint16_t v) { return v; });
+		}
+		virtual eErrorCode getEnvRawDataL(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, int32_t* Data, unsigned Count) override {
+			return envelope(Group, Input, Block, Address, BlockSize, Data, Count, [](uint16_t v) { return (int32_t)v; });
+		}
+		virtual eErrorCode getEnvDataF(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, float* Data, unsigned Count) override {
+			if (Group >= Groups.size() || Input >= Groups[Group].size()) return errArgument;
+			const sInputInfo& f = Groups[Group][Input].Info;
+			return envelope(Group, Input, Block, Address, BlockSize, Data, Count, [&](uint16_t v) { return (float)(v * f.BinToVoltFactor + f.BinToVoltConstant); });
+		}
+		virtual eErrorCode getEnvDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, double* Data, unsigned Count) override {
+			if (Group >= Groups.size() || Input >= Groups[Group].size()) return errArgument;
+			const sInputInfo& f = Groups[Group][Input].Info;
+			return envelope(Group, Input, Block, Address, BlockSize, Data, Count, [&](uint16_t v) { return v * f.BinToVoltFactor + f.BinToVoltConstant; });
+		}
+		virtual void Release() override {}
+
+		/// Factory used by CreateBDFAPIObj, replace it to change the layout of the mock files
+		static std::function<bdfMockAPI*()>& factory() {
+			static std::function<bdfMockAPI*()> f = [] { return make(1, 4, 6, 50000); };
+			return f;
+		}
+
+	protected:
+		const sBlock* block(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t Count) {
+			Calls++;
+			if (Group >= Groups.size() || Input >= Groups[Group].size() || Block >= Groups[Group][Input].Blocks.size()) return nullptr;
+			const sBlock& b = Groups[Group][Input].Blocks[Block];
+			if (Address + Count > b.Samples.size()) return nullptr;
+			return &b;
+		}
+
+		/// Reference getEnv* segmentation: segment s starts at Address + floor(s * BlockSize / (Count / 2))
+		template <typename T, typename F>
+		eErrorCode envelope(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, T* Data, unsigned Count, F Scale) {
+			const sBlock* b = block(Group, Input, Block, Address, BlockSize);
+			if (b == nullptr || Count < 2) return errArgument;
+			const unsigned n = Count / 2;
+			const uint16_t mask = (uint16_t)Groups[Group][Input].Info.AnalogMask;
+			for (unsigned s = 0; s < n; s++) {
+				const uint64_t lo = Address + BlockSize * s / n;
+				const uint64_t hi = Address + BlockSize * (s + 1) / n;
+				uint16_t mn = 0xFFFF, mx = 0;
+				for (uint64_t k = lo; k < hi; k++) {
+					const uint16_t v = b->Samples[(size_t)k] & mask;
+					mn = std::min(mn, v);
+					mx = std::max(mx, v);
+				}
+				Data[2 * s] = Scale(mn);
+				Data[2 * s + 1] = Scale(mx);
+			}
+			return errNoError;
+		}
+	};
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+// Minimal checks for the helper tests: a failed CHECK is reported and counted, the test keeps running.
+
+namespace bdftest {
+	inline int& failures() {
+		static int n = 0;
+		return n;
+	}
+
+	/// Path of a scratch file in the temporary directory
+	inline std::string tempPath(const std::string& Name) {
+		std::error_code ec;
+		const std::filesystem::path directory = std::filesystem::temp_directory_path(ec) / "bdf-tests";
+		std::filesystem::create_directories(directory, ec);
+		return (directory / Name).string();
+	}
+
+	/// Exit code of a test
+	inline int result() {
+		if (failures()) std::printf("%d check(s) failed\n", failures());
+		return failures() ? 1 : 0;
+	}
+}
+
+#define CHECK(x) do { if (!(x)) { std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #x); bdftest::failures()++; } } while (0)
@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""Reads the Arrow IPC files written by test_arrow back with pyarrow and compares every column
+with the ".ref" file next to it. Skipped if pyarrow is not installed.
+
+    python3 tests/check_arrow.py <output directory of test_arrow>
+"""
+import math
+import pathlib
+import struct
+import sys
+
+try:
+    import pyarrow.ipc
+except ImportError:
+    print("pyarrow is not installed, skipped")
+    sys.exit(0)
+
+
+def same(a, b):
+    return (math.isnan(a) and math.isnan(b)) or a == b
+
+
+def check(path):
+    with pyarrow.ipc.open_file(str(path)) as reader:
+        table = reader.read_all()
+        metadata = reader.schema.metadata or {}
+        batches = reader.num_record_batches
+    reference = path.with_name(path.name + ".ref").read_bytes()
+    errors = []
+    if b"Group" not in metadata or b"Block" not in metadata:
+        errors.append("schema metadata without Group/Block")
+    offset = 0
+    for name, column in zip(table.column_names, table.columns):
+        code = "f" if column.type == pyarrow.float32() else "d"
+        size = struct.calcsize(code)
+        expected = struct.unpack_from("<%d%s" % (table.num_rows, code), reference, offset)
+        offset += table.num_rows * size
+        if column.null_count:
+            errors.append("%s: %d nulls" % (name, column.null_count))
+        bad = sum(1 for a, b in zip(column.to_pylist(), expected) if not same(a, b))
+        if bad:
+            errors.append("%s: %d of %d values differ" % (name, bad, table.num_rows))
+    if offset != len(reference):
+        errors.append("%d rows do not match the reference" % table.num_rows)
+    for error in errors:
+        print("%s: %s" % (path.name, error))
+    print("%s: %d rows, %d columns, %d batches%s" % (path.name, table.num_rows, table.num_columns, batches, " FAILED" if errors else ""))
+    return not errors
+
+
+def main():
+    files = sorted(pathlib.Path(sys.argv[1]).glob("*.arrow"))
+    ok = bool(files)
+    for path in files:
+        ok = check(path) and ok
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
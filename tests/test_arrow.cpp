@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfArrow.h"
+
+using namespace filereader;
+
+// The files are left in the output directory (argument 1) together with a ".ref" file of the
+// expected columns, so that check_arrow.py can read them back with pyarrow.
+
+static std::vector<char> readFile(const std::string& FileName) {
+	std::ifstream file(FileName, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+template <typename T>
+static std::vector<T> expectedColumn(bdfMockAPI* Mock, unsigned Group, unsigned Input, unsigned Block, uint64_t Rows, bdfConvert::eUnit Unit) {
+	std::vector<T> values((size_t)Rows, std::numeric_limits<T>::quiet_NaN());
+	const uint64_t length = Mock->Groups[Group][Input].Blocks[Block].Info.BlockLength;
+	bdfConvert::getData(Mock, Mock->Groups[Group][Input].Info, Group, Input, Block, 0, values.data(), (unsigned)length, Unit);
+	return values;
+}
+
+// Columns of one file: the file starts and ends with the magic, every batch of every column is in the
+// file in order, and the expected columns are written next to it for check_arrow.py
+template <typename T>
+static void checkFile(bdfMockAPI* Mock, unsigned Group, unsigned Block, const std::string& FileName, const sArrowExportConfig& Config) {
+	const std::vector<char> file = readFile(FileName);
+	CHECK(file.size() > 20 && memcmp(file.data(), "ARROW1\0\0", 8) == 0 && memcmp(file.data() + file.size() - 6, "ARROW1", 6) == 0);
+
+	uint64_t rows = 0;
+	for (const bdfMockAPI::sInput& input : Mock->Groups[Group]) rows = std::max(rows, input.Blocks[Block].Info.BlockLength);
+	std::vector<std::vector<char>> columns;
+	if (Config.TimeColumn) {
+		const bdfAPI::sBlockInfo& info = Mock->Groups[Group][0].Blocks[Block].Info;
+		std::vector<double> time((size_t)rows);
+		for (size_t k = 0; k < time.size(); k++) time[k] = ((double)k - (double)info.TriggerSample) / info.SampleRateHertz;
+		columns.emplace_back((const char*)time.data(), (const char*)(time.data() + time.size()));
+	}
+	for (unsigned i = 0; i < Mock->Groups[Group].size(); i++) {
+		const std::vector<T> values = expectedColumn<T>(Mock, Group, i, Block, rows, Config.Unit);
+		columns.emplace_back((const char*)values.data(), (const char*)(values.data() + values.size()));
+	}
+
+	bool ok = true;
+	auto position = file.begin();
+	for (uint64_t address = 0; address < rows; address += Config.BatchRows) {
+		const uint64_t count = std::min<uint64_t>(Config.BatchRows, rows - address);
+		for (size_t c = 0; c < columns.size(); c++) {
+			const size_t size = (c == 0 && Config.TimeColumn) ? sizeof(double) : sizeof(T);
+			const auto first = columns[c].begin() + (ptrdiff_t)(address * size);
+			position = std::search(position, file.end(), first, first + (ptrdiff_t)(count * size));
+			ok = ok && position != file.end();
+		}
+	}
+	CHECK(ok);
+
+	std::ofstream reference(FileName + ".ref", std::ios::binary);
+	for (const std::vector<char>& column : columns) reference.write(column.data(), (std::streamsize)column.size());
+}
+
+// Every block of a file with 3 workers, one block with float columns, and a block that does not exist
+
+static void exportFile(const std::string& Directory) {
+	std::vector<std::unique_ptr<bdfMockAPI>> mocks;
+	std::vector<bdfAPI*> apis;
+	for (unsigned t = 0; t < 3; t++) {
+		mocks.emplace_back(bdfMockAPI::make(2, 3, 2, 30011, 7));
+		// a shorter input is padded with NaN
+		mocks.back()->Groups[1][2].Blocks[1].Info.BlockLength = 12000;
+		mocks.back()->samples(1, 2, 1).resize(12000);
+		apis.push_back(mocks.back().get());
+	}
+	bdfMockAPI* mock = mocks[0].get();
+	bdfParallelReader reader(apis);
+
+	sArrowExportConfig config;
+	config.BatchRows = 1000;
+	config.BatchesInFlight = 3;
+	std::vector<std::string> names;
+	sArrowExportStatistics statistics{};
+	CHECK(bdfArrowExport::exportFile(reader, Directory + "/file", config, &names, &statistics) == bdfAPI::errNoError);
+	CHECK(names.size() == 4 && statistics.Files == 4);
+	CHECK(statistics.Rows == 4 * 30011 && statistics.Batches == 4 * 31);
+	uint64_t bytes = 0;
+	for (const std::string& name : names) bytes += std::filesystem::file_size(name);
+	CHECK(statistics.Bytes == bytes);
+	for (unsigned g = 0; g < 2; g++) {
+		for (unsigned b = 0; b < 2; b++) {
+			CHECK(names[g * 2 + b] == bdfArrowExport::fileName(Directory + "/file", g, b));
+			checkFile<double>(mock, g, b, names[g * 2 + b], config);
+		}
+	}
+
+	config.SinglePrecision = true;
+	config.TimeColumn = false;
+	config.Unit = bdfConvert::unitPhysical;
+	config.BatchesInFlight = 0;
+	CHECK(bdfArrowExport::exportBlock(reader, 1, 1, Directory + "/single.arrow", config) == bdfAPI::errNoError);
+	checkFile<float>(mock, 1, 1, Directory + "/single.arrow", config);
+
+	// a failed export leaves no file behind
+	CHECK(bdfArrowExport::exportBlock(reader, 0, 9, Directory + "/bad.arrow", config) != bdfAPI::errNoError);
+	CHECK(!std::filesystem::exists(Directory + "/bad.arrow"));
+	config.BatchRows = 0;
+	CHECK(bdfArrowExport::exportBlock(reader, 0, 0, Directory + "/bad.arrow", config) == bdfAPI::errArgument);
+	CHECK(!std::filesystem::exists(Directory + "/bad.arrow"));
+}
+
+int main(int argc, char** argv) {
+	const std::string directory = argc > 1 ? argv[1] : bdftest::tempPath("arrow");
+	std::error_code ec;
+	std::filesystem::remove_all(directory, ec);
+	std::filesystem::create_directories(directory, ec);
+	exportFile(directory);
+	return bdftest::result();
+}
@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfAsyncWriter.h"
+#include "bdfEnvelope.h"
+
+using namespace filereader;
+
+/// Mock whose writes can be held back to keep buffers in flight
+class bdfGatedMockAPI : public bdfMockAPI {
+public:
+	std::atomic<bool> Hold{ false };
+
+	virtual int writeData(int StreamerHandle, char* Data, unsigned int count, int Handle = 0) override {
+		while (Hold.load()) std::this_thread::sleep_for(std::chrono::microseconds(100));
+		return bdfMockAPI::writeData(StreamerHandle, Data, count, Handle);
+	}
+};
+
+/// Gated mock which logs the data writes ("D<streamer>") and records ("E<group>/<block>/<input>") in order
+class bdfLogMockAPI : public bdfGatedMockAPI {
+public:
+	std::vector<std::string> Log;
+
+	virtual int writeData(int StreamerHandle, char* Data, unsigned int count, int Handle = 0) override {
+		int result = bdfGatedMockAPI::writeData(StreamerHandle, Data, count, Handle);
+		Log.push_back("D" + std::to_string(StreamerHandle));
+		return result;
+	}
+
+	virtual void writeEORInfo(uint32_t BlockNr, uint64_t TriggerTime, uint64_t DataCntr, uint32_t Input, uint32_t Board, int GroupHandle = 0) override {
+		bdfMockAPI::writeEORInfo(BlockNr, TriggerTime, DataCntr, Input, Board, GroupHandle);
+		Log.push_back("E" + std::to_string(GroupHandle) + "/" + std::to_string(BlockNr) + "/" + std::to_string(Input));
+	}
+};
+
+static std::vector<char> pattern(size_t Size, uint32_t Seed) {
+	std::vector<char> data(Size);
+	for (char& c : data) c = (char)((Seed = Seed * 1664525u + 1013904223u) >> 24);
+	return data;
+}
+
+// Data of two streamers arrives complete and in order, also through a bdfEnvelopeWriter below the I/O thread
+
+static void ordered() {
+	bdfGatedMockAPI mock;
+	bdfEnvelopeWriter envelope(&mock, 16, 2);
+	std::vector<uint8_t> reference[2];
+	{
+		bdfAsyncWriter::sAsyncWriterConfig config;
+		config.BufferSize = 1000;
+		config.BuffersPerStreamer = 3;
+		bdfAsyncWriter writer(&envelope, config);
+		writer.writeInputHeader(0, 0, 0xFFFC, 3, 10, 0, 1, 0, 0);
+		const int streamers[2] = { writer.initInputStreamer(0, 0, 0, 0), writer.initInputStreamer(0, 1, 0, 0) };
+		uint32_t seed = 5;
+		for (int k = 0; k < 500; k++) {
+			for (int s : streamers) {
+				seed = seed * 1664525u + 1013904223u;
+				std::vector<char> data = pattern(seed >> 22, seed);
+				reference[s].insert(reference[s].end(), data.begin(), data.end());
+				CHECK(writer.writeData(s, data.data(), (unsigned)data.size(), 0) == bdfAPI::errNoError);
+			}
+		}
+		writer.writeEORInfo(0, 0, 0, 0, 0, 0);
+		writer.writeEORInfo(0, 0, 0, 1, 0, 0);
+		CHECK(writer.flush() == bdfAPI::errNoError);
+		CHECK(mock.EndOfRecords == 2);
+		CHECK(mock.Written[0] == reference[0] && mock.Written[1] == reference[1]);
+		bdfAsyncWriter::sAsyncWriterStatistics statistics = writer.getStatistics();
+		CHECK(statistics.BytesQueued == statistics.BytesWritten && statistics.BlocksCommitted == 1);
+		std::shared_ptr<const bdfEnvelopeBuilder> pyramid = envelope.getEnvelope(streamers[0], 0, 0);
+		CHECK(pyramid && pyramid->finished() && pyramid->numberOfSamples() == reference[0].size() / 2);
+
+		writer.writeData(streamers[0], const_cast<char*>("ab"), 2, 0);
+		writer.closeFile();
+		CHECK(mock.Written[0].size() == reference[0].size() + 2 && mock.Closed == 1);
+	}
+}
+
+// Without BlockWhenFull a call is accepted completely or not at all
+
+static void nonBlocking() {
+	bdfGatedMockAPI mock;
+	bdfAsyncWriter::sAsyncWriterConfig config;
+	config.BufferSize = 100;
+	config.BuffersPerStreamer = 2;
+	config.BlockWhenFull = false;
+	bdfAsyncWriter writer(&mock, config);
+	const int streamer = writer.initInputStreamer(0, 0, 0, 0);
+	const std::vector<char> data = pattern(400, 7);
+
+	// the first buffer is held by the I/O thread, the second one is partially filled
+	mock.Hold = true;
+	CHECK(writer.writeData(streamer, const_cast<char*>(data.data()), 150, 0) == bdfAPI::errNoError);
+	CHECK(writer.writeData(streamer, const_cast<char*>(data.data()) + 150, 100, 0) == bdfAPI::errResource);
+	CHECK(writer.writeData(streamer, const_cast<char*>(data.data()) + 150, 50, 0) == bdfAPI::errNoError);
+	mock.Hold = false;
+	CHECK(writer.flush() == bdfAPI::errNoError);
+	CHECK(mock.Written[streamer] == std::vector<uint8_t>(data.begin(), data.begin() + 200));
+	CHECK(writer.getStatistics().BytesQueued == 200);
+
+	// more than all buffers of the streamer can never be accepted
+	CHECK(writer.writeData(streamer, const_cast<char*>(data.data()), 201, 0) == bdfAPI::errArgument);
+	CHECK(writer.writeData(streamer, const_cast<char*>(data.data()) + 200, 200, 0) == bdfAPI::errNoError);
+	CHECK(writer.flush() == bdfAPI::errNoError);
+	CHECK(mock.Written[streamer] == std::vector<uint8_t>(data.begin(), data.end()));
+}
+
+// One streamer continues with the next block after writeEORInfo, each record follows the data of its block
+
+static void consecutiveBlocks() {
+	bdfLogMockAPI mock;
+	bdfAsyncWriter::sAsyncWriterConfig config;
+	config.BufferSize = 1000;
+	config.BuffersPerStreamer = 3;
+	bdfAsyncWriter writer(&mock, config);
+	const int streamer = writer.initInputStreamer(0, 0, 0, 0);
+	const std::vector<char> data = pattern(2200, 3);
+	mock.Hold = true;
+	CHECK(writer.writeData(streamer, const_cast<char*>(data.data()), 1500, 0) == bdfAPI::errNoError);
+	writer.writeEORInfo(0, 0, 1500, 0, 0, 0);
+	CHECK(writer.writeData(streamer, const_cast<char*>(data.data()) + 1500, 700, 0) == bdfAPI::errNoError);
+	writer.writeEORInfo(1, 0, 700, 0, 0, 0);
+	mock.Hold = false;
+	CHECK(writer.flush() == bdfAPI::errNoError);
+	const std::vector<std::string> expected = { "D0", "D0", "E0/0/0", "D0", "E0/1/0" };
+	CHECK(mock.Log == expected);
+	CHECK(mock.Written[streamer] == std::vector<uint8_t>(data.begin(), data.end()));
+	CHECK(writer.getStatistics().BlocksCommitted == 2);
+}
+
+// Producer threads per input of two groups, streamers of all blocks initialized up front: every block is
+// committed once, its records are consecutive and follow all data of its streamers
+
+static void commitProtocol() {
+	bdfLogMockAPI mock;
+	bdfAsyncWriter::sAsyncWriterConfig config;
+	config.BufferSize = 4096;
+	config.BuffersPerStreamer = 3;
+	const int groups = 2, inputs = 4, blocks = 3;
+	std::vector<std::vector<char>> reference(groups * inputs * blocks);
+	std::vector<int> streamers(groups * inputs * blocks);
+	{
+		bdfAsyncWriter writer(&mock, config);
+		for (int b = 0; b < blocks; b++) {
+			for (int g = 0; g < groups; g++) {
+				for (int i = 0; i < inputs; i++) streamers[(g * blocks + b) * inputs + i] = writer.initInputStreamer(0, i, b, g);
+			}
+		}
+		std::atomic<int> bad{ 0 };
+		std::vector<std::thread> threads;
+		for (int g = 0; g < groups; g++) {
+			for (int i = 0; i < inputs; i++) {
+				threads.emplace_back([&, g, i] {
+					uint32_t seed = g * 10 + i + 1;
+					for (int b = 0; b < blocks; b++) {
+						const int streamer = streamers[(g * blocks + b) * inputs + i];
+						for (int k = 0; k < 200; k++) {
+							seed = seed * 1664525u + 1013904223u;
+							std::vector<char> data = pattern(1 + (seed >> 20), seed);
+							reference[streamer].insert(reference[streamer].end(), data.begin(), data.end());
+							if (writer.writeData(streamer, data.data(), (unsigned)data.size(), g) != bdfAPI::errNoError) bad++;
+						}
+						writer.writeEORInfo(b, 0, 0, i, 0, g);
+					}
+				});
+			}
+		}
+		for (std::thread& thread : threads) thread.join();
+		CHECK(bad == 0);
+		CHECK(writer.flush() == bdfAPI::errNoError);
+		bdfAsyncWriter::sAsyncWriterStatistics statistics = writer.getStatistics();
+		CHECK(statistics.BlocksCommitted == (uint64_t)groups * blocks);
+		CHECK(statistics.BytesQueued == statistics.BytesWritten);
+		// the streamers of the earlier blocks are finished and released
+		CHECK(statistics.Streamers == (unsigned)(groups * inputs));
+	}
+	for (size_t s = 0; s < reference.size(); s++) CHECK(mock.Written[s] == std::vector<uint8_t>(reference[s].begin(), reference[s].end()));
+	CHECK(mock.EndOfRecords == groups * inputs * blocks);
+
+	std::map<std::string, size_t> first, last;
+	std::map<int, size_t> lastData;
+	for (size_t k = 0; k < mock.Log.size(); k++) {
+		const std::string& entry = mock.Log[k];
+		if (entry[0] == 'D') {
+			lastData[std::stoi(entry.substr(1))] = k;
+			continue;
+		}
+		const std::string block = entry.substr(0, entry.rfind('/'));
+		if (!first.count(block)) first[block] = k;
+		last[block] = k;
+	}
+	CHECK(first.size() == (size_t)(groups * blocks));
+	for (auto& it : first) CHECK(last[it.first] - it.second == (size_t)inputs - 1);
+	for (int g = 0; g < groups; g++) {
+		for (int b = 0; b < blocks; b++) {
+			const std::string block = "E" + std::to_string(g) + "/" + std::to_string(b);
+			for (int i = 0; i < inputs; i++) CHECK(lastData[streamers[(g * blocks + b) * inputs + i]] < first[block]);
+		}
+	}
+}
+
+// One producer runs a block ahead of the other: the blocks are committed in order, the data of the later
+// block waits for the records of the earlier one
+
+static void producerAhead() {
+	bdfLogMockAPI mock;
+	bdfAsyncWriter::sAsyncWriterConfig config;
+	config.BufferSize = 4;
+	config.BuffersPerStreamer = 8;
+	bdfAsyncWriter writer(&mock, config);
+	const int first = writer.initInputStreamer(0, 0, 0, 0), second = writer.initInputStreamer(0, 1, 0, 0);
+	const std::vector<char> data = pattern(32, 4);
+	mock.Hold = true;
+	for (uint32_t b = 0; b < 2; b++) {
+		CHECK(writer.writeData(first, const_cast<char*>(data.data()) + b * 8, 8, 0) == bdfAPI::errNoError);
+		writer.writeEORInfo(b, 0, 8, 0, 0, 0);
+	}
+	for (uint32_t b = 0; b < 2; b++) {
+		CHECK(writer.writeData(second, const_cast<char*>(data.data()) + 16 + b * 8, 8, 0) == bdfAPI::errNoError);
+		writer.writeEORInfo(b, 0, 8, 1, 0, 0);
+	}
+	mock.Hold = false;
+	CHECK(writer.flush() == bdfAPI::errNoError);
+	CHECK(mock.Log.size() == 12);
+	if (mock.Log.size() != 12) return;
+	CHECK(std::count(mock.Log.begin(), mock.Log.begin() + 4, "D0") == 2 && std::count(mock.Log.begin(), mock.Log.begin() + 4, "D1") == 2);
+	CHECK(mock.Log[4] == "E0/0/0" && mock.Log[5] == "E0/0/1");
+	CHECK(std::count(mock.Log.begin() + 6, mock.Log.begin() + 10, "D0") == 2 && std::count(mock.Log.begin() + 6, mock.Log.begin() + 10, "D1") == 2);
+	CHECK(mock.Log[10] == "E0/1/0" && mock.Log[11] == "E0/1/1");
+	CHECK(mock.Written[first] == std::vector<uint8_t>(data.begin(), data.begin() + 16));
+	CHECK(mock.Written[second] == std::vector<uint8_t>(data.begin() + 16, data.end()));
+	CHECK(writer.getStatistics().BlocksCommitted == 2);
+}
+
+// The streamers of the next block are initialized when an input reaches it: a block is not committed
+// before the input still writing an earlier block has passed it
+
+static void lazyStreamers() {
+	bdfLogMockAPI mock;
+	bdfAsyncWriter::sAsyncWriterConfig config;
+	config.BufferSize = 4;
+	config.BuffersPerStreamer = 8;
+	bdfAsyncWriter writer(&mock, config);
+	std::vector<int> streamers = { writer.initInputStreamer(0, 0, 0, 0), writer.initInputStreamer(0, 1, 0, 0) };
+	const std::vector<char> data = pattern(32, 5);
+	// no held writes: initInputStreamer waits for the write in progress
+	for (uint32_t i = 0; i < 2; i++) {
+		CHECK(writer.writeData(streamers[i], const_cast<char*>(data.data()) + i * 16, 8, 0) == bdfAPI::errNoError);
+		writer.writeEORInfo(0, 0, 8, i, 0, 0);
+		streamers.push_back(writer.initInputStreamer(0, i, 1, 0));
+		CHECK(writer.writeData(streamers.back(), const_cast<char*>(data.data()) + i * 16 + 8, 8, 0) == bdfAPI::errNoError);
+		writer.writeEORInfo(1, 0, 8, i, 0, 0);
+	}
+	CHECK(writer.flush() == bdfAPI::errNoError);
+	const auto at = [&](const std::string& Entry) { return std::find(mock.Log.begin(), mock.Log.end(), Entry) - mock.Log.begin(); };
+	CHECK(mock.Log.size() == 12 && at("E0/0/1") == at("E0/0/0") + 1 && at("E0/1/0") == 10 && at("E0/1/1") == 11);
+	for (size_t k = 0; k < mock.Log.size(); k++) {
+		// the data of the streamers of block 0 precedes its records, all data precedes the records of block 1
+		if (mock.Log[k] == "D" + std::to_string(streamers[0]) || mock.Log[k] == "D" + std::to_string(streamers[1])) CHECK((ptrdiff_t)k < at("E0/0/0"));
+		if (mock.Log[k][0] == 'D') CHECK((ptrdiff_t)k < at("E0/1/0"));
+	}
+	for (size_t n = 0; n < 4; n++) {
+		const size_t offset = (n % 2) * 16 + (n / 2) * 8;
+		CHECK(mock.Written[streamers[n]] == std::vector<uint8_t>(data.begin() + offset, data.begin() + offset + 8));
+	}
+	CHECK(writer.getStatistics().BlocksCommitted == 2 && writer.getStatistics().Streamers == 2);
+}
+
+// A new streamer per block: finished streamers are released once written, the pools stay bounded by the inputs
+
+static void streamerPerBlock() {
+	bdfMockAPI mock;
+	bdfAsyncWriter::sAsyncWriterConfig config;
+	config.BufferSize = 1000;
+	config.BuffersPerStreamer = 2;
+	bdfAsyncWriter writer(&mock, config);
+	std::vector<std::vector<char>> reference;
+	unsigned most = 0;
+	for (uint32_t b = 0; b < 200; b++) {
+		const int streamer = writer.initInputStreamer(0, 0, b, 0);
+		CHECK(streamer == (int)b);
+		reference.push_back(pattern(1500 + b, b));
+		CHECK(writer.writeData(streamer, reference.back().data(), (unsigned)reference.back().size(), 0) == bdfAPI::errNoError);
+		writer.writeEORInfo(b, 0, 0, 0, 0, 0);
+		most = std::max(most, writer.getStatistics().Streamers);
+		// a disk keeping up with the data: the block is written before the next one starts
+		while (writer.getStatistics().BlocksCommitted < b + 1) std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+	CHECK(writer.flush() == bdfAPI::errNoError);
+	CHECK(most <= 2);
+	CHECK(writer.getStatistics().Streamers == 1);
+	CHECK(writer.getStatistics().BytesQueued == writer.getStatistics().BytesWritten);
+	CHECK(mock.EndOfRecords == 200);
+	bool ok = true;
+	for (size_t s = 0; s < reference.size(); s++) ok = ok && mock.Written[s] == std::vector<uint8_t>(reference[s].begin(), reference[s].end());
+	CHECK(ok);
+}
+
+int main() {
+	ordered();
+	nonBlocking();
+	consecutiveBlocks();
+	commitProtocol();
+	producerAhead();
+	lazyStreamers();
+	streamerPerBlock();
+	return bdftest::result();
+}
@@ -0,0 +1,46 @@
+#include <cmath>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfBatchRead.h"
+
+using namespace filereader;
+
+int main() {
+	bdfMockAPI* mock = bdfMockAPI::make(1, 4, 2, 20000);
+	bdfBatchRead reader(mock);
+	const unsigned count = 9000;
+	std::vector<double> planar(4 * count), interleaved(4 * count), reference(count);
+	std::vector<uint16_t> rawPlanar(4 * count), rawInterleaved(4 * count);
+	CHECK(reader.getDataD(0, 1, 100, count, {}, planar.data()) == bdfAPI::errNoError);
+	CHECK(reader.getRawDataS(0, 1, 100, count, {}, rawPlanar.data()) == bdfAPI::errNoError);
+
+	// the interleaved layout reads every input once, whatever the range
+	mock->Calls = 0;
+	CHECK(reader.getDataD(0, 1, 100, count, {}, interleaved.data(), bdfBatchRead::layoutInterleaved) == bdfAPI::errNoError);
+	CHECK(mock->Calls == 4);
+	mock->Calls = 0;
+	CHECK(reader.getRawDataS(0, 1, 100, count, {}, rawInterleaved.data(), bdfBatchRead::layoutInterleaved) == bdfAPI::errNoError);
+	CHECK(mock->Calls == 4);
+
+	bool ok = true;
+	for (unsigned i = 0; i < 4; i++) {
+		mock->getDataD(0, i, 1, 100, reference.data(), count);
+		for (unsigned k = 0; k < count; k++) {
+			ok = ok && std::fabs(planar[i * count + k] - reference[k]) < 1e-12 && interleaved[k * 4 + i] == planar[i * count + k];
+			ok = ok && rawPlanar[i * count + k] == mock->samples(0, i, 1)[100 + k] && rawInterleaved[k * 4 + i] == rawPlanar[i * count + k];
+		}
+	}
+	CHECK(ok);
+
+	std::vector<float> selected(2 * count);
+	CHECK(reader.getDataF(0, 1, 100, count, { 3, 1 }, selected.data(), bdfBatchRead::layoutInterleaved, bdfConvert::unitPhysical) == bdfAPI::errNoError);
+	ok = true;
+	for (unsigned k = 0; k < count; k++) ok = ok && std::fabs(selected[2 * k + 1] - (planar[count + k] * 10 + 1)) < 1e-4;
+	CHECK(ok);
+
+	CHECK(reader.getDataD(0, 1, 19000, count, {}, planar.data()) != bdfAPI::errNoError);
+	CHECK(reader.getDataD(0, 1, 19000, count, {}, interleaved.data(), bdfBatchRead::layoutInterleaved) != bdfAPI::errNoError);
+	delete mock;
+	return bdftest::result();
+}
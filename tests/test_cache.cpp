@@ -0,0 +1,205 @@
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfCache.h"
+
+using namespace filereader;
+
+// Raw chunks with readahead, widened and converted reads, budget eviction and concurrent readers on one cache
+
+static void raw(const std::string& FileName) {
+	std::unique_ptr<bdfMockAPI> mock(bdfMockAPI::make(1, 3, 2, 300000));
+	mock->Groups[0][2].Info.BytesPerSample = 4;
+	bdfBlockCache cache(64 << 20);
+	bdfCachedReader reader(mock.get(), cache, 2, 10000);
+	CHECK(reader.loadFile(FileName.c_str()) == 0);
+
+	std::vector<uint16_t> s(50000), s2(50000);
+	std::vector<int32_t> l(50000), l2(50000);
+	std::vector<double> d(50000), d2(50000);
+	CHECK(reader.getRawDataS(0, 0, 1, 12345, s.data(), 25000) == bdfAPI::errNoError);
+	mock->getRawDataS(0, 0, 1, 12345, s2.data(), 25000);
+	CHECK(s == s2);
+	mock->Calls = 0;
+	CHECK(reader.getRawDataS(0, 0, 1, 12345, s.data(), 25000) == bdfAPI::errNoError);
+	// covered by the readahead of the first read
+	CHECK(reader.getRawDataS(0, 0, 1, 38000, s.data(), 2000) == bdfAPI::errNoError);
+	CHECK(mock->Calls == 0);
+	CHECK(reader.getRawDataL(0, 0, 1, 295000, l.data(), 5000) == bdfAPI::errNoError);
+	mock->getRawDataL(0, 0, 1, 295000, l2.data(), 5000);
+	CHECK(memcmp(l.data(), l2.data(), 5000 * sizeof(int32_t)) == 0);
+	CHECK(reader.getRawDataL(0, 2, 0, 100, l.data(), 50000) == bdfAPI::errNoError);
+	mock->getRawDataL(0, 2, 0, 100, l2.data(), 50000);
+	CHECK(l == l2);
+	CHECK(reader.getDataD(0, 1, 0, 7, d.data(), 50000) == bdfAPI::errNoError);
+	mock->getDataD(0, 1, 0, 7, d2.data(), 50000);
+	CHECK(d == d2);
+	CHECK(reader.getDataD(0, 2, 0, 7, d.data(), 50000) == bdfAPI::errNoError);
+	mock->getDataD(0, 2, 0, 7, d2.data(), 50000);
+	CHECK(d == d2);
+	CHECK(reader.getRawDataS(0, 0, 1, 299990, s.data(), 11) == bdfAPI::errArgument);
+
+	cache.setBudget(16 * 30000);
+	bdfBlockCache::sCacheStatistics statistics = cache.statistics();
+	CHECK(statistics.Bytes <= 16 * 30000 && statistics.Evictions > 0);
+	for (int k = 0; k < 30; k++) reader.getRawDataS(0, 0, 0, (k * 9973) % 250000, s.data(), 40000);
+	CHECK(cache.statistics().Bytes <= 16 * 30000);
+	cache.setBudget(64 << 20);
+
+	std::vector<std::thread> threads;
+	std::atomic<int> bad{ 0 };
+	for (int t = 0; t < 6; t++) {
+		threads.emplace_back([&, t] {
+			std::unique_ptr<bdfMockAPI> api(bdfMockAPI::make(1, 3, 2, 300000));
+			bdfCachedReader threadReader(api.get(), cache, 1, 8192);
+			threadReader.loadFile(FileName.c_str());
+			std::vector<uint16_t> x(5000), y(5000);
+			for (int n = 0; n < 300; n++) {
+				const uint64_t address = (uint64_t)(n * 7919 + t * 31) % 290000;
+				if (threadReader.getRawDataS(0, n % 2, n % 2, address, x.data(), 5000) != bdfAPI::errNoError) bad++;
+				api->getRawDataS(0, n % 2, n % 2, address, y.data(), 5000);
+				if (x != y) bad++;
+			}
+		});
+	}
+	for (std::thread& thread : threads) thread.join();
+	CHECK(bad == 0);
+	cache.erase(bdfBlockCache::fileId(FileName));
+	CHECK(cache.statistics().Entries == 0);
+}
+
+// Envelopes of random views against the wrapped API object, then repeated, panned and zoomed views from the cached windows
+
+static void envelope(const std::string& FileName) {
+	std::mt19937 rng(5);
+	std::unique_ptr<bdfMockAPI> mock(bdfMockAPI::make(1, 2, 1, 300000));
+	mock->Groups[0][1].Info.BytesPerSample = 4;
+	bdfBlockCache cache(64 << 20);
+	bdfCachedReader reader(mock.get(), cache);
+	CHECK(reader.loadFile(FileName.c_str()) == 0);
+
+	for (int t = 0; t < 200; t++) {
+		const unsigned input = t % 2;
+		const uint64_t address = rng() % 300000;
+		const uint64_t size = 1 + rng() % (300000 - address);
+		const unsigned pairs = 1 + (unsigned)(rng() % std::min<uint64_t>(size, 2000));
+		std::vector<uint16_t> s(2 * pairs), s2(2 * pairs);
+		std::vector<int32_t> l(2 * pairs), l2(2 * pairs);
+		std::vector<float> f(2 * pairs), f2(2 * pairs);
+		std::vector<double> d(2 * pairs), d2(2 * pairs);
+		CHECK(reader.getEnvRawDataS(0, input, 0, address, size, s.data(), 2 * pairs) == bdfAPI::errNoError);
+		mock->getEnvRawDataS(0, input, 0, address, size, s2.data(), 2 * pairs);
+		CHECK(s == s2);
+		CHECK(reader.getEnvRawDataL(0, input, 0, address, size, l.data(), 2 * pairs) == bdfAPI::errNoError);
+		mock->getEnvRawDataL(0, input, 0, address, size, l2.data(), 2 * pairs);
+		CHECK(l == l2);
+		CHECK(reader.getEnvDataF(0, input, 0, address, size, f.data(), 2 * pairs) == bdfAPI::errNoError);
+		mock->getEnvDataF(0, input, 0, address, size, f2.data(), 2 * pairs);
+		CHECK(f == f2);
+		CHECK(reader.getEnvDataD(0, input, 0, address, size, d.data(), 2 * pairs) == bdfAPI::errNoError);
+		mock->getEnvDataD(0, input, 0, address, size, d2.data(), 2 * pairs);
+		CHECK(d == d2);
+	}
+	std::vector<double> e(400), e2(400);
+	CHECK(reader.getEnvDataD(0, 0, 0, 299000, 2000, e.data(), 400) == bdfAPI::errArgument);
+
+	// a view, the same view, a pan by one sample and by 10 segments, a zoom in
+	cache.clear();
+	mock->Calls = 0;
+	CHECK(reader.getEnvDataD(0, 0, 0, 1000, 250000, e.data(), 400) == bdfAPI::errNoError);
+	const int first = mock->Calls;
+	CHECK(first > 0);
+	mock->Calls = 0;
+	CHECK(reader.getEnvDataD(0, 0, 0, 1000, 250000, e2.data(), 400) == bdfAPI::errNoError);
+	CHECK(mock->Calls == 0 && e == e2);
+	for (uint64_t address : { 1001, 13500, 12345 }) {
+		for (uint64_t size : { 250000, 125000 }) {
+			mock->Calls = 0;
+			CHECK(reader.getEnvDataD(0, 0, 0, address, size, e.data(), 400) == bdfAPI::errNoError);
+			CHECK(mock->Calls < first);
+			mock->getEnvDataD(0, 0, 0, address, size, e2.data(), 400);
+			CHECK(e == e2);
+		}
+	}
+	mock->Calls = 0;
+	CHECK(reader.getEnvDataD(0, 0, 0, 1001, 250000, e.data(), 400) == bdfAPI::errNoError);
+	CHECK(mock->Calls == 0);
+}
+
+// Mock counting the samples scanned by envelope requests
+class bdfScanMock : public bdfMockAPI {
+public:
+	uint64_t Scanned = 0;
+
+	virtual eErrorCode getEnvRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, uint16_t* Data, unsigned Count) override {
+		Scanned += BlockSize;
+		return bdfMockAPI::getEnvRawDataS(Group, Input, Block, Address, BlockSize, Data, Count);
+	}
+};
+
+// A miss on a coarse level fills at most one page of samples, a negative BinToVoltFactor keeps min below max
+
+static void coarseLevels(const std::string& FileName) {
+	const uint64_t length = 1 << 23;
+	bdfScanMock mock;
+	mock.fill(1, 1, 1, length);
+	bdfBlockCache cache(64 << 20);
+	bdfCachedReader reader(&mock, cache);
+	CHECK(reader.envelopePage(bdfCachedReader::EnvelopeWindow) == bdfCachedReader::EnvelopePage && reader.envelopePage(1 << 18) == 4 && reader.envelopePage(1 << 22) == 1);
+	CHECK(reader.loadFile(FileName.c_str()) == 0);
+
+	// two windows of 2^18 samples (level 3) and one of 2^22 samples (level 4)
+	std::vector<double> e(4), e2(4);
+	CHECK(reader.getEnvDataD(0, 0, 0, 1 << 19, 1 << 19, e.data(), 4) == bdfAPI::errNoError);
+	CHECK(mock.Scanned > 0 && mock.Scanned <= 1 << 20);
+	mock.getEnvDataD(0, 0, 0, 1 << 19, 1 << 19, e2.data(), 4);
+	CHECK(e == e2);
+	mock.Scanned = 0;
+	CHECK(reader.getEnvDataD(0, 0, 0, 1 << 22, 1 << 22, e.data(), 2) == bdfAPI::errNoError);
+	CHECK(mock.Scanned == 1 << 22);
+	mock.getEnvDataD(0, 0, 0, 1 << 22, 1 << 22, e2.data(), 2);
+	CHECK(e[0] == e2[0] && e[1] == e2[1]);
+
+	// readers with a different page size share the cache without mixing up entries
+	bdfCachedReader small(&mock, cache, 0, 64 * 1024, 1 << 18);
+	CHECK(small.loadFile(FileName.c_str()) == 0);
+	mock.Scanned = 0;
+	CHECK(small.getEnvDataD(0, 0, 0, 1 << 19, 1 << 19, e.data(), 4) == bdfAPI::errNoError);
+	CHECK(mock.Scanned == 1 << 19);
+	mock.getEnvDataD(0, 0, 0, 1 << 19, 1 << 19, e2.data(), 4);
+	CHECK(e == e2);
+
+	mock.Groups[0][0].Info.BinToVoltFactor = -2.0 / 65536;
+	mock.Groups[0][0].Info.BinToVoltConstant = 1.0;
+	reader.closeFile();
+	CHECK(reader.loadFile(FileName.c_str()) == 0);
+	std::vector<float> f(400), f2(400);
+	std::vector<double> d(400), d2(400);
+	for (uint64_t size : { 1000, 300000 }) {
+		CHECK(reader.getEnvDataF(0, 0, 0, 5000, size, f.data(), 400) == bdfAPI::errNoError);
+		CHECK(reader.getEnvDataD(0, 0, 0, 5000, size, d.data(), 400) == bdfAPI::errNoError);
+		mock.getEnvDataF(0, 0, 0, 5000, size, f2.data(), 400);
+		mock.getEnvDataD(0, 0, 0, 5000, size, d2.data(), 400);
+		bool ok = true;
+		// the mock does not exchange min and max
+		for (unsigned k = 0; k < 400; k += 2) ok = ok && d[k] <= d[k + 1] && d[k] == d2[k + 1] && d[k + 1] == d2[k] && f[k] == f2[k + 1] && f[k + 1] == f2[k];
+		CHECK(ok);
+	}
+}
+
+int main() {
+	// the file id of the cache is taken from the stamp of a real file
+	const std::string fileName = bdftest::tempPath("cache.bdf");
+	std::ofstream(fileName) << "cache";
+	raw(fileName);
+	envelope(fileName);
+	coarseLevels(fileName);
+	return bdftest::result();
+}
@@ -0,0 +1,143 @@
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfCompress.h"
+
+using namespace filereader;
+
+// Codec round trip of every length class and amplitude, scalar and SSE2 decoder
+
+static void codec() {
+	std::mt19937 rng(5);
+	std::vector<uint16_t> src(bdfDeltaCodec::ChunkSamples), dst(bdfDeltaCodec::ChunkSamples), dst2(bdfDeltaCodec::ChunkSamples);
+	std::vector<uint8_t> encoded(bdfDeltaCodec::maxEncodedSize(bdfDeltaCodec::ChunkSamples));
+	for (int amplitude : { 0, 1, 3, 100, 5000, 65535 }) {
+		for (size_t n : { 1, 7, 8, 9, 127, 128, 129, 1000, 4095, 4096 }) {
+			uint16_t v = (uint16_t)rng();
+			for (size_t k = 0; k < n; k++) {
+				v += (int)(rng() % (2 * amplitude + 1)) - amplitude;
+				src[k] = amplitude == 65535 ? (uint16_t)rng() : v;
+			}
+			const size_t size = bdfDeltaCodec::encode(src.data(), n, encoded.data());
+			CHECK(size <= bdfDeltaCodec::maxEncodedSize(n));
+			std::fill(dst.begin(), dst.end(), 0xABCD);
+			std::fill(dst2.begin(), dst2.end(), 0xABCD);
+			CHECK(bdfDeltaCodec::decode(encoded.data(), size, dst.data(), n, bdfConvert::isaScalar));
+			CHECK(bdfDeltaCodec::decode(encoded.data(), size, dst2.data(), n, bdfConvert::isaSSE2));
+			CHECK(memcmp(dst.data(), src.data(), n * sizeof(uint16_t)) == 0);
+			CHECK(memcmp(dst2.data(), src.data(), n * sizeof(uint16_t)) == 0);
+			CHECK(n == bdfDeltaCodec::ChunkSamples || (dst[n] == 0xABCD && dst2[n] == 0xABCD));
+		}
+	}
+}
+
+// Archive of 16-bit and 32-bit inputs read back through bdfAPI against the source
+
+static void archive() {
+	std::mt19937 rng(5);
+	bdfMockAPI* mock = bdfMockAPI::make(1, 3, 3, 50000);
+	mock->Groups[0][2].Info.BytesPerSample = 4;
+	mock->Groups[0][1].Blocks[2].Info.BlockLength = 12345;
+	mock->samples(0, 1, 2).resize(12345);
+	const std::string fileName = bdftest::tempPath("compress.bdfz");
+	bdfArchive::sArchiveStatistics statistics;
+	CHECK(bdfArchive::create(mock, fileName, &statistics) == bdfAPI::errNoError);
+	CHECK(statistics.ArchiveBytes < statistics.RawBytes);
+
+	bdfArchiveReader reader;
+	CHECK(reader.loadFile(fileName.c_str()) == 0);
+	CHECK(reader.getNumberOfGroups() == 1 && reader.getNumberOfInputs(0) == 3 && reader.getNumberOfBlocks(0, 1) == 3);
+	char value[32];
+	CHECK(reader.getAttribute(0, 1, (char*)"ChName", value, sizeof(value)) == bdfAPI::errNoError && std::string(value) == "A2");
+	for (unsigned i = 0; i < 3; i++) {
+		for (unsigned b = 0; b < 3; b++) {
+			bdfAPI::sBlockInfo blockInfo;
+			CHECK(reader.getBlockInfo(0, i, b, &blockInfo) == bdfAPI::errNoError);
+			const uint64_t length = blockInfo.BlockLength;
+			for (int t = 0; t < 30; t++) {
+				const uint64_t address = rng() % length;
+				const unsigned count = 1 + (unsigned)(rng() % std::min<uint64_t>(length - address, 20000));
+				std::vector<uint16_t> s(count), s2(count);
+				std::vector<int32_t> l(count), l2(count);
+				std::vector<double> d(count), d2(count);
+				if (i != 2) {
+					CHECK(reader.getRawDataS(0, i, b, address, s.data(), count) == bdfAPI::errNoError);
+					mock->getRawDataS(0, i, b, address, s2.data(), count);
+					CHECK(s == s2);
+				}
+				else CHECK(reader.getRawDataS(0, i, b, address, s.data(), count) == bdfAPI::errArgument);
+				CHECK(reader.getRawDataL(0, i, b, address, l.data(), count) == bdfAPI::errNoError);
+				mock->getRawDataL(0, i, b, address, l2.data(), count);
+				CHECK(l == l2);
+				CHECK(reader.getDataD(0, i, b, address, d.data(), count) == bdfAPI::errNoError);
+				mock->getDataD(0, i, b, address, d2.data(), count);
+				CHECK(d == d2);
+				const unsigned pairs = 1 + (unsigned)(rng() % std::min(count, 50u));
+				std::vector<double> e(2 * pairs), e2(2 * pairs);
+				std::vector<uint16_t> es(2 * pairs), es2(2 * pairs);
+				CHECK(reader.getEnvDataD(0, i, b, address, count, e.data(), 2 * pairs) == bdfAPI::errNoError);
+				mock->getEnvDataD(0, i, b, address, count, e2.data(), 2 * pairs);
+				CHECK(e == e2);
+				CHECK(reader.getEnvRawDataS(0, i, b, address, count, es.data(), 2 * pairs) == bdfAPI::errNoError);
+				mock->getEnvRawDataS(0, i, b, address, count, es2.data(), 2 * pairs);
+				CHECK(es == es2);
+			}
+			std::vector<int32_t> l(11);
+			CHECK(reader.getRawDataL(0, i, b, length - 10, l.data(), 11) == bdfAPI::errArgument);
+		}
+	}
+	reader.closeFile();
+	CHECK(reader.getNumberOfGroups() == 0);
+	delete mock;
+}
+
+static void flipByte(const std::string& FileName, long Offset, int Whence) {
+	FILE* file = fopen(FileName.c_str(), "r+b");
+	CHECK(file != nullptr);
+	if (file == nullptr) return;
+	fseek(file, Offset, Whence);
+	const int c = fgetc(file);
+	fseek(file, Offset, Whence);
+	fputc(c ^ 0x55, file);
+	fclose(file);
+}
+
+// A damaged chunk is reported on every read path of both codecs, a damaged directory fails loadFile
+
+static void corruption() {
+	for (unsigned bytesPerSample : { 2u, 4u }) {
+		bdfMockAPI* mock = bdfMockAPI::make(1, 1, 1, 3 * bdfDeltaCodec::ChunkSamples);
+		mock->Groups[0][0].Info.BytesPerSample = bytesPerSample;
+		const std::string fileName = bdftest::tempPath("corrupt.bdfz");
+		CHECK(bdfArchive::create(mock, fileName) == bdfAPI::errNoError);
+		flipByte(fileName, 100, SEEK_SET);
+
+		bdfArchiveReader reader;
+		CHECK(reader.loadFile(fileName.c_str()) == 0);
+		std::vector<int32_t> l(bdfDeltaCodec::ChunkSamples);
+		std::vector<uint16_t> s(bdfDeltaCodec::ChunkSamples);
+		std::vector<double> e(4);
+		CHECK(reader.getRawDataL(0, 0, 0, 10, l.data(), 5) == bdfAPI::errInternal);
+		CHECK(reader.getRawDataL(0, 0, 0, 0, l.data(), bdfDeltaCodec::ChunkSamples) == bdfAPI::errInternal);
+		if (bytesPerSample == 2) CHECK(reader.getRawDataS(0, 0, 0, 0, s.data(), bdfDeltaCodec::ChunkSamples) == bdfAPI::errInternal);
+		CHECK(reader.getEnvDataD(0, 0, 0, 10, 2 * bdfDeltaCodec::ChunkSamples, e.data(), 4) == bdfAPI::errInternal);
+		// the other chunks are intact
+		CHECK(reader.getRawDataL(0, 0, 0, bdfDeltaCodec::ChunkSamples, l.data(), bdfDeltaCodec::ChunkSamples) == bdfAPI::errNoError);
+		reader.closeFile();
+
+		flipByte(fileName, -40, SEEK_END);
+		CHECK(reader.loadFile(fileName.c_str()) == -1);
+		delete mock;
+	}
+}
+
+int main() {
+	codec();
+	archive();
+	corruption();
+	return bdftest::result();
+}
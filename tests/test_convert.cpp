@@ -0,0 +1,87 @@
+#include <cmath>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfConvert.h"
+
+using namespace filereader;
+
+// Every kernel against the scalar formula, for lengths around the vector widths
+
+static void kernels(bdfMockAPI* Mock) {
+	const std::vector<uint16_t>& samples = Mock->samples(0, 0, 0);
+	for (int isa = bdfConvert::isaScalar; isa <= bdfConvert::isaBest; isa++) {
+		const bdfConvert::eInstructionSet set = (bdfConvert::eInstructionSet)isa;
+		for (unsigned n : { 0u, 1u, 7u, 8u, 15u, 16u, 17u, 31u, 33u, 64u, 65u, 4999u }) {
+			std::vector<float> f(n);
+			std::vector<double> d(n);
+			std::vector<int32_t> l(n);
+			bdfConvert::rawToF(samples.data(), f.data(), n, 0xFFFC, 1e-4, -3.0, set);
+			bdfConvert::rawToD(samples.data(), d.data(), n, 0xFFFC, 1e-4, -3.0, set);
+			bdfConvert::rawToL(samples.data(), l.data(), n, 0xFFFC, set);
+			bool ok = true;
+			uint16_t mn = 0xFFFF, mx = 0;
+			for (unsigned k = 0; k < n; k++) {
+				const uint16_t v = samples[k] & 0xFFFC;
+				const double e = v * 1e-4 - 3.0;
+				ok = ok && std::fabs(d[k] - e) < 1e-12 && std::fabs(f[k] - e) < 1e-5 && l[k] == v;
+				mn = std::min(mn, v);
+				mx = std::max(mx, v);
+			}
+			CHECK(ok);
+			if (n) {
+				uint16_t kmn = 0, kmx = 0;
+				bdfConvert::minMax(samples.data(), n, 0xFFFC, kmn, kmx, set);
+				CHECK(kmn == mn && kmx == mx);
+			}
+		}
+	}
+}
+
+// Source placed at the end of the destination buffer
+
+static void inPlace(bdfMockAPI* Mock) {
+	const std::vector<uint16_t>& samples = Mock->samples(0, 0, 0);
+	const unsigned n = 1001;
+	std::vector<double> d(n);
+	uint16_t* src = reinterpret_cast<uint16_t*>(d.data() + n) - n;
+	std::copy(samples.begin(), samples.begin() + n, src);
+	bdfConvert::rawToD(src, d.data(), n, 0xFFFC, 1e-4, -3.0);
+	bool ok = true;
+	for (unsigned k = 0; k < n; k++) ok = ok && std::fabs(d[k] - ((samples[k] & 0xFFFC) * 1e-4 - 3.0)) < 1e-12;
+	CHECK(ok);
+}
+
+// The API helpers against the mock's own getData*
+
+static void api(bdfMockAPI* Mock) {
+	for (unsigned n : { 1u, 9u, 100u, 4999u }) {
+		std::vector<double> d(n), r(n);
+		std::vector<float> f(n), fr(n);
+		std::vector<int32_t> l(n), lr(n);
+		CHECK(bdfConvert::getDataD(Mock, 0, 1, 0, 1, d.data(), n) == bdfAPI::errNoError);
+		CHECK(bdfConvert::getDataF(Mock, 0, 1, 0, 1, f.data(), n) == bdfAPI::errNoError);
+		CHECK(bdfConvert::getRawDataL(Mock, 0, 1, 0, 1, l.data(), n) == bdfAPI::errNoError);
+		Mock->getDataD(0, 1, 0, 1, r.data(), n);
+		Mock->getDataF(0, 1, 0, 1, fr.data(), n);
+		Mock->getRawDataL(0, 1, 0, 1, lr.data(), n);
+		bool ok = true;
+		for (unsigned k = 0; k < n; k++) ok = ok && std::fabs(d[k] - r[k]) < 1e-12 && std::fabs(f[k] - fr[k]) < 1e-5 && l[k] == lr[k];
+		CHECK(ok);
+		CHECK(bdfConvert::getDataD(Mock, 0, 1, 0, 1, d.data(), n, bdfConvert::unitPhysical) == bdfAPI::errNoError);
+		ok = true;
+		for (unsigned k = 0; k < n; k++) ok = ok && std::fabs(d[k] - (r[k] * 10 + 1)) < 1e-9;
+		CHECK(ok);
+	}
+	std::vector<double> d(10);
+	CHECK(bdfConvert::getDataD(Mock, 0, 9, 0, 0, d.data(), 10) != bdfAPI::errNoError);
+}
+
+int main() {
+	bdfMockAPI* mock = bdfMockAPI::make(1, 2, 1, 5000);
+	kernels(mock);
+	inPlace(mock);
+	api(mock);
+	delete mock;
+	return bdftest::result();
+}
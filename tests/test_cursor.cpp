@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfCursor.h"
+
+using namespace filereader;
+
+// Reads in chunks across readahead refills and to the end of the block, as raw words and values, float and double
+
+template <typename T>
+static bool sameValues(const std::vector<T>& Data, const std::vector<double>& Reference, double Tolerance) {
+	bool ok = Data.size() == Reference.size();
+	for (size_t k = 0; ok && k < Data.size(); k++) ok = std::fabs((double)Data[k] - Reference[k]) <= Tolerance * (1 + std::fabs(Reference[k]));
+	return ok;
+}
+
+// Read a block of inputs 2 and 0 with the cursor in chunks of Chunk samples, planar per input
+template <typename T>
+static std::vector<std::vector<T>> readAll(bdfSampleCursor& Cursor, unsigned Chunk) {
+	std::vector<std::vector<T>> inputs(2);
+	std::vector<T> data(2 * Chunk);
+	unsigned read = 0;
+	while (Cursor.next(data.data(), Chunk, read) == bdfAPI::errNoError && read > 0) {
+		for (unsigned c = 0; c < 2; c++) inputs[c].insert(inputs[c].end(), data.begin() + c * Chunk, data.begin() + c * Chunk + read);
+	}
+	return inputs;
+}
+
+static void chunks(bdfMockAPI* Mock) {
+	const uint64_t length = 10007;
+	const unsigned inputs[] = { 2, 0 };
+	std::vector<double> volt[2], physical[2];
+	for (unsigned c = 0; c < 2; c++) {
+		volt[c].resize(length);
+		Mock->getDataD(0, inputs[c], 1, 0, volt[c].data(), (unsigned)length);
+		for (double v : volt[c]) physical[c].push_back(v * 10 + 1);
+	}
+
+	// every readahead refill reads each input once
+	bdfSampleCursor cursor(Mock, 0, { 2, 0 }, 1, bdfConvert::unitVolt, 1000);
+	CHECK(cursor.error() == bdfAPI::errNoError && cursor.numberOfInputs() == 2 && cursor.length() == length && cursor.readaheadSamples() == 1000);
+	std::vector<uint16_t> raw(2 * 333);
+	unsigned read = 0;
+	Mock->Calls = 0;
+	for (int n = 0; n < 9; n++) CHECK(cursor.next(raw.data(), 333, read) == bdfAPI::errNoError && read == 333);
+	CHECK(cursor.position() == 2997 && Mock->Calls == 6);
+	CHECK(std::equal(raw.begin(), raw.begin() + 333, Mock->samples(0, 2, 1).begin() + 2664));
+	CHECK(std::equal(raw.begin() + 333, raw.end(), Mock->samples(0, 0, 1).begin() + 2664));
+
+	// seeking inside the buffer does not read, a read of the readahead size goes directly to the destination
+	CHECK(cursor.seek(2500) == bdfAPI::errNoError);
+	CHECK(cursor.next(raw.data(), 300, read) == bdfAPI::errNoError && read == 300 && Mock->Calls == 6);
+	std::vector<uint16_t> large(2 * 1000);
+	CHECK(cursor.next(large.data(), 1000, read) == bdfAPI::errNoError && read == 1000 && Mock->Calls == 8);
+	CHECK(std::equal(large.begin(), large.begin() + 1000, Mock->samples(0, 2, 1).begin() + 2800));
+
+	// the end of the block
+	CHECK(cursor.seek(length - 100) == bdfAPI::errNoError);
+	CHECK(cursor.next(raw.data(), 333, read) == bdfAPI::errNoError && read == 100 && cursor.remaining() == 0);
+	CHECK(std::equal(raw.begin(), raw.begin() + 100, Mock->samples(0, 2, 1).end() - 100));
+	CHECK(std::equal(raw.begin() + 333, raw.begin() + 433, Mock->samples(0, 0, 1).end() - 100));
+	CHECK(cursor.next(raw.data(), 333, read) == bdfAPI::errNoError && read == 0);
+	CHECK(cursor.seek(length + 1) == bdfAPI::errArgument);
+
+	// whole block in chunks that do not divide the readahead, every type
+	cursor.seek(0);
+	std::vector<std::vector<int32_t>> values = readAll<int32_t>(cursor, 333);
+	CHECK(values[0].size() == length && std::equal(values[0].begin(), values[0].end(), Mock->samples(0, 2, 1).begin()));
+	CHECK(values[1].size() == length && std::equal(values[1].begin(), values[1].end(), Mock->samples(0, 0, 1).begin()));
+	cursor.seek(0);
+	std::vector<std::vector<double>> doubles = readAll<double>(cursor, 777);
+	cursor.seek(0);
+	std::vector<std::vector<float>> floats = readAll<float>(cursor, 333);
+	for (unsigned c = 0; c < 2; c++) {
+		CHECK(sameValues(doubles[c], volt[c], 1e-15));
+		CHECK(sameValues(floats[c], volt[c], 1e-6));
+	}
+
+	bdfSampleCursor physicalCursor(Mock, 0, { 2, 0 }, 1, bdfConvert::unitPhysical, 1000);
+	doubles = readAll<double>(physicalCursor, 1500);
+	physicalCursor.seek(0);
+	floats = readAll<float>(physicalCursor, 999);
+	for (unsigned c = 0; c < 2; c++) {
+		CHECK(sameValues(doubles[c], physical[c], 1e-12));
+		CHECK(sameValues(floats[c], physical[c], 1e-6));
+	}
+
+	// a block that does not exist, no destination
+	bdfSampleCursor missing(Mock, 0, { 0 }, 5);
+	CHECK(missing.error() == bdfAPI::errArgument && missing.next(raw.data(), 10, read) == bdfAPI::errArgument && read == 0);
+	CHECK(cursor.next((uint16_t*)nullptr, 10, read) == bdfAPI::errArgument);
+}
+
+// Inputs with 4 bytes per sample are read through getRawDataL, raw words are refused
+
+static void wideInputs(bdfMockAPI* Mock) {
+	Mock->Groups[0][1].Info.BytesPerSample = 4;
+	bdfSampleCursor cursor(Mock, 0, { 1 }, 0, bdfConvert::unitVolt, 1000);
+	std::vector<int32_t> values(400);
+	std::vector<double> data(400), reference(400);
+	unsigned read = 0;
+	CHECK(cursor.next(values.data(), 400, read) == bdfAPI::errNoError && read == 400);
+	CHECK(std::equal(values.begin(), values.end(), Mock->samples(0, 1, 0).begin()));
+	CHECK(cursor.next(data.data(), 400, read) == bdfAPI::errNoError && read == 400);
+	Mock->getDataD(0, 1, 0, 400, reference.data(), 400);
+	CHECK(sameValues(data, reference, 1e-15));
+	std::vector<uint16_t> raw(400);
+	CHECK(cursor.next(raw.data(), 400, read) == bdfAPI::errArgument);
+	Mock->Groups[0][1].Info.BytesPerSample = 2;
+}
+
+int main() {
+	bdfMockAPI* mock = bdfMockAPI::make(1, 3, 2, 10007);
+	chunks(mock);
+	wideInputs(mock);
+	delete mock;
+	return bdftest::result();
+}
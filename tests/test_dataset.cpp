@@ -0,0 +1,154 @@
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfDataset.h"
+
+using namespace filereader;
+
+static std::atomic<int> liveApis{ 0 }, loads{ 0 };
+
+// Mock file whose layout follows from its name: "heap1_" files have 3 inputs, the others 2, and
+// "_rec2" recordings start 30 minutes before "_rec1" recordings.
+class bdfFileMock : public bdfMockAPI {
+public:
+	bdfFileMock() { liveApis++; }
+	virtual ~bdfFileMock() { liveApis--; }
+
+	virtual int loadFile(const char* FileName) override {
+		loads++;
+		const std::string name = std::filesystem::path(FileName).filename().string();
+		unsigned seed = 0;
+		for (char c : name) seed = seed * 31 + (unsigned char)c;
+		fill(1, name.rfind("heap1", 0) == 0 ? 3 : 2, 2 + seed % 3, 2000 + seed % 1000, seed);
+		const bool early = name.find("_rec2") != std::string::npos;
+		for (sInput& input : Groups[0]) {
+			for (unsigned b = 0; b < input.Blocks.size(); b++) {
+				input.Blocks[b].Info.StartTime = { 2022, 6, 13, 11, early ? 0u : 30u, 0, 0 };
+				input.Blocks[b].Info.TriggerTimeSeconds = b * 1.0;
+			}
+		}
+		return 0;
+	}
+};
+
+static std::vector<double> volts(const bdfMockAPI& File, unsigned Input) {
+	std::vector<double> data;
+	const bdfAPI::sInputInfo& info = File.Groups[0][Input].Info;
+	for (const bdfMockAPI::sBlock& block : File.Groups[0][Input].Blocks) {
+		for (uint16_t v : block.Samples) data.push_back((v & info.AnalogMask) * info.BinToVoltFactor + info.BinToVoltConstant);
+	}
+	return data;
+}
+
+// Heap sources, recording order, time and position axes, envelopes across files and concurrent reads through the pool
+
+static void dataset() {
+	bdfMockAPI::factory() = [] { return new bdfFileMock(); };
+	const std::string directory = bdftest::tempPath("dataset");
+	std::error_code ec;
+	std::filesystem::remove_all(directory, ec);
+	std::filesystem::create_directories(directory, ec);
+	const std::vector<std::string> names = { "heap0_rec1.bdf", "heap0_rec2.bdf", "heap1_rec1.bdf", "heap1_rec2.bdf", "other.bdf" };
+	for (const std::string& name : names) std::ofstream(directory + "/" + name) << name;
+	std::ofstream(directory + "/notes.txt") << "x";
+
+	std::map<std::string, std::unique_ptr<bdfFileMock>> files;
+	for (const std::string& name : names) {
+		files[name].reset(new bdfFileMock());
+		files[name]->loadFile((directory + "/" + name).c_str());
+	}
+	const bdfFileMock& rec1 = *files["heap0_rec1.bdf"];
+	const bdfFileMock& rec2 = *files["heap0_rec2.bdf"];
+	std::vector<double> expected = volts(rec2, 0), tail = volts(rec1, 0);
+	expected.insert(expected.end(), tail.begin(), tail.end());
+
+	for (int pass = 0; pass < 2; pass++) {
+		// the second pass opens from the index files without loading
+		loads = 0;
+		bdfDataset dataset(2, 4);
+		CHECK(dataset.openDirectory(directory) == bdfAPI::errNoError);
+		CHECK(loads == (pass == 0 ? 5 : 0));
+		CHECK(dataset.numberOfFiles() == 5);
+		CHECK(dataset.getNumberOfGroups() == 3);
+		CHECK(dataset.groupSource(0) == "" && dataset.groupSource(1) == "heap0" && dataset.groupSource(2) == "heap1");
+		CHECK(dataset.getNumberOfInputs(2) == 3);
+
+		unsigned file, fileGroup, fileBlock;
+		CHECK(dataset.getLocation(1, 0, 0, file, fileGroup, fileBlock) == bdfAPI::errNoError);
+		CHECK(std::filesystem::path(dataset.fileName(file)).filename() == "heap0_rec2.bdf");
+		const unsigned blocks2 = (unsigned)rec2.Groups[0][0].Blocks.size();
+		CHECK(dataset.getNumberOfBlocks(1, 0) == blocks2 + rec1.Groups[0][0].Blocks.size());
+
+		double seconds;
+		uint64_t position;
+		CHECK(dataset.getBlockTime(1, 0, 0, seconds, position) == bdfAPI::errNoError && position == 0);
+		CHECK(dataset.getBlockTime(1, 0, blocks2, seconds, position) == bdfAPI::errNoError);
+		CHECK(position == volts(rec2, 0).size());
+		unsigned block;
+		uint64_t sample;
+		CHECK(dataset.findTime(1, 0, seconds + 0.001, block, sample) == bdfAPI::errNoError);
+		CHECK(block == blocks2 && sample == 1000);
+
+		// position axis across files
+		const uint64_t length = dataset.length(1, 0);
+		CHECK(length == expected.size());
+		std::vector<double> all((size_t)length);
+		CHECK(dataset.getData(1, 0, (uint64_t)0, all.data(), (unsigned)length) == bdfAPI::errNoError);
+		CHECK(all == expected);
+		CHECK(dataset.getData(1, 0, length - 1, all.data(), 2) == bdfAPI::errArgument);
+		CHECK(dataset.getData(1, 0, 999u, (uint64_t)0, all.data(), 1) == bdfAPI::errArgument);
+
+		for (unsigned segments : { 1u, 7u, 100u }) {
+			const uint64_t address = 1234, size = length - 3000;
+			std::vector<double> envelope(2 * segments);
+			CHECK(dataset.getEnvData(1, 0, address, size, envelope.data(), 2 * segments) == bdfAPI::errNoError);
+			bool ok = true;
+			for (unsigned s = 0; s < segments; s++) {
+				const auto first = expected.begin() + (ptrdiff_t)(address + size * s / segments);
+				const auto last = expected.begin() + (ptrdiff_t)(address + size * (s + 1) / segments);
+				ok = ok && std::fabs(*std::min_element(first, last) - envelope[2 * s]) < 1e-9 && std::fabs(*std::max_element(first, last) - envelope[2 * s + 1]) < 1e-9;
+			}
+			CHECK(ok);
+		}
+
+		std::vector<uint16_t> raw(100);
+		CHECK(dataset.getRawDataS(2, 2, 1, 10, raw.data(), 100) == bdfAPI::errNoError);
+		CHECK(dataset.getLocation(2, 2, 1, file, fileGroup, fileBlock) == bdfAPI::errNoError);
+		const std::string name = std::filesystem::path(dataset.fileName(file)).filename().string();
+		CHECK(memcmp(raw.data(), &files[name]->samples(0, 2, fileBlock)[10], 100 * sizeof(uint16_t)) == 0);
+
+		// 8 threads on a pool of 2 files
+		std::vector<std::thread> threads;
+		std::atomic<int> bad{ 0 };
+		for (int t = 0; t < 8; t++) {
+			threads.emplace_back([&, t] {
+				std::vector<double> data(1500);
+				for (int n = 0; n < 50; n++) {
+					const unsigned group = 1 + (n + t) % 2, input = (n * 7 + t) % 2;
+					const uint64_t address = (uint64_t)(n * 7919 + t * 104729) % (dataset.length(group, input) - 1500);
+					if (dataset.getData(group, input, address, data.data(), 1500) != bdfAPI::errNoError) bad++;
+					else if (group == 1 && input == 0 && memcmp(data.data(), &expected[(size_t)address], 1500 * sizeof(double)) != 0) bad++;
+				}
+			});
+		}
+		for (std::thread& thread : threads) thread.join();
+		CHECK(bad == 0);
+		CHECK(liveApis <= (int)files.size() + 2);
+	}
+	CHECK(std::filesystem::exists(directory + "/heap0_rec1.bdf.idx"));
+	CHECK(liveApis == (int)files.size());
+}
+
+int main() {
+	dataset();
+	return bdftest::result();
+}
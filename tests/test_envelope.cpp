@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfEnvelope.h"
+
+using namespace filereader;
+
+// Level estimates of getEnv* requests
+
+static void estimates(bdfMockAPI* Mock) {
+	bdfEnvelope::sEnvelopeEstimate estimate;
+	std::vector<double> data(20), reference(20);
+	CHECK(bdfEnvelope::getEnvDataDEstimated(Mock, 0, 0, 0, 100, 52, data.data(), 10, &estimate) == bdfAPI::errNoError);
+	CHECK(estimate.Level == 0 && estimate.SamplesPerPair == 1 && estimate.MinSegmentSize == 10);
+	CHECK(bdfEnvelope::getEnvDataDEstimated(Mock, 0, 0, 0, 0, 100000, data.data(), 20, &estimate) == bdfAPI::errNoError);
+	CHECK(estimate.Level == 3 && estimate.SamplesPerPair == 4096 && estimate.MinSegmentSize == 10000);
+	CHECK(estimate.MaxValuesRead <= 100000);
+	Mock->getEnvDataD(0, 0, 0, 0, 100000, reference.data(), 20);
+	CHECK(data == reference);
+
+	bdfAPI::sBlockInfo blockInfo{};
+	blockInfo.ReductionFactor = 16;
+	blockInfo.NumberOfReductions = 8;
+	CHECK(bdfEnvelope::estimateLevel(blockInfo, 10000000000ull, 4000, &estimate) == bdfAPI::errNoError);
+	CHECK(estimate.Level == 5 && estimate.SamplesPerPair == 1048576);
+	CHECK(bdfEnvelope::estimateLevel(blockInfo, 100, 0, &estimate) == bdfAPI::errArgument);
+}
+
+// The helpers forward every request, the DLL decides about its validity
+
+static void forwarding(bdfMockAPI* Mock) {
+	bdfEnvelope::sEnvelopeEstimate estimate;
+	std::vector<double> data(10), reference(10);
+	CHECK(bdfEnvelope::getEnvDataDEstimated(Mock, 0, 0, 0, 100, 3, data.data(), 10, &estimate) == bdfAPI::errNoError);
+	CHECK(estimate.Level == 0 && estimate.MinSegmentSize == 0);
+	Mock->getEnvDataD(0, 0, 0, 100, 3, reference.data(), 10);
+	CHECK(data == reference);
+	CHECK(bdfEnvelope::getEnvDataDEstimated(Mock, 0, 0, 0, 99990, 52, data.data(), 10, &estimate) == bdfAPI::errArgument);
+	CHECK(estimate.SamplesPerPair == 0);
+	CHECK(bdfEnvelope::getEnvDataDEstimated(nullptr, 0, 0, 0, 0, 52, data.data(), 10) == bdfAPI::errInvalidHandle);
+}
+
+// Pyramids streamed in odd sized chunks against a direct reduction of the samples
+
+static void pyramids(bdfMockAPI* Mock) {
+	const std::vector<uint16_t>& samples = Mock->samples(0, 0, 0);
+	const uint64_t length = 99999;
+	for (unsigned factor : { 2u, 3u, 8u, 16u, 24u, 32u, 100u }) {
+		bdfEnvelopeWriter writer(Mock, factor, 3);
+		writer.writeInputHeader(0, 0, 0xFFFC, 3, 10, 0, 1, 0, 0);
+		int streamer = writer.initInputStreamer(0, 0, 0, 0);
+		const char* bytes = reinterpret_cast<const char*>(samples.data());
+		const size_t total = length * 2 + 1;
+		size_t pos = 0;
+		for (unsigned step = 1; pos < total; step = step * 7 % 1009 + 1) {
+			const unsigned n = (unsigned)std::min<size_t>(step, total - pos);
+			writer.writeData(streamer, const_cast<char*>(bytes) + pos, n, 0);
+			pos += n;
+		}
+		writer.writeEORInfo(0, 0, total, 0, 0, 0);
+		std::shared_ptr<const bdfEnvelopeBuilder> envelope = writer.getEnvelope(streamer, 0, 0);
+		CHECK(envelope && envelope->finished() && envelope->numberOfSamples() == length);
+		if (!envelope) continue;
+		uint64_t samplesPerPair = 1;
+		for (unsigned level = 1; level <= 3; level++) {
+			samplesPerPair *= factor;
+			const uint64_t nrOfPairs = (length + samplesPerPair - 1) / samplesPerPair;
+			CHECK(envelope->numberOfPairs(level) == nrOfPairs);
+			std::vector<uint16_t> pairs(2 * nrOfPairs);
+			CHECK(envelope->getPairs(level, 0, pairs.data(), nrOfPairs) == nrOfPairs);
+			bool ok = true;
+			for (uint64_t k = 0; k < nrOfPairs; k++) {
+				uint16_t mn = 0xFFFF, mx = 0;
+				for (uint64_t j = k * samplesPerPair; j < std::min((k + 1) * samplesPerPair, length); j++) {
+					mn = std::min<uint16_t>(mn, samples[(size_t)j] & 0xFFFC);
+					mx = std::max<uint16_t>(mx, samples[(size_t)j] & 0xFFFC);
+				}
+				ok = ok && pairs[2 * k] == mn && pairs[2 * k + 1] == mx;
+			}
+			CHECK(ok);
+		}
+		// the streamer continues with the next block
+		writer.writeData(streamer, const_cast<char*>(bytes), 200, 0);
+		CHECK(writer.getEnvelope(streamer, 1, 0) && writer.getEnvelope(streamer, 1, 0)->numberOfSamples() == 100);
+		writer.closeFile();
+		CHECK(writer.getEnvelope(streamer, 1, 0)->finished());
+	}
+}
+
+// Windowed min/max kernel against the scalar reduction
+
+static void windows(bdfMockAPI* Mock) {
+	const std::vector<uint16_t>& samples = Mock->samples(0, 0, 0);
+	for (int isa = bdfConvert::isaScalar; isa <= bdfConvert::isaBest; isa++) {
+		for (unsigned window : { 1u, 5u, 8u, 16u, 24u, 32u, 48u }) {
+			for (size_t nrOfWindows : { 0, 1, 7, 8, 9, 17, 100 }) {
+				std::vector<uint16_t> pairs(2 * nrOfWindows);
+				bdfConvert::minMaxWindows(samples.data() + 3, nrOfWindows, window, 0xFFFC, pairs.data(), (bdfConvert::eInstructionSet)isa);
+				bool ok = true;
+				for (size_t w = 0; w < nrOfWindows; w++) {
+					uint16_t mn = 0xFFFF, mx = 0;
+					for (unsigned k = 0; k < window; k++) {
+						mn = std::min<uint16_t>(mn, samples[3 + w * window + k] & 0xFFFC);
+						mx = std::max<uint16_t>(mx, samples[3 + w * window + k] & 0xFFFC);
+					}
+					ok = ok && pairs[2 * w] == mn && pairs[2 * w + 1] == mx;
+				}
+				CHECK(ok);
+			}
+		}
+	}
+	// full 16-bit range, the SSE2 kernel compares with a flipped sign bit
+	std::vector<uint16_t> extremes(64, 0x8000);
+	extremes[5] = 0xFFFF;
+	extremes[40] = 0;
+	uint16_t pairs[4];
+	for (int isa = bdfConvert::isaScalar; isa <= bdfConvert::isaBest; isa++) {
+		bdfConvert::minMaxWindows(extremes.data(), 2, 32, 0xFFFF, pairs, (bdfConvert::eInstructionSet)isa);
+		CHECK(pairs[0] == 0x8000 && pairs[1] == 0xFFFF && pairs[2] == 0 && pairs[3] == 0x8000);
+	}
+}
+
+// Inputs wider than 16 bits are passed through without a pyramid
+
+static void wideInputs(bdfMockAPI* Mock) {
+	bdfEnvelopeWriter writer(Mock);
+	writer.writeInputHeader(0, 1, 0xFFFFFF00, 0xFF, 10, 0, 1, 0, 0);
+	int streamer = writer.initInputStreamer(0, 1, 0, 0);
+	uint32_t words[64] = {};
+	CHECK(writer.writeData(streamer, reinterpret_cast<char*>(words), sizeof(words), 0) == bdfAPI::errNoError);
+	CHECK(writer.getEnvelope(streamer, 0, 0) == nullptr);
+	CHECK(Mock->Written[streamer].size() == sizeof(words));
+}
+
+// One producer thread per input, each closing its own blocks
+
+static void producers(bdfMockAPI* Mock) {
+	bdfEnvelopeWriter writer(Mock);
+	const int streamers[2] = { writer.initInputStreamer(0, 0, 0, 0), writer.initInputStreamer(0, 1, 0, 0) };
+	auto produce = [&](unsigned Input) {
+		const char* bytes = reinterpret_cast<const char*>(Mock->samples(0, 0, 0).data());
+		for (uint32_t block = 0; block < 3; block++) {
+			for (int k = 0; k < 1000; k++) writer.writeData(streamers[Input], const_cast<char*>(bytes) + k * 33, 33, 0);
+			writer.writeEORInfo(block, 0, 33000, Input, 0, 0);
+		}
+	};
+	std::thread first(produce, 0u), second(produce, 1u);
+	first.join();
+	second.join();
+	for (int input = 0; input < 2; input++) {
+		for (uint32_t block = 0; block < 3; block++) {
+			std::shared_ptr<const bdfEnvelopeBuilder> envelope = writer.getEnvelope(streamers[input], block, 0);
+			CHECK(envelope && envelope->finished() && envelope->numberOfSamples() == 16500);
+		}
+	}
+}
+
+// Mock writer with one handle per group, counting the samples the reader side scans
+class bdfSidecarMock : public bdfMockAPI {
+public:
+	uint64_t SamplesScanned = 0;
+
+	virtual int initFileWriter(unsigned Group, sDateTime&, eOperationMode, double, uint32_t, uint32_t) override { return (int)Group; }
+	virtual eErrorCode getRawDataS(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint16_t* Data, unsigned Count) override {
+		SamplesScanned += Count;
+		return bdfMockAPI::getRawDataS(Group, Input, Block, Address, Data, Count);
+	}
+	virtual eErrorCode getEnvDataD(unsigned Group, unsigned Input, unsigned Block, uint64_t Address, uint64_t BlockSize, double* Data, unsigned Count) override {
+		SamplesScanned += BlockSize;
+		return bdfMockAPI::getEnvDataD(Group, Input, Block, Address, BlockSize, Data, Count);
+	}
+};
+
+// Pyramids written to the sidecar and read back through bdfEnvelopeReader, closeFile of one group, stale and corrupt sidecars
+
+static void sidecar() {
+	const uint64_t length = 200003;
+	bdfSidecarMock source;
+	source.fill(2, 2, 2, length);
+	bdfEnvelopeWriter writer(&source, 16, 3);
+	bdfAPI::sDateTime startTime = { 2022, 6, 13, 11, 0, 0, 0 };
+	for (unsigned g = 0; g < 2; g++) {
+		const int handle = writer.initFileWriter(g, startTime, bdfAPI::multiEventRecorder, 1e6, 1, 0);
+		for (unsigned i = 0; i < 2; i++) writer.writeInputHeader(0, i, 0xFFFC, 3, 10, 0, 1, 0, handle);
+		for (unsigned b = 0; b < 2; b++) {
+			for (unsigned i = 0; i < 2; i++) {
+				const int streamer = writer.initInputStreamer(0, i, b, handle);
+				char* bytes = reinterpret_cast<char*>(source.samples(g, i, b).data());
+				for (uint64_t pos = 0; pos < 2 * length; pos += 65536) writer.writeData(streamer, bytes + pos, (unsigned)std::min<uint64_t>(65536, 2 * length - pos), handle);
+				// the last block of group 1 is closed by closeFile
+				if (g == 0 || b == 0) writer.writeEORInfo(b, 0, 2 * length, i, 0, handle);
+			}
+		}
+	}
+	writer.closeFile(0);
+	CHECK(!writer.getEnvelope(7, 1, 1)->finished());
+	writer.closeFile(1);
+	CHECK(writer.getEnvelope(7, 1, 1)->finished());
+
+	const std::string fileName = bdftest::tempPath("envelope.bdf");
+	std::ofstream(fileName) << "envelope";
+	CHECK(writer.saveEnvelopeFile(fileName) == bdfAPI::errNoError);
+
+	std::mt19937 rng(5);
+	bdfSidecarMock mock;
+	mock.fill(2, 2, 2, length);
+	bdfEnvelopeReader reader(&mock);
+	CHECK(reader.loadFile(fileName.c_str()) == 0 && reader.numberOfPyramids() == 8);
+	for (int t = 0; t < 300; t++) {
+		const unsigned g = t % 2, i = (t / 2) % 2, b = (t / 4) % 2;
+		const uint64_t address = t % 3 == 0 ? 0 : rng() % length;
+		const uint64_t size = t % 5 == 0 ? length - address : 1 + rng() % (length - address);
+		const unsigned pairs = 1 + (unsigned)(rng() % std::min<uint64_t>(size, 2000));
+		std::vector<uint16_t> s(2 * pairs), s2(2 * pairs);
+		std::vector<int32_t> l(2 * pairs), l2(2 * pairs);
+		std::vector<float> f(2 * pairs), f2(2 * pairs);
+		std::vector<double> d(2 * pairs), d2(2 * pairs);
+		CHECK(reader.getEnvRawDataS(g, i, b, address, size, s.data(), 2 * pairs) == bdfAPI::errNoError);
+		mock.getEnvRawDataS(g, i, b, address, size, s2.data(), 2 * pairs);
+		CHECK(s == s2);
+		CHECK(reader.getEnvRawDataL(g, i, b, address, size, l.data(), 2 * pairs) == bdfAPI::errNoError);
+		mock.getEnvRawDataL(g, i, b, address, size, l2.data(), 2 * pairs);
+		CHECK(l == l2);
+		CHECK(reader.getEnvDataF(g, i, b, address, size, f.data(), 2 * pairs) == bdfAPI::errNoError);
+		mock.getEnvDataF(g, i, b, address, size, f2.data(), 2 * pairs);
+		CHECK(f == f2);
+		CHECK(reader.getEnvDataD(g, i, b, address, size, d.data(), 2 * pairs) == bdfAPI::errNoError);
+		mock.getEnvDataD(g, i, b, address, size, d2.data(), 2 * pairs);
+		CHECK(d == d2);
+	}
+	std::vector<double> d(400);
+	CHECK(reader.getEnvDataD(0, 0, 0, length - 10, 11, d.data(), 2) == bdfAPI::errArgument);
+
+	// an overview of the whole block scans a small part of the samples
+	mock.SamplesScanned = 0;
+	CHECK(reader.getEnvDataD(1, 1, 1, 0, length, d.data(), 400) == bdfAPI::errNoError);
+	CHECK(mock.SamplesScanned < length / 4);
+
+	// a rewritten file or a damaged sidecar is not used, the requests are forwarded
+	std::ofstream(fileName) << "rewritten";
+	CHECK(reader.loadFile(fileName.c_str()) == 0 && reader.numberOfPyramids() == 0);
+	mock.SamplesScanned = 0;
+	CHECK(reader.getEnvDataD(1, 1, 1, 0, length, d.data(), 400) == bdfAPI::errNoError && mock.SamplesScanned == length);
+	CHECK(writer.saveEnvelopeFile(fileName) == bdfAPI::errNoError);
+	CHECK(reader.loadFile(fileName.c_str()) == 0 && reader.numberOfPyramids() == 8);
+	{
+		std::fstream file(bdfEnvelopeFile::envelopeFileName(fileName), std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(200);
+		file.put('x');
+	}
+	CHECK(reader.loadFile(fileName.c_str()) == 0 && reader.numberOfPyramids() == 0);
+	reader.closeFile();
+}
+
+int main() {
+	bdfMockAPI* mock = bdfMockAPI::make(1, 1, 1, 100000);
+	estimates(mock);
+	forwarding(mock);
+	pyramids(mock);
+	windows(mock);
+	wideInputs(mock);
+	producers(mock);
+	sidecar();
+	delete mock;
+	return bdftest::result();
+}
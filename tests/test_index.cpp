@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfIndex.h"
+
+using namespace filereader;
+
+// Mock counting loadFile and block info queries, loadFile fails while Fail is set
+class bdfIndexMock : public bdfMockAPI {
+public:
+	int Loads = 0;
+	int BlockInfos = 0;
+	bool Fail = false;
+
+	bdfIndexMock() { fill(2, 3, 4, 5000); }
+
+	virtual int loadFile(const char*) override {
+		Loads++;
+		return Fail ? -1 : 0;
+	}
+	virtual eErrorCode getBlockInfo(unsigned Group, unsigned Input, unsigned Block, sBlockInfo* BlockInfo) override {
+		BlockInfos++;
+		return bdfMockAPI::getBlockInfo(Group, Input, Block, BlockInfo);
+	}
+};
+
+static void writeFile(const std::string& FileName, const std::string& Content) {
+	std::ofstream(FileName, std::ios::binary) << Content;
+}
+
+// The metadata of the reader matches the mock, and a data read loads the file
+static bool sameMetadata(bdfIndexedReader& Reader, bdfIndexMock& Reference) {
+	bool ok = Reader.getNumberOfGroups() == 2;
+	for (unsigned g = 0; g < 2; g++) {
+		bdfAPI::eOperationMode mode;
+		ok = ok && Reader.getOperationMode(g, mode) == bdfAPI::errNoError && mode == Reference.Modes[g];
+		ok = ok && Reader.getNumberOfInputs(g) == 3;
+		for (unsigned i = 0; i < 3; i++) {
+			bdfAPI::sInputInfo info;
+			ok = ok && Reader.getInputInfo(g, i, &info) == bdfAPI::errNoError && info.InputNumber == i && info.AnalogMask == 0xFFFC;
+			ok = ok && Reader.getNumberOfBlocks(g, i) == 4;
+			char name[16];
+			ok = ok && Reader.getAttribute(g, i, (char*)"ChName", name, sizeof(name)) == bdfAPI::errNoError && name == "A" + std::to_string(i + 1);
+			for (unsigned b = 0; b < 4; b++) {
+				bdfAPI::sBlockInfo block;
+				ok = ok && Reader.getBlockInfo(g, i, b, &block) == bdfAPI::errNoError;
+				ok = ok && block.BlockLength == 5000 && block.TriggerTimeSeconds == b * 0.5;
+			}
+		}
+	}
+	return ok;
+}
+
+// Build mode: index built on the first open, used on the next, rebuilt for a changed file or a corrupt index
+
+static void buildMode(const std::string& FileName) {
+	const std::string indexName = bdfBlockIndex::indexFileName(FileName);
+	bdfIndexMock reference;
+	{
+		bdfIndexMock mock;
+		bdfIndexedReader reader(&mock);
+		CHECK(reader.loadFile(FileName.c_str()) == 0);
+		CHECK(mock.Loads == 1 && reader.isLoaded() && reader.isIndexed() && std::filesystem::exists(indexName));
+	}
+
+	// index hit: no loadFile and no metadata query until the first data access
+	bdfIndexMock mock;
+	bdfIndexedReader reader(&mock);
+	CHECK(reader.loadFile(FileName.c_str()) == 0);
+	CHECK(mock.Loads == 0 && reader.isIndexed() && !reader.isLoaded());
+	CHECK(sameMetadata(reader, reference) && mock.Loads == 0 && mock.BlockInfos == 0);
+	std::vector<uint16_t> data(100);
+	CHECK(reader.getRawDataS(1, 2, 3, 400, data.data(), 100) == bdfAPI::errNoError && mock.Loads == 1);
+	CHECK(std::equal(data.begin(), data.end(), mock.samples(1, 2, 3).begin() + 400));
+	reader.closeFile();
+	CHECK(!reader.isLoaded() && !reader.isIndexed());
+
+	// stale stamp: the file changed, the index is rebuilt
+	writeFile(FileName, "rewritten file");
+	mock.Loads = 0;
+	CHECK(reader.loadFile(FileName.c_str()) == 0);
+	CHECK(mock.Loads == 1 && reader.isIndexed());
+	{
+		bdfIndexMock other;
+		bdfIndexedReader hit(&other);
+		CHECK(hit.loadFile(FileName.c_str()) == 0 && other.Loads == 0 && hit.isIndexed());
+	}
+
+	// corrupt index
+	{
+		std::fstream file(indexName, std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(100);
+		file.put('x');
+	}
+	mock.Loads = 0;
+	CHECK(reader.loadFile(FileName.c_str()) == 0);
+	CHECK(mock.Loads == 1 && reader.isIndexed() && sameMetadata(reader, reference));
+
+	// a file the wrapped object cannot open
+	std::filesystem::remove(indexName);
+	mock.Fail = true;
+	CHECK(reader.loadFile(FileName.c_str()) == -1);
+	CHECK(reader.loadFile(bdftest::tempPath("missing.bdf").c_str()) == -1);
+}
+
+// Lazy mode: loadFile does not load the file, the first access does; no index is written
+
+static void lazyMode(const std::string& FileName) {
+	const std::string indexName = bdfBlockIndex::indexFileName(FileName);
+	std::filesystem::remove(indexName);
+	bdfIndexMock reference;
+	bdfIndexMock mock;
+	bdfIndexedReader reader(&mock, bdfIndexedReader::indexLazy);
+	CHECK(reader.loadFile(FileName.c_str()) == 0);
+	CHECK(mock.Loads == 0 && !reader.isLoaded() && !reader.isIndexed());
+	CHECK(reader.getNumberOfGroups() == 2 && mock.Loads == 1 && reader.isLoaded());
+	CHECK(sameMetadata(reader, reference) && mock.Loads == 1 && mock.BlockInfos > 0);
+	CHECK(!std::filesystem::exists(indexName));
+
+	// data access first
+	mock.Loads = 0;
+	CHECK(reader.loadFile(FileName.c_str()) == 0 && mock.Loads == 0);
+	std::vector<double> data(10);
+	CHECK(reader.getDataD(0, 1, 2, 0, data.data(), 10) == bdfAPI::errNoError && mock.Loads == 1);
+
+	// with a valid index the lazy mode uses it
+	CHECK(bdfIndexedReader::buildIndex(&reference, FileName) == bdfAPI::errNoError);
+	mock.Loads = 0;
+	mock.BlockInfos = 0;
+	CHECK(reader.loadFile(FileName.c_str()) == 0 && reader.isIndexed());
+	CHECK(sameMetadata(reader, reference) && mock.Loads == 0 && mock.BlockInfos == 0);
+
+	// the stamp is checked on loadFile, a failed load of the wrapped object on the first access
+	CHECK(reader.loadFile(bdftest::tempPath("missing.bdf").c_str()) == -1);
+	std::filesystem::remove(indexName);
+	mock.Fail = true;
+	CHECK(reader.loadFile(FileName.c_str()) == 0);
+	CHECK(reader.getDataD(0, 1, 2, 0, data.data(), 10) == bdfAPI::errInvalidHandle && reader.getNumberOfGroups() == 0);
+}
+
+int main() {
+	const std::string fileName = bdftest::tempPath("index.bdf");
+	std::filesystem::remove(bdfBlockIndex::indexFileName(fileName));
+	std::filesystem::remove(bdftest::tempPath("missing.bdf"));
+	writeFile(fileName, "index test file");
+	buildMode(fileName);
+	writeFile(fileName, "index test file");
+	lazyMode(fileName);
+	return bdftest::result();
+}
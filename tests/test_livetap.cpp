@@ -0,0 +1,160 @@
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfLiveTap.h"
+
+using namespace filereader;
+
+// A reader thread follows the stream while blocks are written
+
+static void follow() {
+	bdfMockAPI mock;
+	bdfLiveTap tap(&mock, 1000);
+	const int streamer = tap.initInputStreamer(0, 0, 0);
+	std::vector<char> received, reference;
+	std::thread reader([&] {
+		uint64_t sequence = 0, offset = 0;
+		char buffer[300];
+		for (;;) {
+			sequence = tap.waitForUpdate(sequence, 1000);
+			bdfLiveTap::sLiveProgress progress;
+			if (!tap.getProgress(streamer, progress)) continue;
+			if (offset < progress.FirstRetained) offset = progress.FirstRetained;
+			size_t n;
+			while ((n = tap.read(streamer, offset, buffer, sizeof(buffer))) > 0) {
+				received.insert(received.end(), buffer, buffer + n);
+				offset += n;
+			}
+			if (tap.closed() && offset == progress.TotalBytes) break;
+		}
+	});
+	for (int i = 0; i < 2000; i++) {
+		char data[37];
+		for (int k = 0; k < 37; k++) data[k] = (char)(i * 37 + k);
+		reference.insert(reference.end(), data, data + 37);
+		tap.writeData(streamer, data, 37);
+		if (i % 500 == 499) tap.writeEORInfo(i / 500, 0, 0, 0, 0);
+	}
+	tap.closeFile();
+	reader.join();
+	CHECK(received.size() >= 1000 && received.size() <= reference.size());
+	CHECK(memcmp(received.data() + received.size() - 1000, reference.data() + reference.size() - 1000, 1000) == 0);
+	bdfLiveTap::sLiveProgress progress;
+	CHECK(tap.getProgress(streamer, progress));
+	CHECK(progress.BlocksCompleted == 4 && progress.Block == 4 && progress.TotalBytes == 74000 && progress.BlockStartOffset == 74000);
+}
+
+// initInputStreamer of a known streamer starts a block at the current offset, older offsets stay valid
+
+static void reinit() {
+	bdfMockAPI mock;
+	bdfLiveTap tap(&mock, 1000);
+	const int streamer = tap.initInputStreamer(0, 0, 0);
+	char first[600], second[300], data[600];
+	for (int k = 0; k < 600; k++) first[k] = (char)k;
+	for (int k = 0; k < 300; k++) second[k] = (char)(k + 7);
+	tap.writeData(streamer, first, 600);
+	tap.writeEORInfo(0, 0, 600, 0, 0);
+
+	// the mock hands out a new handle per call, the key of the tap is (Handle, streamer)
+	mock.Streamers.resize(streamer);
+	mock.Written.resize(streamer);
+	CHECK(tap.initInputStreamer(0, 0, 1) == streamer);
+	bdfLiveTap::sLiveProgress progress;
+	CHECK(tap.getProgress(streamer, progress));
+	CHECK(progress.Block == 1 && progress.BlocksCompleted == 1 && progress.TotalBytes == 600 && progress.BlockStartOffset == 600);
+	CHECK(tap.read(streamer, 100, data, 500) == 500 && memcmp(data, first + 100, 500) == 0);
+	tap.writeData(streamer, second, 300);
+	CHECK(tap.read(streamer, 100, data, 600) == 600);
+	CHECK(memcmp(data, first + 100, 500) == 0 && memcmp(data + 500, second, 100) == 0);
+	CHECK(tap.getProgress(streamer, progress) && progress.TotalBytes == 900);
+}
+
+// Another process follows the committed progress through the progress file
+
+static void progressFile() {
+	bdfMockAPI mock;
+	const std::string fileName = bdfLiveTap::progressFileName(bdftest::tempPath("live.bdf"));
+	std::filesystem::remove(fileName);
+	bdfLiveTap::sLiveSnapshot snapshot;
+	CHECK(bdfLiveTap::readProgressFile(fileName, snapshot) == bdfAPI::errArgument);
+	{
+		bdfLiveTap tap(&mock, 1000);
+		// writeData does not publish within the interval
+		CHECK(tap.setProgressFile(fileName, 60000) == bdfAPI::errNoError);
+		const int streamers[2] = { tap.initInputStreamer(0, 0, 0), tap.initInputStreamer(0, 1, 0) };
+		char data[100] = {};
+		tap.writeData(streamers[0], data, 100);
+		tap.writeData(streamers[1], data, 40);
+		CHECK(bdfLiveTap::readProgressFile(fileName, snapshot) == bdfAPI::errNoError);
+		CHECK(snapshot.Streamers.size() == 2 && snapshot.Streamers[0].Progress.TotalBytes == 0 && !snapshot.Closed);
+
+		tap.writeEORInfo(0, 0, 100, 0, 0);
+		CHECK(bdfLiveTap::readProgressFile(fileName, snapshot) == bdfAPI::errNoError);
+		CHECK(snapshot.Streamers.size() == 2);
+		if (snapshot.Streamers.size() == 2) {
+			const bdfLiveTap::sLiveStreamer& a = snapshot.Streamers[0];
+			const bdfLiveTap::sLiveStreamer& b = snapshot.Streamers[1];
+			CHECK(a.Streamer == streamers[0] && a.Input == 0 && a.Progress.BlocksCompleted == 1 && a.Progress.TotalBytes == 100);
+			CHECK(b.Streamer == streamers[1] && b.Input == 1 && b.Progress.BlocksCompleted == 0 && b.Progress.TotalBytes == 40);
+		}
+		const uint64_t sequence = snapshot.Sequence;
+		tap.closeFile();
+		CHECK(bdfLiveTap::readProgressFile(fileName, snapshot) == bdfAPI::errNoError);
+		CHECK(snapshot.Closed && snapshot.Sequence > sequence);
+		// 8 bytes magic, sequence, closed and count, 48 bytes per streamer, checksum
+		CHECK(std::filesystem::file_size(fileName) == 8 + 16 + 2 * 48 + 8);
+	}
+	// a damaged file is rejected
+	{
+		std::fstream file(fileName, std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(20);
+		file.put('x');
+	}
+	CHECK(bdfLiveTap::readProgressFile(fileName, snapshot) == bdfAPI::errArgument);
+	std::filesystem::remove(fileName);
+}
+
+// writeData publishes the progress at most once per interval
+
+static void publishInterval() {
+	bdfMockAPI mock;
+	const std::string fileName = bdfLiveTap::progressFileName(bdftest::tempPath("interval.bdf"));
+	bdfLiveTap tap(&mock, 1000);
+	bdfLiveTap::sLiveSnapshot snapshot;
+	char data[100] = {};
+	CHECK(tap.setProgressFile(fileName, 0) == bdfAPI::errNoError);
+	const int streamer = tap.initInputStreamer(3, 2, 0);
+	tap.writeData(streamer, data, 100);
+	CHECK(bdfLiveTap::readProgressFile(fileName, snapshot) == bdfAPI::errNoError && snapshot.Sequence == tap.sequence());
+	CHECK(snapshot.Streamers.size() == 1 && snapshot.Streamers[0].Board == 3 && snapshot.Streamers[0].Input == 2 && snapshot.Streamers[0].Progress.TotalBytes == 100);
+
+	CHECK(tap.setProgressFile(fileName, 200) == bdfAPI::errNoError);
+	tap.writeData(streamer, data, 50);
+	CHECK(bdfLiveTap::readProgressFile(fileName, snapshot) == bdfAPI::errNoError && snapshot.Streamers[0].Progress.TotalBytes == 100);
+	std::this_thread::sleep_for(std::chrono::milliseconds(250));
+	tap.writeData(streamer, data, 50);
+	CHECK(bdfLiveTap::readProgressFile(fileName, snapshot) == bdfAPI::errNoError && snapshot.Streamers[0].Progress.TotalBytes == 200);
+	tap.writeData(streamer, data, 50);
+	CHECK(bdfLiveTap::readProgressFile(fileName, snapshot) == bdfAPI::errNoError && snapshot.Streamers[0].Progress.TotalBytes == 200);
+
+	// stopped publishing
+	CHECK(tap.setProgressFile("") == bdfAPI::errNoError);
+	std::this_thread::sleep_for(std::chrono::milliseconds(250));
+	tap.writeData(streamer, data, 50);
+	CHECK(bdfLiveTap::readProgressFile(fileName, snapshot) == bdfAPI::errNoError && snapshot.Streamers[0].Progress.TotalBytes == 200);
+	std::filesystem::remove(fileName);
+}
+
+int main() {
+	follow();
+	reinit();
+	progressFile();
+	publishInterval();
+	return bdftest::result();
+}
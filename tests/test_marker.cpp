@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfMarker.h"
+
+using namespace filereader;
+
+// Every bit extraction kernel against the scalar one
+
+static void kernels() {
+	std::mt19937 rng(5);
+	for (size_t n : { 0, 1, 63, 64, 65, 127, 128, 1000, 4097 }) {
+		for (unsigned bit = 0; bit < 16; bit++) {
+			std::vector<uint16_t> samples(n);
+			for (uint16_t& v : samples) v = (uint16_t)rng();
+			std::vector<uint64_t> reference((n + 63) / 64), bits((n + 63) / 64);
+			bdfMarker::extractBits(samples.data(), n, bit, reference.data(), bdfConvert::isaScalar);
+			bool ok = true;
+			for (size_t k = 0; k < n; k++) ok = ok && ((reference[k / 64] >> (k % 64)) & 1) == ((samples[k] >> bit) & 1u);
+			CHECK(ok);
+			for (bdfConvert::eInstructionSet isa : { bdfConvert::isaSSE2, bdfConvert::isaAVX2, bdfConvert::isaBest }) {
+				std::fill(bits.begin(), bits.end(), ~0ull);
+				bdfMarker::extractBits(samples.data(), n, bit, bits.data(), isa);
+				CHECK(bits == reference);
+			}
+		}
+	}
+}
+
+// Edge index of both marker bits of a block read in several transfers
+
+static void edges() {
+	std::mt19937 rng(5);
+	bdfMockAPI* mock = bdfMockAPI::make(1, 2, 2, 100003);
+	std::vector<uint16_t>& samples = mock->samples(0, 1, 1);
+	bool level = false;
+	for (uint16_t& v : samples) {
+		if (rng() % 3000 == 0) level = !level;
+		v = (uint16_t)((v & ~2) | (level ? 2 : 0));
+	}
+	for (auto& block : mock->Groups[0][1].Blocks) block.Info.PreferredTransferSize = 1000;
+
+	bdfMarkerIndex index(mock);
+	for (unsigned marker = 0; marker < 2; marker++) {
+		std::vector<uint64_t> reference;
+		for (size_t k = 1; k < samples.size(); k++) {
+			if (((samples[k] >> marker) & 1) != ((samples[k - 1] >> marker) & 1)) reference.push_back(k);
+		}
+		const bdfMarkerIndex::sMarkerEdges* found = nullptr;
+		CHECK(index.getEdges(0, 1, 1, marker, &found) == bdfAPI::errNoError);
+		CHECK(found && found->Edges == reference && found->InitialLevel == (bool)((samples[0] >> marker) & 1));
+		CHECK(reference.size() > 5);
+		if (reference.size() <= 5) continue;
+
+		uint64_t next;
+		CHECK(index.nextEdge(0, 1, 1, marker, reference[3], next) == bdfAPI::errNoError && next == reference[3]);
+		CHECK(index.nextEdge(0, 1, 1, marker, reference[3] + 1, next) == bdfAPI::errNoError && next == reference[4]);
+		CHECK(index.nextEdge(0, 1, 1, marker, reference.back() + 1, next) == bdfAPI::errNoError && next == samples.size());
+		for (uint64_t address : { (uint64_t)0, (uint64_t)5, reference[2] - 1, reference[2], reference[2] + 1, (uint64_t)samples.size() - 1 }) {
+			bool high;
+			CHECK(index.getLevel(0, 1, 1, marker, address, high) == bdfAPI::errNoError && high == (bool)((samples[(size_t)address] >> marker) & 1));
+		}
+		std::vector<uint64_t> bits;
+		CHECK(index.getMarkerBits(0, 1, 1, 77, 5000, marker, bits) == bdfAPI::errNoError);
+		bool ok = bits.size() * 64 >= 5000;
+		for (int k = 0; ok && k < 5000; k++) ok = ((bits[k / 64] >> (k % 64)) & 1) == ((samples[77 + k] >> marker) & 1u);
+		CHECK(ok);
+	}
+	const bdfMarkerIndex::sMarkerEdges* found = nullptr;
+	CHECK(index.getEdges(0, 1, 1, 2, &found) != bdfAPI::errNoError);
+
+	// the index is cached
+	const int calls = mock->Calls;
+	CHECK(index.getEdges(0, 1, 1, 0, &found) == bdfAPI::errNoError && mock->Calls == calls);
+	delete mock;
+}
+
+int main() {
+	kernels();
+	edges();
+	return bdftest::result();
+}
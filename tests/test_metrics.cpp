@@ -0,0 +1,104 @@
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfMetrics.h"
+
+using namespace filereader;
+
+// Counters of several threads on one collector, estimated envelope levels, the trace and a reset
+
+static void counters() {
+	bdfMetrics metrics;
+	metrics.setTrace(true, 100);
+	const int threads = 4;
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([&, t] {
+			std::unique_ptr<bdfMockAPI> mock(bdfMockAPI::make(1, 2, 2, 1 << 16, t + 1));
+			bdfInstrumentedAPI api(mock.get(), metrics);
+			api.loadFile("metrics.bdf");
+			std::vector<uint16_t> data(4096);
+			std::vector<double> envelope(4000);
+			for (int n = 0; n < 300; n++) api.getRawDataS(0, n % 2, 0, n * 100, data.data(), 4096);
+			api.getRawDataS(0, 5, 0, 0, data.data(), 10);
+			api.getEnvDataD(0, 0, 0, 0, 1 << 16, envelope.data(), 4000);
+			api.getEnvDataD(0, 0, 0, 0, 4000, envelope.data(), 4000);
+			api.writeData(api.initInputStreamer(0, 0, 0), (char*)data.data(), 1000);
+		});
+	}
+	for (std::thread& worker : workers) worker.join();
+
+	std::unique_ptr<bdfMockAPI> mock(bdfMockAPI::make(1, 1, 1, 1 << 16));
+	bdfEnvelope::sEnvelopeEstimate coarse, fine;
+	CHECK(bdfEnvelope::estimateLevel(mock->Groups[0][0].Blocks[0].Info, 1 << 16, 4000, &coarse) == bdfAPI::errNoError);
+	CHECK(bdfEnvelope::estimateLevel(mock->Groups[0][0].Blocks[0].Info, 4000, 4000, &fine) == bdfAPI::errNoError);
+	CHECK(coarse.Level > 0 && fine.Level == 0);
+
+	bdfMetrics::sMetricsStatistics s = metrics.statistics();
+	const bdfMetrics::sFunctionStatistics& raw = s.Functions[bdfMetrics::fnGetRawDataS];
+	CHECK(s.Threads == threads);
+	CHECK(raw.Calls == 301 * threads && raw.Errors == threads);
+	CHECK(bdfMetrics::percentile(raw, 0.5) > 0 && bdfMetrics::percentile(raw, 0.5) <= bdfMetrics::percentile(raw, 0.99));
+	CHECK(s.Functions[bdfMetrics::fnGetEnvDataD].Calls == 2 * threads);
+	CHECK(s.EstimatedEnvelopeLevels[coarse.Level] == threads && s.EstimatedEnvelopeLevels[0] == threads);
+	CHECK(s.BytesWritten == 1000 * threads);
+	CHECK(s.TraceEvents == 100 * threads && s.TraceEventsDropped > 0);
+
+	const std::string fileName = bdftest::tempPath("metrics.json");
+	CHECK(metrics.writeTrace(fileName) == bdfAPI::errNoError);
+	std::ifstream file(fileName);
+	const std::string trace((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	CHECK(trace.find("\"traceEvents\"") != std::string::npos && trace.find("\"name\":\"getRawDataS\"") != std::string::npos);
+
+	metrics.resetStatistics();
+	s = metrics.statistics();
+	CHECK(s.Functions[bdfMetrics::fnGetRawDataS].Calls == 0 && s.EstimatedEnvelopeLevels[0] == 0 && s.TraceEvents == 0);
+
+	// disabled, nothing is recorded
+	bdfInstrumentedAPI api(mock.get(), metrics);
+	metrics.setEnabled(false);
+	uint16_t data[16];
+	api.getRawDataS(0, 0, 0, 0, data, 16);
+	metrics.setEnabled(true);
+	api.getRawDataS(0, 0, 0, 0, data, 16);
+	CHECK(metrics.statistics().Functions[bdfMetrics::fnGetRawDataS].Calls == 1);
+}
+
+// The cache counters are reported relative to attachCache and resetStatistics, the cache itself is not reset
+
+static void cache() {
+	bdfBlockCache cache(1 << 20);
+	const bdfBlockCache::sKey key{ 1, 0, 0, 0, 0, 0, 0, 0 }, missing{ 2, 0, 0, 0, 0, 0, 0, 0 };
+	cache.insert(key, std::make_shared<const std::vector<uint8_t>>(100));
+	cache.find(key);
+	cache.find(missing);
+
+	bdfMetrics metrics;
+	metrics.attachCache(&cache);
+	CHECK(metrics.statistics().CacheHits == 0 && metrics.statistics().CacheMisses == 0);
+	cache.find(key);
+	cache.find(key);
+	cache.find(missing);
+	CHECK(metrics.statistics().CacheHits == 2 && metrics.statistics().CacheMisses == 1);
+
+	metrics.resetStatistics();
+	CHECK(cache.statistics().Hits == 3 && cache.statistics().Misses == 2);
+	cache.find(key);
+	CHECK(metrics.statistics().CacheHits == 1 && metrics.statistics().CacheMisses == 0);
+
+	// reset by its owner
+	cache.resetStatistics();
+	cache.find(missing);
+	CHECK(metrics.statistics().CacheHits == 0 && metrics.statistics().CacheMisses == 1);
+}
+
+int main() {
+	counters();
+	cache();
+	return bdftest::result();
+}
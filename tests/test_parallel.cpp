@@ -0,0 +1,143 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfParallel.h"
+
+using namespace filereader;
+
+// Mock counting the objects alive and closed, "missing.bdf" cannot be opened
+class bdfCountedMock : public bdfMockAPI {
+public:
+	static std::atomic<int>& alive() {
+		static std::atomic<int> n{ 0 };
+		return n;
+	}
+	static std::atomic<int>& closed() {
+		static std::atomic<int> n{ 0 };
+		return n;
+	}
+
+	bdfCountedMock() { alive()++; }
+	virtual ~bdfCountedMock() { alive()--; }
+
+	virtual int loadFile(const char* FileName) override { return std::string(FileName) == "missing.bdf" ? -1 : 0; }
+	virtual void closeFile(int) override { closed()++; }
+};
+
+// Every task runs once, the first tasks are spread over all workers, and the fan-out reads match one API object
+
+static void distribution() {
+	bdfParallelReader reader("parallel.bdf", 4);
+	CHECK(reader.isOpen() && reader.numberOfThreads() == 4 && bdfCountedMock::alive() == 4);
+
+	// a worker holds on to its task until all 4 have one, so the first 4 tasks go to different workers
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::set<bdfAPI*> first;
+	std::vector<std::atomic<int>> runs(1000);
+	bdfAPI::eErrorCode err = reader.run(runs.size(), [&](bdfAPI* api, size_t n) {
+		runs[n]++;
+		if (n < 4) {
+			std::unique_lock<std::mutex> lock(mutex);
+			first.insert(api);
+			condition.notify_all();
+			if (!condition.wait_for(lock, std::chrono::seconds(10), [&] { return first.size() == 4; })) return bdfAPI::errInternal;
+		}
+		return bdfAPI::errNoError;
+	});
+	CHECK(err == bdfAPI::errNoError && first.size() == 4);
+	bool once = true;
+	for (std::atomic<int>& r : runs) once = once && r == 1;
+	CHECK(once);
+	CHECK(reader.run(0, [](bdfAPI*, size_t) { return bdfAPI::errInternal; }) == bdfAPI::errNoError);
+
+	bdfMockAPI* mock = static_cast<bdfMockAPI*>(reader.api());
+	const unsigned count = 3000;
+	std::vector<double> data(4 * count), reference(count);
+	CHECK(reader.getDataD(0, 2, 500, count, { 3, 0, 2, 1 }, data.data()) == bdfAPI::errNoError);
+	bool ok = true;
+	const unsigned inputs[] = { 3, 0, 2, 1 };
+	for (unsigned n = 0; n < 4; n++) {
+		mock->getDataD(0, inputs[n], 2, 500, reference.data(), count);
+		for (unsigned k = 0; k < count; k++) ok = ok && data[n * count + k] == reference[k];
+	}
+	CHECK(ok);
+
+	std::vector<double> blocks(6 * count);
+	CHECK(reader.getDataD(0, 1, { 0, 1, 2, 3, 4, 5 }, 100, count, blocks.data(), bdfConvert::unitPhysical) == bdfAPI::errNoError);
+	ok = true;
+	for (unsigned b = 0; b < 6; b++) {
+		mock->getDataD(0, 1, b, 100, reference.data(), count);
+		for (unsigned k = 0; k < count; k++) ok = ok && std::abs(blocks[b * count + k] - (reference[k] * 10 + 1)) < 1e-9;
+	}
+	CHECK(ok);
+
+	std::vector<double> envelope(2 * 200), envelopeReference(200);
+	CHECK(reader.getEnvDataD(0, 4, 0, 50000, 200, { 1, 3 }, envelope.data()) == bdfAPI::errNoError);
+	mock->getEnvDataD(0, 3, 4, 0, 50000, envelopeReference.data(), 200);
+	CHECK(std::vector<double>(envelope.begin() + 200, envelope.end()) == envelopeReference);
+}
+
+// The first error of a worker is returned, no further tasks are started, and the reader can be used again
+
+static void errors() {
+	bdfParallelReader reader("parallel.bdf", 4);
+	std::atomic<int> started{ 0 };
+	bdfAPI::eErrorCode err = reader.run(10000, [&](bdfAPI*, size_t n) {
+		started++;
+		if (n == 10) return bdfAPI::errResource;
+		if (n > 10) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return n == 11 ? bdfAPI::errInternal : bdfAPI::errNoError;
+	});
+	CHECK((err == bdfAPI::errResource || err == bdfAPI::errInternal) && started < 10000);
+
+	// a read error of one input
+	std::vector<double> data(3 * 100);
+	CHECK(reader.getDataD(0, 0, 0, 100, { 0, 7, 1 }, data.data()) == bdfAPI::errArgument);
+	CHECK(reader.getDataD(0, 0, 0, 100, { 0, 2, 1 }, data.data()) == bdfAPI::errNoError);
+}
+
+// Objects opened by the reader are closed and destroyed, objects passed in are not
+
+static void release() {
+	bdfCountedMock::closed() = 0;
+	{
+		bdfParallelReader reader("parallel.bdf", 3);
+		CHECK(bdfCountedMock::alive() == 3);
+	}
+	CHECK(bdfCountedMock::alive() == 0 && bdfCountedMock::closed() == 3);
+
+	// a file that cannot be opened leaves no object behind
+	{
+		bdfParallelReader reader("missing.bdf", 3);
+		CHECK(!reader.isOpen() && reader.api() == nullptr && bdfCountedMock::alive() == 0);
+		CHECK(reader.run(5, [](bdfAPI*, size_t) { return bdfAPI::errNoError; }) == bdfAPI::errInvalidHandle);
+	}
+
+	bdfCountedMock::closed() = 0;
+	bdfCountedMock first, second;
+	{
+		bdfParallelReader reader(std::vector<bdfAPI*>{ &first, &second });
+		CHECK(reader.numberOfThreads() == 2);
+	}
+	CHECK(bdfCountedMock::alive() == 2 && bdfCountedMock::closed() == 0);
+}
+
+int main() {
+	bdfMockAPI::factory() = [] {
+		bdfCountedMock* m = new bdfCountedMock();
+		m->fill(1, 4, 6, 50000);
+		return m;
+	};
+	distribution();
+	errors();
+	release();
+	return bdftest::result();
+}
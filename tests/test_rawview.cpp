@@ -0,0 +1,58 @@
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfRawView.h"
+
+using namespace filereader;
+
+// View contents over several transfers for 16-bit and 32-bit inputs, repeated ranges, argument errors and closeFile
+
+static void views() {
+	std::unique_ptr<bdfMockAPI> mock(bdfMockAPI::make(1, 2, 2, 20000));
+	mock->Groups[0][1].Info.BytesPerSample = 4;
+	bdfRawViewStore store(mock.get());
+
+	const bdfRawView* view = nullptr;
+	CHECK(store.getView(0, 0, 1, 123, 15000, &view) == bdfAPI::errNoError && view != nullptr);
+	CHECK(view->size() == 15000 && view->address() == 123 && view->bytesPerSample() == 2 && view->sizeInBytes() == 30000);
+	CHECK(view->samplesL() == nullptr && view->data() == view->samplesS());
+	CHECK(memcmp(view->samplesS(), &mock->samples(0, 0, 1)[123], 15000 * sizeof(uint16_t)) == 0);
+
+	const bdfRawView* wide = nullptr;
+	CHECK(store.getView(0, 1, 0, 0, 20000, &wide) == bdfAPI::errNoError && wide != nullptr);
+	CHECK(wide->samplesS() == nullptr && wide->sizeInBytes() == 20000 * sizeof(int32_t));
+	bool same = true;
+	for (size_t k = 0; k < 20000; k++) same = same && wide->samplesL()[k] == (int32_t)mock->samples(0, 1, 0)[k];
+	CHECK(same);
+
+	// the same range is not read again
+	mock->Calls = 0;
+	const bdfRawView* again = nullptr;
+	CHECK(store.getView(0, 0, 1, 123, 15000, &again) == bdfAPI::errNoError && again == view && mock->Calls == 0);
+
+	const bdfRawView* bad = nullptr;
+	CHECK(store.getView(0, 0, 0, 19990, 11, &bad) == bdfAPI::errArgument && bad == nullptr);
+	CHECK(store.getView(0, 0, 0, 20001, 1, &bad) == bdfAPI::errArgument);
+	CHECK(store.getView(0, 0, 0, 0, 0, &bad) == bdfAPI::errArgument);
+	CHECK(store.getView(0, 0, 0, 0, 10, nullptr) == bdfAPI::errArgument);
+	CHECK(store.getView(0, 5, 0, 0, 10, &bad) == bdfAPI::errArgument);
+	CHECK(store.getView(0, 0, 7, 0, 10, &bad) == bdfAPI::errArgument);
+	CHECK(store.getView(0, 0, 0, 19990, 10, &bad) == bdfAPI::errNoError && bad != nullptr);
+
+	// closeFile releases the views and closes the file, a new request reads again
+	store.closeFile();
+	CHECK(mock->Closed == 1);
+	mock->Calls = 0;
+	CHECK(store.getView(0, 0, 1, 123, 15000, &again) == bdfAPI::errNoError && mock->Calls > 0);
+	CHECK(memcmp(again->samplesS(), &mock->samples(0, 0, 1)[123], 15000 * sizeof(uint16_t)) == 0);
+
+	bdfRawViewStore empty(nullptr);
+	CHECK(empty.getView(0, 0, 0, 0, 10, &bad) == bdfAPI::errInvalidHandle);
+}
+
+int main() {
+	views();
+	return bdftest::result();
+}
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfResample.h"
+
+using namespace filereader;
+
+int main() {
+	bdfMockAPI* mock = bdfMockAPI::make(1, 1, 1, 100000);
+	bdfAPI::sBlockInfo& blockInfo = mock->Groups[0][0].Blocks[0].Info;
+	blockInfo.SampleRateHertz = 1e6;
+	blockInfo.TimebaseDivisor = 2; // 500 kHz
+	blockInfo.TriggerSample = 20000;
+	blockInfo.PreferredTransferSize = 3000;
+	const std::vector<uint16_t>& samples = mock->samples(0, 0, 0);
+	const bdfAPI::sInputInfo& inputInfo = mock->Groups[0][0].Info;
+	auto volt = [&](size_t Sample) { return (samples[Sample] & inputInfo.AnalogMask) * inputInfo.BinToVoltFactor + inputInfo.BinToVoltConstant; };
+
+	// decimation by 10 to 50 kHz from sample 0
+	std::vector<double> points(2 * 10000);
+	CHECK(bdfResample::getData(mock, 0, 0, 0, -0.04, 5e4, points.data(), 10000, bdfResample::methodSample) == bdfAPI::errNoError);
+	bool ok = true;
+	for (int k = 0; k < 10000; k++) ok = ok && points[k] == volt(10 * k);
+	CHECK(ok);
+	CHECK(bdfResample::getData(mock, 0, 0, 0, -0.04, 5e4, points.data(), 10000, bdfResample::methodMean) == bdfAPI::errNoError);
+	ok = true;
+	for (int k = 0; k < 10000; k++) {
+		double sum = 0;
+		for (int j = 0; j < 10; j++) sum += samples[10 * k + j] & inputInfo.AnalogMask;
+		ok = ok && std::fabs(points[k] - (sum / 10 * inputInfo.BinToVoltFactor + inputInfo.BinToVoltConstant)) < 1e-12;
+	}
+	CHECK(ok);
+	CHECK(bdfResample::getData(mock, 0, 0, 0, -0.04, 5e4, points.data(), 10000, bdfResample::methodMinMax) == bdfAPI::errNoError);
+	ok = true;
+	for (int k = 0; k < 10000; k++) {
+		double mn = 1e9, mx = -1e9;
+		for (int j = 0; j < 10; j++) {
+			mn = std::min(mn, volt(10 * k + j));
+			mx = std::max(mx, volt(10 * k + j));
+		}
+		ok = ok && points[2 * k] == mn && points[2 * k + 1] == mx;
+	}
+	CHECK(ok);
+
+	// 4x upsampling with hold, starting before the block
+	std::vector<double> hold(1000);
+	CHECK(bdfResample::getData(mock, 0, 0, 0, -0.04 - 4e-6, 2e6, hold.data(), 1000) == bdfAPI::errNoError);
+	ok = true;
+	for (int k = 0; k < 8; k++) ok = ok && std::isnan(hold[k]);
+	for (int k = 8; k < 1000; k++) ok = ok && hold[k] == volt((k - 8) / 4);
+	CHECK(ok);
+
+	// past the end of the block
+	CHECK(bdfResample::getData(mock, 0, 0, 0, 0.159, 1e4, hold.data(), 100, bdfResample::methodMean) == bdfAPI::errNoError);
+	CHECK(!std::isnan(hold[0]) && std::isnan(hold[20]));
+
+	// two timebase segments: 500 kHz up to sample 50000, then 50 kHz
+	const std::vector<bdfResample::sTimebaseSegment> timebase = { { 0, 5e5 }, { 50000, 5e4 } };
+	std::vector<float> dual(100);
+	CHECK(bdfResample::getData(mock, 0, 0, 0, 0.06, 5e4, dual.data(), 100, bdfResample::methodSample, bdfConvert::unitVolt, &timebase) == bdfAPI::errNoError);
+	ok = true;
+	for (int k = 0; k < 100; k++) ok = ok && std::fabs(dual[k] - volt(50000 + k)) < 1e-6;
+	CHECK(ok);
+
+	// blocks of a *Dual operation mode: 100 kHz up to the trigger, 1 MHz up to the stop trigger, then 100 kHz
+	mock->Modes[0] = bdfAPI::multiEventRecorderDual;
+	blockInfo.TimebaseDivisor = 10;
+	blockInfo.StopTriggerSample = 60000;
+	const std::vector<bdfResample::sTimebaseSegment> segments = bdfResample::dualTimebase(blockInfo);
+	CHECK(segments.size() == 3 && segments[0].FirstSample == 0 && segments[0].SampleRateHertz == 1e5);
+	CHECK(segments[1].FirstSample == 20000 && segments[1].SampleRateHertz == 1e6 && segments[2].FirstSample == 60000 && segments[2].SampleRateHertz == 1e5);
+	CHECK(bdfResample::getData(mock, 0, 0, 0, -0.2, 1e5, dual.data(), 100) == bdfAPI::errNoError);
+	ok = true;
+	for (int k = 0; k < 100; k++) ok = ok && std::fabs(dual[k] - volt(k)) < 1e-6;
+	CHECK(ok);
+	CHECK(bdfResample::getData(mock, 0, 0, 0, -1e-5, 1e6, dual.data(), 100) == bdfAPI::errNoError);
+	ok = true;
+	// 10 us before the trigger is the sample before it
+	for (int k = 0; k < 10; k++) ok = ok && std::fabs(dual[k] - volt(19999)) < 1e-6;
+	for (int k = 10; k < 100; k++) ok = ok && std::fabs(dual[k] - volt(20000 + k - 10)) < 1e-6;
+	CHECK(ok);
+	CHECK(bdfResample::getData(mock, 0, 0, 0, 0.04, 1e5, dual.data(), 100) == bdfAPI::errNoError);
+	ok = true;
+	for (int k = 0; k < 100; k++) ok = ok && std::fabs(dual[k] - volt(60000 + k)) < 1e-6;
+	CHECK(ok);
+	// explicit segments are used as given
+	CHECK(bdfResample::getData(mock, 0, 0, 0, 0.06, 5e4, dual.data(), 100, bdfResample::methodSample, bdfConvert::unitVolt, &timebase) == bdfAPI::errNoError);
+	ok = true;
+	for (int k = 0; k < 100; k++) ok = ok && std::fabs(dual[k] - volt(50000 + k)) < 1e-6;
+	CHECK(ok);
+
+	// without a stop trigger the block ends with the fast rate, a trigger at sample 0 starts with it
+	blockInfo.StopTriggerSample = 0;
+	CHECK(bdfResample::dualTimebase(blockInfo).size() == 2);
+	blockInfo.TriggerSample = 0;
+	CHECK(bdfResample::dualTimebase(blockInfo).size() == 1 && bdfResample::dualTimebase(blockInfo)[0].SampleRateHertz == 1e6);
+	mock->Modes[0] = bdfAPI::singleEventRecorderDual;
+	CHECK(bdfResample::getData(mock, 0, 0, 0, 0, 1e6, dual.data(), 100) == bdfAPI::errNoError);
+	ok = true;
+	for (int k = 0; k < 100; k++) ok = ok && std::fabs(dual[k] - volt(k)) < 1e-6;
+	CHECK(ok);
+	delete mock;
+	return bdftest::result();
+}
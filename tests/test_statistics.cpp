@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfStatistics.h"
+
+using namespace filereader;
+
+static bdfStatistics::sRawStatistics reference(const uint16_t* Src, size_t Count, uint32_t Mask) {
+	bdfStatistics::sRawStatistics r = bdfStatistics::empty();
+	long double sum = 0, m2 = 0;
+	for (size_t k = 0; k < Count; k++) {
+		const uint32_t v = Src[k] & Mask;
+		sum += v;
+		r.Min = std::min(r.Min, v);
+		r.Max = std::max(r.Max, v);
+		if (v == 0) r.ClipLow++;
+		if (v == Mask) r.ClipHigh++;
+	}
+	r.Count = Count;
+	r.Mean = (double)(sum / Count);
+	for (size_t k = 0; k < Count; k++) {
+		const long double d = (Src[k] & Mask) - (long double)r.Mean;
+		m2 += d * d;
+	}
+	r.M2 = (double)m2;
+	return r;
+}
+
+// Every kernel against a long double reference, accumulated in two parts
+
+static void kernels() {
+	std::mt19937 rng(3);
+	for (size_t n : { 1, 7, 8, 15, 16, 17, 100, 65536, 65537, 300001 }) {
+		for (uint32_t mask : { 0xFFFFu, 0xFFFCu, 0x3FFFu }) {
+			std::vector<uint16_t> samples(n);
+			for (uint16_t& v : samples) {
+				const int r = rng() % 10;
+				v = r == 0 ? 0 : (r == 1 ? 0xFFFF : (uint16_t)rng());
+			}
+			const bdfStatistics::sRawStatistics expected = reference(samples.data(), n, mask);
+			for (bdfConvert::eInstructionSet isa : { bdfConvert::isaScalar, bdfConvert::isaSSE2, bdfConvert::isaAVX2 }) {
+				bdfStatistics::sRawStatistics s = bdfStatistics::empty();
+				const size_t half = n / 3;
+				bdfStatistics::accumulate(samples.data(), half, mask, s, isa);
+				bdfStatistics::accumulate(samples.data() + half, n - half, mask, s, isa);
+				CHECK(s.Count == expected.Count && s.Min == expected.Min && s.Max == expected.Max && s.ClipLow == expected.ClipLow && s.ClipHigh == expected.ClipHigh);
+				CHECK(std::fabs(s.Mean - expected.Mean) < 1e-9 * expected.Mean + 1e-9);
+				CHECK(std::fabs(s.M2 - expected.M2) <= 1e-9 * expected.M2 + 1e-6);
+			}
+			std::vector<int32_t> wide(samples.begin(), samples.end());
+			bdfStatistics::sRawStatistics s = bdfStatistics::empty();
+			bdfStatistics::accumulate(wide.data(), n, mask, s);
+			CHECK(s.Min == expected.Min && s.ClipHigh == expected.ClipHigh && std::fabs(s.M2 - expected.M2) <= 1e-9 * expected.M2 + 1e-6);
+		}
+	}
+	// a constant signal has no deviation
+	std::vector<uint16_t> constant(100000, 40000);
+	bdfStatistics::sRawStatistics s = bdfStatistics::empty();
+	bdfStatistics::accumulate(constant.data(), constant.size(), 0xFFFF, s);
+	const bdfStatistics::sStatistics scaled = bdfStatistics::scale(s, 1, 0);
+	CHECK(scaled.StdDev < 1e-3 && scaled.Mean == 40000 && scaled.Rms == 40000);
+}
+
+// Statistics of a block through the cache file, against the converted samples
+
+static void cache() {
+	const std::string fileName = bdftest::tempPath("statistics.bdf");
+	{
+		std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+		file << "hello";
+	}
+	std::filesystem::remove(bdfStatisticsCache::cacheFileName(fileName));
+	bdfStatistics::sStatistics computed, loaded;
+	{
+		bdfStatisticsCache statistics(fileName, 4);
+		CHECK(statistics.computeAll() == bdfAPI::errNoError);
+		CHECK(statistics.getStatistics(0, 2, 3, computed, bdfConvert::unitPhysical) == bdfAPI::errNoError);
+	}
+	CHECK(std::filesystem::exists(bdfStatisticsCache::cacheFileName(fileName)));
+	{
+		bdfStatisticsCache statistics(fileName, 4);
+		CHECK(statistics.getStatistics(0, 2, 3, loaded, bdfConvert::unitPhysical) == bdfAPI::errNoError);
+		CHECK(memcmp(&computed, &loaded, sizeof(computed)) == 0);
+	}
+
+	bdfMockAPI* mock = bdfMockAPI::factory()();
+	std::vector<double> data(50000);
+	bdfConvert::getDataD(mock, 0, 2, 3, 0, data.data(), 50000, bdfConvert::unitPhysical);
+	double mn = 1e9, mx = -1e9, sum = 0, squares = 0;
+	for (double v : data) {
+		mn = std::min(mn, v);
+		mx = std::max(mx, v);
+		sum += v;
+		squares += v * v;
+	}
+	CHECK(std::fabs(computed.Min - mn) < 1e-9 && std::fabs(computed.Max - mx) < 1e-9);
+	CHECK(std::fabs(computed.Mean - sum / 50000) < 1e-9 && std::fabs(computed.Rms - std::sqrt(squares / 50000)) < 1e-9);
+	delete mock;
+	std::filesystem::remove(bdfStatisticsCache::cacheFileName(fileName));
+	std::filesystem::remove(fileName);
+}
+
+int main() {
+	kernels();
+	cache();
+	return bdftest::result();
+}
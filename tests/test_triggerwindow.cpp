@@ -0,0 +1,113 @@
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "bdfTest.h"
+#include "bdfMockAPI.h"
+#include "bdfTriggerWindow.h"
+
+using namespace filereader;
+
+static const unsigned triggers[] = { 100, 10000, 19950, 0 };
+
+// Mock with a different trigger sample per block, block 3 has no samples before the trigger
+static bdfMockAPI* makeMock() {
+	bdfMockAPI* mock = bdfMockAPI::make(1, 3, 4, 20000);
+	for (bdfMockAPI::sInput& input : mock->Groups[0]) {
+		for (unsigned b = 0; b < 4; b++) input.Blocks[b].Info.TriggerSample = triggers[b];
+	}
+	return mock;
+}
+
+// Window values and mask against the samples of the mock: sample k of the window is block sample trigger + Offset + k
+template <typename T>
+static bool sameWindows(bdfMockAPI* Mock, const std::vector<unsigned>& Blocks, const std::vector<unsigned>& Inputs, int64_t Offset, unsigned Length,
+	const std::vector<T>& Data, const std::vector<uint8_t>& Valid, bdfConvert::eUnit Unit, double Tolerance) {
+	bool ok = true;
+	for (size_t n = 0; n < Blocks.size(); n++) {
+		for (size_t i = 0; i < Inputs.size(); i++) {
+			std::vector<double> block(20000);
+			Mock->getDataD(0, Inputs[i], Blocks[n], 0, block.data(), 20000);
+			const size_t base = (n * Inputs.size() + i) * Length;
+			for (unsigned k = 0; k < Length; k++) {
+				const int64_t address = (int64_t)triggers[Blocks[n]] + Offset + k;
+				if (address < 0 || address >= 20000) {
+					ok = ok && Valid[base + k] == 0 && std::isnan((double)Data[base + k]);
+					continue;
+				}
+				const double expected = Unit == bdfConvert::unitVolt ? block[(size_t)address] : block[(size_t)address] * 10 + 1;
+				ok = ok && Valid[base + k] == 1 && std::fabs((double)Data[base + k] - expected) <= Tolerance * (1 + std::fabs(expected));
+			}
+		}
+	}
+	return ok;
+}
+
+// Pre- and post-trigger windows clipped at both block edges, blocks in any order, through one API object
+
+static void serial() {
+	std::unique_ptr<bdfMockAPI> mock(makeMock());
+	const std::vector<unsigned> blocks = { 3, 1, 0, 2 }, inputs = { 2, 0 };
+	const unsigned length = 1500;
+	std::vector<double> data(blocks.size() * inputs.size() * length);
+	std::vector<uint8_t> valid(data.size());
+
+	// pre-trigger: clipped at the start of blocks 0 and 3
+	CHECK(bdfTriggerWindows::getWindows(mock.get(), 0, blocks, inputs, -500, length, data.data(), valid.data()) == bdfAPI::errNoError);
+	CHECK(sameWindows(mock.get(), blocks, inputs, -500, length, data, valid, bdfConvert::unitVolt, 1e-15));
+	CHECK(valid[0] == 0 && valid[499] == 0 && valid[500] == 1);
+
+	// post-trigger: clipped at the end of block 2
+	CHECK(bdfTriggerWindows::getWindows(mock.get(), 0, blocks, inputs, 20, length, data.data(), valid.data()) == bdfAPI::errNoError);
+	CHECK(sameWindows(mock.get(), blocks, inputs, 20, length, data, valid, bdfConvert::unitVolt, 1e-15));
+
+	// a window completely before the block is padding only, without a read
+	std::vector<float> floats(data.size());
+	mock->Calls = 0;
+	CHECK(bdfTriggerWindows::getWindows(mock.get(), 0, { 3 }, { 1 }, -5000, length, floats.data(), valid.data(), bdfConvert::unitPhysical) == bdfAPI::errNoError);
+	CHECK(mock->Calls == 0 && std::isnan(floats[0]) && std::isnan(floats[length - 1]) && valid[0] == 0 && valid[length - 1] == 0);
+
+	// all blocks and inputs, float in physical units, a padding value and no mask
+	std::vector<float> all(4 * 3 * 300);
+	CHECK(bdfTriggerWindows::getWindows(mock.get(), 0, {}, {}, -200, 300, all.data(), nullptr, bdfConvert::unitPhysical, -1.0f) == bdfAPI::errNoError);
+	CHECK(all[(3 * 3 + 0) * 300] == -1.0f && all[(3 * 3 + 2) * 300 + 199] == -1.0f && all[(3 * 3 + 2) * 300 + 200] != -1.0f);
+	std::vector<float> selected(3 * 300);
+	std::vector<uint8_t> selectedValid(selected.size());
+	CHECK(bdfTriggerWindows::getWindows(mock.get(), 0, { 1 }, {}, -200, 300, selected.data(), selectedValid.data(), bdfConvert::unitPhysical) == bdfAPI::errNoError);
+	CHECK(memcmp(selected.data(), all.data() + 3 * 300, selected.size() * sizeof(float)) == 0);
+	CHECK(sameWindows(mock.get(), { 1 }, { 0, 1, 2 }, -200, 300, selected, selectedValid, bdfConvert::unitPhysical, 1e-6));
+
+	// a block that does not exist
+	CHECK(bdfTriggerWindows::getWindows(mock.get(), 0, { 1, 7 }, inputs, 0, 10, data.data()) == bdfAPI::errArgument);
+}
+
+// The parallel path gives the same windows as the serial one
+
+static void parallel() {
+	std::vector<std::unique_ptr<bdfMockAPI>> mocks;
+	std::vector<bdfAPI*> apis;
+	for (int t = 0; t < 3; t++) {
+		mocks.emplace_back(makeMock());
+		apis.push_back(mocks.back().get());
+	}
+	bdfParallelReader reader(apis);
+	const std::vector<unsigned> blocks = { 2, 0, 3, 1, 2 }, inputs = { 1, 2, 0 };
+	const unsigned length = 2000;
+	std::vector<double> data(blocks.size() * inputs.size() * length), serialData(data.size());
+	std::vector<uint8_t> valid(data.size()), serialValid(data.size());
+	CHECK(bdfTriggerWindows::getWindows(reader, 0, blocks, inputs, -900, length, data.data(), valid.data()) == bdfAPI::errNoError);
+	CHECK(bdfTriggerWindows::getWindows(mocks[0].get(), 0, blocks, inputs, -900, length, serialData.data(), serialValid.data()) == bdfAPI::errNoError);
+	CHECK(valid == serialValid);
+	bool same = true;
+	for (size_t k = 0; k < data.size(); k++) same = same && (data[k] == serialData[k] || (std::isnan(data[k]) && std::isnan(serialData[k])));
+	CHECK(same);
+	CHECK(sameWindows(mocks[0].get(), blocks, inputs, -900, length, data, valid, bdfConvert::unitVolt, 1e-15));
+
+	CHECK(bdfTriggerWindows::getWindows(reader, 0, { 0, 9 }, inputs, 0, 10, data.data()) == bdfAPI::errArgument);
+}
+
+int main() {
+	serial();
+	parallel();
+	return bdftest::result();
+}